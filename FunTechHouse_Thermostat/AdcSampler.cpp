@@ -0,0 +1,218 @@
+/**
+ * @file AdcSampler.cpp
+ * @author Johan Simonsson
+ * @brief Continuous interrupt driven sampling of the analog inputs
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined(__AVR__)
+#include <Arduino.h>
+#else
+#include <stddef.h>
+#define A0 14 ///< The first analog pin, like on the Uno
+#endif
+
+#include "AdcSampler.h"
+
+/**
+ * The sampler that gets the adc interrupts.
+ */
+static AdcSampler* adcSamplerActive = NULL;
+
+#if defined(__AVR__)
+/**
+ * A conversion is done.
+ */
+ISR(ADC_vect)
+{
+    if(NULL != adcSamplerActive)
+    {
+        adcSamplerActive->isr();
+    }
+}
+#endif
+
+/**
+ * The default constructor, no channels and no extra bits.
+ */
+AdcSampler::AdcSampler()
+{
+    count   = 0;
+    current = 0;
+    for( int i=0 ; i<ADC_SAMPLER_CHANNELS ; i++ )
+    {
+        mux[i]   = 0;
+        value[i] = 0;
+        valid[i] = false;
+    }
+}
+
+/**
+ * Add a analog input to sample, must be done before begin().
+ *
+ * @param pin the analog input, A0..A7 (or 0..7)
+ * @return the channel to use with getValue(), or -1 if there is no channel left
+ */
+int8_t AdcSampler::addChannel(uint8_t pin)
+{
+    if(count >= ADC_SAMPLER_CHANNELS)
+    {
+        return -1;
+    }
+
+    //Same as analogRead
+    if(pin >= A0)
+    {
+        pin -= A0;
+    }
+    mux[count] = pin & 0x07;
+    count++;
+    return count-1;
+}
+
+/**
+ * How many extra bits, must be done before begin().
+ *
+ * @param bits extra bits, 0..OVERSAMPLE_BITS_MAX
+ */
+void AdcSampler::setBits(uint8_t bits)
+{
+    for( int i=0 ; i<ADC_SAMPLER_CHANNELS ; i++ )
+    {
+        sample[i].setBits(bits);
+    }
+}
+
+/**
+ * How many extra bits is used?
+ *
+ * @return extra bits, the values is (0..1023<<bits)
+ */
+uint8_t AdcSampler::getBits()
+{
+    return sample[0].getBits();
+}
+
+/**
+ * Select the reference and input for the next conversion.
+ *
+ * @param channel the channel to sample
+ */
+void AdcSampler::selectChannel(uint8_t channel)
+{
+    current = channel;
+#if defined(__AVR__)
+    ADMUX = (1<<REFS1) | (1<<REFS0) | mux[channel];
+#endif
+}
+
+/**
+ * Start the sampling, the adc interrupt is used from now on.
+ */
+void AdcSampler::begin()
+{
+    if(0 == count)
+    {
+        return;
+    }
+
+    adcSamplerActive = this;
+    selectChannel(0);
+
+#if defined(__AVR__)
+    //Enable, interrupt, clock/128 and start the first conversion.
+    ADCSRA = (1<<ADEN) | (1<<ADIE) | (1<<ADPS2) | (1<<ADPS1) | (1<<ADPS0) | (1<<ADSC);
+#endif
+}
+
+/**
+ * The last value for a channel.
+ *
+ * @param channel from addChannel()
+ * @param value [out] the value, (0..1023<<bits)
+ * @return true if ok, false if there is no value yet.
+ */
+bool AdcSampler::getValue(int8_t channel, uint16_t* value)
+{
+    if( (channel < 0) || (channel >= count) )
+    {
+        return false;
+    }
+
+#if defined(__AVR__)
+    //The interrupt must not update the value while we read it.
+    uint8_t sreg = SREG;
+    cli();
+#endif
+    bool ok = valid[channel];
+    *value = this->value[channel];
+#if defined(__AVR__)
+    SREG = sreg;
+#endif
+
+    return ok;
+}
+
+/**
+ * Take care of the last conversion and start the next,
+ * only to be called from the adc interrupt.
+ */
+void AdcSampler::isr()
+{
+#if defined(__AVR__)
+    uint16_t reading = ADC;
+#else
+    uint16_t reading = 0;
+#endif
+
+    if(sample[current].addValue(reading))
+    {
+        value[current] = sample[current].getValue();
+        valid[current] = true;
+
+        uint8_t next = current+1;
+        if(next >= count)
+        {
+            next = 0;
+        }
+        selectChannel(next);
+    }
+
+#if defined(__AVR__)
+    ADCSRA |= (1<<ADSC);
+#endif
+}
+
+#if !defined(__AVR__)
+/**
+ * Set the value for a channel, there is no adc on the pc.
+ *
+ * @param channel from addChannel()
+ * @param value the value, (0..1023<<bits)
+ */
+void AdcSampler::setValue(int8_t channel, uint16_t value)
+{
+    if( (channel < 0) || (channel >= count) )
+    {
+        return;
+    }
+    this->value[channel] = value;
+    valid[channel] = true;
+}
+#endif
@@ -0,0 +1,79 @@
+/**
+ * @file AdcSampler.h
+ * @author Johan Simonsson
+ * @brief Continuous interrupt driven sampling of the analog inputs
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __ADCSAMPLER_H
+#define  __ADCSAMPLER_H
+
+#include <stdint.h>
+
+#include "Oversample.h"
+
+/**
+ * Most analog inputs that can be sampled.
+ */
+#define ADC_SAMPLER_CHANNELS 4
+
+/**
+ * Samples the analog inputs all the time from the ADC interrupt,
+ * so the main loop does not have to wait for analogRead.
+ *
+ * The inputs is sampled one at a time, 4^bits samples each (Oversample),
+ * then the next input is selected. The conversion is started from the interrupt
+ * after the mux is changed, so no sample is taken from the wrong input.
+ *
+ * With the adc clock at 16MHz/128 one sample takes 104us,
+ * so 3 inputs with 2 extra bits is 3*16*104us = 5ms for new values on all.
+ *
+ * The reference is the internal 1.1V (like analogReference(INTERNAL) on a ATmega328),
+ * and analogRead must not be used when the sampler is running.
+ */
+class AdcSampler
+{
+    private:
+        uint8_t mux[ADC_SAMPLER_CHANNELS];             ///< The adc mux for every channel
+        Oversample sample[ADC_SAMPLER_CHANNELS];       ///< The current sum for every channel
+        volatile uint16_t value[ADC_SAMPLER_CHANNELS]; ///< The last value for every channel
+        volatile bool valid[ADC_SAMPLER_CHANNELS];     ///< There is a value for the channel
+        uint8_t count;            ///< How many channels is used
+        volatile uint8_t current; ///< The channel that is sampled now
+
+        void selectChannel(uint8_t channel);
+
+    public:
+        AdcSampler();
+
+        int8_t addChannel(uint8_t pin);
+        void setBits(uint8_t bits);
+        uint8_t getBits();
+
+        void begin();
+        bool getValue(int8_t channel, uint16_t* value);
+
+        void isr();
+
+#if !defined(__AVR__)
+        void setValue(int8_t channel, uint16_t value);
+#endif
+};
+
+#endif  // __ADCSAMPLER_H
@@ -0,0 +1,260 @@
+/**
+ * @file AnalogSensor.cpp
+ * @author Johan Simonsson
+ * @brief Conversion of analog sensor readings with calibration and segment tables
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#else
+#define PROGMEM
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#endif
+
+#include "AnalogSensor.h"
+#include "LVTS.h"
+
+/*
+ * Made by test/test_AnalogSensor (ANALOG_TABLE=ntc10k),
+ * Steinhart-Hart from R25=10k and B=3950.
+ */
+const AnalogPoint analogNtc10k[] PROGMEM = {
+    {   51,  12425 },
+    {   55,  12122 },
+    {   60,  11778 },
+    {   66,  11408 },
+    {   72,  11076 },
+    {   79,  10727 },
+    {   86,  10413 },
+    {   94,  10089 },
+    {  103,   9761 },
+    {  113,   9434 },
+    {  124,   9111 },
+    {  137,   8769 },
+    {  152,   8419 },
+    {  168,   8087 },
+    {  186,   7755 },
+    {  206,   7426 },
+    {  229,   7090 },
+    {  255,   6753 },
+    {  284,   6421 },
+    {  316,   6095 },
+    {  353,   5761 },
+    {  395,   5426 },
+    {  441,   5101 },
+    {  494,   4769 },
+    {  553,   4441 },
+    {  619,   4115 },
+    {  695,   3782 },
+    {  779,   3453 },
+    {  877,   3112 },
+    {  986,   2772 },
+    { 1023,   2665 }
+};
+const uint8_t analogNtc10kSize = sizeof(analogNtc10k)/sizeof(AnalogPoint);
+
+/**
+ * The default constructor, no curve and no calibration.
+ */
+AnalogSensor::AnalogSensor()
+{
+    curve = 0;
+    curveSize = 0;
+    clearCalibration();
+}
+
+/**
+ * The segment table to use for ANALOG_CURVE.
+ *
+ * @param curve [in] the points in flash (PROGMEM), sorted on the reading
+ * @param size how many points, at least 2
+ */
+void AnalogSensor::setCurve(const AnalogPoint* curve, uint8_t size)
+{
+    this->curve = curve;
+    this->curveSize = size;
+}
+
+/**
+ * Two point calibration, i.e. measured in ice water and in boiling water.
+ *
+ * The gain must be 0.5..2, else the calibration is not used.
+ *
+ * @param measured1 the first point as measured in 0.01 degC
+ * @param true1 the first point, the true value in 0.01 degC
+ * @param measured2 the second point as measured in 0.01 degC
+ * @param true2 the second point, the true value in 0.01 degC
+ * @return true if ok, false if bad values.
+ */
+bool AnalogSensor::setCalibration(int16_t measured1, int16_t true1, int16_t measured2, int16_t true2)
+{
+    int32_t measuredDiff = (int32_t)measured2 - measured1;
+    int32_t trueDiff     = (int32_t)true2 - true1;
+    if(0 == measuredDiff)
+    {
+        return false;
+    }
+
+    int32_t g = (trueDiff << ANALOG_GAIN_SHIFT) / measuredDiff;
+    if( (g < (1L << (ANALOG_GAIN_SHIFT-1))) || (g > (1L << (ANALOG_GAIN_SHIFT+1))) )
+    {
+        return false;
+    }
+
+    calMeasured = measured1;
+    calTrue     = true1;
+    gain        = g;
+    return true;
+}
+
+/**
+ * No calibration, the values is used as they are.
+ */
+void AnalogSensor::clearCalibration()
+{
+    calMeasured = 0;
+    calTrue     = 0;
+    gain        = 1L << ANALOG_GAIN_SHIFT;
+}
+
+/**
+ * Use the calibration on a value.
+ *
+ * @param centi the measured value in 0.01 degC
+ * @return the calibrated value in 0.01 degC
+ */
+int16_t AnalogSensor::calibrate(int16_t centi)
+{
+    //The gain is max 2.0, so this fits in 32bit
+    int32_t value = ((int32_t)centi - calMeasured) * gain;
+    value = (value + (1L << (ANALOG_GAIN_SHIFT-1))) >> ANALOG_GAIN_SHIFT;
+    value += calTrue;
+
+    if(value > 32767)
+    {
+        value = 32767;
+    }
+    else if(value < -32767)
+    {
+        value = -32767;
+    }
+    return (int16_t)value;
+}
+
+/**
+ * Convert a reading to a calibrated temperature.
+ *
+ * @param type the sensor type
+ * @param reading from analogRead, (0..1023<<extraBits).
+ * @param ok becomes true if ok, false if fail.
+ * @param extraBits the reading is oversampled with this many extra bits
+ * @return temperature in 0.01 degC
+ */
+int16_t AnalogSensor::convert(Sensor::SensorTypes type, uint16_t reading, bool *ok, uint8_t extraBits)
+{
+    int16_t centi = 0;
+    switch(type)
+    {
+        case Sensor::LM35DZ:
+            centi = LVTS::lm35Centi(reading, ok, extraBits);
+            break;
+        case Sensor::LM34DZ:
+            centi = LVTS::lm34Centi(reading, ok, extraBits);
+            break;
+        case Sensor::NTC_10K:
+            centi = interpolate(analogNtc10k, analogNtc10kSize, reading, ok, extraBits);
+            break;
+        case Sensor::ANALOG_CURVE:
+            centi = interpolate(curve, curveSize, reading, ok, extraBits);
+            break;
+        default:
+            *ok = false;
+            break;
+    }
+
+    if(false == *ok)
+    {
+        return 0;
+    }
+    return calibrate(centi);
+}
+
+/**
+ * Look up a reading in a segment table, with linear interpolation between the points.
+ *
+ * @param curve [in] the points in flash (PROGMEM), sorted on the reading
+ * @param size how many points
+ * @param reading the reading, (0..1023<<extraBits).
+ * @param ok becomes true if ok, false if outside the table.
+ * @param extraBits the reading is oversampled with this many extra bits
+ * @return temperature in 0.01 degC
+ */
+int16_t AnalogSensor::interpolate(const AnalogPoint* curve, uint8_t size,
+        uint16_t reading, bool *ok, uint8_t extraBits)
+{
+    *ok = false;
+    if( (0 == curve) || (size < 2) )
+    {
+        return 0;
+    }
+
+    uint32_t first = ((uint32_t)pgm_read_word(&curve[0].reading)) << extraBits;
+    uint32_t last  = ((uint32_t)pgm_read_word(&curve[size-1].reading)) << extraBits;
+    if( (reading < first) || (reading > last) )
+    {
+        return 0;
+    }
+
+    //Binary search for the segment, low <= reading < high
+    uint8_t low  = 0;
+    uint8_t high = size-1;
+    while( (high - low) > 1 )
+    {
+        uint8_t mid = (low + high) / 2;
+        if( (((uint32_t)pgm_read_word(&curve[mid].reading)) << extraBits) <= reading )
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    int32_t x0 = ((int32_t)pgm_read_word(&curve[low].reading))  << extraBits;
+    int32_t x1 = ((int32_t)pgm_read_word(&curve[high].reading)) << extraBits;
+    int32_t y0 = (int16_t)pgm_read_word(&curve[low].centi);
+    int32_t y1 = (int16_t)pgm_read_word(&curve[high].centi);
+
+    *ok = true;
+    if(x1 <= x0)
+    {
+        return (int16_t)y0;
+    }
+
+    //Rounded to nearest, also when the curve goes down
+    int32_t num = (y1 - y0) * (reading - x0);
+    int32_t den = x1 - x0;
+    if(num >= 0)
+    {
+        return (int16_t)(y0 + ((num + den/2) / den));
+    }
+    return (int16_t)(y0 + ((num - den/2) / den));
+}
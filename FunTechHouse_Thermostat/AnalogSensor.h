@@ -0,0 +1,92 @@
+/**
+ * @file AnalogSensor.h
+ * @author Johan Simonsson
+ * @brief Conversion of analog sensor readings with calibration and segment tables
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __ANALOGSENSOR_H
+#define  __ANALOGSENSOR_H
+
+#include <stdint.h>
+
+#include "Sensor.h"
+
+/**
+ * Full gain for setCalibration(), 1.0 is 1<<14.
+ */
+#define ANALOG_GAIN_SHIFT 14
+
+/**
+ * One point in a segment table.
+ */
+typedef struct
+{
+    uint16_t reading; ///< The 10bit reading, (0..1023)
+    int16_t  centi;   ///< The temperature in 0.01 degC
+} AnalogPoint;
+
+/**
+ * NTC 10k B3950, from GND to the input with 33k to 5V (1.1V reference).
+ * Valid from 26.6 to 124 degC, within 0.06 degC.
+ */
+extern const AnalogPoint analogNtc10k[];
+extern const uint8_t analogNtc10kSize;
+
+/**
+ * Converts a reading from a analog sensor to 0.01 degC, without floating point.
+ *
+ * - LM35DZ and LM34DZ uses the LVTS tables.
+ * - NTC_10K uses the analogNtc10k segment table.
+ * - ANALOG_CURVE uses a segment table from setCurve(),
+ *   i.e. a polynomial or a other NTC.
+ *
+ * The segment tables is points with linear interpolation between them,
+ * and they are stored in flash (PROGMEM). A NTC is Steinhart-Hart
+ * and a polynomial is a polynomial, so the tables is made on the pc
+ * where log() and pow() is free (see test/test_AnalogSensor).
+ *
+ * Then a two point calibration (gain and offset) can be added on top.
+ */
+class AnalogSensor
+{
+    private:
+        const AnalogPoint* curve; ///< Segment table in flash for ANALOG_CURVE
+        uint8_t curveSize;        ///< Points in the table
+
+        int16_t calMeasured; ///< The first calibration point, as measured in 0.01 degC
+        int16_t calTrue;     ///< The first calibration point, the true value in 0.01 degC
+        int32_t gain;        ///< The calibration gain, 1<<ANALOG_GAIN_SHIFT is 1.0
+
+    public:
+        AnalogSensor();
+
+        void setCurve(const AnalogPoint* curve, uint8_t size);
+
+        bool setCalibration(int16_t measured1, int16_t true1, int16_t measured2, int16_t true2);
+        void clearCalibration();
+        int16_t calibrate(int16_t centi);
+
+        int16_t convert(Sensor::SensorTypes type, uint16_t reading, bool *ok, uint8_t extraBits = 0);
+
+        static int16_t interpolate(const AnalogPoint* curve, uint8_t size,
+                uint16_t reading, bool *ok, uint8_t extraBits = 0);
+};
+
+#endif  // __ANALOGSENSOR_H
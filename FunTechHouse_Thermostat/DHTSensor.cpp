@@ -0,0 +1,358 @@
+/**
+ * @file DHTSensor.cpp
+ * @author Johan Simonsson
+ * @brief DHT11, DHT21 and DHT22 read in the background with pin change interrupts
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+
+#if defined(__AVR__)
+#include <Arduino.h>
+#endif
+
+#include "DHTSensor.h"
+#include "Sensor.h"
+
+/**
+ * The sensor that is read now, and gets the pin change interrupts.
+ */
+static DHTSensor* dhtActive = NULL;
+
+#if defined(__AVR__)
+/**
+ * A pin has changed, the same for all three ports.
+ */
+ISR(PCINT0_vect)
+{
+    if(NULL != dhtActive)
+    {
+        dhtActive->isr();
+    }
+}
+
+ISR(PCINT1_vect)
+{
+    if(NULL != dhtActive)
+    {
+        dhtActive->isr();
+    }
+}
+
+ISR(PCINT2_vect)
+{
+    if(NULL != dhtActive)
+    {
+        dhtActive->isr();
+    }
+}
+#endif
+
+/**
+ * The default constructor, call begin() before it is used.
+ *
+ * @param pin the data pin (not used on the pc)
+ * @param type Sensor::DHT_11, Sensor::DHT_21 or Sensor::DHT_22
+ */
+DHTSensor::DHTSensor(uint8_t pin, uint8_t type)
+{
+#if defined(__AVR__)
+    this->pin = pin;
+    mask = digitalPinToBitMask(pin);
+    reg  = portInputRegister(digitalPinToPort(pin));
+    lastLevel = 0;
+#else
+    (void)pin;
+#endif
+    this->type = type;
+    state  = DHT_STATE_IDLE;
+    waited = 0;
+
+    edgeCount = 0;
+    lastFall  = 0;
+
+    temperature = 0;
+    humidity    = 0;
+    errors      = 0;
+    valid       = false;
+}
+
+/**
+ * Release the pin, the first read is DHT_INTERVAL later
+ * (the sensor needs 1-2s after power on).
+ */
+void DHTSensor::begin()
+{
+#if defined(__AVR__)
+    pinMode(pin, INPUT_PULLUP);
+#endif
+    state  = DHT_STATE_IDLE;
+    waited = 0;
+}
+
+/**
+ * Call this every 10ms, it starts the next read and
+ * decodes the frame from the interrupt. It never waits.
+ *
+ * @param ms the time since the last call
+ */
+void DHTSensor::poll(uint16_t ms)
+{
+    if(waited < 0xFFFF - ms)
+    {
+        waited += ms;
+    }
+
+    if(DHT_STATE_IDLE == state)
+    {
+        //Time to read, and no other sensor has the interrupt
+        if( (waited < DHT_INTERVAL) || (NULL != dhtActive) )
+        {
+            return;
+        }
+        dhtActive = this;
+        pinLow();
+        state  = DHT_STATE_START;
+        waited = 0;
+        return;
+    }
+
+    if(DHT_STATE_START == state)
+    {
+        uint16_t start = DHT_START_DHT22;
+        if(Sensor::DHT_11 == type)
+        {
+            start = DHT_START_DHT11;
+        }
+        if(waited < start)
+        {
+            return;
+        }
+        edgeCount = 0;
+        captureStart();
+        state  = DHT_STATE_CAPTURE;
+        waited = 0;
+        return;
+    }
+
+    //The frame is about 5ms, then the last edge is there
+    if( (edgeCount < DHT_EDGES) && (waited < DHT_TIMEOUT) )
+    {
+        return;
+    }
+    captureStop();
+    dhtActive = NULL;
+    state  = DHT_STATE_IDLE;
+    waited = 0;
+
+    if(decode())
+    {
+        errors = 0;
+        valid  = true;
+    }
+    else if(errors < DHT_ERRORS_MAX)
+    {
+        errors++;
+        if(DHT_ERRORS_MAX == errors)
+        {
+            valid = false;
+        }
+    }
+}
+
+/**
+ * Is a read running?
+ *
+ * @return true if the pin is used
+ */
+bool DHTSensor::isBusy()
+{
+    return (DHT_STATE_IDLE != state);
+}
+
+/**
+ * The 40 bits from the edge times, with the checksum and range checked.
+ *
+ * @return true if ok, and the new values is saved
+ */
+bool DHTSensor::decode()
+{
+    if(edgeCount < DHT_EDGES)
+    {
+        return false;
+    }
+
+    //The response is 80us low and 80us high
+    if(width[0] <= DHT_BIT_ONE)
+    {
+        return false;
+    }
+
+    uint8_t data[5] = { 0, 0, 0, 0, 0 };
+    for( uint8_t i=0 ; i<40 ; i++ )
+    {
+        uint8_t time = width[i+1];
+        if( (time < DHT_BIT_MIN) || (time > DHT_BIT_MAX) )
+        {
+            return false;
+        }
+        data[i/8] <<= 1;
+        if(time > DHT_BIT_ONE)
+        {
+            data[i/8] |= 1;
+        }
+    }
+
+    if( (uint8_t)(data[0] + data[1] + data[2] + data[3]) != data[4] )
+    {
+        return false;
+    }
+
+    int16_t temp;
+    int16_t hum;
+    if(Sensor::DHT_11 == type)
+    {
+        //Whole %RH and degC, the newer has tenths in the second byte
+        hum  = (data[0] * 100) + ((data[1] % 10) * 10);
+        temp = (data[2] * 100) + ((data[3] & 0x0F) * 10);
+        if(data[3] & 0x80)
+        {
+            temp = -temp;
+        }
+    }
+    else
+    {
+        //0.1 %RH and 0.1 degC, the highest bit is the sign
+        hum  = (((uint16_t)data[0] << 8) | data[1]) * 10;
+        temp = ((((uint16_t)data[2] & 0x7F) << 8) | data[3]) * 10;
+        if(data[2] & 0x80)
+        {
+            temp = -temp;
+        }
+    }
+
+    //The DHT22 range is -40..80degC
+    if( (hum > 10000) || (temp < -4000) || (temp > 8000) )
+    {
+        return false;
+    }
+
+    temperature = temp;
+    humidity    = hum;
+    return true;
+}
+
+/**
+ * The last temperature.
+ *
+ * @param ok becomes true if ok, false if there is no valid value
+ * @return temperature in 0.01 degC
+ */
+int16_t DHTSensor::getTemperature(bool *ok)
+{
+    *ok = valid;
+    return valid ? temperature : 0;
+}
+
+/**
+ * The last humidity.
+ *
+ * @param ok becomes true if ok, false if there is no valid value
+ * @return relative humidity in 0.01 %RH
+ */
+int16_t DHTSensor::getHumidity(bool *ok)
+{
+    *ok = valid;
+    return valid ? humidity : 0;
+}
+
+/**
+ * The pin change interrupt, the falling edges is saved.
+ */
+void DHTSensor::isr()
+{
+#if defined(__AVR__)
+    uint8_t level = *reg & mask;
+    if( (0 == level) && (0 != lastLevel) )
+    {
+        fall((uint16_t)micros());
+    }
+    lastLevel = level;
+#endif
+}
+
+/**
+ * A falling edge, the time from the last one is saved.
+ *
+ * @param us the time in us (only the difference is used)
+ */
+void DHTSensor::fall(uint16_t us)
+{
+    if(edgeCount >= DHT_EDGES)
+    {
+        return;
+    }
+    if(edgeCount > 0)
+    {
+        uint16_t time = us - lastFall;
+        width[edgeCount-1] = (time > 255) ? 255 : time;
+    }
+    lastFall = us;
+    edgeCount++;
+}
+
+/**
+ * Start the sensor, the pin is low until captureStart().
+ */
+void DHTSensor::pinLow()
+{
+#if defined(__AVR__)
+    digitalWrite(pin, LOW);
+    pinMode(pin, OUTPUT);
+#endif
+}
+
+/**
+ * Release the pin and turn on the interrupt,
+ * the sensor answers 20-40us later.
+ */
+void DHTSensor::captureStart()
+{
+#if defined(__AVR__)
+    pinMode(pin, INPUT_PULLUP);
+    lastLevel = *reg & mask;
+    *digitalPinToPCMSK(pin) |= (1 << digitalPinToPCMSKbit(pin));
+    PCIFR = (1 << digitalPinToPCICRbit(pin));
+    *digitalPinToPCICR(pin) |= (1 << digitalPinToPCICRbit(pin));
+#endif
+}
+
+/**
+ * Turn off the interrupt for the pin.
+ */
+void DHTSensor::captureStop()
+{
+#if defined(__AVR__)
+    *digitalPinToPCMSK(pin) &= ~(1 << digitalPinToPCMSKbit(pin));
+    if(0 == *digitalPinToPCMSK(pin))
+    {
+        *digitalPinToPCICR(pin) &= ~(1 << digitalPinToPCICRbit(pin));
+    }
+#endif
+}
@@ -0,0 +1,117 @@
+/**
+ * @file DHTSensor.h
+ * @author Johan Simonsson
+ * @brief DHT11, DHT21 and DHT22 read in the background with pin change interrupts
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __DHTSENSOR_H
+#define  __DHTSENSOR_H
+
+#include <stdint.h>
+
+/**
+ * The value is not valid after this many bad reads in a row,
+ * before that the last good value is kept.
+ */
+#define DHT_ERRORS_MAX 3
+
+#define DHT_INTERVAL    2000 ///< ms between the reads, the DHT22 needs 2s
+#define DHT_START_DHT11   18 ///< ms low to start a DHT11
+#define DHT_START_DHT22    1 ///< ms low to start a DHT21 and DHT22
+#define DHT_TIMEOUT       20 ///< ms to wait for the frame (it is about 5ms)
+
+/**
+ * The falling edges in a frame, the start of the response
+ * and then one before and after every bit.
+ */
+#define DHT_EDGES 42
+
+/**
+ * From falling edge to falling edge is 50us low and 26-28us high for a 0,
+ * and 50us low and 70us high for a 1.
+ */
+#define DHT_BIT_MIN  50 ///< Shorter is a glitch
+#define DHT_BIT_ONE 100 ///< Longer is a 1
+#define DHT_BIT_MAX 170 ///< Longer is a lost edge
+
+/**
+ * What poll() is doing.
+ */
+#define DHT_STATE_IDLE    0 ///< Waits for the next read
+#define DHT_STATE_START   1 ///< The pin is low to start the sensor
+#define DHT_STATE_CAPTURE 2 ///< The interrupt saves the edges
+
+/**
+ * A DHT11, DHT21 (AM2301) or DHT22 (AM2302) on one pin.
+ *
+ * The usual drivers waits for the whole 40 bit frame with the interrupts off (5ms).
+ * Here poll() pulls the pin low to start the sensor and releases it
+ * the next call, then the pin change interrupt saves the time of every
+ * falling edge and the next poll() decodes the frame from the times.
+ * So nothing waits, and the other interrupts (OneWireEngine) can run.
+ *
+ * Call poll() every 10ms, with the ms since the last call.
+ * Only one sensor is read at a time, the others waits for the interrupt.
+ *
+ * On the pc there is no interrupt, the tests call fall() with the times.
+ */
+class DHTSensor
+{
+    private:
+#if defined(__AVR__)
+        uint8_t pin;                ///< The pin
+        uint8_t mask;               ///< The pin in the port
+        volatile uint8_t* reg;      ///< The input register of the port
+        volatile uint8_t lastLevel; ///< The pin at the last interrupt
+#endif
+        uint8_t type;       ///< Sensor::DHT_11, DHT_21 or DHT_22
+        uint8_t state;      ///< DHT_STATE_*
+        uint16_t waited;    ///< ms in this state
+
+        volatile uint8_t edgeCount;      ///< Falling edges saved
+        volatile uint16_t lastFall;      ///< The time of the last edge in us
+        uint8_t width[DHT_EDGES-1];      ///< us between the edges, 255 is longer
+
+        int16_t temperature; ///< The last value in 0.01 degC
+        int16_t humidity;    ///< The last value in 0.01 %RH
+        uint8_t errors;      ///< Bad reads in a row
+        bool valid;          ///< There is a good value
+
+        bool decode();
+
+        void pinLow();
+        void captureStart();
+        void captureStop();
+
+    public:
+        DHTSensor(uint8_t pin, uint8_t type);
+        void begin();
+
+        void poll(uint16_t ms);
+        bool isBusy();
+
+        int16_t getTemperature(bool *ok);
+        int16_t getHumidity(bool *ok);
+
+        void isr();
+        void fall(uint16_t us);
+};
+
+#endif  // __DHTSENSOR_H
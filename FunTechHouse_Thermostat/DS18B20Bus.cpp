@@ -0,0 +1,785 @@
+/**
+ * @file DS18B20Bus.cpp
+ * @author Johan Simonsson
+ * @brief Many DS18B20 on one OneWire bus, read without waiting
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "DS18B20Bus.h"
+
+/**
+ * The conversion time in ms for 9, 10, 11 and 12 bit (93.75 is rounded up).
+ */
+static const uint16_t conversionTime[4] = { 94, 188, 375, 750 };
+
+/**
+ * The default constructor, call begin() to find the devices.
+ *
+ * @param bus the bus the devices is on
+ */
+DS18B20Bus::DS18B20Bus(OneWireBus* bus)
+{
+    this->bus = bus;
+    count = 0;
+    converting = false;
+
+    heartbeat = 1;
+    heartbeatCnt = 0;
+
+    copyPending = false;
+    waited = 0;
+    hold = false;
+    step = DS18B20_STEP_IDLE;
+
+    for( uint8_t i=0 ; i<DS18B20_DEVICES_MAX ; i++ )
+    {
+        alarmHigh[i] = DS18B20_ALARM_HIGH_OFF;
+        alarmLow[i]  = DS18B20_ALARM_LOW_OFF;
+        config[i]    = DS18B20_CONFIG_12BIT;
+        dirty[i]     = false;
+    }
+}
+
+/**
+ * Is this a family that we can read?
+ *
+ * @param family the first byte in the ROM code
+ * @return true if DS18S20, DS18B20 or DS1822
+ */
+bool DS18B20Bus::isFamily(uint8_t family)
+{
+    return ( (DS18B20_FAMILY_DS18S20 == family) ||
+             (DS18B20_FAMILY_DS18B20 == family) ||
+             (DS18B20_FAMILY_DS1822  == family) );
+}
+
+/**
+ * Search the bus and save the ROM codes,
+ * devices with a bad crc or of a other family is not used.
+ *
+ * The alarm levels from setAlarm() is kept (for the same index)
+ * and written to the devices by the next tick().
+ *
+ * @return how many devices was found
+ */
+uint8_t DS18B20Bus::begin()
+{
+    uint8_t addr[8];
+
+    count = 0;
+    converting = false;
+    step = DS18B20_STEP_IDLE;
+
+    bus->resetSearch();
+    while( (count < DS18B20_DEVICES_MAX) && bus->search(addr) )
+    {
+        addRom(addr);
+    }
+    bus->resetSearch();
+    heartbeatCnt = 0;
+
+    return count;
+}
+
+/**
+ * Add a known device without a search (i.e. saved in the EEPROM),
+ * call this instead of begin().
+ *
+ * A device that is not on the bus gets bad reads, see hasLost().
+ *
+ * @param rom [in] the 8 byte ROM code
+ * @return the index, or -1 if bad crc, other family or no room
+ */
+int8_t DS18B20Bus::addRom(const uint8_t* rom)
+{
+    if( (count >= DS18B20_DEVICES_MAX) ||
+        (OneWireBus::crc8(rom, 7) != rom[7]) || !isFamily(rom[0]) )
+    {
+        return -1;
+    }
+
+    int8_t index = findRom(rom);
+    if(index >= 0)
+    {
+        return index;
+    }
+
+    memcpy(this->rom[count], rom, 8);
+    raw[count]    = 0;
+    errors[count] = 0;
+    valid[count]  = false;
+    dirty[count]  = true;
+    return count++;
+}
+
+/**
+ * Is there a device that has not answered for DS18B20_ERRORS_MAX reads?
+ * Then it is time for a new search with begin().
+ *
+ * @return true if a device is lost
+ */
+bool DS18B20Bus::hasLost()
+{
+    for( uint8_t i=0 ; i<count ; i++ )
+    {
+        if(errors[i] >= DS18B20_ERRORS_MAX)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Read the last conversion and start the next,
+ * call this once every tick (at least 750ms apart).
+ *
+ * All devices is read every heartbeat tick,
+ * and the ticks between only the devices with a alarm.
+ *
+ * This waits for the bus, see poll() to do it in the background.
+ */
+void DS18B20Bus::tick()
+{
+    if(0 == count)
+    {
+        return;
+    }
+
+    if(DS18B20_STEP_IDLE == step)
+    {
+        startTick();
+    }
+    while( (DS18B20_STEP_IDLE != step) && (DS18B20_STEP_HOLD != step) )
+    {
+        if(ONEWIRE_XFER_BUSY != bus->getTransferState())
+        {
+            runStep();
+        }
+    }
+}
+
+/**
+ * Call this often (every 10-100ms) instead of tick(),
+ * it starts the tick() when the conversion is done.
+ *
+ * With a bus that does the transfers in the background (OneWireEngine)
+ * every call only starts the next one, except when a tick between the heartbeats
+ * starts and the Alarm Search waits for the bus (see the class doc).
+ *
+ * @param ms the time since the last call
+ */
+void DS18B20Bus::poll(uint16_t ms)
+{
+    if(0 == count)
+    {
+        return;
+    }
+
+    if(DS18B20_STEP_IDLE == step)
+    {
+        if(converting)
+        {
+            if(waited < 0xFFFF - ms)
+            {
+                waited += ms;
+            }
+            if(waited < getConversionTime())
+            {
+                return;
+            }
+        }
+        startTick();
+    }
+
+    while( (DS18B20_STEP_IDLE != step) && (DS18B20_STEP_HOLD != step) &&
+           (ONEWIRE_XFER_BUSY != bus->getTransferState()) )
+    {
+        runStep();
+    }
+}
+
+/**
+ * Wait with the conversion after the reads and writes,
+ * until convert() is called (used by DS18B20Group).
+ *
+ * @param hold true to wait, false to convert at once (default)
+ */
+void DS18B20Bus::setHold(bool hold)
+{
+    this->hold = hold;
+}
+
+/**
+ * Start a tick now, without waiting for the conversion time,
+ * then call runNext() until the tick is done.
+ * Nothing is done if a tick is already running.
+ */
+void DS18B20Bus::startRead()
+{
+    if( (0 == count) || (DS18B20_STEP_IDLE != step) )
+    {
+        return;
+    }
+    startTick();
+}
+
+/**
+ * Take care of the last transfer and start the next one,
+ * if the bus is not busy.
+ *
+ * @return true if something was done, false if busy, held or no tick
+ */
+bool DS18B20Bus::runNext()
+{
+    if( (DS18B20_STEP_IDLE == step) || (DS18B20_STEP_HOLD == step) ||
+        (ONEWIRE_XFER_BUSY == bus->getTransferState()) )
+    {
+        return false;
+    }
+    runStep();
+    return true;
+}
+
+/**
+ * Is the tick waiting for convert() (see setHold)?
+ *
+ * @return true if held
+ */
+bool DS18B20Bus::isHeld()
+{
+    return (DS18B20_STEP_HOLD == step);
+}
+
+/**
+ * Start the conversion when held, call runNext() after this
+ * so the tick is done when the transfer is.
+ */
+void DS18B20Bus::convert()
+{
+    if( (DS18B20_STEP_HOLD == step) && (ONEWIRE_XFER_BUSY != bus->getTransferState()) )
+    {
+        runStep();
+    }
+}
+
+/**
+ * Is a tick running (from poll)?
+ *
+ * @return true if the bus is used
+ */
+bool DS18B20Bus::isBusy()
+{
+    return (DS18B20_STEP_IDLE != step);
+}
+
+/**
+ * What devices to read this tick,
+ * all every heartbeat and else the devices with a alarm.
+ */
+void DS18B20Bus::startTick()
+{
+    readCount = 0;
+
+    if(converting)
+    {
+        if(0 == heartbeatCnt)
+        {
+            for( uint8_t i=0 ; i<count ; i++ )
+            {
+                readList[readCount++] = i;
+            }
+        }
+        else
+        {
+            //The devices without a valid value, and the ones with a alarm
+            bool done[DS18B20_DEVICES_MAX];
+            for( uint8_t i=0 ; i<count ; i++ )
+            {
+                done[i] = !valid[i];
+                if(done[i])
+                {
+                    readList[readCount++] = i;
+                }
+            }
+
+            uint8_t addr[8];
+            uint8_t found = 0;
+            bus->resetSearch();
+            while( (found < count) && bus->search(addr, true) )
+            {
+                found++;
+                int8_t index = findRom(addr);
+                if( (index >= 0) && !done[index] )
+                {
+                    readList[readCount++] = index;
+                    done[index] = true;
+                }
+            }
+            bus->resetSearch();
+        }
+
+        heartbeatCnt++;
+        if(heartbeatCnt >= heartbeat)
+        {
+            heartbeatCnt = 0;
+        }
+    }
+
+    step = DS18B20_STEP_READ;
+    stepIndex = 0;
+    pending = false;
+}
+
+/**
+ * Take care of the last transfer and start the next,
+ * call when the bus is not busy.
+ *
+ * The steps is: read the devices in readList, write TH, TL and config
+ * to the dirty devices, copy to the EEPROM (then no conversion this tick)
+ * and start the next conversion.
+ */
+void DS18B20Bus::runStep()
+{
+    uint8_t state = bus->getTransferState();
+
+    if(pending)
+    {
+        pending = false;
+        if(DS18B20_STEP_READ == step)
+        {
+            uint8_t index = readList[stepIndex++];
+            readDone(index, (ONEWIRE_XFER_DONE == state) && checkScratchpad(index, rxBuf));
+        }
+        else if(DS18B20_STEP_WRITE == step)
+        {
+            if(ONEWIRE_XFER_DONE == state)
+            {
+                dirty[stepIndex] = false;
+            }
+            stepIndex++;
+        }
+        else if(DS18B20_STEP_COPY == step)
+        {
+            //The copy needs the bus for 10ms, so no conversion this time
+            if(ONEWIRE_XFER_DONE == state)
+            {
+                copyPending = false;
+                converting = false;
+                step = DS18B20_STEP_IDLE;
+                return;
+            }
+            step = DS18B20_STEP_CONVERT;
+        }
+        else
+        {
+            converting = (ONEWIRE_XFER_DONE == state);
+            waited = 0;
+            step = DS18B20_STEP_IDLE;
+            return;
+        }
+    }
+
+    if(DS18B20_STEP_READ == step)
+    {
+        if(stepIndex < readCount)
+        {
+            pending = startSelect(readList[stepIndex], DS18B20_CMD_READ_SCRATCH, 0, 9);
+            return;
+        }
+        step = DS18B20_STEP_WRITE;
+        stepIndex = 0;
+    }
+
+    if(DS18B20_STEP_WRITE == step)
+    {
+        while( (stepIndex < count) && !dirty[stepIndex] )
+        {
+            stepIndex++;
+        }
+        if(stepIndex < count)
+        {
+            //The DS18S20 has no config register
+            txBuf[10] = (uint8_t)alarmHigh[stepIndex];
+            txBuf[11] = (uint8_t)alarmLow[stepIndex];
+            txBuf[12] = config[stepIndex];
+            uint8_t len = (DS18B20_FAMILY_DS18S20 == rom[stepIndex][0]) ? 2 : 3;
+            pending = startSelect(stepIndex, DS18B20_CMD_WRITE_SCRATCH, len, 0);
+            return;
+        }
+        step = DS18B20_STEP_COPY;
+    }
+
+    if(DS18B20_STEP_COPY == step)
+    {
+        bool written = true;
+        for( uint8_t i=0 ; i<count ; i++ )
+        {
+            if(dirty[i])
+            {
+                written = false;
+            }
+        }
+
+        //Keep the bus high during the copy (10ms), the next reset stops that
+        if(copyPending && written)
+        {
+            txBuf[0] = ONEWIRE_CMD_SKIP_ROM;
+            txBuf[1] = DS18B20_CMD_COPY_SCRATCH;
+            pending = bus->transfer(ONEWIRE_XFER_RESET | ONEWIRE_XFER_POWER, txBuf, 2, 0, 0);
+            return;
+        }
+        step = DS18B20_STEP_CONVERT;
+    }
+
+    //Wait for the other buses, convert() continues from here
+    if( hold && (DS18B20_STEP_HOLD != step) )
+    {
+        step = DS18B20_STEP_HOLD;
+        return;
+    }
+
+    //Keep the bus high for parasite powered devices, the next reset stops that
+    step = DS18B20_STEP_CONVERT;
+    txBuf[0] = ONEWIRE_CMD_SKIP_ROM;
+    txBuf[1] = DS18B20_CMD_CONVERT;
+    pending = bus->transfer(ONEWIRE_XFER_RESET | ONEWIRE_XFER_POWER, txBuf, 2, 0, 0);
+}
+
+/**
+ * Read all devices every n ticks, and only the devices with a alarm between.
+ *
+ * @param ticks 1 reads all devices every tick (default), 0 is the same as 1
+ */
+void DS18B20Bus::setHeartbeat(uint8_t ticks)
+{
+    if(0 == ticks)
+    {
+        ticks = 1;
+    }
+    heartbeat = ticks;
+    heartbeatCnt = 0;
+}
+
+/**
+ * The alarm levels in the device (TH and TL),
+ * the device has a alarm when the temperature is >= high or <= low.
+ *
+ * This can be done before begin(), and is written by the next tick().
+ *
+ * @param index the device, 0..DS18B20_DEVICES_MAX-1
+ * @param low TL in degC, DS18B20_ALARM_LOW_OFF for no low alarm
+ * @param high TH in degC, DS18B20_ALARM_HIGH_OFF for no high alarm
+ * @return true if ok
+ */
+bool DS18B20Bus::setAlarm(uint8_t index, int8_t low, int8_t high)
+{
+    if(index >= DS18B20_DEVICES_MAX)
+    {
+        return false;
+    }
+
+    if(high > DS18B20_ALARM_HIGH_OFF)
+    {
+        high = DS18B20_ALARM_HIGH_OFF;
+    }
+    if(low < DS18B20_ALARM_LOW_OFF)
+    {
+        low = DS18B20_ALARM_LOW_OFF;
+    }
+
+    if( (alarmHigh[index] != high) || (alarmLow[index] != low) )
+    {
+        alarmHigh[index] = high;
+        alarmLow[index]  = low;
+        dirty[index]     = true;
+    }
+    return true;
+}
+
+/**
+ * The resolution of one device,
+ * it is written to the device and copied to its EEPROM by the next tick().
+ *
+ * The DS18S20 is always 9bit (with the count remain),
+ * so this has no effect on that.
+ *
+ * @param index the device, 0..DS18B20_DEVICES_MAX-1
+ * @param bits 9..12
+ * @return true if ok
+ */
+bool DS18B20Bus::setResolution(uint8_t index, uint8_t bits)
+{
+    if( (index >= DS18B20_DEVICES_MAX) ||
+        (bits < DS18B20_RESOLUTION_MIN) || (bits > DS18B20_RESOLUTION_MAX) )
+    {
+        return false;
+    }
+
+    uint8_t value = ((bits - DS18B20_RESOLUTION_MIN) << 5) | 0x1F;
+    if(config[index] != value)
+    {
+        config[index] = value;
+        dirty[index]  = true;
+        copyPending   = true;
+    }
+    return true;
+}
+
+/**
+ * The resolution of one device.
+ *
+ * @param index the device
+ * @return 9..12 bit, 0 if no such device
+ */
+uint8_t DS18B20Bus::getResolution(uint8_t index)
+{
+    if(index >= count)
+    {
+        return 0;
+    }
+    if(DS18B20_FAMILY_DS18S20 == rom[index][0])
+    {
+        return DS18B20_RESOLUTION_MIN;
+    }
+    return DS18B20_RESOLUTION_MIN + ((config[index] >> 5) & 0x03);
+}
+
+/**
+ * How long the conversion takes, all devices is converted at once
+ * so this is the time of the slowest device.
+ *
+ * @return the time in ms
+ */
+uint16_t DS18B20Bus::getConversionTime()
+{
+    uint16_t time = conversionTime[0];
+    for( uint8_t i=0 ; i<count ; i++ )
+    {
+        uint8_t res = (config[i] >> 5) & 0x03;
+        if(DS18B20_FAMILY_DS18S20 == rom[i][0])
+        {
+            res = 3;
+        }
+        if(conversionTime[res] > time)
+        {
+            time = conversionTime[res];
+        }
+    }
+    return time;
+}
+
+/**
+ * Count the errors after a read.
+ *
+ * @param index the device
+ * @param ok true if the read was ok
+ */
+void DS18B20Bus::readDone(uint8_t index, bool ok)
+{
+    if(ok)
+    {
+        errors[index] = 0;
+    }
+    else if(errors[index] < DS18B20_ERRORS_MAX)
+    {
+        errors[index]++;
+        if(DS18B20_ERRORS_MAX == errors[index])
+        {
+            valid[index] = false;
+        }
+    }
+}
+
+/**
+ * Start a command to one device (Match ROM).
+ *
+ * @param index the device
+ * @param command the command after the ROM code
+ * @param dataLen bytes after the command, from txBuf[10]
+ * @param rxLen bytes to read into rxBuf
+ * @return true if started
+ */
+bool DS18B20Bus::startSelect(uint8_t index, uint8_t command, uint8_t dataLen, uint8_t rxLen)
+{
+    txBuf[0] = ONEWIRE_CMD_MATCH_ROM;
+    memcpy(&txBuf[1], rom[index], 8);
+    txBuf[9] = command;
+    return bus->transfer(ONEWIRE_XFER_RESET, txBuf, 10+dataLen, rxBuf, rxLen);
+}
+
+/**
+ * Check a scratchpad and save the temperature.
+ *
+ * @param index the device
+ * @param data [in] the 9 byte scratchpad
+ * @return true if ok, false if bad crc or value
+ */
+bool DS18B20Bus::checkScratchpad(uint8_t index, const uint8_t* data)
+{
+    uint8_t all = 0;
+    for( uint8_t i=0 ; i<9 ; i++ )
+    {
+        all |= data[i];
+    }
+
+    //All zero has a good crc, but is a shorted bus
+    if( (0 == all) || (OneWireBus::crc8(data, 8) != data[8]) )
+    {
+        return false;
+    }
+
+    //The device has lost TH, TL or config (i.e. after a power loss)
+    if( ((int8_t)data[2] != alarmHigh[index]) || ((int8_t)data[3] != alarmLow[index]) ||
+        ((DS18B20_FAMILY_DS18S20 != rom[index][0]) && (data[4] != config[index])) )
+    {
+        dirty[index] = true;
+    }
+
+    int16_t value = toRaw(data, rom[index][0]);
+
+    //85degC is the power on value, before the first conversion
+    if( !valid[index] && (value == (85*16)) )
+    {
+        return false;
+    }
+
+    //Datasheet tells us
+    //-"Measures temperatures from -55°C to +125°C"
+    //so if it not in that range... something is wrong!
+    if( (value > (125*16)) || (value < (-55*16)) )
+    {
+        return false;
+    }
+
+    raw[index]   = value;
+    valid[index] = true;
+    return true;
+}
+
+/**
+ * The temperature from a scratchpad.
+ *
+ * @param data [in] the 9 byte scratchpad
+ * @param family the first byte in the ROM code
+ * @return temperature in 1/16 degC
+ */
+int16_t DS18B20Bus::toRaw(const uint8_t* data, uint8_t family)
+{
+    int16_t value = (int16_t)((((uint16_t)data[1]) << 8) | data[0]);
+
+    if(DS18B20_FAMILY_DS18S20 == family)
+    {
+        value = value << 3; // 9 bit resolution, 0.5 degC
+        if(data[7] == 0x10)
+        {
+            // count remain gives full 12 bit resolution
+            value = (value & 0xFFF0) + 12 - data[6];
+        }
+    }
+    else
+    {
+        // at lower resolution the low bits is undefined
+        uint8_t cfg = (data[4] & 0x60);
+        if(cfg == 0x00)
+        {
+            value &= ~7; // 9 bit resolution, 93.75 ms
+        }
+        else if(cfg == 0x20)
+        {
+            value &= ~3; // 10 bit res, 187.5 ms
+        }
+        else if(cfg == 0x40)
+        {
+            value &= ~1; // 11 bit res, 375 ms
+        }
+        // default is 12 bit resolution, 750 ms conversion time
+    }
+    return value;
+}
+
+/**
+ * How many devices was found by begin()?
+ *
+ * @return number of devices
+ */
+uint8_t DS18B20Bus::getCount()
+{
+    return count;
+}
+
+/**
+ * The ROM code for a device.
+ *
+ * @param index the device, 0..getCount()-1
+ * @return the 8 byte ROM code, or NULL if there is no such device
+ */
+const uint8_t* DS18B20Bus::getRom(uint8_t index)
+{
+    if(index >= count)
+    {
+        return 0;
+    }
+    return rom[index];
+}
+
+/**
+ * Find a device from the ROM code.
+ *
+ * @param rom [in] the 8 byte ROM code
+ * @return the index, or -1 if it is not on the bus
+ */
+int8_t DS18B20Bus::findRom(const uint8_t* rom)
+{
+    for( uint8_t i=0 ; i<count ; i++ )
+    {
+        if(0 == memcmp(this->rom[i], rom, 8))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * The last temperature from a device.
+ *
+ * @param index the device, 0..getCount()-1
+ * @param ok becomes true if ok, false if there is no valid value
+ * @return temperature in 0.01 degC
+ */
+int16_t DS18B20Bus::getCenti(uint8_t index, bool *ok)
+{
+    if( (index >= count) || !valid[index] )
+    {
+        *ok = false;
+        return 0;
+    }
+
+    //1/16 to 1/100, rounded
+    int32_t value = ((int32_t)raw[index]) * 100;
+    *ok = true;
+    if(value >= 0)
+    {
+        return (int16_t)((value + 8) / 16);
+    }
+    return (int16_t)((value - 8) / 16);
+}
@@ -0,0 +1,190 @@
+/**
+ * @file DS18B20Bus.h
+ * @author Johan Simonsson
+ * @brief Many DS18B20 on one OneWire bus, read without waiting
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __DS18B20BUS_H
+#define  __DS18B20BUS_H
+
+#include <stdint.h>
+
+#include "OneWireBus.h"
+
+/**
+ * Most devices on one bus, every device is 8+2+7 bytes RAM.
+ */
+#ifndef DS18B20_DEVICES_MAX
+#define DS18B20_DEVICES_MAX 8
+#endif
+
+/**
+ * A device is not valid after this many bad reads in a row,
+ * before that the last good value is kept.
+ */
+#define DS18B20_ERRORS_MAX 3
+
+/**
+ * The family codes (first byte in the ROM code).
+ */
+#define DS18B20_FAMILY_DS18S20 0x10 ///< DS18S20 and the old DS1820
+#define DS18B20_FAMILY_DS18B20 0x28 ///< DS18B20
+#define DS18B20_FAMILY_DS1822  0x22 ///< DS1822
+
+/**
+ * The DS18B20 commands.
+ */
+#define DS18B20_CMD_CONVERT      0x44 ///< Convert T
+#define DS18B20_CMD_READ_SCRATCH  0xBE ///< Read Scratchpad
+#define DS18B20_CMD_WRITE_SCRATCH 0x4E ///< Write Scratchpad (TH, TL and config)
+#define DS18B20_CMD_COPY_SCRATCH  0x48 ///< Copy Scratchpad to the EEPROM
+
+/**
+ * TH and TL when there is no alarm, the device range.
+ */
+#define DS18B20_ALARM_HIGH_OFF 125
+#define DS18B20_ALARM_LOW_OFF  (-55)
+
+/**
+ * The config register for 12bit, the power on default.
+ */
+#define DS18B20_CONFIG_12BIT 0x7F
+
+/**
+ * The resolution in the config register (bit 5 and 6), 9..12 bit.
+ */
+#define DS18B20_RESOLUTION_MIN 9
+#define DS18B20_RESOLUTION_MAX 12
+
+/**
+ * The steps in a tick, see runStep().
+ */
+#define DS18B20_STEP_IDLE    0 ///< Waiting for the conversion
+#define DS18B20_STEP_READ    1 ///< Read the scratchpads
+#define DS18B20_STEP_WRITE   2 ///< Write TH, TL and config
+#define DS18B20_STEP_COPY    3 ///< Copy the scratchpads to the EEPROM
+#define DS18B20_STEP_CONVERT 4 ///< Start the next conversion
+#define DS18B20_STEP_HOLD    5 ///< Waiting for the other buses, see setHold()
+
+/**
+ * Many DS18B20 (and DS18S20, DS1822) on one OneWire bus.
+ *
+ * The bus is searched once with begin() and the ROM codes is saved,
+ * then every tick() does:
+ * - Read the scratchpad from every device, the result from the last tick.
+ *   The crc is checked, and a bad read keeps the last value.
+ * - Start a new conversion on all devices at once (Skip ROM, Convert T).
+ *
+ * The conversion takes 750ms (12bit), so with one tick every second
+ * there is no need to wait.
+ *
+ * With setResolution() the conversion is faster (94ms at 9bit),
+ * then call poll() more often and it does the tick() as soon as
+ * the slowest device is done.
+ *
+ * Every read and write is one OneWireBus::transfer(), so with a bus that
+ * does the transfers in the background (OneWireEngine) poll() only starts them.
+ *
+ * With many devices the reads is most of the bus time (about 10ms each),
+ * so with setHeartbeat() all devices is only read every n ticks.
+ * The ticks between only reads the devices with a alarm (Alarm Search),
+ * the device sets the alarm flag if the temperature is >= TH or <= TL
+ * (setAlarm, in whole degC). So with TH and TL just inside the alarm levels
+ * a alarm is still seen the next tick.
+ * The Alarm Search is done with OneWireBus::search() when the tick starts,
+ * every bit is a read and a write that depends on it so it is not a transfer().
+ * Then poll() waits for the bus, about 14ms for every device with a alarm
+ * (longer with OneWirePin) and about 1.5ms when there is none.
+ * So a short heartbeat is best when many devices can have a alarm at once.
+ *
+ * With many buses (one for every pin) use DS18B20Group instead of tick()
+ * and poll(), it starts the conversion on all buses at once.
+ */
+class DS18B20Bus
+{
+    private:
+        OneWireBus* bus; ///< The bus
+
+        uint8_t rom[DS18B20_DEVICES_MAX][8]; ///< The ROM codes
+        int16_t raw[DS18B20_DEVICES_MAX];    ///< The last value in 1/16 degC
+        uint8_t errors[DS18B20_DEVICES_MAX]; ///< Bad reads in a row
+        bool    valid[DS18B20_DEVICES_MAX];  ///< There is a good value
+        uint8_t count;   ///< How many devices
+        bool converting; ///< A conversion is started, read it the next tick
+
+        int8_t  alarmHigh[DS18B20_DEVICES_MAX]; ///< TH in degC
+        int8_t  alarmLow[DS18B20_DEVICES_MAX];  ///< TL in degC
+        uint8_t config[DS18B20_DEVICES_MAX];    ///< The config register
+        bool    dirty[DS18B20_DEVICES_MAX];     ///< TH, TL and config must be written
+
+        uint8_t heartbeat;    ///< Read all devices every n ticks
+        uint8_t heartbeatCnt; ///< Ticks since all devices was read
+
+        bool copyPending;    ///< The config must be copied to the EEPROM
+        uint16_t waited;     ///< ms since the conversion was started, see poll()
+
+        bool hold;         ///< Wait with the conversion until convert()
+        uint8_t step;      ///< What the tick is doing, DS18B20_STEP_*
+        uint8_t stepIndex; ///< Where in the step
+        bool    pending;   ///< A transfer for the step is started
+        uint8_t readList[DS18B20_DEVICES_MAX]; ///< The devices to read this tick
+        uint8_t readCount; ///< How many in readList
+        uint8_t txBuf[13]; ///< Match ROM, ROM code, command and TH, TL, config
+        uint8_t rxBuf[9];  ///< The scratchpad
+
+        void startTick();
+        void runStep();
+        bool startSelect(uint8_t index, uint8_t command, uint8_t dataLen, uint8_t rxLen);
+        void readDone(uint8_t index, bool ok);
+        bool checkScratchpad(uint8_t index, const uint8_t* data);
+        static bool isFamily(uint8_t family);
+
+    public:
+        DS18B20Bus(OneWireBus* bus);
+
+        uint8_t begin();
+        int8_t addRom(const uint8_t* rom);
+        bool hasLost();
+        void tick();
+        void poll(uint16_t ms);
+        bool isBusy();
+
+        void setHold(bool hold);
+        void startRead();
+        bool runNext();
+        bool isHeld();
+        void convert();
+
+        void setHeartbeat(uint8_t ticks);
+        bool setAlarm(uint8_t index, int8_t low, int8_t high);
+        bool setResolution(uint8_t index, uint8_t bits);
+        uint8_t getResolution(uint8_t index);
+        uint16_t getConversionTime();
+
+        uint8_t getCount();
+        const uint8_t* getRom(uint8_t index);
+        int8_t findRom(const uint8_t* rom);
+
+        int16_t getCenti(uint8_t index, bool *ok);
+
+        static int16_t toRaw(const uint8_t* data, uint8_t family);
+};
+
+#endif  // __DS18B20BUS_H
@@ -0,0 +1,248 @@
+/**
+ * @file DS18B20Group.cpp
+ * @author Johan Simonsson
+ * @brief DS18B20 on many OneWire buses, converted at once
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DS18B20Group.h"
+
+/**
+ * The default constructor, add the buses and call begin().
+ */
+DS18B20Group::DS18B20Group()
+{
+    count = 0;
+    next = 0;
+    converting = false;
+    waited = 0;
+}
+
+/**
+ * Add a bus to the group, the conversion on it is then started by the group.
+ *
+ * @param bus the bus
+ * @return true if ok, false if there is DS18B20_GROUP_MAX buses already
+ */
+bool DS18B20Group::add(DS18B20Bus* bus)
+{
+    if( (0 == bus) || (count >= DS18B20_GROUP_MAX) )
+    {
+        return false;
+    }
+    bus->setHold(true);
+    buses[count++] = bus;
+    return true;
+}
+
+/**
+ * Search all buses for devices.
+ *
+ * @return how many devices was found on all buses
+ */
+uint8_t DS18B20Group::begin()
+{
+    uint8_t devices = 0;
+    for( uint8_t i=0 ; i<count ; i++ )
+    {
+        devices += buses[i]->begin();
+    }
+    converting = false;
+    waited = 0;
+    return devices;
+}
+
+/**
+ * Read the last conversion on all buses and start the next,
+ * call this once every tick (at least 750ms apart).
+ *
+ * This waits for the buses, see poll() to do it in the background.
+ */
+void DS18B20Group::tick()
+{
+    if(!isBusy())
+    {
+        converting = false;
+        for( uint8_t i=0 ; i<count ; i++ )
+        {
+            buses[i]->startRead();
+        }
+    }
+    while(isBusy())
+    {
+        run();
+    }
+}
+
+/**
+ * Call this often (every 10-100ms) instead of tick(),
+ * it starts the reads when the conversion is done on all buses.
+ *
+ * It never waits for a bus that is busy in the background.
+ *
+ * @param ms the time since the last call
+ */
+void DS18B20Group::poll(uint16_t ms)
+{
+    if(!isBusy())
+    {
+        if(converting)
+        {
+            if(waited < 0xFFFF - ms)
+            {
+                waited += ms;
+            }
+            if(waited < getConversionTime())
+            {
+                return;
+            }
+        }
+
+        converting = false;
+        for( uint8_t i=0 ; i<count ; i++ )
+        {
+            buses[i]->startRead();
+        }
+    }
+    run();
+}
+
+/**
+ * One transfer on every bus in turn, until all buses is busy or held.
+ * When all is held the conversion is started on all at once.
+ */
+void DS18B20Group::run()
+{
+    if(0 == count)
+    {
+        return;
+    }
+
+    bool progress = true;
+    while(progress)
+    {
+        progress = false;
+        for( uint8_t i=0 ; i<count ; i++ )
+        {
+            if(buses[(next + i) % count]->runNext())
+            {
+                progress = true;
+            }
+        }
+
+        if(!progress && isHeld())
+        {
+            for( uint8_t i=0 ; i<count ; i++ )
+            {
+                if(buses[i]->isHeld())
+                {
+                    buses[i]->convert();
+                    converting = true;
+                    progress = true;
+                }
+            }
+            waited = 0;
+        }
+    }
+    next = (next + 1) % count;
+}
+
+/**
+ * Is all buses done with the reads, and some waits for the conversion?
+ *
+ * @return true if it is time for convert()
+ */
+bool DS18B20Group::isHeld()
+{
+    bool held = false;
+    for( uint8_t i=0 ; i<count ; i++ )
+    {
+        if(buses[i]->isHeld())
+        {
+            held = true;
+        }
+        else if(buses[i]->isBusy())
+        {
+            return false;
+        }
+    }
+    return held;
+}
+
+/**
+ * Is a tick running on some bus (from poll)?
+ *
+ * @return true if a bus is used
+ */
+bool DS18B20Group::isBusy()
+{
+    for( uint8_t i=0 ; i<count ; i++ )
+    {
+        if(buses[i]->isBusy())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * How many buses is in the group?
+ *
+ * @return number of buses
+ */
+uint8_t DS18B20Group::getCount()
+{
+    return count;
+}
+
+/**
+ * One bus in the group, to read the devices on it.
+ *
+ * @param index the bus, 0..getCount()-1
+ * @return the bus, or NULL if there is no such bus
+ */
+DS18B20Bus* DS18B20Group::getBus(uint8_t index)
+{
+    if(index >= count)
+    {
+        return 0;
+    }
+    return buses[index];
+}
+
+/**
+ * How long the conversion takes, all buses is converted at once
+ * so this is the time of the slowest device on any bus.
+ *
+ * @return the time in ms
+ */
+uint16_t DS18B20Group::getConversionTime()
+{
+    uint16_t time = 0;
+    for( uint8_t i=0 ; i<count ; i++ )
+    {
+        uint16_t busTime = buses[i]->getConversionTime();
+        if(busTime > time)
+        {
+            time = busTime;
+        }
+    }
+    return time;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file DS18B20Group.h
+ * @author Johan Simonsson
+ * @brief DS18B20 on many OneWire buses, converted at once
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __DS18B20GROUP_H
+#define  __DS18B20GROUP_H
+
+#include <stdint.h>
+
+#include "DS18B20Bus.h"
+
+/**
+ * Most buses in a group, the OneWire pins is A0..A5, 2..3 and 5..9.
+ */
+#define DS18B20_GROUP_MAX 4
+
+/**
+ * Many DS18B20Bus (one for every pin) that is read as one.
+ *
+ * Every tick the scratchpads is read from all buses, one transfer
+ * on every bus in turn, so a bus in the background (OneWireEngine)
+ * works while the others is read. When all buses is done with the reads
+ * the conversion is started on all of them at once,
+ * so all values is ready after one conversion time (the slowest device).
+ *
+ * Use tick() or poll() on the group instead of on the buses,
+ * the devices and values is still read from each DS18B20Bus.
+ */
+class DS18B20Group
+{
+    private:
+        DS18B20Bus* buses[DS18B20_GROUP_MAX]; ///< The buses
+        uint8_t count;    ///< How many buses
+        uint8_t next;     ///< The bus to start with, so all gets the first transfer
+        bool converting;  ///< A conversion is started on some bus
+        uint16_t waited;  ///< ms since the conversion was started, see poll()
+
+        void run();
+        bool isHeld();
+
+    public:
+        DS18B20Group();
+
+        bool add(DS18B20Bus* bus);
+        uint8_t begin();
+        void tick();
+        void poll(uint16_t ms);
+        bool isBusy();
+
+        uint8_t getCount();
+        DS18B20Bus* getBus(uint8_t index);
+        uint16_t getConversionTime();
+};
+
+#endif  // __DS18B20GROUP_H
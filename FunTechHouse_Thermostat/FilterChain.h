@@ -0,0 +1,305 @@
+/**
+ * @file FilterChain.h
+ * @author Johan Simonsson
+ * @brief Filter stages on raw adc counts that is put together at compile time
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __FILTERCHAIN_H
+#define  __FILTERCHAIN_H
+
+#include <stdint.h>
+
+#include "RingFilter.h"
+#include "SortedWindow.h"
+#include "SpikeFilter.h"
+
+/**
+ * Filter stages and a chain to put them together at compile time,
+ * i.e. FilterChain< FilterMedian<5>, FilterEma<2>, FilterClamp<0,977> >.
+ *
+ * All stages work on raw uint16_t adc counts, so there is no floating point per sample.
+ * The last stage can keep decimals (i.e. FilterEma and FilterMean),
+ * those is returned by getValue() so they can be converted to degrees once (LVTS::lm35).
+ *
+ * A stage has the same functions as the chain, so a chain can be a stage in a other chain:
+ * - void init(), forget all old values
+ * - uint16_t addValue(uint16_t value), add a new value and get the output
+ * - double getValue(), the last output with decimals if the stage has them
+ *
+ * There is no virtual functions, so the compiler can inline the whole chain.
+ */
+
+/**
+ * A stage that does nothing, used to fill the chain.
+ */
+class FilterPass
+{
+    public:
+        void init() {}
+        uint16_t addValue(uint16_t value) { return value; }
+};
+
+/**
+ * Running median over N values, see SortedWindow.
+ * Like FilterSpike<SPIKE_FILTER_MEDIAN> but with the window size as a parameter.
+ *
+ * @tparam N window size, odd is best
+ */
+template <uint8_t N>
+class FilterMedian
+{
+    private:
+        SortedWindow<uint16_t, N> window; ///< The last values, also sorted
+
+    public:
+        void init()
+        {
+            window.init();
+        }
+
+        uint16_t addValue(uint16_t value)
+        {
+            window.addValue(value);
+            return window.getMedian();
+        }
+
+        double getValue()
+        {
+            return window.getMedian();
+        }
+};
+
+/**
+ * Exponential moving average, y += alpha*(x-y) with alpha = 1/2^SHIFT.
+ *
+ * The state has 8 extra bits, so small changes is not lost,
+ * and a power of two alpha is only shifts (no multiply on the AVR).
+ * The first value is used as start value.
+ *
+ * @tparam SHIFT alpha is 1/2^SHIFT, 0..8
+ */
+template <uint8_t SHIFT>
+class FilterEma
+{
+    private:
+        uint32_t state;  ///< The average in 1/256 counts
+        bool firstTime;  ///< No value yet
+
+    public:
+        FilterEma() { init(); }
+
+        void init()
+        {
+            state = 0;
+            firstTime = true;
+        }
+
+        uint16_t addValue(uint16_t value)
+        {
+            uint32_t x = ((uint32_t)value) << 8;
+            if(firstTime)
+            {
+                state = x;
+                firstTime = false;
+            }
+            else if(x > state)
+            {
+                state += (x - state) >> SHIFT;
+            }
+            else
+            {
+                state -= (state - x) >> SHIFT;
+            }
+            return (uint16_t)((state + 128) >> 8);
+        }
+
+        double getValue()
+        {
+            return state / 256.0;
+        }
+};
+
+/**
+ * Limit the values to LO..HI.
+ *
+ * @tparam LO lowest value
+ * @tparam HI highest value
+ */
+template <uint16_t LO, uint16_t HI>
+class FilterClamp
+{
+    private:
+        uint16_t last; ///< The last output
+
+    public:
+        FilterClamp() { init(); }
+
+        void init()
+        {
+            last = LO;
+        }
+
+        uint16_t addValue(uint16_t value)
+        {
+            if(value < LO)
+            {
+                value = LO;
+            }
+            else if(value > HI)
+            {
+                value = HI;
+            }
+            last = value;
+            return value;
+        }
+
+        double getValue()
+        {
+            return last;
+        }
+};
+
+/**
+ * The trimmed mean over the last N values, see RingFilter.
+ *
+ * @tparam N window size
+ */
+template <uint8_t N>
+class FilterMean
+{
+    private:
+        RingFilter<uint16_t, N, uint32_t> ring; ///< The window
+
+    public:
+        void init()
+        {
+            ring.init();
+        }
+
+        uint16_t addValue(uint16_t value)
+        {
+            ring.addValue(value);
+            return ring.getRounded();
+        }
+
+        double getValue()
+        {
+            return ring.getValue();
+        }
+};
+
+/**
+ * Median or Hampel filter against spikes, see SpikeFilter.
+ *
+ * @tparam TYPE SPIKE_FILTER_MEDIAN or SPIKE_FILTER_HAMPEL
+ */
+template <SpikeFilterType TYPE>
+class FilterSpike
+{
+    private:
+        SpikeFilter spike; ///< The filter
+        uint16_t last;     ///< The last output
+
+    public:
+        FilterSpike()
+        {
+            spike.setType(TYPE);
+            last = 0;
+        }
+
+        void init()
+        {
+            spike.init();
+        }
+
+        uint16_t addValue(uint16_t value)
+        {
+            last = spike.addValue(value);
+            return last;
+        }
+
+        double getValue()
+        {
+            return last;
+        }
+};
+
+/**
+ * Up to four stages after each other, the output from one is the input to the next.
+ *
+ * Unused stages is FilterPass, and is not stored at all.
+ *
+ * @tparam S1 first stage
+ * @tparam S2 second stage
+ * @tparam S3 third stage
+ * @tparam S4 last stage
+ */
+template <class S1, class S2 = FilterPass, class S3 = FilterPass, class S4 = FilterPass>
+class FilterChain
+{
+    private:
+        S1 first;                        ///< The first stage
+        FilterChain<S2, S3, S4> rest;    ///< The rest of the stages
+
+    public:
+        void init()
+        {
+            first.init();
+            rest.init();
+        }
+
+        uint16_t addValue(uint16_t value)
+        {
+            return rest.addValue( first.addValue(value) );
+        }
+
+        double getValue()
+        {
+            return rest.getValue();
+        }
+};
+
+/**
+ * The end of the chain, only one stage left.
+ */
+template <class S1>
+class FilterChain<S1, FilterPass, FilterPass, FilterPass>
+{
+    private:
+        S1 first; ///< The last stage
+
+    public:
+        void init()
+        {
+            first.init();
+        }
+
+        uint16_t addValue(uint16_t value)
+        {
+            return first.addValue(value);
+        }
+
+        double getValue()
+        {
+            return first.getValue();
+        }
+};
+
+#endif  // __FILTERCHAIN_H
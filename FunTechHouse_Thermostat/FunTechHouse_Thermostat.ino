@@ -24,35 +24,170 @@
 #include <SPI.h>
 #include <Ethernet.h>
 #include "PubSubClient.h"
+#include "MQTT_Dispatch.h"
 #include "Thermostat.h"
+#include "PowerBudget.h"
+#include "SensorVote.h"
 
 #include "LVTS.h"
-#include "ValueAvg.h"
+#include "FilterChain.h"
+#include "AdcSampler.h"
+#include "OneWireEngine.h"
+#include "OneWirePin.h"
+#include "DS18B20Bus.h"
+#include "DS18B20Group.h"
+#include "OneWireStore.h"
+#include "DHTSensor.h"
 #include "TemperatureSensor.h"
 
 #define OUT_STR_MAX 100
 
+// The main loop runs once a second (one tick),
+// but the outputs are updated every slot (100ms) for the time proportional mode.
+#define SLOTS_PER_TICK 10
+
+// The OneWire bus is polled every 10ms, a scratchpad read takes about 14ms.
+#define POLLS_PER_SLOT 10
+
+// The analog inputs is sampled all the time by the adc interrupt,
+// and 4^OVERSAMPLE_BITS samples is one value with OVERSAMPLE_BITS extra bits
+// (see test/test_Oversample), the LM35 noise is the dither.
+#define OVERSAMPLE_BITS 2
+
+// Then the thermostat is filtered over a sliding window of those values, one per tick
+// (the sensors does the same, see SENSOR_FILTER_WINDOW).
+// The filters work on the raw values, and only the result is converted to degrees (LVTS table).
+#define FILTER_WINDOW 8
+
 // Update these with values suitable for your network.
 byte mac[]    = {  0xDE, 0xED, 0xBA, 0xFE, 0xFE, 0x05 };
 
 // The MQTT device name, this must be unique
 char project_name[]  = "FunTechHouse_Thermostat";
 
+// All topics starts with this, then the name (setTopicName_P) and "_Data" or "_Diag".
+const char topicPrefix[] PROGMEM = "FunTechHouse/Pannrum/";
+
 Thermostat thermostat(3, THERMOSTAT_TYPE_BIN_CNT);
+
+// The heater stages is 2kW, 4kW and 9kW, but the fuse only allows 6kW.
+const uint16_t thermostatPower[] = { 2000, 4000, 9000 };
+PowerBudget power(6000);
+
 #define SENSOR_CNT 2
 TemperatureSensor sensors[SENSOR_CNT];
 
+// The thermostat sensor is close to the contactors, so remove the spikes first.
+FilterChain< FilterSpike<SPIKE_FILTER_HAMPEL>, FilterMean<FILTER_WINDOW> > thermostatFilter;
+
+// The thermostat can vote between its own LM35 (A0) and sensors[THERMOSTAT_VOTE_SENSOR],
+// so it goes on heating with the one that is left if one is broken.
+// That sensor must be a second probe at the same point in the boiler,
+// GT1-VV and GT2-VV is somewhere else, so there is no vote until there is one.
+//#define THERMOSTAT_VOTE_SENSOR 2
+#ifdef THERMOSTAT_VOTE_SENSOR
+SensorVote thermostatVote(2, SENSOR_VOTE_MEDIAN);
+#endif
+
+// The adc channel for the thermostat, the LM35 sensors has their own (setAdc).
+AdcSampler adc;
+int8_t thermostatChannel;
+
+// The DS18B20 sensors is on OneWire buses, the devices is found at startup.
+// The first bus is done by Timer2 in the background (OneWirePin waits for it instead),
+// the group reads all buses in turn and converts them at once.
+OneWireEngine oneWireEngine(6);
+DS18B20Bus oneWire(&oneWireEngine);
+//OneWirePin oneWirePin7(7);
+//DS18B20Bus oneWire7(&oneWirePin7);
+DS18B20Group oneWireGroup;
+
+// The DS18B20 on the first bus, the sensors that use them and the offsets
+// is saved in the EEPROM, so the boot does not need a search.
+OneWireStore oneWireStore(0);
+
+// A DHT22 (temperature and humidity) on pin 8, read in the background.
+DHTSensor dht(8, Sensor::DHT_22);
+
 PubSubClient client("mosqhub", 1883, callback);
 
+// The thermostat and the sensors, to find who a received topic is for.
+MQTT_Dispatch mqttDispatch;
+
 //The stage out relays is connected to:
 int gpioStage0  = 2;
 int gpioStage1  = 5; //Upps built the hw with the gpio in the wrong order.
 int gpioStage2  = 3;
 
+/**
+ * Publish to a topic of the thermostat or a sensor,
+ * the topic may be in flash (setTopic_P, setTopicName_P) or in ram (setTopic).
+ *
+ * @param logic the thermostat or a sensor
+ * @param topic MQTT_TOPIC_PUBLISH or MQTT_TOPIC_DIAGNOSTIC
+ * @param payload the string to send
+ * @return true if sent
+ */
+boolean mqttPublish(MQTT_Logic* logic, uint8_t topic, char* payload)
+{
+    const char* prefix;
+    const char* name;
+    const char* suffix;
+    if(logic->getTopic_P(topic, &prefix, &name, &suffix))
+    {
+        return client.publish_P(prefix, name, suffix, payload);
+    }
+    if(NULL == name)
+    {
+        return false;
+    }
+    return client.publish((char*)name, payload);
+}
+
+/**
+ * Subscribe to the commands for the thermostat or a sensor.
+ *
+ * @param logic the thermostat or a sensor
+ * @return true if ok
+ */
+boolean mqttSubscribe(MQTT_Logic* logic)
+{
+    const char* prefix;
+    const char* name;
+    const char* suffix;
+    if(logic->getTopic_P(MQTT_TOPIC_SUBSCRIBE, &prefix, &name, &suffix))
+    {
+        return client.subscribe_P(prefix, name, suffix);
+    }
+    if(NULL == name)
+    {
+        return false;
+    }
+    return client.subscribe((char*)name);
+}
+
+/**
+ * Commands from the server, like "setpoint=55.5 ; hyst=3 ; outmax=2".
+ *
+ * The commands is applied at once so they are used in this tick,
+ * but the ack is sent later in the loop since the payload is in the client buffer.
+ * The owner of the topic is found by its hash (mqttDispatch), the topic is in the client buffer as well.
+ */
 void callback(char* topic, byte* payload, unsigned int length)
 {
-    // handle message arrived
-    //client.publish(topic_out, "echo...");
+    MQTT_Logic* logic = mqttDispatch.find(topic);
+    if(NULL == logic)
+    {
+        return;
+    }
+
+    logic->commandParse((char*)payload, length);
+
+    if(logic != &thermostat)
+    {
+        //The offset for a DS18B20 is saved (only if changed)
+        oneWireStore.save(&oneWire, sensors, SENSOR_CNT);
+    }
 }
 
 
@@ -61,30 +196,98 @@ void configure()
     //Config the thermostat
     thermostat.setSetpoint(60.0, 5.0); //55..60
     thermostat.setValueDiff(1.0);
-    thermostat.setOutMax(0x3); // => 4(9kW), later 2(4kW) or 3(6kW)
+    //thermostat.setCycleTime(60*SLOTS_PER_TICK); // 60s for contactors, 1s for SSR
     thermostat.setAlarmLevels(true, 15.0, true, 10.0); // 60-15=45 60+10=70
-    thermostat.setTopic(
-            "FunTechHouse/Pannrum/ElPanna_Data",
-            "FunTechHouse/Pannrum/ElPanna"
-            );
+    //The topics stay in flash, only the pointers is in ram (see mqttPublish)
+    thermostat.setTopicName_P(topicPrefix, PSTR("ElPanna"),
+            MQTT_TOPIC_SUBSCRIBE | MQTT_TOPIC_PUBLISH | MQTT_TOPIC_DIAGNOSTIC);
+    //thermostat.setAutoTune(true); // Staging interval and hyst from the plant estimate
+
+    //The power budget replaces setOutMax, more thermostats can share the fuse.
+    power.add(&thermostat, thermostatPower, 0);
 
     //Config the first sensor
     sensors[0].setAlarmLevels(false, 25.0, false, 22.0);
     sensors[0].setSensor(TemperatureSensor::LM35DZ, A1);
     sensors[0].setDiffToSend(1.4);
-    sensors[0].setTopic(
-            "FunTechHouse/Pannrum/GT1-VV_Data",
-            "FunTechHouse/Pannrum/GT1-VV"
-            );
+    sensors[0].setSpikeFilter(SPIKE_FILTER_HAMPEL);
+    sensors[0].setTopicName_P(topicPrefix, PSTR("GT1-VV"), MQTT_TOPIC_SUBSCRIBE | MQTT_TOPIC_PUBLISH);
 
     //Then configure a second sensor
     sensors[1].setAlarmLevels(false, 25.0, false, 22.0);
     sensors[1].setSensor(TemperatureSensor::LM35DZ, A2);
     sensors[1].setDiffToSend(1.4);
-    sensors[1].setTopic(
-            "FunTechHouse/Pannrum/GT2-VV_Data",
-            "FunTechHouse/Pannrum/GT2-VV"
-            );
+    sensors[1].setSpikeFilter(SPIKE_FILTER_MEDIAN);
+    sensors[1].setKalman(true); // Smoother, and the slope (degC/min) is sent with the value
+    sensors[1].setTopicName_P(topicPrefix, PSTR("GT2-VV"), MQTT_TOPIC_SUBSCRIBE | MQTT_TOPIC_PUBLISH);
+
+    //A DS18B20 sensor is the device on the OneWire bus (first found is 0)
+    //sensors[2].setSensor(TemperatureSensor::DS18B20, 6);
+    //sensors[2].setOneWire(&oneWire, 0);
+    //sensors[2].setAlarmLevels(true, 80.0, false, 0.0); // TH/TL in the device
+    //oneWire.setResolution(0, 10); // 0.25degC, a new value every 200ms
+
+    //A DHT22 sends the humidity with the temperature
+    //sensors[3].setSensor(TemperatureSensor::DHT_22, 8);
+    //sensors[3].setDHT(&dht);
+    //sensors[3].setHumidityDiffToSend(3.0);
+
+    //Read all DS18B20 every 10 conversions, between only the ones with a alarm
+    oneWire.setHeartbeat(10);
+
+    //A second bus (on pin 7) is converted together with the first
+    oneWireGroup.add(&oneWire);
+    //oneWireGroup.add(&oneWire7);
+
+    //The analog inputs to sample
+    adc.setBits(OVERSAMPLE_BITS);
+    thermostatChannel = adc.addChannel(A0);
+    for( int i=0 ; i<SENSOR_CNT; i++ )
+    {
+        sensors[i].setAdc(&adc);
+    }
+
+    //Last, when all topics is set
+    mqttDispatch.add(&thermostat);
+    for( int i=0 ; i<SENSOR_CNT; i++ )
+    {
+        mqttDispatch.add(&sensors[i]);
+    }
+}
+
+/**
+ * Update the stage out relays with the latest data from the thermostat.
+ *
+ * @param ok false if there is no valid sensor value, then all outputs goes off.
+ */
+void updateOutputs(bool ok)
+{
+    if(ok && thermostat.getStageOut(0))
+    {
+        digitalWrite(gpioStage0, HIGH);
+    }
+    else
+    {
+        digitalWrite(gpioStage0, LOW);
+    }
+
+    if(ok && thermostat.getStageOut(1))
+    {
+        digitalWrite(gpioStage1, HIGH);
+    }
+    else
+    {
+        digitalWrite(gpioStage1, LOW);
+    }
+
+    if(ok && thermostat.getStageOut(2))
+    {
+        digitalWrite(gpioStage2, HIGH);
+    }
+    else
+    {
+        digitalWrite(gpioStage2, LOW);
+    }
 }
 
 void setup()
@@ -104,18 +307,28 @@ void setup()
 
     //Configure this project.
     configure();
+    adc.begin();
+    oneWireEngine.begin();
+    dht.begin();
+
+    //The devices from the EEPROM, or a search the first time
+    if(!oneWireStore.load(&oneWire, sensors, SENSOR_CNT))
+    {
+        oneWireGroup.begin();
+        oneWireStore.save(&oneWire, sensors, SENSOR_CNT);
+    }
 
     //Start ethernet, if no ip is given then dhcp is used.
     Ethernet.begin(mac);
     if (client.connect(project_name))
     {
-        client.publish( thermostat.getTopicPublish(), "#Hello world" );
-        client.subscribe( thermostat.getTopicSubscribe() );
+        mqttPublish( &thermostat, MQTT_TOPIC_PUBLISH, "#Hello world" );
+        mqttSubscribe( &thermostat );
 
         for( int i=0 ; i<SENSOR_CNT; i++ )
         {
-            client.publish( sensors[i].getTopicPublish(), "#Hello world" );
-            client.subscribe( sensors[i].getTopicSubscribe() );
+            mqttPublish( &sensors[i], MQTT_TOPIC_PUBLISH, "#Hello world" );
+            mqttSubscribe( &sensors[i] );
         }
     }
 }
@@ -131,32 +344,53 @@ void loop()
         client.connect(project_name);
     }
 
-    ValueAvg filter;
     double temperature = 0;
     char str[OUT_STR_MAX];
 
+    //Part 1.0 - Read all sensors, every sensor type knows how it is read (TemperatureSensor::readTypes).
+    int16_t sensorCenti[SENSOR_CNT];
+    bool sensorOk[SENSOR_CNT];
+    for( int i=0 ; i<SENSOR_CNT; i++ )
+    {
+        sensors[i].readStart();
+        sensorCenti[i] = sensors[i].readResult(&sensorOk[i]);
+    }
+
     //Part 1.1 - Update Thermostat with new value and check alarms
-    bool ok = true;
-    filter.init();
-    for( int j=0 ; j<9 ; j++ )
+    uint16_t reading = 0;
+    int16_t centi = 0;
+    bool ok = adc.getValue(thermostatChannel, &reading);
+    if(ok)
     {
-        bool res = false;
-        filter.addValue( LVTS::lm35( analogRead(A0), &res ) );
-        if(false == res)
-        {
-            ok = false;
-        }
+        ok = LVTS::lm35Valid(reading, OVERSAMPLE_BITS);
     }
-    temperature = filter.getValue();
+    if(ok)
+    {
+        uint16_t filtered = thermostatFilter.addValue(reading);
+        centi = LVTS::lm35Centi( filtered, &ok, OVERSAMPLE_BITS );
+    }
+    else
+    {
+        //Don't let the bad values stay in the window.
+        thermostatFilter.init();
+    }
+
+#ifdef THERMOSTAT_VOTE_SENSOR
+    //The vote has a value as long as one of them is fine (in this tick)
+    thermostatVote.setValue(0, centi, ok);
+    thermostatVote.setValue(1, sensorCenti[THERMOSTAT_VOTE_SENSOR], sensorOk[THERMOSTAT_VOTE_SENSOR]);
+    temperature = thermostatVote.vote(&ok) / 100.0;
+#else
+    temperature = centi / 100.0;
+#endif
 
-    //No sensor connected becomes 109deg,
-    //so lets just ignore values higher than 105
+    //A LM35 that is not connected is not ok (lm35Valid), then there is no value
     if(ok)
     {
         if( thermostat.valueTimeToSend(temperature) )
         {
             thermostat.getValueString( str, OUT_STR_MAX );
-            if(client.publish( thermostat.getTopicPublish(), str))
+            if(mqttPublish( &thermostat, MQTT_TOPIC_PUBLISH, str))
             {
                 thermostat.valueIsSent();
             }
@@ -165,7 +399,7 @@ void loop()
         if( thermostat.alarmLowTimeToSend() )
         {
             thermostat.getAlarmLowString( str, OUT_STR_MAX );
-            if(client.publish( thermostat.getTopicPublish(), str) )
+            if(mqttPublish( &thermostat, MQTT_TOPIC_PUBLISH, str) )
             {
                 thermostat.alarmLowIsSent();
             }
@@ -174,76 +408,64 @@ void loop()
         if( thermostat.alarmHighTimeToSend() )
         {
             thermostat.getAlarmHighString( str, OUT_STR_MAX );
-            if(client.publish( thermostat.getTopicPublish(), str) )
+            if(mqttPublish( &thermostat, MQTT_TOPIC_PUBLISH, str) )
             {
                 thermostat.alarmHighIsSent();
             }
         }
 
-        // Part 1.2 - Update the outputs with the latest data.
-        if(thermostat.getStageOut(0))
-        {
-            digitalWrite(gpioStage0, HIGH);
-        }
-        else
-        {
-            digitalWrite(gpioStage0, LOW);
-        }
-
-        if(thermostat.getStageOut(1))
-        {
-            digitalWrite(gpioStage1, HIGH);
-        }
-        else
+        if( thermostat.commandTimeToSend() )
         {
-            digitalWrite(gpioStage1, LOW);
+            thermostat.getCommandString( str, OUT_STR_MAX );
+            if(mqttPublish( &thermostat, MQTT_TOPIC_PUBLISH, str) )
+            {
+                thermostat.commandIsSent();
+            }
         }
 
-        if(thermostat.getStageOut(2))
+        if( thermostat.plantTimeToSend() )
         {
-            digitalWrite(gpioStage2, HIGH);
-        }
-        else
-        {
-            digitalWrite(gpioStage2, LOW);
+            thermostat.getPlantString( str, OUT_STR_MAX );
+            if(mqttPublish( &thermostat, MQTT_TOPIC_DIAGNOSTIC, str) )
+            {
+                thermostat.plantIsSent();
+            }
         }
     }
     else
     {
         //This is bad, we don't have a sensor to play with!
-        //All out to Zero
-        digitalWrite(gpioStage0, LOW);
-        digitalWrite(gpioStage1, LOW);
-        digitalWrite(gpioStage2, LOW);
-        /// @todo Send a alarm that the sensor is broken!!!
+        //All out to Zero (done by updateOutputs)
     }
 
-    // Part 2.1 - Loop the misc sensors attached to this device.
-    for( int i=0 ; i<SENSOR_CNT; i++ )
+#ifdef THERMOSTAT_VOTE_SENSOR
+    //A broken sensor (or one that is back)
+    if( thermostatVote.faultTimeToSend() )
     {
-        bool readOk = true;
-
-        if( ((int)TemperatureSensor::LM35DZ) == sensors[i].getSensorType() )
+        thermostatVote.getFaultString( str, OUT_STR_MAX );
+        if(mqttPublish( &thermostat, MQTT_TOPIC_PUBLISH, str) )
         {
-            //There is some noice so take a avg on some samples
-            //so we don't see the noice as much...
-            filter.init();
-            for( int j=0 ; j<9 ; j++ )
-            {
-                bool res = false;
-                filter.addValue(
-                        LVTS::lm35(
-                            analogRead( sensors[i].getSensorPin() ),
-                            &res
-                            )
-                        );
-                if(false == res)
-                {
-                    readOk = false;
-                }
-            }
-            temperature = filter.getValue();
+            thermostatVote.faultIsSent();
         }
+    }
+#endif
+
+    // Part 1.2 - Share the power and update the outputs with the latest data.
+    power.update();
+    updateOutputs(ok);
+
+    // Part 2.1 - The DS18B20 is read by poll() in Part 3.1,
+    // a saved device that does not answer starts a new search.
+    if( oneWire.hasLost() && !oneWireGroup.isBusy() )
+    {
+        oneWireStore.rescan(&oneWire, sensors, SENSOR_CNT);
+    }
+
+    // Part 2.2 - Loop the misc sensors attached to this device, they are read in Part 1.0.
+    for( int i=0 ; i<SENSOR_CNT; i++ )
+    {
+        bool readOk = sensorOk[i];
+        temperature = sensorCenti[i] / 100.0;
 
         if(true == readOk)
         {
@@ -258,16 +480,25 @@ void loop()
                 if(client.connected())
                 {
                     sensors[i].getValueString( str, OUT_STR_MAX );
-                    if( client.publish( sensors[i].getTopicPublish(), str) )
+                    if( mqttPublish( &sensors[i], MQTT_TOPIC_PUBLISH, str) )
                     {
                         sensors[i].valueIsSent();
                     }
                 }
             }
 
+            if(sensors[i].commandTimeToSend())
+            {
+                sensors[i].getCommandString( str, OUT_STR_MAX );
+                if( client.connected() && mqttPublish( &sensors[i], MQTT_TOPIC_PUBLISH, str) )
+                {
+                    sensors[i].commandIsSent();
+                }
+            }
+
             if(sensors[i].alarmHighCheck(str, OUT_STR_MAX))
             {
-                if( (false == client.connected()) || (false == client.publish(sensors[i].getTopicPublish(), str)) )
+                if( (false == client.connected()) || (false == mqttPublish( &sensors[i], MQTT_TOPIC_PUBLISH, str)) )
                 {
                     sensors[i].alarmHighFailed();
                 }
@@ -275,7 +506,7 @@ void loop()
 
             if(sensors[i].alarmLowCheck(str, OUT_STR_MAX))
             {
-                if( (false == client.connected()) || (false == client.publish(sensors[i].getTopicPublish(), str)) )
+                if( (false == client.connected()) || (false == mqttPublish( &sensors[i], MQTT_TOPIC_PUBLISH, str)) )
                 {
                     sensors[i].alarmLowFailed();
                 }
@@ -283,6 +514,22 @@ void loop()
         }
     }
 
-
-    delay(1000);
+    // Part 3.1 - Wait for the next tick,
+    // but step the time proportional output during the wait,
+    // and read the DS18B20 as soon as the conversion is done (and the DHT),
+    // the next transfer on the bus is started every POLLS_PER_SLOT.
+    for( int slot=0 ; slot<SLOTS_PER_TICK ; slot++ )
+    {
+        for( int i=0 ; i<POLLS_PER_SLOT ; i++ )
+        {
+            delay(1000/(SLOTS_PER_TICK*POLLS_PER_SLOT));
+            oneWireGroup.poll(1000/(SLOTS_PER_TICK*POLLS_PER_SLOT));
+            for( int j=0 ; j<SENSOR_CNT; j++ )
+            {
+                sensors[j].readPoll(1000/(SLOTS_PER_TICK*POLLS_PER_SLOT));
+            }
+        }
+        thermostat.nextSlot();
+        updateOutputs(ok);
+    }
 }
@@ -0,0 +1,151 @@
+/**
+ * @file KalmanFilter.cpp
+ * @author Johan Simonsson
+ * @brief Fixed point Kalman filter for the temperature and its slope
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "KalmanFilter.h"
+
+/**
+ * The default constructor, with KALMAN_NOISE and KALMAN_PROCESS.
+ */
+KalmanFilter::KalmanFilter()
+{
+    setNoise(KALMAN_NOISE, KALMAN_PROCESS);
+    init();
+}
+
+/**
+ * Forget the estimate, the next value starts over.
+ */
+void KalmanFilter::init()
+{
+    temperature = 0;
+    slope = 0;
+    p00 = 0;
+    p01 = 0;
+    p11 = 0;
+    valid = false;
+}
+
+/**
+ * How noisy is the readings and how fast can the slope change?
+ * A higher noise (or lower process) gives a smoother value that is slower to follow.
+ * The values is limited to 1..KALMAN_NOISE_MAX and 0..KALMAN_PROCESS_MAX,
+ * else the covariance overflows.
+ *
+ * @param noise the noise of the readings, in 0.01 degC (std dev)
+ * @param process the change of the slope per sample, in 0.001 degC (std dev)
+ */
+void KalmanFilter::setNoise(uint16_t noise, uint16_t process)
+{
+    if(noise < 1)
+    {
+        noise = 1;
+    }
+    if(noise > KALMAN_NOISE_MAX)
+    {
+        noise = KALMAN_NOISE_MAX;
+    }
+    if(process > KALMAN_PROCESS_MAX)
+    {
+        process = KALMAN_PROCESS_MAX;
+    }
+    r = ((int32_t)noise * noise) << KALMAN_P_SHIFT;
+    q = (((int32_t)process * process) << KALMAN_P_SHIFT) / 100;
+}
+
+/**
+ * Add the next reading, one per sample.
+ *
+ * @param value the reading in 0.01 degC
+ * @return the estimate in 0.01 degC
+ */
+int16_t KalmanFilter::addValue(int16_t value)
+{
+    int32_t z = (int32_t)value * (1L << KALMAN_SHIFT);
+
+    if(!valid)
+    {
+        temperature = z;
+        slope = 0;
+        p00 = r;
+        p01 = 0;
+        p11 = ((int32_t)KALMAN_SLOPE_INIT * KALMAN_SLOPE_INIT) << KALMAN_P_SHIFT;
+        valid = true;
+        return value;
+    }
+
+    //Predict, the slope noise is a change in the slope during the sample
+    //(Q is q*[1/4 1/2 ; 1/2 1])
+    temperature += slope;
+    p00 += 2*p01 + p11 + q/4;
+    p01 += p11 + q/2;
+    p11 += q;
+
+    //Correct with the reading
+    int32_t error = z - temperature;
+    int32_t s = p00 + r;
+    int32_t k0 = (int32_t)(((int64_t)p00 << KALMAN_GAIN_SHIFT) / s);
+    int32_t k1 = (int32_t)(((int64_t)p01 << KALMAN_GAIN_SHIFT) / s);
+
+    temperature += (int32_t)(((int64_t)k0 * error) >> KALMAN_GAIN_SHIFT);
+    slope       += (int32_t)(((int64_t)k1 * error) >> KALMAN_GAIN_SHIFT);
+
+    //P = (I - K*H) * P
+    p11 -= (int32_t)(((int64_t)k1 * p01) >> KALMAN_GAIN_SHIFT);
+    p01 -= (int32_t)(((int64_t)k0 * p01) >> KALMAN_GAIN_SHIFT);
+    p00 -= (int32_t)(((int64_t)k0 * p00) >> KALMAN_GAIN_SHIFT);
+
+    return getValue();
+}
+
+/**
+ * The estimate.
+ *
+ * @return the temperature in 0.01 degC
+ */
+int16_t KalmanFilter::getValue()
+{
+    return (int16_t)((temperature + (1 << (KALMAN_SHIFT-1))) >> KALMAN_SHIFT);
+}
+
+/**
+ * The slope, as the change over some samples.
+ * With one sample per second, 60 gives 0.01 degC per minute.
+ *
+ * @param samples over how many samples
+ * @return the change in 0.01 degC
+ */
+int16_t KalmanFilter::getSlope(uint16_t samples)
+{
+    int32_t change = slope * samples;
+    return (int16_t)((change + (1 << (KALMAN_SHIFT-1))) >> KALMAN_SHIFT);
+}
+
+/**
+ * Is there a estimate?
+ *
+ * @return true after the first value
+ */
+bool KalmanFilter::isValid()
+{
+    return valid;
+}
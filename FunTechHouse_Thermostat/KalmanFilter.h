@@ -0,0 +1,106 @@
+/**
+ * @file KalmanFilter.h
+ * @author Johan Simonsson
+ * @brief Fixed point Kalman filter for the temperature and its slope
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __KALMANFILTER_H
+#define  __KALMANFILTER_H
+
+#include <stdint.h>
+
+/**
+ * The state has this many extra bits.
+ */
+#define KALMAN_SHIFT 8
+
+/**
+ * The covariance has this many extra bits, the slope variance is small.
+ */
+#define KALMAN_P_SHIFT 12
+
+/**
+ * The gain is 0..1<<KALMAN_GAIN_SHIFT.
+ */
+#define KALMAN_GAIN_SHIFT 16
+
+/**
+ * Default noise of the readings, in 0.01 degC (std dev).
+ */
+#define KALMAN_NOISE 25
+
+/**
+ * Default change of the slope per sample, in 0.001 degC per sample (std dev).
+ */
+#define KALMAN_PROCESS 1
+
+/**
+ * The largest noise and process for setNoise(), then the covariance fits in int32_t.
+ */
+#define KALMAN_NOISE_MAX 500
+#define KALMAN_PROCESS_MAX 500
+
+/**
+ * The slope is unknown at the start, in 0.01 degC per sample (std dev).
+ */
+#define KALMAN_SLOPE_INIT 50
+
+/**
+ * A Kalman filter with the temperature and the slope as state,
+ * one value per sample (tick) and no floating point.
+ *
+ * The model is a constant slope that can change a little every sample:
+ * @code
+ * T = T + S
+ * S = S + noise
+ * @endcode
+ * Every new value is first predicted with the model, then corrected with the gain
+ * that comes from how sure we are on the prediction (P) and the reading noise (R).
+ * So it follows a steady ramp without the lag that a mean has,
+ * and the noise is lower than a mean over the same samples.
+ *
+ * The state has KALMAN_SHIFT extra bits, P has KALMAN_P_SHIFT and the gain is in KALMAN_GAIN_SHIFT bits.
+ * The gain is done in 64 bits, that is only once per sample.
+ */
+class KalmanFilter
+{
+    private:
+        int32_t temperature; ///< The estimate, 0.01 degC << KALMAN_SHIFT
+        int32_t slope;       ///< The estimate, 0.01 degC per sample << KALMAN_SHIFT
+        int32_t p00;         ///< Variance of the temperature
+        int32_t p01;         ///< Covariance
+        int32_t p11;         ///< Variance of the slope
+        int32_t r;           ///< Variance of the readings
+        int32_t q;           ///< Variance of the slope change per sample
+        bool valid;          ///< There is a estimate
+
+    public:
+        KalmanFilter();
+
+        void init();
+        void setNoise(uint16_t noise, uint16_t process);
+
+        int16_t addValue(int16_t value);
+        int16_t getValue();
+        int16_t getSlope(uint16_t samples);
+        bool isValid();
+};
+
+#endif  // __KALMANFILTER_H
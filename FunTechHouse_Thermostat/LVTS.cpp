@@ -21,23 +21,77 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#else
+#define PROGMEM
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#endif
+
 #include "LVTS.h"
 
+/*
+ * The lookup tables is made by the preprocessor,
+ * LVTS_R1024(F) is F(0), F(1) .. F(1023) so F is done for every 10bit reading.
+ */
+#define LVTS_R4(F,i)    F(i), F((i)+1), F((i)+2), F((i)+3)
+#define LVTS_R16(F,i)   LVTS_R4(F,i),   LVTS_R4(F,(i)+4),    LVTS_R4(F,(i)+8),    LVTS_R4(F,(i)+12)
+#define LVTS_R64(F,i)   LVTS_R16(F,i),  LVTS_R16(F,(i)+16),  LVTS_R16(F,(i)+32),  LVTS_R16(F,(i)+48)
+#define LVTS_R256(F,i)  LVTS_R64(F,i),  LVTS_R64(F,(i)+64),  LVTS_R64(F,(i)+128), LVTS_R64(F,(i)+192)
+#define LVTS_R1024(F)   LVTS_R256(F,0), LVTS_R256(F,256),    LVTS_R256(F,512),    LVTS_R256(F,768)
+
+/*
+ * Rounded to nearest, also for negative values.
+ * The tables is made at compile time, so the 64bit math does not cost anything.
+ */
+#define LVTS_DIV(n,d) ( ((n) >= 0) ? (((n) + (d)/2) / (d)) : (((n) - (d)/2) / (d)) )
+
+/*
+ * LM35, the reading in 0.01 degC is
+ * reading*aref/1024/slope = reading*LVTS_AREF_MV*1000 / (1024*LVTS_LM35_SLOPE),
+ * valid for 0..105 degC (the same as lm35).
+ */
+#define LVTS_LM35_NUM(i) ((long long)(i)*LVTS_AREF_MV*1000LL)
+#define LVTS_LM35_DEN    (1024LL*LVTS_LM35_SLOPE)
+#define LVTS_LM35(i) ( (LVTS_LM35_NUM(i) <= 10500LL*LVTS_LM35_DEN) ? \
+        (int16_t)LVTS_DIV(LVTS_LM35_NUM(i), LVTS_LM35_DEN) : LVTS_INVALID )
+
+/*
+ * LM34, the reading in 0.01 degF is the same as above,
+ * and then (degF-32)*5/9 to 0.01 degC, valid for -17..40 degC (the same as lm34).
+ */
+#define LVTS_LM34_NUM(i) ((long long)(i)*LVTS_AREF_MV*5000LL - 3200LL*5LL*1024LL*LVTS_LM34_SLOPE)
+#define LVTS_LM34_DEN    (9LL*1024LL*LVTS_LM34_SLOPE)
+#define LVTS_LM34(i) ( ((LVTS_LM34_NUM(i) >= -1700LL*LVTS_LM34_DEN) && \
+                        (LVTS_LM34_NUM(i) <=  4000LL*LVTS_LM34_DEN)) ? \
+        (int16_t)LVTS_DIV(LVTS_LM34_NUM(i), LVTS_LM34_DEN) : LVTS_INVALID )
+
+/**
+ * LM35 in 0.01 degC for every 10bit reading, or LVTS_INVALID.
+ */
+static const int16_t lm35Table[1024] PROGMEM = { LVTS_R1024(LVTS_LM35) };
+
+/**
+ * LM34 in 0.01 degC for every 10bit reading, or LVTS_INVALID.
+ */
+static const int16_t lm34Table[1024] PROGMEM = { LVTS_R1024(LVTS_LM34) };
+
 /**
  * LM35 temperature sensor.
  *
  * analogReference(INTERNAL); should be used.
  *
- * @param reading from analogRead, (0..1023).
+ * @param reading from analogRead, (0..1023), or a filtered reading with decimals.
  * @param ok becomes true if ok, false if fail.
+ * @param extraBits the reading is oversampled with this many extra bits (0..1023<<extraBits)
  * @return temperature in degC
  */
-double LVTS::lm35(int reading, bool *ok)
+double LVTS::lm35(double reading, bool *ok, uint8_t extraBits)
 {
-    double aref = 1.10; // Internal 1.1V ref
+    double aref = LVTS_AREF_MV/1000.0; // Internal 1.1V ref
 
     double temperature = reading * aref;
-    temperature /= 1024.0;               // ADC resolution
+    temperature /= 1024.0*(1UL<<extraBits); // ADC resolution
     temperature *= 100;                  // 10mV/C (0.01V/C)
 
     //Datasheet tells us
@@ -54,21 +108,38 @@ double LVTS::lm35(int reading, bool *ok)
     return 0.0;
 }
 
+/**
+ * Is the reading in the range that LVTS::lm35 accepts?
+ *
+ * This is the same check without floating point,
+ * so it can be done on every sample and the conversion only on the filtered value.
+ *
+ * @param reading from analogRead, (0..1023).
+ * @param extraBits the reading is oversampled with this many extra bits (0..1023<<extraBits)
+ * @return true if 0..105 degC
+ */
+bool LVTS::lm35Valid(long reading, uint8_t extraBits)
+{
+    // reading*1.1/(1024<<extraBits)*100 <= 105
+    return ( (reading >= 0) && ((reading*110) <= ((105L*1024) << extraBits)) );
+}
+
 /**
  * LM34 temperature sensor.
  *
  * analogReference(INTERNAL); should be used.
  *
- * @param reading from analogRead, (0..1023).
+ * @param reading from analogRead, (0..1023), or a filtered reading with decimals.
  * @param ok becomes true if ok, false if fail.
+ * @param extraBits the reading is oversampled with this many extra bits (0..1023<<extraBits)
  * @return temperature in degC
  */
-double LVTS::lm34(int reading, bool *ok)
+double LVTS::lm34(double reading, bool *ok, uint8_t extraBits)
 {
-    double aref = 1.10; // Internal 1.1V ref
+    double aref = LVTS_AREF_MV/1000.0; // Internal 1.1V ref
 
     double temperature = reading * aref;
-    temperature /= 1024.0;               // ADC resolution
+    temperature /= 1024.0*(1UL<<extraBits); // ADC resolution
     temperature *= 100;                  // 10mV/C (0.01V/F)
 
     temperature = F2C(temperature);
@@ -99,3 +170,79 @@ double LVTS::F2C(double degC)
     degC /= 9;
     return degC; //is now F
 }
+
+/**
+ * Look up a reading in a table, with linear interpolation for the extra bits.
+ *
+ * @param table [in] the table in flash, 1024 values in 0.01 degC
+ * @param reading the reading, (0..1023<<extraBits).
+ * @param ok becomes true if ok, false if fail.
+ * @param extraBits the reading is oversampled with this many extra bits
+ * @return temperature in 0.01 degC
+ */
+int16_t LVTS::interpolate(const int16_t* table, uint16_t reading, bool *ok, uint8_t extraBits)
+{
+    uint16_t index = reading >> extraBits;
+    uint16_t frac  = reading - (index << extraBits);
+    *ok = false;
+
+    if(index > 1023)
+    {
+        return 0;
+    }
+
+    int16_t low = (int16_t)pgm_read_word(&table[index]);
+    if(LVTS_INVALID == low)
+    {
+        return 0;
+    }
+    if(0 == frac)
+    {
+        *ok = true;
+        return low;
+    }
+
+    if(index >= 1023)
+    {
+        return 0;
+    }
+    int16_t high = (int16_t)pgm_read_word(&table[index+1]);
+    if(LVTS_INVALID == high)
+    {
+        return 0;
+    }
+
+    long diff = ((long)(high - low)) * frac;
+    *ok = true;
+    return low + (int16_t)((diff + (1L << (extraBits-1))) >> extraBits);
+}
+
+/**
+ * LM35 temperature sensor, with a table lookup and no floating point.
+ *
+ * analogReference(INTERNAL); should be used.
+ *
+ * @param reading from analogRead, (0..1023<<extraBits).
+ * @param ok becomes true if ok, false if fail.
+ * @param extraBits the reading is oversampled with this many extra bits
+ * @return temperature in 0.01 degC
+ */
+int16_t LVTS::lm35Centi(uint16_t reading, bool *ok, uint8_t extraBits)
+{
+    return interpolate(lm35Table, reading, ok, extraBits);
+}
+
+/**
+ * LM34 temperature sensor, with a table lookup and no floating point.
+ *
+ * analogReference(INTERNAL); should be used.
+ *
+ * @param reading from analogRead, (0..1023<<extraBits).
+ * @param ok becomes true if ok, false if fail.
+ * @param extraBits the reading is oversampled with this many extra bits
+ * @return temperature in 0.01 degC
+ */
+int16_t LVTS::lm34Centi(uint16_t reading, bool *ok, uint8_t extraBits)
+{
+    return interpolate(lm34Table, reading, ok, extraBits);
+}
@@ -24,12 +24,50 @@
 #ifndef  __LVTS_H
 #define  __LVTS_H
 
+#include <stdint.h>
+
+/**
+ * The adc reference in mV, INTERNAL is 1.1V on the ATmega328.
+ *
+ * This and the sensor slopes is used to make the lookup tables at compile time,
+ * so set them with -D in the build flags to use an other reference or sensor.
+ * A define in the sketch before LVTS.h does nothing, the tables is made in LVTS.cpp.
+ */
+#ifndef LVTS_AREF_MV
+#define LVTS_AREF_MV 1100
+#endif
+
+/**
+ * LM35 slope in 0.1mV per degC (10mV/C).
+ */
+#ifndef LVTS_LM35_SLOPE
+#define LVTS_LM35_SLOPE 100
+#endif
+
+/**
+ * LM34 slope in 0.1mV per degF (10mV/F).
+ */
+#ifndef LVTS_LM34_SLOPE
+#define LVTS_LM34_SLOPE 100
+#endif
+
+/**
+ * Marks a reading out of range in the lookup tables.
+ */
+#define LVTS_INVALID (-32768)
+
 class LVTS
 {
      private:
+         static int16_t interpolate(const int16_t* table, uint16_t reading, bool *ok, uint8_t extraBits);
+
      public:
-         static double lm34(int reading, bool *ok);
-         static double lm35(int reading, bool *ok);
+         static double lm34(double reading, bool *ok, uint8_t extraBits = 0);
+         static double lm35(double reading, bool *ok, uint8_t extraBits = 0);
+         static bool lm35Valid(long reading, uint8_t extraBits = 0);
+
+         static int16_t lm34Centi(uint16_t reading, bool *ok, uint8_t extraBits = 0);
+         static int16_t lm35Centi(uint16_t reading, bool *ok, uint8_t extraBits = 0);
 
          static double F2C(double degC);
 
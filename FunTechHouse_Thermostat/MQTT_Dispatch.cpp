@@ -0,0 +1,166 @@
+/**
+ * @file MQTT_Dispatch.cpp
+ * @author Johan Simonsson
+ * @brief Finds the owner of a received topic.
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#else
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#endif
+
+#include "MQTT_Dispatch.h"
+
+/**
+ * The start value of the hash (djb2).
+ */
+#define MQTT_DISPATCH_HASH_INIT 5381
+
+/**
+ * Default constructur
+ */
+MQTT_Dispatch::MQTT_Dispatch()
+{
+    cnt = 0;
+    for( uint8_t i=0 ; i<MQTT_DISPATCH_SLOTS ; i++ )
+    {
+        slot[i] = MQTT_DISPATCH_EMPTY;
+    }
+}
+
+/**
+ * Continue the hash with one more part of a topic.
+ *
+ * @param hash the hash so far
+ * @param str [in] the part, NULL is nothing
+ * @param flash true if the part is in flash (PROGMEM)
+ * @param len [in,out] the length so far, this part is added
+ * @return the new hash
+ */
+uint16_t MQTT_Dispatch::hashPart(uint16_t hash, const char* str, bool flash, uint16_t* len)
+{
+    if(NULL == str)
+    {
+        return hash;
+    }
+
+    while(true)
+    {
+        uint8_t c = flash ? pgm_read_byte(str) : (uint8_t)*str;
+        if(0 == c)
+        {
+            break;
+        }
+        hash = ((hash << 5) + hash) ^ c;
+        str++;
+        (*len)++;
+    }
+    return hash;
+}
+
+/**
+ * The hash of a topic, in ram.
+ *
+ * @param topic [in] the topic
+ * @param len [out] the length of the topic
+ * @return the hash
+ */
+uint16_t MQTT_Dispatch::hashTopic(const char* topic, uint16_t* len)
+{
+    *len = 0;
+    return hashPart(MQTT_DISPATCH_HASH_INIT, topic, false, len);
+}
+
+/**
+ * Add a object with a subscribe topic, the hash is calculated now.
+ *
+ * @param logic the thermostat or a sensor
+ * @return true if ok, false if full or there is no subscribe topic
+ */
+bool MQTT_Dispatch::add(MQTT_Logic* logic)
+{
+    if(cnt >= MQTT_DISPATCH_MAX)
+    {
+        return false;
+    }
+
+    const char* prefix;
+    const char* name;
+    const char* suffix;
+    bool flash = logic->getTopic_P(MQTT_TOPIC_SUBSCRIBE, &prefix, &name, &suffix);
+    if(NULL == name)
+    {
+        return false;
+    }
+
+    uint16_t length = 0;
+    uint16_t h = MQTT_DISPATCH_HASH_INIT;
+    h = hashPart(h, prefix, true, &length);
+    h = hashPart(h, name, flash, &length);
+    h = hashPart(h, suffix, true, &length);
+    if(length > 0xFF)
+    {
+        //Can't be received anyway, the packet is max MQTT_MAX_PACKET_SIZE
+        return false;
+    }
+
+    this->logic[cnt] = logic;
+    this->hash[cnt]  = h;
+    this->len[cnt]   = length;
+
+    //The first empty slot from the hash
+    uint8_t s = h & (MQTT_DISPATCH_SLOTS-1);
+    while(MQTT_DISPATCH_EMPTY != slot[s])
+    {
+        s = (s+1) & (MQTT_DISPATCH_SLOTS-1);
+    }
+    slot[s] = cnt;
+    cnt++;
+
+    return true;
+}
+
+/**
+ * Find the object that subscribes to this topic.
+ *
+ * @param topic [in] the received topic
+ * @return the object, or NULL if none
+ */
+MQTT_Logic* MQTT_Dispatch::find(const char* topic)
+{
+    uint16_t length;
+    uint16_t h = hashTopic(topic, &length);
+
+    //Until a empty slot, there is always one since MQTT_DISPATCH_SLOTS > MQTT_DISPATCH_MAX
+    uint8_t s = h & (MQTT_DISPATCH_SLOTS-1);
+    while(MQTT_DISPATCH_EMPTY != slot[s])
+    {
+        uint8_t i = slot[s];
+        if( (hash[i] == h) && (len[i] == length) && logic[i]->checkTopicSubscribe((char*)topic) )
+        {
+            return logic[i];
+        }
+        s = (s+1) & (MQTT_DISPATCH_SLOTS-1);
+    }
+    return NULL;
+}
@@ -0,0 +1,79 @@
+/**
+ * @file MQTT_Dispatch.h
+ * @author Johan Simonsson
+ * @brief Finds the owner of a received topic.
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __MQTT_DISPATCH_H
+#define  __MQTT_DISPATCH_H
+
+#include <stdint.h>
+
+#include "MQTT_Logic.h"
+
+/**
+ * How many objects can subscribe.
+ */
+#define MQTT_DISPATCH_MAX 8
+
+/**
+ * Size of the hash table, a power of 2 and bigger than MQTT_DISPATCH_MAX
+ * so there is always a empty slot and the search is short.
+ */
+#define MQTT_DISPATCH_SLOTS 16
+
+/**
+ * A empty slot in the hash table.
+ */
+#define MQTT_DISPATCH_EMPTY 0xFF
+
+/**
+ * Finds what object a received topic is for, without comparing it with every subscribe topic.
+ *
+ * The thermostat and the sensors is added at configure time (add),
+ * then the hash and length of the subscribe topic is calculated once.
+ * The topic can be in ram or flash, or in parts (MQTT_Logic::setTopicName_P).
+ * A received topic is hashed and gives the slot in the table directly,
+ * and only the object with the same hash and length is compared with the whole string
+ * (MQTT_Logic::checkTopicSubscribe), so normally there is one compare or none at all.
+ *
+ * Please note that the topics must be set before add, a later change is not seen.
+ */
+class MQTT_Dispatch
+{
+    private:
+        uint8_t cnt;                          ///< How many objects is added
+        MQTT_Logic* logic[MQTT_DISPATCH_MAX]; ///< The objects
+        uint16_t hash[MQTT_DISPATCH_MAX];     ///< Hash of the subscribe topic
+        uint8_t len[MQTT_DISPATCH_MAX];       ///< Length of the subscribe topic
+        uint8_t slot[MQTT_DISPATCH_SLOTS];    ///< Index in logic, or MQTT_DISPATCH_EMPTY
+
+        static uint16_t hashPart(uint16_t hash, const char* str, bool flash, uint16_t* len);
+
+    public:
+        MQTT_Dispatch();
+
+        bool add(MQTT_Logic* logic);
+        MQTT_Logic* find(const char* topic);
+
+        static uint16_t hashTopic(const char* topic, uint16_t* len);
+};
+
+#endif  // __MQTT_DISPATCH_H
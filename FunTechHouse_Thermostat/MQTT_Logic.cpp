@@ -25,7 +25,23 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#else
+#define PROGMEM
+#define strcmp_P(a, b) strcmp((a), (b))
+#define strncmp_P(a, b, n) strncmp((a), (b), (n))
+#define strlen_P(a) strlen(a)
+#endif
+
 #include "MQTT_Logic.h"
+#include "StringHelp.h"
+
+/**
+ * The end of the named topics (setTopicName_P), the publish topic has none.
+ */
+static const char topicSuffixSubscribe[] PROGMEM = "_Data";
+static const char topicSuffixDiagnostic[] PROGMEM = "_Diag"; ///< @see topicSuffixSubscribe
 
 /**
  * Default constructur
@@ -34,27 +50,75 @@ MQTT_Logic::MQTT_Logic()
 {
     topicIn  = NULL;
     topicOut = NULL;
+    topicDiag = NULL;
+    topicPrefix = NULL;
+    topicFlash = 0;
+
+    commandAck = false;
 }
 
 
 /**
- * What mqtt topics this sensor will use.
+ * Copy a topic to the heap, the old copy is freed (but not a topic in flash).
+ *
+ * @param topic [in,out] the topic to replace
+ * @param bit the MQTT_TOPIC_ bit for the topic
+ * @param value [in] the new topic, in ram
+ */
+void MQTT_Logic::copyTopic(char** topic, uint8_t bit, const char* value)
+{
+    if(0 == (topicFlash & bit))
+    {
+        free(*topic);
+    }
+    topicFlash &= ~(bit | (bit << MQTT_TOPIC_NAMED_SHIFT));
+
+    int len = strlen(value);
+    *topic = (char*)malloc(len+1);
+    if(NULL != *topic)
+    {
+        memcpy(*topic, value, len+1);
+    }
+}
+
+/**
+ * What mqtt topics this sensor will use, they are copied.
  *
  * @param topicSubscribe data from the mqtt server
  * @param topicPublish data to the mqtt server
- * @return true if ok
+ * @return true if ok, false if there is no heap left
  */
 bool MQTT_Logic::setTopic(char* topicSubscribe, char* topicPublish)
 {
-    int len = strlen(topicSubscribe);
-    topicIn = (char*)malloc(len+1);
-    memcpy(topicIn , topicSubscribe, len);
-    topicIn[len] = '\0';
+    copyTopic(&topicIn, MQTT_TOPIC_SUBSCRIBE, topicSubscribe);
+    copyTopic(&topicOut, MQTT_TOPIC_PUBLISH, topicPublish);
+
+    return ( (NULL != topicIn) && (NULL != topicOut) );
+}
+
+/**
+ * What mqtt topics this sensor will use, they stay in flash.
+ * Like setTopic_P(PSTR("house/in"), PSTR("house/out")), only the pointers is in ram.
+ *
+ * @param topicSubscribe [in] data from the mqtt server, in flash (PROGMEM)
+ * @param topicPublish [in] data to the mqtt server, in flash (PROGMEM)
+ * @return true if ok
+ */
+bool MQTT_Logic::setTopic_P(const char* topicSubscribe, const char* topicPublish)
+{
+    if(0 == (topicFlash & MQTT_TOPIC_SUBSCRIBE))
+    {
+        free(topicIn);
+    }
+    if(0 == (topicFlash & MQTT_TOPIC_PUBLISH))
+    {
+        free(topicOut);
+    }
 
-    len = strlen(topicPublish);
-    topicOut = (char*)malloc(len+1);
-    memcpy(topicOut , topicPublish, len);
-    topicOut[len] = '\0';
+    topicIn  = (char*)topicSubscribe;
+    topicOut = (char*)topicPublish;
+    topicFlash |= (MQTT_TOPIC_SUBSCRIBE | MQTT_TOPIC_PUBLISH);
+    topicFlash &= ~((MQTT_TOPIC_SUBSCRIBE | MQTT_TOPIC_PUBLISH) << MQTT_TOPIC_NAMED_SHIFT);
 
     return true;
 }
@@ -79,6 +143,162 @@ char* MQTT_Logic::getTopicPublish()
     return topicOut;
 }
 
+/**
+ * What mqtt topic to use for diagnostics,
+ * i.e. internal estimates that is not the normal value.
+ *
+ * @param topicDiagnostic diagnostics to the mqtt server
+ * @return true if ok, false if there is no heap left
+ */
+bool MQTT_Logic::setTopicDiagnostic(char* topicDiagnostic)
+{
+    copyTopic(&topicDiag, MQTT_TOPIC_DIAGNOSTIC, topicDiagnostic);
+    return (NULL != topicDiag);
+}
+
+/**
+ * What mqtt topic to use for diagnostics, it stays in flash.
+ *
+ * @param topicDiagnostic [in] diagnostics to the mqtt server, in flash (PROGMEM)
+ * @return true if ok
+ */
+bool MQTT_Logic::setTopicDiagnostic_P(const char* topicDiagnostic)
+{
+    if(0 == (topicFlash & MQTT_TOPIC_DIAGNOSTIC))
+    {
+        free(topicDiag);
+    }
+    topicDiag = (char*)topicDiagnostic;
+    topicFlash |= MQTT_TOPIC_DIAGNOSTIC;
+    topicFlash &= ~(MQTT_TOPIC_DIAGNOSTIC << MQTT_TOPIC_NAMED_SHIFT);
+
+    return true;
+}
+
+/**
+ * Get the stored diagnostics topic
+ *
+ * @return the stored string, or NULL if there is no diagnostics topic
+ */
+char* MQTT_Logic::getTopicDiagnostic()
+{
+    return topicDiag;
+}
+
+/**
+ * The topics is a shared prefix and a name, both stay in flash.
+ * Like setTopicName_P(prefix, PSTR("GT1-VV"), MQTT_TOPIC_SUBSCRIBE | MQTT_TOPIC_PUBLISH)
+ * with "FunTechHouse/Pannrum/" in prefix gives
+ * "FunTechHouse/Pannrum/GT1-VV_Data" (subscribe) and "FunTechHouse/Pannrum/GT1-VV" (publish).
+ *
+ * @param prefix [in] the start of the topics, in flash (PROGMEM) and shared with other objects
+ * @param name [in] the name, in flash (PROGMEM)
+ * @param topics the topics to set, MQTT_TOPIC_ bits
+ * @return true if ok
+ */
+bool MQTT_Logic::setTopicName_P(const char* prefix, const char* name, uint8_t topics)
+{
+    char** topic[3] = { &topicIn, &topicOut, &topicDiag };
+    for( uint8_t i=0 ; i<3 ; i++ )
+    {
+        uint8_t bit = (1 << i);
+        if(0 == (topics & bit))
+        {
+            continue;
+        }
+        if(0 == (topicFlash & bit))
+        {
+            free(*topic[i]);
+        }
+        *topic[i] = (char*)name;
+        topicFlash |= bit | (bit << MQTT_TOPIC_NAMED_SHIFT);
+    }
+    topicPrefix = prefix;
+
+    return true;
+}
+
+/**
+ * Get one of the topics, not for a named topic (setTopicName_P) since it is in parts.
+ *
+ * @param topic MQTT_TOPIC_SUBSCRIBE, MQTT_TOPIC_PUBLISH or MQTT_TOPIC_DIAGNOSTIC
+ * @return the stored string, or NULL if not set or named
+ */
+char* MQTT_Logic::getTopic(uint8_t topic)
+{
+    if(topicFlash & (topic << MQTT_TOPIC_NAMED_SHIFT))
+    {
+        return NULL;
+    }
+    return getTopicPart(topic);
+}
+
+/**
+ * Get one of the topics in flash, in the parts that shall be written after each other.
+ * A whole topic (setTopic_P) is only the name.
+ *
+ * @param topic MQTT_TOPIC_SUBSCRIBE, MQTT_TOPIC_PUBLISH or MQTT_TOPIC_DIAGNOSTIC
+ * @param prefix [out] the shared start, or NULL
+ * @param name [out] the name
+ * @param suffix [out] the end, or NULL
+ * @return true if ok, false if the topic is not set or not in flash
+ */
+bool MQTT_Logic::getTopic_P(uint8_t topic, const char** prefix, const char** name, const char** suffix)
+{
+    *prefix = NULL;
+    *name   = getTopicPart(topic);
+    *suffix = NULL;
+    if( (NULL == *name) || !isTopicFlash(topic) )
+    {
+        return false;
+    }
+
+    if(topicFlash & (topic << MQTT_TOPIC_NAMED_SHIFT))
+    {
+        *prefix = topicPrefix;
+        if(MQTT_TOPIC_SUBSCRIBE == topic)
+        {
+            *suffix = topicSuffixSubscribe;
+        }
+        else if(MQTT_TOPIC_DIAGNOSTIC == topic)
+        {
+            *suffix = topicSuffixDiagnostic;
+        }
+    }
+    return true;
+}
+
+/**
+ * The stored pointer for a topic.
+ *
+ * @param topic MQTT_TOPIC_SUBSCRIBE, MQTT_TOPIC_PUBLISH or MQTT_TOPIC_DIAGNOSTIC
+ * @return the pointer, or NULL if not set
+ */
+char* MQTT_Logic::getTopicPart(uint8_t topic)
+{
+    switch(topic)
+    {
+        case MQTT_TOPIC_SUBSCRIBE:
+            return topicIn;
+        case MQTT_TOPIC_PUBLISH:
+            return topicOut;
+        case MQTT_TOPIC_DIAGNOSTIC:
+            return topicDiag;
+    }
+    return NULL;
+}
+
+/**
+ * Is the topic in flash (setTopic_P)?
+ *
+ * @param topic MQTT_TOPIC_SUBSCRIBE, MQTT_TOPIC_PUBLISH or MQTT_TOPIC_DIAGNOSTIC
+ * @return true if in flash, false if in ram
+ */
+bool MQTT_Logic::isTopicFlash(uint8_t topic)
+{
+    return (0 != (topicFlash & topic));
+}
+
 /**
  * Is this topic the same as the stored one?
  *
@@ -89,6 +309,22 @@ bool MQTT_Logic::checkTopicSubscribe(char* check)
 {
     bool res = false;
 
+    if(NULL == topicIn)
+    {
+        return false;
+    }
+
+    if(topicFlash & (MQTT_TOPIC_SUBSCRIBE << MQTT_TOPIC_NAMED_SHIFT))
+    {
+        const char* name = skipPrefix(check, topicPrefix);
+        return checkTopicSubscribe(topicPrefix, name);
+    }
+
+    if(topicFlash & MQTT_TOPIC_SUBSCRIBE)
+    {
+        return (0 == strcmp_P(check, topicIn));
+    }
+
     if(0 == strcmp(check,topicIn))
     {
         res = true;
@@ -96,3 +332,189 @@ bool MQTT_Logic::checkTopicSubscribe(char* check)
 
     return res;
 }
+
+/**
+ * Is this the subscribe topic, when the prefix is already checked?
+ * Many objects can share the prefix, so it is only compared once (skipPrefix).
+ *
+ * @param prefix [in] the prefix that was skipped, in flash
+ * @param name [in] the rest of the topic, NULL if the prefix did not match
+ * @return true if same, false if not the same or not a named topic.
+ */
+bool MQTT_Logic::checkTopicSubscribe(const char* prefix, const char* name)
+{
+    if( (NULL == name) || (NULL == topicIn) || (prefix != topicPrefix) ||
+        (0 == (topicFlash & (MQTT_TOPIC_SUBSCRIBE << MQTT_TOPIC_NAMED_SHIFT))) )
+    {
+        return false;
+    }
+    size_t len = strlen_P(topicIn);
+    if(0 != strncmp_P(name, topicIn, len))
+    {
+        return false;
+    }
+    return (0 == strcmp_P(name+len, topicSuffixSubscribe));
+}
+
+/**
+ * Skip the prefix of a received topic.
+ *
+ * @param check [in] the received topic
+ * @param prefix [in] the prefix, in flash
+ * @return the rest of the topic, or NULL if it does not start with the prefix
+ */
+const char* MQTT_Logic::skipPrefix(const char* check, const char* prefix)
+{
+    if(NULL == prefix)
+    {
+        return NULL;
+    }
+    size_t len = strlen_P(prefix);
+    if(0 != strncmp_P(check, prefix, len))
+    {
+        return NULL;
+    }
+    return check+len;
+}
+
+/**
+ * Chars between the commands.
+ *
+ * @param c the char to check
+ * @return true if separator
+ */
+static bool isCommandSeparator(char c)
+{
+    return ( (' ' == c) || (';' == c) || (',' == c) || ('\r' == c) || ('\n' == c) );
+}
+
+/**
+ * Parse and apply commands from the server, like "setpoint=55.5 ; hyst=3".
+ *
+ * The parse is done in place on the received data, so it can be used
+ * directly on the payload from the mqtt client (that is not null terminated).
+ * Every value is parsed as a number in 0.01 steps and given to commandSet(),
+ * and the new state shall be sent to the server as ack (see commandTimeToSend).
+ *
+ * @param data [in] the received payload
+ * @param size length of the payload
+ * @return true if all commands was ok, false if some was unknown or had a bad value.
+ */
+bool MQTT_Logic::commandParse(const char* data, unsigned int size)
+{
+    bool ok = true;
+    unsigned int pos = 0;
+
+    while(pos < size)
+    {
+        //Skip the separators between the commands
+        if(isCommandSeparator(data[pos]))
+        {
+            pos++;
+            continue;
+        }
+
+        //key=value
+        const char* key = data+pos;
+        unsigned int keyLen = 0;
+        while( (pos < size) && ('=' != data[pos]) && !isCommandSeparator(data[pos]) )
+        {
+            keyLen++;
+            pos++;
+        }
+
+        if( (pos >= size) || ('=' != data[pos]) )
+        {
+            ok = false;
+            continue;
+        }
+        pos++;
+
+        const char* value = data+pos;
+        unsigned int valueLen = 0;
+        while( (pos < size) && !isCommandSeparator(data[pos]) )
+        {
+            valueLen++;
+            pos++;
+        }
+
+        long number = 0;
+        if( !StringHelp::parseFixed(value, valueLen, &number) ||
+            !commandSet(key, keyLen, number) )
+        {
+            ok = false;
+        }
+    }
+
+    //Always ack, so the server can see what the state is after a bad command.
+    commandAck = true;
+    return ok;
+}
+
+/**
+ * Is the key the same as name?
+ *
+ * @param key [in] the key, not null terminated
+ * @param keyLen length of the key
+ * @param name [in] the name to compare with
+ * @return true if same
+ */
+bool MQTT_Logic::commandIs(const char* key, unsigned int keyLen, const char* name)
+{
+    if(strlen(name) != keyLen)
+    {
+        return false;
+    }
+    return (0 == strncmp(key, name, keyLen));
+}
+
+/**
+ * Apply one command, this is implemented by the classes that has commands.
+ *
+ * @param key [in] the command, not null terminated
+ * @param keyLen length of the key
+ * @param value the value in 0.01 steps, i.e. 5550 is 55.5
+ * @return true if ok, false if unknown command or bad value.
+ */
+bool MQTT_Logic::commandSet(const char* key, unsigned int keyLen, long value)
+{
+    (void)key;
+    (void)keyLen;
+    (void)value;
+    return false;
+}
+
+/**
+ * Is there a ack for a command that should be sent to the server?
+ *
+ * @return true if time to send
+ */
+bool MQTT_Logic::commandTimeToSend()
+{
+    return commandAck;
+}
+
+/**
+ * The ack with the state that can be changed by commands.
+ *
+ * @param data [out] the string to send
+ * @param size size of data
+ * @return true if ok
+ */
+bool MQTT_Logic::getCommandString(char* data, int size)
+{
+    int res = snprintf(data, size, "#ack");
+
+    if(res < size)
+        return true;
+
+    return false;
+}
+
+/**
+ * The ack was sent to the server.
+ */
+void MQTT_Logic::commandIsSent()
+{
+    commandAck = false;
+}
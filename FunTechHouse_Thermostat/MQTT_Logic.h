@@ -24,24 +24,75 @@
 #ifndef  __MQTT_LOGIC_H
 #define  __MQTT_LOGIC_H
 
+#include <stdint.h>
+
+/**
+ * The topics, as bits in the flash mask.
+ */
+#define MQTT_TOPIC_SUBSCRIBE  0x01 ///< Data from the server
+#define MQTT_TOPIC_PUBLISH    0x02 ///< Data to the server
+#define MQTT_TOPIC_DIAGNOSTIC 0x04 ///< Diagnostics to the server
+
+/**
+ * The topic is prefix+name+suffix (setTopicName_P), as bits in the flash mask.
+ */
+#define MQTT_TOPIC_NAMED_SHIFT 4
+
 /**
  * The MQTT logic functions that can be inherited.
+ *
+ * The topics can be copied to the heap (setTopic) or stay in flash (setTopic_P),
+ * then only the pointer is in ram. A topic in flash must be sent with
+ * PubSubClient::publish_P and PubSubClient::subscribe_P, see isTopicFlash() and getTopic_P().
+ *
+ * Many objects often has the same start of the topics, like "FunTechHouse/Pannrum/".
+ * With setTopicName_P they share that prefix and only has a short name,
+ * the topics is then prefix+name+"_Data" (subscribe), prefix+name (publish)
+ * and prefix+name+"_Diag".
+ * The parts is never put together, they are written one after the other to the packet.
  */
 class MQTT_Logic
 {
     protected:
+        static bool commandIs(const char* key, unsigned int keyLen, const char* name);
+        virtual bool commandSet(const char* key, unsigned int keyLen, long value);
 
     private: 
         char* topicIn; ///< MQTT topic for data from the server
         char* topicOut;///< MQTT topic for data to the server
+        char* topicDiag;///< MQTT topic for diagnostics to the server, NULL if not used
+        const char* topicPrefix; ///< Shared start of the named topics (flash)
+        uint8_t topicFlash; ///< The topics that is in flash (PROGMEM), a MQTT_TOPIC_ bit each,
+                            ///< and the named ones << MQTT_TOPIC_NAMED_SHIFT
+
+        void copyTopic(char** topic, uint8_t bit, const char* value);
+        char* getTopicPart(uint8_t topic);
+
+        bool commandAck; ///< A command is applied, send the new state to the server
 
     public:
         MQTT_Logic();
 
         bool setTopic(char* topicSubscribe, char* topicPublish);
+        bool setTopic_P(const char* topicSubscribe, const char* topicPublish);
         char* getTopicSubscribe();
         char* getTopicPublish();
+        bool setTopicDiagnostic(char* topicDiagnostic);
+        bool setTopicDiagnostic_P(const char* topicDiagnostic);
+        char* getTopicDiagnostic();
+        bool setTopicName_P(const char* prefix, const char* name, uint8_t topics);
+        char* getTopic(uint8_t topic);
+        bool getTopic_P(uint8_t topic, const char** prefix, const char** name, const char** suffix);
+        bool isTopicFlash(uint8_t topic);
         bool checkTopicSubscribe(char* check);
+        bool checkTopicSubscribe(const char* prefix, const char* name);
+
+        static const char* skipPrefix(const char* check, const char* prefix);
+
+        bool commandParse(const char* data, unsigned int size);
+        bool commandTimeToSend();
+        virtual bool getCommandString(char* data, int size);
+        void commandIsSent();
 
 };
 
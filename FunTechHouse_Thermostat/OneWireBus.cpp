@@ -0,0 +1,112 @@
+/**
+ * @file OneWireBus.cpp
+ * @author Johan Simonsson
+ * @brief Byte level interface to a OneWire bus
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "OneWireBus.h"
+
+/**
+ * The default constructor.
+ */
+OneWireBus::OneWireBus()
+{
+    transferState = ONEWIRE_XFER_DONE;
+}
+
+/**
+ * Reset, write some bytes and then read some bytes.
+ *
+ * This is done at once with reset(), write() and read(),
+ * a bus that can do it in the background must override this and getTransferState().
+ *
+ * @param flags ONEWIRE_XFER_RESET and/or ONEWIRE_XFER_POWER
+ * @param tx [in] the bytes to write, must be kept until the transfer is done
+ * @param txLen how many bytes to write
+ * @param rx [out] the read bytes
+ * @param rxLen how many bytes to read
+ * @return true if started, false if a other transfer is running
+ */
+bool OneWireBus::transfer(uint8_t flags, const uint8_t* tx, uint8_t txLen, uint8_t* rx, uint8_t rxLen)
+{
+    if( (flags & ONEWIRE_XFER_RESET) && !reset() )
+    {
+        transferState = ONEWIRE_XFER_NO_DEVICE;
+        return true;
+    }
+
+    for( uint8_t i=0 ; i<txLen ; i++ )
+    {
+        uint8_t power = 0;
+        if( (flags & ONEWIRE_XFER_POWER) && (i == txLen-1) && (0 == rxLen) )
+        {
+            power = 1;
+        }
+        write(tx[i], power);
+    }
+
+    for( uint8_t i=0 ; i<rxLen ; i++ )
+    {
+        rx[i] = read();
+    }
+
+    transferState = ONEWIRE_XFER_DONE;
+    return true;
+}
+
+/**
+ * Is the last transfer() done?
+ *
+ * @return ONEWIRE_XFER_DONE, ONEWIRE_XFER_BUSY or ONEWIRE_XFER_NO_DEVICE
+ */
+uint8_t OneWireBus::getTransferState()
+{
+    return transferState;
+}
+
+/**
+ * The Dallas/Maxim 8 bit crc (x^8 + x^5 + x^4 + 1), used in the ROM and scratchpad.
+ *
+ * The same as OneWire::crc8, but without the table
+ * and also on the pc.
+ *
+ * @param data [in] the bytes
+ * @param len how many bytes
+ * @return the crc, data with the crc at the end gives 0.
+ */
+uint8_t OneWireBus::crc8(const uint8_t* data, uint8_t len)
+{
+    uint8_t crc = 0;
+    while(len--)
+    {
+        uint8_t in = *data++;
+        for( uint8_t i=0 ; i<8 ; i++ )
+        {
+            uint8_t mix = (crc ^ in) & 0x01;
+            crc >>= 1;
+            if(mix)
+            {
+                crc ^= 0x8C;
+            }
+            in >>= 1;
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file OneWireBus.h
+ * @author Johan Simonsson
+ * @brief Byte level interface to a OneWire bus
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __ONEWIREBUS_H
+#define  __ONEWIREBUS_H
+
+#include <stdint.h>
+
+/**
+ * The OneWire commands to all devices.
+ */
+#define ONEWIRE_CMD_SEARCH_ROM 0xF0 ///< Search for the ROM codes
+#define ONEWIRE_CMD_ALARM_SEARCH 0xEC ///< Search for the ROM codes with a alarm
+#define ONEWIRE_CMD_MATCH_ROM  0x55 ///< Next command is for one device (select)
+#define ONEWIRE_CMD_SKIP_ROM   0xCC ///< Next command is for all devices (skip)
+
+/**
+ * The flags to transfer().
+ */
+#define ONEWIRE_XFER_RESET 0x01 ///< Reset before the bytes, and check for a device
+#define ONEWIRE_XFER_POWER 0x02 ///< Keep the bus high after the last byte written
+
+/**
+ * The state of the last transfer().
+ */
+#define ONEWIRE_XFER_DONE      0 ///< Done, the bytes is read
+#define ONEWIRE_XFER_BUSY      1 ///< Still running
+#define ONEWIRE_XFER_NO_DEVICE 2 ///< No device answered the reset
+
+/**
+ * A OneWire bus on byte level, with the same functions as the OneWire library.
+ *
+ * The drivers (i.e. DS18B20Bus) only use this,
+ * so they can be tested on the pc with a simulated bus.
+ * On the Arduino it is OneWirePin or OneWireEngine.
+ *
+ * A whole command (reset, write and read) can also be done with transfer(),
+ * here it is done at once with the functions below,
+ * but OneWireEngine does it in the background.
+ */
+class OneWireBus
+{
+    protected:
+        volatile uint8_t transferState; ///< The state of the last transfer
+
+    public:
+        OneWireBus();
+        virtual ~OneWireBus() {}
+
+        /**
+         * Reset pulse.
+         *
+         * @return 1 if there is a device on the bus
+         */
+        virtual uint8_t reset() = 0;
+
+        /**
+         * Write a byte.
+         *
+         * @param value the byte
+         * @param power 1 keeps the bus high after, for parasite powered devices
+         */
+        virtual void write(uint8_t value, uint8_t power = 0) = 0;
+
+        /**
+         * Read a byte.
+         *
+         * @return the byte
+         */
+        virtual uint8_t read() = 0;
+
+        /**
+         * Match ROM, the next command is only for this device.
+         *
+         * @param rom [in] the 8 byte ROM code
+         */
+        virtual void select(const uint8_t* rom) = 0;
+
+        /**
+         * Skip ROM, the next command is for all devices.
+         */
+        virtual void skip() = 0;
+
+        /**
+         * Stop the power from write(value, 1).
+         */
+        virtual void depower() = 0;
+
+        /**
+         * Start the next search() from the beginning.
+         */
+        virtual void resetSearch() = 0;
+
+        /**
+         * Find the next device.
+         *
+         * @param rom [out] the 8 byte ROM code
+         * @param alarm true to only find the devices with a alarm (0xEC)
+         * @return 1 if a device is found, 0 if there is no more devices
+         */
+        virtual uint8_t search(uint8_t* rom, bool alarm = false) = 0;
+
+        virtual bool transfer(uint8_t flags, const uint8_t* tx, uint8_t txLen, uint8_t* rx, uint8_t rxLen);
+        virtual uint8_t getTransferState();
+
+        static uint8_t crc8(const uint8_t* data, uint8_t len);
+};
+
+#endif  // __ONEWIREBUS_H
@@ -0,0 +1,597 @@
+/**
+ * @file OneWireEngine.cpp
+ * @author Johan Simonsson
+ * @brief A OneWire bus driven by a timer interrupt
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#if defined(__AVR__)
+#include <Arduino.h>
+#endif
+
+#include "OneWireEngine.h"
+
+#if defined(__AVR__)
+/**
+ * The engine that has Timer2.
+ */
+static OneWireEngine* oneWireEngineActive = NULL;
+
+/**
+ * Time for the next part of the slot.
+ */
+ISR(TIMER2_COMPA_vect)
+{
+    if(NULL != oneWireEngineActive)
+    {
+        oneWireEngineActive->isr();
+    }
+}
+#endif
+
+/**
+ * The default constructor, call begin() before it is used.
+ *
+ * @param pin the pin the bus is connected to (not used on the pc)
+ */
+OneWireEngine::OneWireEngine(uint8_t pin)
+{
+#if defined(__AVR__)
+    mask = PIN_TO_BITMASK(pin);
+    reg  = PIN_TO_BASEREG(pin);
+#else
+    (void)pin;
+    line = 0;
+    now = 0;
+    slotTime = 0;
+    nextTime = 0;
+    busyTime = 0;
+    isrCount = 0;
+    latency = 0;
+#endif
+    phase  = ONEWIRE_PHASE_IDLE;
+    flags  = 0;
+    tx     = 0;
+    rx     = 0;
+    txBits = 0;
+    rxBits = 0;
+    bitPos = 0;
+    resetSearch();
+}
+
+/**
+ * Release the pin and take Timer2.
+ */
+void OneWireEngine::begin()
+{
+    pinRelease();
+
+#if defined(__AVR__)
+    oneWireEngineActive = this;
+
+    //CTC mode, clock/32 (2us), the interrupt is on when a transfer is running
+    TIMSK2 = 0;
+    TCCR2A = (1<<WGM21);
+    TCCR2B = (1<<CS21) | (1<<CS20);
+#endif
+}
+
+/**
+ * Start a transfer on bit level.
+ *
+ * @param flags ONEWIRE_XFER_RESET and/or ONEWIRE_XFER_POWER
+ * @param tx [in] the bits to write, the lowest bit first
+ * @param txBits how many bits to write
+ * @param rx [out] the read bits
+ * @param rxBits how many bits to read
+ * @return true if started, false if a other transfer is running
+ */
+bool OneWireEngine::start(uint8_t flags, const uint8_t* tx, uint16_t txBits, uint8_t* rx, uint16_t rxBits)
+{
+    if(ONEWIRE_XFER_BUSY == transferState)
+    {
+        return false;
+    }
+
+    this->flags  = flags;
+    this->tx     = tx;
+    this->txBits = txBits;
+    this->rx     = rx;
+    this->rxBits = rxBits;
+    bitPos = 0;
+    transferState = ONEWIRE_XFER_BUSY;
+
+#if defined(__AVR__)
+    //The timer counts from now, so timerStart() does not see a old count
+    TCNT2 = 0;
+#else
+    slotTime = now;
+#endif
+
+    if(flags & ONEWIRE_XFER_RESET)
+    {
+        phase = ONEWIRE_PHASE_RESET;
+        pinLow();
+        timerStart(ONEWIRE_US_RESET_LOW);
+    }
+    else
+    {
+        phase = ONEWIRE_PHASE_SLOT;
+        timerStart(ONEWIRE_US_START);
+    }
+
+#if defined(__AVR__)
+    TIFR2 = (1<<OCF2A);
+    TIMSK2 |= (1<<OCIE2A);
+#endif
+    return true;
+}
+
+/**
+ * Wait for the transfer to be done.
+ */
+void OneWireEngine::wait()
+{
+    while(ONEWIRE_XFER_BUSY == getTransferState())
+    {
+    }
+}
+
+/**
+ * The next part of the transfer, only to be called from the timer interrupt.
+ */
+void OneWireEngine::isr()
+{
+#if !defined(__AVR__)
+    isrCount++;
+#endif
+
+    if(ONEWIRE_PHASE_RESET == phase)
+    {
+        pinRelease();
+        phase = ONEWIRE_PHASE_PRESENCE;
+        timerStart(ONEWIRE_US_PRESENCE);
+        return;
+    }
+
+    if(ONEWIRE_PHASE_PRESENCE == phase)
+    {
+        if(pinRead())
+        {
+            timerStop();
+            phase = ONEWIRE_PHASE_IDLE;
+            transferState = ONEWIRE_XFER_NO_DEVICE;
+            return;
+        }
+        phase = ONEWIRE_PHASE_SLOT;
+        timerStart(ONEWIRE_US_RESET_REST);
+        return;
+    }
+
+    if(ONEWIRE_PHASE_WRITE0 == phase)
+    {
+        pinRelease();
+        phase = ONEWIRE_PHASE_SLOT;
+        timerStart(ONEWIRE_US_RECOVERY);
+        return;
+    }
+
+    if(bitPos < txBits)
+    {
+        uint8_t bit = (tx[bitPos >> 3] >> (bitPos & 0x07)) & 0x01;
+        bitPos++;
+
+        pinLow();
+        if(bit)
+        {
+            busyWait(ONEWIRE_US_WRITE1_LOW);
+            pinRelease();
+            timerStart(ONEWIRE_US_SLOT);
+        }
+        else
+        {
+            phase = ONEWIRE_PHASE_WRITE0;
+            timerStart(ONEWIRE_US_WRITE0_LOW);
+        }
+        return;
+    }
+
+    if(bitPos < (txBits + rxBits))
+    {
+        uint16_t pos = bitPos - txBits;
+        uint8_t rxMask = 1 << (pos & 0x07);
+        bitPos++;
+
+        pinLow();
+        busyWait(ONEWIRE_US_READ_LOW);
+        pinRelease();
+        busyWait(ONEWIRE_US_READ_SAMPLE);
+        if(pinRead())
+        {
+            rx[pos >> 3] |= rxMask;
+        }
+        else
+        {
+            rx[pos >> 3] &= ~rxMask;
+        }
+        timerStart(ONEWIRE_US_SLOT);
+        return;
+    }
+
+    //Done, the devices needs the power within 10us for Convert T and Copy Scratchpad
+    if(flags & ONEWIRE_XFER_POWER)
+    {
+        pinPower();
+    }
+    timerStop();
+    phase = ONEWIRE_PHASE_IDLE;
+    transferState = ONEWIRE_XFER_DONE;
+}
+
+/**
+ * Reset, write some bytes and then read some bytes in the background.
+ *
+ * @param flags ONEWIRE_XFER_RESET and/or ONEWIRE_XFER_POWER
+ * @param tx [in] the bytes to write, must be kept until the transfer is done
+ * @param txLen how many bytes to write
+ * @param rx [out] the read bytes, not valid until the transfer is done
+ * @param rxLen how many bytes to read
+ * @return true if started, false if a other transfer is running
+ */
+bool OneWireEngine::transfer(uint8_t flags, const uint8_t* tx, uint8_t txLen, uint8_t* rx, uint8_t rxLen)
+{
+    return start(flags, tx, txLen*8, rx, rxLen*8);
+}
+
+/**
+ * Is the last transfer() done?
+ *
+ * @return ONEWIRE_XFER_DONE, ONEWIRE_XFER_BUSY or ONEWIRE_XFER_NO_DEVICE
+ */
+uint8_t OneWireEngine::getTransferState()
+{
+#if !defined(__AVR__)
+    //On the pc the time only moves when we look
+    if(ONEWIRE_XFER_BUSY == transferState)
+    {
+        slotTime = nextTime;
+        now = nextTime + latency;
+        isr();
+    }
+#endif
+    return transferState;
+}
+
+uint8_t OneWireEngine::reset()
+{
+    start(ONEWIRE_XFER_RESET, 0, 0, 0, 0);
+    wait();
+    return (ONEWIRE_XFER_DONE == transferState) ? 1 : 0;
+}
+
+void OneWireEngine::write(uint8_t value, uint8_t power)
+{
+    buffer[0] = value;
+    start((1 == power) ? ONEWIRE_XFER_POWER : 0, buffer, 8, 0, 0);
+    wait();
+}
+
+uint8_t OneWireEngine::read()
+{
+    start(0, 0, 0, buffer, 8);
+    wait();
+    return buffer[0];
+}
+
+void OneWireEngine::select(const uint8_t* rom)
+{
+    buffer[0] = ONEWIRE_CMD_MATCH_ROM;
+    memcpy(&buffer[1], rom, 8);
+    start(0, buffer, 9*8, 0, 0);
+    wait();
+}
+
+void OneWireEngine::skip()
+{
+    write(ONEWIRE_CMD_SKIP_ROM);
+}
+
+void OneWireEngine::depower()
+{
+    pinRelease();
+}
+
+void OneWireEngine::resetSearch()
+{
+    memset(searchRom, 0, 8);
+    lastDiscrepancy = 0;
+    lastDevice = false;
+}
+
+/**
+ * Find the next device, the search algorithm from Maxim AN187.
+ *
+ * Every bit is 3 slots (the bit, the complement and the direction),
+ * so this waits for the bus for about 14ms.
+ *
+ * @param rom [out] the 8 byte ROM code
+ * @param alarm true to only find the devices with a alarm (0xEC)
+ * @return 1 if a device is found, 0 if there is no more devices
+ */
+uint8_t OneWireEngine::search(uint8_t* rom, bool alarm)
+{
+    if(lastDevice)
+    {
+        return 0;
+    }
+    if(!reset())
+    {
+        resetSearch();
+        return 0;
+    }
+    write(alarm ? ONEWIRE_CMD_ALARM_SEARCH : ONEWIRE_CMD_SEARCH_ROM);
+
+    uint8_t lastZero = 0;
+    for( uint8_t bit=1 ; bit<=64 ; bit++ )
+    {
+        //The bit and the complement from all devices that is left
+        uint8_t pair = 0;
+        start(0, 0, 0, &pair, 2);
+        wait();
+        uint8_t idBit  = pair & 0x01;
+        uint8_t cmpBit = (pair >> 1) & 0x01;
+        if(idBit && cmpBit)
+        {
+            resetSearch();
+            return 0;
+        }
+
+        uint8_t byte = (bit-1) >> 3;
+        uint8_t bitMask = 1 << ((bit-1) & 0x07);
+        uint8_t dir;
+        if(idBit != cmpBit)
+        {
+            dir = idBit;
+        }
+        else
+        {
+            //Both 0 and 1, take the same way as last time up to the last discrepancy
+            if(bit < lastDiscrepancy)
+            {
+                dir = (searchRom[byte] & bitMask) ? 1 : 0;
+            }
+            else
+            {
+                dir = (bit == lastDiscrepancy) ? 1 : 0;
+            }
+            if(0 == dir)
+            {
+                lastZero = bit;
+            }
+        }
+
+        if(dir)
+        {
+            searchRom[byte] |= bitMask;
+        }
+        else
+        {
+            searchRom[byte] &= ~bitMask;
+        }
+        start(0, &dir, 1, 0, 0);
+        wait();
+    }
+
+    lastDiscrepancy = lastZero;
+    if(0 == lastDiscrepancy)
+    {
+        lastDevice = true;
+    }
+    memcpy(rom, searchRom, 8);
+    return 1;
+}
+
+/**
+ * Drive the wire low.
+ */
+void OneWireEngine::pinLow()
+{
+#if defined(__AVR__)
+    DIRECT_WRITE_LOW(reg, mask);
+    DIRECT_MODE_OUTPUT(reg, mask);
+#else
+    if(line)
+    {
+        line->drive(now, ONEWIRE_LINE_LOW);
+    }
+#endif
+}
+
+/**
+ * Let the pull up (or a device) have the wire.
+ */
+void OneWireEngine::pinRelease()
+{
+#if defined(__AVR__)
+    DIRECT_MODE_INPUT(reg, mask);
+    DIRECT_WRITE_LOW(reg, mask);
+#else
+    if(line)
+    {
+        line->drive(now, ONEWIRE_LINE_RELEASE);
+    }
+#endif
+}
+
+/**
+ * Drive the wire high, for parasite powered devices.
+ */
+void OneWireEngine::pinPower()
+{
+#if defined(__AVR__)
+    DIRECT_WRITE_HIGH(reg, mask);
+    DIRECT_MODE_OUTPUT(reg, mask);
+#else
+    if(line)
+    {
+        line->drive(now, ONEWIRE_LINE_POWER);
+    }
+#endif
+}
+
+/**
+ * Read the wire.
+ *
+ * @return 1 if high
+ */
+uint8_t OneWireEngine::pinRead()
+{
+#if defined(__AVR__)
+    return DIRECT_READ(reg, mask);
+#else
+    if(line)
+    {
+        return line->sample(now);
+    }
+    return 1;
+#endif
+}
+
+/**
+ * Wait in the interrupt, only for the short parts of a slot.
+ *
+ * @param us the time
+ */
+void OneWireEngine::busyWait(uint8_t us)
+{
+#if defined(__AVR__)
+    delayMicroseconds(us);
+#else
+    now += us;
+    busyTime += us;
+#endif
+}
+
+/**
+ * The next interrupt, counted from the last one.
+ *
+ * In CTC mode the compare register is not buffered, so a value that the
+ * timer already has passed is not seen until the timer wraps (512us later).
+ * The interrupt is 4-6us after the match, so a short time (the recovery after a 0)
+ * would be missed. Then the interrupt is ONEWIRE_US_TIMER_MIN from now instead,
+ * and that part of the slot is a bit longer.
+ *
+ * @param us the time, 2..512us
+ */
+void OneWireEngine::timerStart(uint16_t us)
+{
+#if defined(__AVR__)
+    uint16_t count = (us >> 1) - 1;
+    uint16_t min = TCNT2 + (ONEWIRE_US_TIMER_MIN >> 1);
+    if(count < min)
+    {
+        count = min;
+    }
+    if(count > 0xFF)
+    {
+        count = 0xFF;
+    }
+    OCR2A = (uint8_t)count;
+#else
+    //The same, with the timer count as the time since the match
+    uint32_t count = us;
+    uint32_t min = (now - slotTime) + ONEWIRE_US_TIMER_MIN;
+    if(count < min)
+    {
+        count = min;
+    }
+    nextTime = slotTime + count;
+
+    //And the timer, a compare it has passed is seen after the wrap
+    if(nextTime <= now)
+    {
+        nextTime += ONEWIRE_US_TIMER_WRAP;
+    }
+#endif
+}
+
+/**
+ * No more interrupts, the transfer is done.
+ */
+void OneWireEngine::timerStop()
+{
+#if defined(__AVR__)
+    TIMSK2 &= ~(1<<OCIE2A);
+#endif
+}
+
+#if !defined(__AVR__)
+/**
+ * The simulated wire.
+ *
+ * @param line the wire, or NULL for no devices
+ */
+void OneWireEngine::setLine(OneWireLine* line)
+{
+    this->line = line;
+}
+
+/**
+ * The time from the compare match to the interrupt code,
+ * the vector, the register push and the call to isr().
+ *
+ * @param us the latency, 0 (default) is a ideal interrupt
+ */
+void OneWireEngine::setLatency(uint8_t us)
+{
+    latency = us;
+}
+
+/**
+ * The simulated time.
+ *
+ * @return the time in us
+ */
+uint32_t OneWireEngine::getTime()
+{
+    return now;
+}
+
+/**
+ * How long the interrupt has waited, the time the cpu is not free.
+ *
+ * @return the time in us
+ */
+uint32_t OneWireEngine::getBusyTime()
+{
+    return busyTime;
+}
+
+/**
+ * How many interrupts.
+ *
+ * @return the count
+ */
+uint32_t OneWireEngine::getIsrCount()
+{
+    return isrCount;
+}
+#endif
@@ -0,0 +1,190 @@
+/**
+ * @file OneWireEngine.h
+ * @author Johan Simonsson
+ * @brief A OneWire bus driven by a timer interrupt
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __ONEWIREENGINE_H
+#define  __ONEWIREENGINE_H
+
+#include <stdint.h>
+
+#include "OneWireBus.h"
+
+#if defined(__AVR__)
+#include "OneWire.h"
+#endif
+
+/**
+ * The timing in us, the same as the OneWire library.
+ */
+#define ONEWIRE_US_RESET_LOW   500 ///< The reset pulse
+#define ONEWIRE_US_PRESENCE     80 ///< Release to the sample of the presence pulse
+#define ONEWIRE_US_RESET_REST  420 ///< Sample to the end of the reset
+#define ONEWIRE_US_SLOT         70 ///< A write 1 or read slot
+#define ONEWIRE_US_WRITE1_LOW   10 ///< Low time for a 1
+#define ONEWIRE_US_WRITE0_LOW   64 ///< Low time for a 0
+#define ONEWIRE_US_RECOVERY      6 ///< High time after a 0
+#define ONEWIRE_US_READ_LOW      3 ///< Low time to start a read
+#define ONEWIRE_US_READ_SAMPLE  10 ///< Release to the sample of a read
+#define ONEWIRE_US_START        10 ///< From transfer() to the first slot (without reset)
+
+/**
+ * The next compare is never closer than this to the timer when it is set,
+ * else the match is missed and the interrupt comes after the wrap (512us).
+ * The interrupt latency is 4-6us, so a short part (the recovery) gets longer instead.
+ */
+#define ONEWIRE_US_TIMER_MIN     4
+
+/**
+ * The time for a whole turn of Timer2, 256 steps of 2us.
+ */
+#define ONEWIRE_US_TIMER_WRAP  512
+
+/**
+ * What the next timer interrupt shall do.
+ */
+#define ONEWIRE_PHASE_IDLE     0 ///< Nothing
+#define ONEWIRE_PHASE_RESET    1 ///< End the reset pulse
+#define ONEWIRE_PHASE_PRESENCE 2 ///< Sample the presence pulse
+#define ONEWIRE_PHASE_SLOT     3 ///< Start the next bit
+#define ONEWIRE_PHASE_WRITE0   4 ///< End the low part of a 0
+
+#if !defined(__AVR__)
+/**
+ * The levels for OneWireLine::drive().
+ */
+#define ONEWIRE_LINE_LOW     0 ///< Driven low
+#define ONEWIRE_LINE_RELEASE 1 ///< Released, the pull up (or a device)
+#define ONEWIRE_LINE_POWER   2 ///< Driven high, for parasite powered devices
+
+/**
+ * The wire on the pc, so the engine can be tested with a simulated bus.
+ */
+class OneWireLine
+{
+    public:
+        virtual ~OneWireLine() {}
+
+        /**
+         * The engine changes the wire.
+         *
+         * @param us the time
+         * @param level ONEWIRE_LINE_LOW, ONEWIRE_LINE_RELEASE or ONEWIRE_LINE_POWER
+         */
+        virtual void drive(uint32_t us, uint8_t level) = 0;
+
+        /**
+         * The engine reads the wire.
+         *
+         * @param us the time
+         * @return 1 if the wire is high
+         */
+        virtual uint8_t sample(uint32_t us) = 0;
+};
+#endif
+
+/**
+ * A OneWire bus where every bit is done from the Timer2 compare interrupt,
+ * so transfer() returns at once and the bytes is sent and read in the background.
+ *
+ * The interrupt only waits for the short parts of a slot (10us for a 1,
+ * 13us for a read), the rest of the 70us slot and the whole 0 and reset
+ * is done by the timer. So the cpu is free about 80% of the bus time,
+ * and the interrupts is only disabled in the short parts.
+ *
+ * The functions from OneWireBus (reset, write, read, search...) is also here,
+ * they start a transfer and wait for it.
+ *
+ * Timer2 runs at 16MHz/32 (2us), so only one engine can be used,
+ * and not together with tone() or analogWrite() on pin 3 and 11.
+ *
+ * On the pc the wire is a OneWireLine, and the time only moves
+ * when getTransferState() is called (one interrupt every call).
+ * The interrupt can be set to come some us after the compare match (setLatency),
+ * and a compare that is set behind the timer is missed like on the AVR.
+ */
+class OneWireEngine : public OneWireBus
+{
+    private:
+#if defined(__AVR__)
+        IO_REG_TYPE mask;          ///< The pin
+        volatile IO_REG_TYPE* reg; ///< The port of the pin
+#else
+        OneWireLine* line;  ///< The simulated wire
+        uint32_t now;       ///< The time in us
+        uint32_t slotTime;  ///< When the last interrupt was
+        uint32_t nextTime;  ///< When the next interrupt is
+        uint32_t busyTime;  ///< Time waited in the interrupt
+        uint32_t isrCount;  ///< How many interrupts
+        uint8_t latency;    ///< From the compare match to the interrupt code
+#endif
+        volatile uint8_t phase; ///< What the next interrupt shall do, ONEWIRE_PHASE_*
+        uint8_t flags;          ///< ONEWIRE_XFER_RESET and ONEWIRE_XFER_POWER
+        const uint8_t* tx;      ///< The bytes to write
+        uint8_t* rx;            ///< The read bytes
+        uint16_t txBits;        ///< How many bits to write
+        uint16_t rxBits;        ///< How many bits to read
+        uint16_t bitPos;        ///< The next bit, the written bits and then the read bits
+
+        uint8_t buffer[9];      ///< The bytes for the functions that wait
+        uint8_t searchRom[8];   ///< The last ROM code from search()
+        uint8_t lastDiscrepancy;///< Where search() shall take the other way
+        bool lastDevice;        ///< The last search() found the last device
+
+        bool start(uint8_t flags, const uint8_t* tx, uint16_t txBits, uint8_t* rx, uint16_t rxBits);
+        void wait();
+
+        void pinLow();
+        void pinRelease();
+        void pinPower();
+        uint8_t pinRead();
+        void busyWait(uint8_t us);
+        void timerStart(uint16_t us);
+        void timerStop();
+
+    public:
+        OneWireEngine(uint8_t pin);
+        void begin();
+
+        bool transfer(uint8_t flags, const uint8_t* tx, uint8_t txLen, uint8_t* rx, uint8_t rxLen);
+        uint8_t getTransferState();
+
+        uint8_t reset();
+        void write(uint8_t value, uint8_t power = 0);
+        uint8_t read();
+        void select(const uint8_t* rom);
+        void skip();
+        void depower();
+        void resetSearch();
+        uint8_t search(uint8_t* rom, bool alarm = false);
+
+        void isr();
+
+#if !defined(__AVR__)
+        void setLine(OneWireLine* line);
+        void setLatency(uint8_t us);
+        uint32_t getTime();
+        uint32_t getBusyTime();
+        uint32_t getIsrCount();
+#endif
+};
+
+#endif  // __ONEWIREENGINE_H
@@ -0,0 +1,73 @@
+/**
+ * @file OneWirePin.cpp
+ * @author Johan Simonsson
+ * @brief OneWireBus on a Arduino pin
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "OneWirePin.h"
+
+/**
+ * The default constructor.
+ *
+ * @param pin the pin the bus is connected to
+ */
+OneWirePin::OneWirePin(uint8_t pin) : wire(pin)
+{
+}
+
+uint8_t OneWirePin::reset()
+{
+    return wire.reset();
+}
+
+void OneWirePin::write(uint8_t value, uint8_t power)
+{
+    wire.write(value, power);
+}
+
+uint8_t OneWirePin::read()
+{
+    return wire.read();
+}
+
+void OneWirePin::select(const uint8_t* rom)
+{
+    wire.select((uint8_t*)rom);
+}
+
+void OneWirePin::skip()
+{
+    wire.skip();
+}
+
+void OneWirePin::depower()
+{
+    wire.depower();
+}
+
+void OneWirePin::resetSearch()
+{
+    wire.reset_search();
+}
+
+uint8_t OneWirePin::search(uint8_t* rom, bool alarm)
+{
+    return wire.search(rom, !alarm);
+}
@@ -1,7 +1,7 @@
 /**
- * @file DS18B20.h
+ * @file OneWirePin.h
  * @author Johan Simonsson
- * @brief Reads data from a DS18B20
+ * @brief OneWireBus on a Arduino pin
  */
 
 /*
@@ -21,16 +21,33 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#ifndef  __DS18B20_H
-#define  __DS18B20_H
+#ifndef  __ONEWIREPIN_H
+#define  __ONEWIREPIN_H
 
+#include <stdint.h>
 
-class DS18B20
+#include "OneWire.h"
+#include "OneWireBus.h"
+
+/**
+ * OneWireBus with the OneWire library, on one pin.
+ */
+class OneWirePin : public OneWireBus
 {
-     private:
-     public:
-         static double getTemperature(int pin);
+    private:
+        OneWire wire; ///< The bus
+
+    public:
+        OneWirePin(uint8_t pin);
 
+        uint8_t reset();
+        void write(uint8_t value, uint8_t power = 0);
+        uint8_t read();
+        void select(const uint8_t* rom);
+        void skip();
+        void depower();
+        void resetSearch();
+        uint8_t search(uint8_t* rom, bool alarm = false);
 };
 
-#endif  // __DS18B20_H
+#endif  // __ONEWIREPIN_H
@@ -0,0 +1,313 @@
+/**
+ * @file OneWireStore.cpp
+ * @author Johan Simonsson
+ * @brief The DS18B20 ROM codes and the sensors that use them, in the EEPROM
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#if defined(__AVR__)
+#include <avr/eeprom.h>
+#endif
+
+#include "OneWireStore.h"
+
+#if !defined(__AVR__)
+uint8_t oneWireStoreEeprom[ONEWIRE_STORE_EEPROM_SIZE];
+uint16_t oneWireStoreWrites = 0;
+#endif
+
+/**
+ * The default constructor.
+ *
+ * @param address the first byte in the EEPROM, getSize() bytes is used
+ */
+OneWireStore::OneWireStore(uint16_t address)
+{
+    this->address = address;
+    rescanWait = 0;
+}
+
+/**
+ * How many bytes in the EEPROM is used.
+ *
+ * @return the size in bytes
+ */
+uint16_t OneWireStore::getSize()
+{
+    return ONEWIRE_STORE_HEADER + (ONEWIRE_STORE_RECORD * DS18B20_DEVICES_MAX);
+}
+
+/**
+ * Read one byte.
+ */
+uint8_t OneWireStore::readByte(uint16_t addr)
+{
+#if defined(__AVR__)
+    return eeprom_read_byte((const uint8_t*)(uintptr_t)addr);
+#else
+    return oneWireStoreEeprom[addr % ONEWIRE_STORE_EEPROM_SIZE];
+#endif
+}
+
+/**
+ * Write one byte, if it is not the same already (a write is 3.3ms).
+ */
+void OneWireStore::writeByte(uint16_t addr, uint8_t value)
+{
+#if defined(__AVR__)
+    eeprom_update_byte((uint8_t*)(uintptr_t)addr, value);
+#else
+    if(oneWireStoreEeprom[addr % ONEWIRE_STORE_EEPROM_SIZE] != value)
+    {
+        oneWireStoreEeprom[addr % ONEWIRE_STORE_EEPROM_SIZE] = value;
+        oneWireStoreWrites++;
+    }
+#endif
+}
+
+/**
+ * Check the header.
+ *
+ * @param count becomes the number of records
+ * @return true if ok, false if empty or of a other version
+ */
+bool OneWireStore::readHeader(uint8_t* count)
+{
+    uint8_t data[ONEWIRE_STORE_HEADER];
+    for( uint8_t i=0 ; i<ONEWIRE_STORE_HEADER ; i++ )
+    {
+        data[i] = readByte(address + i);
+    }
+
+    if( (ONEWIRE_STORE_MAGIC != data[0]) || (ONEWIRE_STORE_VERSION != data[1]) ||
+        (data[2] > DS18B20_DEVICES_MAX) || (OneWireBus::crc8(data, 3) != data[3]) )
+    {
+        return false;
+    }
+    *count = data[2];
+    return true;
+}
+
+/**
+ * Read and check one record.
+ *
+ * @param index the record
+ * @param data [out] the ONEWIRE_STORE_RECORD bytes
+ * @return true if the crc is ok
+ */
+bool OneWireStore::readRecord(uint8_t index, uint8_t* data)
+{
+    uint16_t addr = address + ONEWIRE_STORE_HEADER + (index * ONEWIRE_STORE_RECORD);
+    for( uint8_t i=0 ; i<ONEWIRE_STORE_RECORD ; i++ )
+    {
+        data[i] = readByte(addr + i);
+    }
+    return (OneWireBus::crc8(data, ONEWIRE_STORE_RECORD-1) == data[ONEWIRE_STORE_RECORD-1]);
+}
+
+/**
+ * Add the saved devices to the bus (instead of begin)
+ * and give the sensors the device and offset they had.
+ *
+ * Nothing is changed if the EEPROM is empty or has a bad record,
+ * then do begin() and save().
+ *
+ * @param bus the bus, with no devices yet
+ * @param sensors the sensor list
+ * @param sensorCnt how many sensors in the list
+ * @return true if loaded
+ */
+bool OneWireStore::load(DS18B20Bus* bus, TemperatureSensor* sensors, uint8_t sensorCnt)
+{
+    uint8_t count;
+    uint8_t data[ONEWIRE_STORE_RECORD];
+
+    if(!readHeader(&count) || (0 == count))
+    {
+        return false;
+    }
+    for( uint8_t i=0 ; i<count ; i++ )
+    {
+        if(!readRecord(i, data))
+        {
+            return false;
+        }
+    }
+
+    for( uint8_t i=0 ; i<count ; i++ )
+    {
+        readRecord(i, data);
+        int8_t index = bus->addRom(data);
+        uint8_t sensor = data[8];
+        if( (index >= 0) && (sensor < sensorCnt) )
+        {
+            int16_t offset = (int16_t)(((uint16_t)data[10] << 8) | data[9]);
+            sensors[sensor].setOneWire(bus, index);
+            sensors[sensor].setValueOffset(offset / 100.0);
+        }
+    }
+    return true;
+}
+
+/**
+ * Save the devices on the bus, and the sensors that use them.
+ *
+ * Nothing is saved if a sensor has no device on the bus,
+ * a lost device is kept on the bus by rescan() so its record is kept.
+ *
+ * @param bus the bus
+ * @param sensors the sensor list
+ * @param sensorCnt how many sensors in the list
+ * @return true if saved
+ */
+bool OneWireStore::save(DS18B20Bus* bus, TemperatureSensor* sensors, uint8_t sensorCnt)
+{
+    uint8_t count = bus->getCount();
+    uint8_t sensorOf[DS18B20_DEVICES_MAX];
+    memset(sensorOf, ONEWIRE_STORE_NO_SENSOR, sizeof(sensorOf));
+
+    for( uint8_t i=0 ; i<sensorCnt ; i++ )
+    {
+        uint8_t index;
+        if(sensors[i].getOneWire(&index) != bus)
+        {
+            continue;
+        }
+        if(index >= count)
+        {
+            return false;
+        }
+        sensorOf[index] = i;
+    }
+
+    uint8_t data[ONEWIRE_STORE_RECORD];
+    for( uint8_t i=0 ; i<count ; i++ )
+    {
+        memcpy(data, bus->getRom(i), 8);
+        data[8] = sensorOf[i];
+
+        int16_t offset = 0;
+        if(ONEWIRE_STORE_NO_SENSOR != sensorOf[i])
+        {
+            double value = sensors[sensorOf[i]].getValueOffset() * 100;
+            offset = (int16_t)((value < 0) ? (value - 0.5) : (value + 0.5));
+        }
+        data[9]  = offset & 0xFF;
+        data[10] = (offset >> 8) & 0xFF;
+        data[11] = OneWireBus::crc8(data, ONEWIRE_STORE_RECORD-1);
+
+        uint16_t addr = address + ONEWIRE_STORE_HEADER + (i * ONEWIRE_STORE_RECORD);
+        for( uint8_t j=0 ; j<ONEWIRE_STORE_RECORD ; j++ )
+        {
+            writeByte(addr + j, data[j]);
+        }
+    }
+
+    //The header last, so a reset during the save leaves a bad record
+    data[0] = ONEWIRE_STORE_MAGIC;
+    data[1] = ONEWIRE_STORE_VERSION;
+    data[2] = count;
+    data[3] = OneWireBus::crc8(data, 3);
+    for( uint8_t i=0 ; i<ONEWIRE_STORE_HEADER ; i++ )
+    {
+        writeByte(address + i, data[i]);
+    }
+    return true;
+}
+
+/**
+ * Search the bus again (when DS18B20Bus::hasLost),
+ * and give the sensors the same device as before from the ROM code.
+ *
+ * A saved device that is not found is added after the others (DS18B20Bus::addRom),
+ * so it is still read and the sensor is back as soon as the device answers.
+ * Until then the reads fail, hasLost() is true again and this is called every tick,
+ * but only every ONEWIRE_STORE_RESCAN_WAIT call does a new search.
+ * The EEPROM is only saved when all devices was found.
+ *
+ * @param bus the bus, not in a tick
+ * @param sensors the sensor list
+ * @param sensorCnt how many sensors in the list
+ * @return how many devices was found, 0 if it is not time for a search
+ */
+uint8_t OneWireStore::rescan(DS18B20Bus* bus, TemperatureSensor* sensors, uint8_t sensorCnt)
+{
+    uint8_t count;
+    uint8_t data[ONEWIRE_STORE_RECORD];
+    bool all = true;
+
+    if(rescanWait > 0)
+    {
+        rescanWait--;
+        return 0;
+    }
+
+    uint8_t found = bus->begin();
+    if(!readHeader(&count))
+    {
+        count = 0;
+    }
+
+    for( uint8_t i=0 ; i<count ; i++ )
+    {
+        if(!readRecord(i, data))
+        {
+            continue;
+        }
+
+        int8_t index = bus->findRom(data);
+        uint8_t sensor = data[8];
+        if(index < 0)
+        {
+            all = false;
+            index = bus->addRom(data);
+        }
+        if(index < 0)
+        {
+            index = DS18B20_DEVICES_MAX;
+        }
+        if(sensor < sensorCnt)
+        {
+            sensors[sensor].setOneWire(bus, index);
+        }
+    }
+
+    if(all)
+    {
+        save(bus, sensors, sensorCnt);
+    }
+    else
+    {
+        rescanWait = ONEWIRE_STORE_RESCAN_WAIT;
+    }
+    return found;
+}
+
+/**
+ * Remove the saved devices, the next boot does a search.
+ */
+void OneWireStore::erase()
+{
+    for( uint8_t i=0 ; i<ONEWIRE_STORE_HEADER ; i++ )
+    {
+        writeByte(address + i, 0xFF);
+    }
+}
@@ -0,0 +1,94 @@
+/**
+ * @file OneWireStore.h
+ * @author Johan Simonsson
+ * @brief The DS18B20 ROM codes and the sensors that use them, in the EEPROM
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __ONEWIRESTORE_H
+#define  __ONEWIRESTORE_H
+
+#include <stdint.h>
+
+#include "DS18B20Bus.h"
+#include "TemperatureSensor.h"
+
+#define ONEWIRE_STORE_MAGIC   0xD5 ///< First byte in the header
+#define ONEWIRE_STORE_VERSION 1    ///< Change when the layout is changed
+
+#define ONEWIRE_STORE_HEADER 4  ///< Magic, version, count and crc
+#define ONEWIRE_STORE_RECORD 12 ///< ROM code, sensor, offset (2) and crc
+
+/**
+ * The sensor in a record when no sensor use the device.
+ */
+#define ONEWIRE_STORE_NO_SENSOR 0xFF
+
+/**
+ * How many calls to rescan() to skip after a search that did not find all devices,
+ * the search waits for the bus (about 14ms for every device).
+ * With one call every tick (1s) a lost device is searched for every minute.
+ */
+#define ONEWIRE_STORE_RESCAN_WAIT 60
+
+#if !defined(__AVR__)
+/**
+ * The EEPROM when not on the Arduino (ATmega328 size).
+ */
+#define ONEWIRE_STORE_EEPROM_SIZE 1024
+extern uint8_t oneWireStoreEeprom[ONEWIRE_STORE_EEPROM_SIZE];
+extern uint16_t oneWireStoreWrites; ///< Bytes written to oneWireStoreEeprom
+#endif
+
+/**
+ * The devices on a DS18B20Bus in the EEPROM, so the boot does not need a search
+ * and the same device is used by the same sensor (topic) even when
+ * a new device is added (that can change the search order).
+ *
+ * Every device is a record with the ROM code, the sensor that use it
+ * (the index in the sensor list, so the topics is kept in the code)
+ * and the calibration offset in 0.01 degC.
+ * The records is in the same order as on the bus.
+ *
+ * Only the bytes that is changed is written, so save() can be called
+ * after every command without wearing out the EEPROM.
+ */
+class OneWireStore
+{
+    private:
+        uint16_t address; ///< The first byte in the EEPROM
+        uint8_t rescanWait; ///< Calls to rescan() until the next search
+
+        static uint8_t readByte(uint16_t addr);
+        static void writeByte(uint16_t addr, uint8_t value);
+        bool readHeader(uint8_t* count);
+        bool readRecord(uint8_t index, uint8_t* data);
+
+    public:
+        OneWireStore(uint16_t address);
+
+        bool load(DS18B20Bus* bus, TemperatureSensor* sensors, uint8_t sensorCnt);
+        bool save(DS18B20Bus* bus, TemperatureSensor* sensors, uint8_t sensorCnt);
+        uint8_t rescan(DS18B20Bus* bus, TemperatureSensor* sensors, uint8_t sensorCnt);
+        void erase();
+
+        static uint16_t getSize();
+};
+
+#endif  // __ONEWIRESTORE_H
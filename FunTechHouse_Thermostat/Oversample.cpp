@@ -0,0 +1,116 @@
+/**
+ * @file Oversample.cpp
+ * @author Johan Simonsson
+ * @brief Oversampling and decimation of adc readings for extra resolution
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Oversample.h"
+
+/**
+ * The default constructor.
+ *
+ * @param bits extra bits, 0..OVERSAMPLE_BITS_MAX
+ */
+Oversample::Oversample(uint8_t bits)
+{
+    value = 0;
+    setBits(bits);
+}
+
+/**
+ * How many extra bits, this also restarts the current sum.
+ *
+ * @param bits extra bits, 0..OVERSAMPLE_BITS_MAX (4^bits samples per value)
+ */
+void Oversample::setBits(uint8_t bits)
+{
+    if(bits > OVERSAMPLE_BITS_MAX)
+    {
+        bits = OVERSAMPLE_BITS_MAX;
+    }
+    this->bits = bits;
+    init();
+}
+
+/**
+ * How many extra bits is used?
+ *
+ * @return extra bits
+ */
+uint8_t Oversample::getBits()
+{
+    return bits;
+}
+
+/**
+ * How many samples is needed for one value?
+ *
+ * @return 4^bits
+ */
+uint16_t Oversample::getSampleCount()
+{
+    return ((uint16_t)1) << (2*bits);
+}
+
+/**
+ * Forget the current sum, the last value is kept.
+ */
+void Oversample::init()
+{
+    sum = 0;
+    cnt = 0;
+}
+
+/**
+ * Add a new sample.
+ *
+ * @param sample from analogRead, (0..1023).
+ * @return true when there is a new value in getValue()
+ */
+bool Oversample::addValue(uint16_t sample)
+{
+    sum += sample;
+    cnt++;
+    if(cnt < getSampleCount())
+    {
+        return false;
+    }
+
+    //Decimate, rounded to nearest
+    uint32_t half = 0;
+    if(bits > 0)
+    {
+        half = ((uint32_t)1) << (bits-1);
+    }
+    value = (uint16_t)((sum + half) >> bits);
+
+    init();
+    return true;
+}
+
+/**
+ * The last decimated value.
+ *
+ * @return value with 10+bits bits, (0..1023<<bits).
+ */
+uint16_t Oversample::getValue()
+{
+    return value;
+}
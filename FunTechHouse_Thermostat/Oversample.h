@@ -0,0 +1,66 @@
+/**
+ * @file Oversample.h
+ * @author Johan Simonsson
+ * @brief Oversampling and decimation of adc readings for extra resolution
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __OVERSAMPLE_H
+#define  __OVERSAMPLE_H
+
+#include <stdint.h>
+
+/**
+ * Most extra bits, 4^5=1024 samples of 1023 fits in 32bit
+ * and the result (15bit) fits in a int16_t (SpikeFilter).
+ */
+#define OVERSAMPLE_BITS_MAX 5
+
+/**
+ * Oversample and decimate, 4^n samples of 10bit is added in integer
+ * and the sum is shifted down n bits to a value with 10+n bits.
+ *
+ * This only gives more resolution if the signal has some noise (dither)
+ * of about 1 adc step or more, so the samples is spread over more than one step.
+ * The LM35 noise is about 1.5 adc steps, so that is dither enough.
+ * Without noise all samples is the same, and the result is only the sample << n.
+ *
+ * See Atmel AVR121 "Enhancing ADC resolution by oversampling".
+ */
+class Oversample
+{
+    private:
+        uint8_t  bits;  ///< Extra bits, n
+        uint32_t sum;   ///< Sum of the samples so far
+        uint16_t cnt;   ///< Samples so far
+        uint16_t value; ///< The last decimated value
+
+    public:
+        Oversample(uint8_t bits = 0);
+
+        void setBits(uint8_t bits);
+        uint8_t getBits();
+        uint16_t getSampleCount();
+
+        void init();
+        bool addValue(uint16_t sample);
+        uint16_t getValue();
+};
+
+#endif  // __OVERSAMPLE_H
@@ -0,0 +1,225 @@
+/**
+ * @file PidRegulator.cpp
+ * @author Johan Simonsson
+ * @brief A fixed point PID regulator with multi stage output
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PidRegulator.h"
+#include "Regulator.h"
+
+/**
+ * The default constructor.
+ *
+ * @param stageCount how many output stages to use
+ * @param type what output type to use
+ */
+PidRegulator::PidRegulator(unsigned int stageCount, ThermostatType type)
+    : Regulator(stageCount, type)
+{
+    kp = 0;
+    ki = 0;
+    kd = 0;
+
+    setpointQ = (int32_t)(setpoint*100);
+    valueLast = 0;
+    firstTime = true;
+
+    iTerm = 0;
+    out   = 0;
+
+    samplePeriod = 1;
+    sampleCnt    = 0;
+}
+
+/**
+ * Setpoint to work with.
+ *
+ * @param setpoint the target value
+ */
+void PidRegulator::setSetpoint(double setpoint)
+{
+    this->setpoint = setpoint;
+    setpointQ = (int32_t)(setpoint*100);
+}
+
+/**
+ * Set the PID gains.
+ *
+ * Example kp=10 will give 10% output for every degree under the setpoint.
+ *
+ * @param kp proportional gain, % output per degree
+ * @param ki integral gain, % output per degree and second
+ * @param kd derivative gain, % output per degree per second
+ */
+void PidRegulator::setTuning(double kp, double ki, double kd)
+{
+    this->kp = (int32_t)(kp*256);
+    this->ki = (int32_t)(ki*256);
+    this->kd = (int32_t)(kd*256);
+}
+
+/**
+ * How often shall the PID be calculated?
+ *
+ * A tick is one call to valueTimeToSend (every second in the main loop).
+ *
+ * @param ticks ticks between every calculation, 1..PID_SAMPLE_PERIOD_MAX
+ */
+void PidRegulator::setSamplePeriod(unsigned int ticks)
+{
+    if(ticks == 0)
+    {
+        ticks = 1;
+    }
+    if(ticks > PID_SAMPLE_PERIOD_MAX)
+    {
+        ticks = PID_SAMPLE_PERIOD_MAX;
+    }
+
+    samplePeriod = ticks;
+    sampleCnt    = 0;
+}
+
+/**
+ * The continuous output before the stage quantizer.
+ *
+ * @return output 0..REGULATOR_OUT_MAX
+ */
+uint16_t PidRegulator::getOutput()
+{
+    return out;
+}
+
+/**
+ * Calculate the new output, every samplePeriod tick.
+ *
+ * @return true if ok
+ */
+bool PidRegulator::calcOutput()
+{
+    sampleCnt++;
+    if(!firstTime && (sampleCnt < samplePeriod))
+    {
+        return true;
+    }
+    sampleCnt = 0;
+
+    calcPid((int32_t)(value*100));
+    setOutput(out);
+    return true;
+}
+
+/**
+ * The PID math, all in fixed point.
+ *
+ * @param valueQ measured value in 0.01 degrees
+ */
+void PidRegulator::calcPid(int32_t valueQ)
+{
+    if(firstTime)
+    {
+        valueLast = valueQ;
+        firstTime = false;
+    }
+
+    int32_t error = setpointQ - valueQ;
+
+    //Limit the error so the products below fits in 32bit
+    if(error > REGULATOR_OUT_MAX)
+    {
+        error = REGULATOR_OUT_MAX;
+    }
+    else if(error < -REGULATOR_OUT_MAX)
+    {
+        error = -REGULATOR_OUT_MAX;
+    }
+
+    //Derivative on measurement, a rising value lowers the output.
+    int32_t dValue = valueQ - valueLast;
+    valueLast = valueQ;
+
+    int32_t pd = (kp * error) >> 8;
+    pd -= ((kd * dValue) / (int32_t)samplePeriod) >> 8;
+
+    int32_t step = ki * error;
+    const int32_t stepMax = ((int32_t)REGULATOR_OUT_MAX) << 8;
+    if(step > stepMax)
+    {
+        step = stepMax;
+    }
+    else if(step < -stepMax)
+    {
+        step = -stepMax;
+    }
+    step *= (int32_t)samplePeriod;
+
+    int32_t iNew = iTerm + step;
+    if(iNew > stepMax)
+    {
+        iNew = stepMax;
+    }
+    else if(iNew < 0)
+    {
+        iNew = 0;
+    }
+
+    //Anti-windup, don't integrate further into saturation.
+    int32_t u = pd + (iNew >> 8);
+    if( !((u > REGULATOR_OUT_MAX) && (step > 0)) &&
+        !((u < 0) && (step < 0)) )
+    {
+        iTerm = iNew;
+    }
+
+    u = pd + (iTerm >> 8);
+    if(u > REGULATOR_OUT_MAX)
+    {
+        u = REGULATOR_OUT_MAX;
+    }
+    else if(u < 0)
+    {
+        u = 0;
+    }
+    out = (uint16_t)u;
+}
+
+/**
+ * Apply a command from the server,
+ * "setpoint" is the same as setSetpoint() and the rest is done by Regulator.
+ * A setpoint outside REGULATOR_SETPOINT_MIN..REGULATOR_SETPOINT_MAX is not used.
+ *
+ * @param key [in] the command, not null terminated
+ * @param keyLen length of the key
+ * @param value the value in 0.01 steps
+ * @return true if ok, false if unknown command or bad value.
+ */
+bool PidRegulator::commandSet(const char* key, unsigned int keyLen, long value)
+{
+    if(commandIs(key, keyLen, "setpoint"))
+    {
+        if(!commandSetpointOk(value))
+        {
+            return false;
+        }
+        setSetpoint(value/100.0);
+        return true;
+    }
+    return Regulator::commandSet(key, keyLen, value);
+}
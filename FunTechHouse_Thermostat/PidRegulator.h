@@ -0,0 +1,82 @@
+/**
+ * @file PidRegulator.h
+ * @author Johan Simonsson
+ * @brief A fixed point PID regulator with multi stage output
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __PIDREGULATOR_H
+#define  __PIDREGULATOR_H
+
+#include <stdint.h>
+
+#include "Regulator.h"
+
+/**
+ * Longest sample period in ticks, this keeps the integral math inside 32bit.
+ */
+#define PID_SAMPLE_PERIOD_MAX 600
+
+/**
+ * A PID regulator with multi stage output.
+ *
+ * All the math is done in fixed point,
+ * the value is in 0.01 degrees, the output in 0.01% (REGULATOR_OUT_MAX)
+ * and the gains is in 1/256 steps.
+ *
+ * - The integral part is only updated when the output is not saturated
+ *   in the same direction (conditional integration anti-windup).
+ * - The derivative part works on the measured value and not the error,
+ *   so a setpoint change does not give a kick on the output.
+ *
+ * The continuous output is mapped onto the stages by Regulator::setOutput(),
+ * and with a cycle time the top stage is time proportional.
+ */
+class PidRegulator : public Regulator
+{
+     private:
+         int32_t kp; ///< Proportional gain, % per degree in 1/256
+         int32_t ki; ///< Integral gain, % per degree and second in 1/256
+         int32_t kd; ///< Derivative gain, % per degree per second in 1/256
+
+         int32_t setpointQ; ///< Setpoint in 0.01 degrees
+         int32_t valueLast; ///< Last measured value in 0.01 degrees
+         bool    firstTime; ///< No last value yet
+
+         int32_t  iTerm; ///< The integral part in 1/256 of the output
+         uint16_t out;   ///< The output 0..REGULATOR_OUT_MAX
+
+         unsigned int samplePeriod; ///< How many ticks between every calculation
+         unsigned int sampleCnt;    ///< Ticks since last calculation
+
+         bool calcOutput();
+         void calcPid(int32_t valueQ);
+         bool commandSet(const char* key, unsigned int keyLen, long value);
+
+     public:
+         PidRegulator(unsigned int stages, ThermostatType type);
+
+         void setSetpoint(double setpoint);
+         void setTuning(double kp, double ki, double kd);
+         void setSamplePeriod(unsigned int ticks);
+
+         uint16_t getOutput();
+};
+
+#endif  // __PIDREGULATOR_H
@@ -0,0 +1,314 @@
+/**
+ * @file PlantIdent.cpp
+ * @author Johan Simonsson
+ * @brief Online plant identification from step responses
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PlantIdent.h"
+
+/**
+ * The default constructor, no estimates yet.
+ */
+PlantIdent::PlantIdent()
+{
+    active = false;
+    tick   = 0;
+    y0     = 0;
+    du     = 0;
+
+    for( int i=0 ; i<PLANT_SLOPE_WINDOW ; i++ )
+    {
+        window[i] = 0;
+    }
+    windowPos = 0;
+
+    slopeMax     = 0;
+    slopeMaxTick = 0;
+    slopeMaxY    = 0;
+
+    deadTime     = 0;
+    timeConstant = 0;
+    gain         = 0;
+    slope        = 0;
+
+    validDeadTime     = false;
+    validTimeConstant = false;
+    newResult         = false;
+}
+
+/**
+ * The output has made a step up, start to record the response.
+ *
+ * If there is a active step it is finished with what we have.
+ *
+ * @param value the value right now in 0.01 degrees
+ * @param outDiff how big the step was in % output
+ */
+void PlantIdent::stepStart(int16_t value, uint8_t outDiff)
+{
+    stepAbort();
+
+    if(0 == outDiff)
+        return;
+
+    active = true;
+    tick   = 0;
+    y0     = value;
+    du     = outDiff;
+
+    for( int i=0 ; i<PLANT_SLOPE_WINDOW ; i++ )
+    {
+        window[i] = value;
+    }
+    windowPos = 0;
+
+    slopeMax     = 0;
+    slopeMaxTick = 0;
+    slopeMaxY    = value;
+}
+
+/**
+ * The output was changed (i.e. turned off) before the response was done,
+ * save the dead time if we got that far.
+ */
+void PlantIdent::stepAbort()
+{
+    if(active)
+    {
+        stepDone(false);
+    }
+}
+
+/**
+ * A new value, this should be called once every tick.
+ *
+ * @param value the value in 0.01 degrees
+ */
+void PlantIdent::addValue(int16_t value)
+{
+    if(!active)
+        return;
+
+    tick++;
+
+    int16_t oldest = window[windowPos];
+    window[windowPos] = value;
+    windowPos++;
+    if(windowPos >= PLANT_SLOPE_WINDOW)
+    {
+        windowPos = 0;
+    }
+
+    if(tick >= PLANT_SLOPE_WINDOW)
+    {
+        int16_t rise = value - oldest;
+        if(rise > slopeMax)
+        {
+            slopeMax     = rise;
+            slopeMaxTick = tick - (PLANT_SLOPE_WINDOW/2);
+            slopeMaxY    = (int16_t)(((int32_t)value + oldest) / 2);
+        }
+        else if( (slopeMax >= PLANT_SLOPE_MIN) &&
+                 (((int32_t)rise * 100) <= ((int32_t)slopeMax * 37)) )
+        {
+            //The slope has fallen to exp(-1), so one time constant has passed.
+            stepDone(true);
+            return;
+        }
+    }
+
+    if(tick >= PLANT_STEP_MAX)
+    {
+        stepDone(false);
+    }
+}
+
+/**
+ * The average of the old and new estimate.
+ *
+ * @param oldValue the old estimate
+ * @param newValue the new estimate
+ * @param valid false if there is no old estimate
+ * @return the new estimate
+ */
+uint16_t PlantIdent::avg(uint16_t oldValue, uint16_t newValue, bool valid)
+{
+    if(!valid)
+    {
+        return newValue;
+    }
+    return (uint16_t)(((uint32_t)oldValue + newValue + 1) / 2);
+}
+
+/**
+ * The step response is done, update the estimates.
+ *
+ * @param decayFound true if the slope has decayed, then we can estimate T and K
+ */
+void PlantIdent::stepDone(bool decayFound)
+{
+    active = false;
+
+    if(slopeMax < PLANT_SLOPE_MIN)
+    {
+        //Nothing to learn from this step.
+        return;
+    }
+
+    //Where the tangent crosses y0
+    int32_t rise = (int32_t)slopeMaxY - y0;
+    int32_t l = (int32_t)slopeMaxTick - ((rise * PLANT_SLOPE_WINDOW) / slopeMax);
+    if(l < 0)
+    {
+        l = 0;
+    }
+
+    deadTime = avg(deadTime, (uint16_t)l, validDeadTime);
+    slope    = (int16_t)avg(slope, slopeMax, validDeadTime);
+    validDeadTime = true;
+
+    if(decayFound)
+    {
+        uint16_t t = (tick - (PLANT_SLOPE_WINDOW/2)) - slopeMaxTick;
+
+        //K = Smax*T/du, Smax is per window.
+        int32_t k = ((int32_t)slopeMax * t) / ((int32_t)PLANT_SLOPE_WINDOW * du);
+
+        timeConstant = avg(timeConstant, t, validTimeConstant);
+        gain         = avg(gain, (uint16_t)k, validTimeConstant);
+        validTimeConstant = true;
+    }
+
+    newResult = true;
+}
+
+/**
+ * Do we have enough data to use the estimates?
+ *
+ * @return true if there is a estimate of both dead time and time constant
+ */
+bool PlantIdent::isValid()
+{
+    return (validDeadTime && validTimeConstant);
+}
+
+/**
+ * The estimated dead time.
+ *
+ * @return ticks
+ */
+uint16_t PlantIdent::getDeadTime()
+{
+    return deadTime;
+}
+
+/**
+ * The estimated time constant.
+ *
+ * @return ticks
+ */
+uint16_t PlantIdent::getTimeConstant()
+{
+    return timeConstant;
+}
+
+/**
+ * The estimated gain.
+ *
+ * @return 0.01 degrees per % output
+ */
+uint16_t PlantIdent::getGain()
+{
+    return gain;
+}
+
+/**
+ * How long shall we wait until the next stage?
+ *
+ * After L+T we have seen most of what the last stage can do.
+ *
+ * @param fallback value to use if there is no estimate yet
+ * @return ticks
+ */
+uint16_t PlantIdent::getStageInterval(uint16_t fallback)
+{
+    if(!isValid())
+    {
+        return fallback;
+    }
+
+    uint32_t interval = (uint32_t)deadTime + timeConstant;
+    if(interval < PLANT_INTERVAL_MIN)
+    {
+        interval = PLANT_INTERVAL_MIN;
+    }
+    if(interval > PLANT_INTERVAL_MAX)
+    {
+        interval = PLANT_INTERVAL_MAX;
+    }
+    return (uint16_t)interval;
+}
+
+/**
+ * How big shall the hysteresis be?
+ *
+ * During the dead time the value continues to move in the same direction
+ * after we turned the output on or off, so the hysteresis must be
+ * bigger than that (2*slope*L) or we will be toggling on our own lag.
+ *
+ * @param fallback value to use if there is no estimate yet
+ * @return hysteresis in 0.01 degrees
+ */
+int16_t PlantIdent::getHyst(int16_t fallback)
+{
+    if(!validDeadTime)
+    {
+        return fallback;
+    }
+
+    int32_t hyst = (2 * (int32_t)slope * deadTime) / PLANT_SLOPE_WINDOW;
+    if(hyst < PLANT_HYST_MIN)
+    {
+        hyst = PLANT_HYST_MIN;
+    }
+    if(hyst > PLANT_HYST_MAX)
+    {
+        hyst = PLANT_HYST_MAX;
+    }
+    return (int16_t)hyst;
+}
+
+/**
+ * Is there a new estimate to send to the server?
+ *
+ * @return true if there is a new estimate
+ */
+bool PlantIdent::resultTimeToSend()
+{
+    return newResult;
+}
+
+/**
+ * The estimate was sent to the server.
+ */
+void PlantIdent::resultIsSent()
+{
+    newResult = false;
+}
@@ -0,0 +1,118 @@
+/**
+ * @file PlantIdent.h
+ * @author Johan Simonsson
+ * @brief Online plant identification from step responses
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __PLANTIDENT_H
+#define  __PLANTIDENT_H
+
+#include <stdint.h>
+
+/**
+ * The slope is measured over this many ticks.
+ */
+#define PLANT_SLOPE_WINDOW 8
+
+/**
+ * Rise in 0.01 degrees per window that must be seen before we trust the slope.
+ */
+#define PLANT_SLOPE_MIN 5
+
+/**
+ * Give up on a step response after this many ticks.
+ */
+#define PLANT_STEP_MAX 7200
+
+/**
+ * Limits for the derived staging interval in ticks.
+ */
+#define PLANT_INTERVAL_MIN 60
+#define PLANT_INTERVAL_MAX 1800
+
+/**
+ * Limits for the derived hysteresis in 0.01 degrees.
+ */
+#define PLANT_HYST_MIN 50
+#define PLANT_HYST_MAX 1000
+
+/**
+ * Estimates the plant as first order plus dead time,
+ * from the step responses we get every time a stage is added.
+ *
+ * The response after a step is
+ * y(t) = y0 + K*du*(1-exp(-(t-L)/T)) for t > L
+ *
+ * - The slope is biggest just after the dead time (Smax = K*du/T).
+ * - The dead time L is where the tangent at Smax crosses y0.
+ * - The slope has fallen to 37% (exp(-1)) of Smax after another T.
+ * - Then the gain is K = Smax*T/du.
+ *
+ * Only the last PLANT_SLOPE_WINDOW values is saved,
+ * and all math is integer (values in 0.01 degrees, time in ticks).
+ * Every new estimate is averaged with the old one.
+ */
+class PlantIdent
+{
+    private:
+        bool     active;  ///< A step response is recorded right now
+        uint16_t tick;    ///< Ticks since the step
+        int16_t  y0;      ///< Value when the step was made
+        uint8_t  du;      ///< Output step in %
+
+        int16_t  window[PLANT_SLOPE_WINDOW]; ///< The last values
+        uint8_t  windowPos;                  ///< Where to put the next value
+
+        int16_t  slopeMax;     ///< Biggest rise over the window, 0.01 degrees per window
+        uint16_t slopeMaxTick; ///< Tick in the middle of the window with the biggest rise
+        int16_t  slopeMaxY;    ///< Value in the middle of the window with the biggest rise
+
+        uint16_t deadTime;     ///< Estimated dead time in ticks
+        uint16_t timeConstant; ///< Estimated time constant in ticks
+        uint16_t gain;         ///< Estimated gain in 0.01 degrees per % output
+        int16_t  slope;        ///< Estimated slope for a full step, 0.01 degrees per window
+
+        bool validDeadTime;    ///< We have a dead time estimate
+        bool validTimeConstant;///< We have a time constant (and gain) estimate
+        bool newResult;        ///< There is a new estimate that is not sent yet
+
+        void stepDone(bool decayFound);
+        uint16_t avg(uint16_t oldValue, uint16_t newValue, bool valid);
+
+    public:
+        PlantIdent();
+
+        void stepStart(int16_t value, uint8_t outDiff);
+        void stepAbort();
+        void addValue(int16_t value);
+
+        bool isValid();
+        uint16_t getDeadTime();
+        uint16_t getTimeConstant();
+        uint16_t getGain();
+
+        uint16_t getStageInterval(uint16_t fallback);
+        int16_t  getHyst(int16_t fallback);
+
+        bool resultTimeToSend();
+        void resultIsSent();
+};
+
+#endif  // __PLANTIDENT_H
@@ -0,0 +1,229 @@
+/**
+ * @file PowerBudget.cpp
+ * @author Johan Simonsson
+ * @brief Share one power budget (main fuse) between many regulators
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PowerBudget.h"
+#include "Regulator.h"
+
+/**
+ * The default constructor.
+ *
+ * @param budget total power in W
+ */
+PowerBudget::PowerBudget(uint32_t budget)
+{
+    this->budget = budget;
+    cnt = 0;
+
+    for( uint8_t i=0 ; i<POWER_BUDGET_MAX ; i++ )
+    {
+        regulator[i]  = 0;
+        stagePower[i] = 0;
+        priority[i]   = 0;
+        level[i]      = 0;
+    }
+}
+
+/**
+ * Change the total power, i.e. if some other load is turned on.
+ *
+ * @param budget total power in W
+ */
+void PowerBudget::setBudget(uint32_t budget)
+{
+    this->budget = budget;
+}
+
+/**
+ * Add a regulator that shall share the budget.
+ *
+ * Example a BIN_CNT heater with the stages 2kW, 4kW and 9kW
+ * is added with stagePower {2000, 4000, 9000}.
+ *
+ * @param regulator the regulator to control
+ * @param stagePower array with the power in W for every stage, must live as long as this object.
+ * @param priority 0 is the most important
+ * @return true if ok, false if there is no room for more regulators.
+ */
+bool PowerBudget::add(Regulator* regulator, const uint16_t* stagePower, uint8_t priority)
+{
+    if(cnt >= POWER_BUDGET_MAX)
+    {
+        return false;
+    }
+
+    this->regulator[cnt]  = regulator;
+    this->stagePower[cnt] = stagePower;
+    this->priority[cnt]   = priority;
+    this->level[cnt]      = 0;
+    cnt++;
+
+    //Nothing is allowed until the first update.
+    regulator->setLevelMax(0);
+    return true;
+}
+
+/**
+ * The power for a output level.
+ *
+ * @param index the regulator
+ * @param level the output level
+ * @return power in W
+ */
+uint32_t PowerBudget::getLevelPower(uint8_t index, uint8_t level)
+{
+    uint8_t out = regulator[index]->getLevelOut(level);
+    uint32_t power = 0;
+
+    for( uint8_t stage=0 ; stage<regulator[index]->getStageCount() ; stage++ )
+    {
+        if(out & (1 << stage))
+        {
+            power += stagePower[index][stage];
+        }
+    }
+    return power;
+}
+
+/**
+ * The highest power any level up to "level" can use,
+ * that is what must be reserved when the limit is "level".
+ *
+ * @param index the regulator
+ * @param level the level limit
+ * @return power in W
+ */
+uint32_t PowerBudget::getLevelPowerMax(uint8_t index, uint8_t level)
+{
+    uint32_t power = 0;
+    for( uint8_t l=1 ; l<=level ; l++ )
+    {
+        uint32_t p = getLevelPower(index, l);
+        if(p > power)
+        {
+            power = p;
+        }
+    }
+    return power;
+}
+
+/**
+ * The highest level up to "level" where this and all levels below fits in the power.
+ *
+ * @param index the regulator
+ * @param level the wanted level
+ * @param power the power that is left
+ * @return the level that fits
+ */
+uint8_t PowerBudget::getLevelFit(uint8_t index, uint8_t level, uint32_t power)
+{
+    uint8_t fit = 0;
+    while( (fit < level) && (getLevelPower(index, fit+1) <= power) )
+    {
+        fit++;
+    }
+    return fit;
+}
+
+/**
+ * Shall regulator a get its share before regulator b?
+ *
+ * @return true if a is before b
+ */
+bool PowerBudget::isBefore(uint8_t a, uint8_t b)
+{
+    if(priority[a] != priority[b])
+    {
+        return (priority[a] < priority[b]);
+    }
+    return (regulator[a]->getDeficit() > regulator[b]->getDeficit());
+}
+
+/**
+ * Hand out the budget, call this every tick after the regulators got new values.
+ */
+void PowerBudget::update()
+{
+    //The order to hand out the budget, a simple insertion sort since cnt is small.
+    uint8_t order[POWER_BUDGET_MAX];
+    for( uint8_t i=0 ; i<cnt ; i++ )
+    {
+        uint8_t j = i;
+        while( (j > 0) && isBefore(i, order[j-1]) )
+        {
+            order[j] = order[j-1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    uint32_t left = budget;
+    for( uint8_t i=0 ; i<cnt ; i++ )
+    {
+        uint8_t index = order[i];
+        Regulator* reg = regulator[index];
+
+        //One level up if below the setpoint, else keep what is used now.
+        uint8_t want = reg->getOutLevel();
+        if( (reg->getDeficit() > 0) && (want < reg->getLevelCount()) )
+        {
+            want++;
+        }
+
+        uint8_t fit = getLevelFit(index, want, left);
+
+        left -= getLevelPowerMax(index, fit);
+        level[index] = fit;
+        reg->setLevelMax(fit);
+    }
+}
+
+/**
+ * The level limit from the last update.
+ *
+ * @param index the regulator in the order they were added
+ * @return the level limit
+ */
+uint8_t PowerBudget::getLevelMax(uint8_t index)
+{
+    if(index >= cnt)
+    {
+        return 0;
+    }
+    return level[index];
+}
+
+/**
+ * The worst case power with the limits from the last update,
+ * this is always inside the budget.
+ *
+ * @return power in W
+ */
+uint32_t PowerBudget::getPowerMax()
+{
+    uint32_t power = 0;
+    for( uint8_t i=0 ; i<cnt ; i++ )
+    {
+        power += getLevelPowerMax(i, level[i]);
+    }
+    return power;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file PowerBudget.h
+ * @author Johan Simonsson
+ * @brief Share one power budget (main fuse) between many regulators
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __POWERBUDGET_H
+#define  __POWERBUDGET_H
+
+#include <stdint.h>
+
+#include "Regulator.h"
+
+/**
+ * How many regulators can share one budget.
+ */
+#define POWER_BUDGET_MAX 4
+
+/**
+ * Shares one power budget (i.e. the main fuse) between many regulators.
+ *
+ * Every tick update() gives each regulator a level limit (see Regulator::setLevelMax),
+ * so the sum of the power for all limits is inside the budget.
+ * That way the fuse holds whatever the regulators do until the next tick.
+ *
+ * The budget is handed out in priority order (0 is the most important),
+ * and for the same priority the one furthest below its setpoint goes first.
+ * A regulator that is below its setpoint may go one level up from where it is now,
+ * and a regulator that is satisfied only keeps what it uses right now.
+ * So the power is not reserved for levels that is not used yet,
+ * and a less important regulator can use it until it is needed (then it is shed at once).
+ *
+ * The out max from setOutMax() (i.e. the "outmax" command) is still the upper limit,
+ * the budget only hands out levels below it (see Regulator::getLevelCount).
+ * A setOutMax() between two updates replaces the level limit from the budget,
+ * so call update() after the commands and before the outputs is written.
+ */
+class PowerBudget
+{
+    private:
+        uint32_t budget; ///< Total power we may use, in W
+
+        uint8_t cnt;                            ///< How many regulators is added
+        Regulator* regulator[POWER_BUDGET_MAX]; ///< The regulators that share the budget
+        const uint16_t* stagePower[POWER_BUDGET_MAX]; ///< Power for every stage in W
+        uint8_t priority[POWER_BUDGET_MAX];     ///< 0 is the most important
+        uint8_t level[POWER_BUDGET_MAX];        ///< The level limit from the last update
+
+        uint32_t getLevelPower(uint8_t index, uint8_t level);
+        uint32_t getLevelPowerMax(uint8_t index, uint8_t level);
+        uint8_t getLevelFit(uint8_t index, uint8_t level, uint32_t power);
+        bool isBefore(uint8_t a, uint8_t b);
+
+    public:
+        PowerBudget(uint32_t budget);
+
+        void setBudget(uint32_t budget);
+        bool add(Regulator* regulator, const uint16_t* stagePower, uint8_t priority);
+
+        void update();
+
+        uint8_t getLevelMax(uint8_t index);
+        uint32_t getPowerMax();
+};
+
+#endif  // __POWERBUDGET_H
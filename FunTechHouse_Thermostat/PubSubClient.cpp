@@ -7,6 +7,7 @@
 #include "PubSubClient.h"
 #include <EthernetClient.h>
 #include <string.h>
+#include <avr/pgmspace.h>
 
 PubSubClient::PubSubClient() : _client() {
 }
@@ -132,13 +133,14 @@ boolean PubSubClient::loop() {
             lastInActivity = t;
             uint8_t type = buffer[0]&0xF0;
             if (type == MQTTPUBLISH) {
-               if (callback) {
-                  uint16_t tl = (buffer[2]<<8)+buffer[3];
-                  char topic[tl+1];
-                  for (uint16_t i=0;i<tl;i++) {
-                     topic[i] = buffer[4+i];
-                  }
-                  topic[tl] = 0;
+               uint16_t tl = (buffer[2]<<8)+buffer[3];
+               if (callback && (4+tl <= len)) {
+                  // The topic is moved one byte back over its length, so it can be
+                  // null terminated in the buffer without a copy on the stack.
+                  // (The remaining length is one byte since the buffer is < 128)
+                  memmove(buffer+3,buffer+4,tl);
+                  buffer[3+tl] = 0;
+                  char *topic = (char*)buffer+3;
                   // ignore msgID - only support QoS 0 subs
                   uint8_t *payload = buffer+4+tl;
                   callback(topic,payload,len-4-tl);
@@ -165,8 +167,22 @@ boolean PubSubClient::publish(char* topic, uint8_t* payload, unsigned int plengt
 }
 
 boolean PubSubClient::publish(char* topic, uint8_t* payload, unsigned int plength, boolean retained) {
+   return publishTopic(NULL, topic, NULL, false, payload, plength, retained);
+}
+
+// The topic is in flash (PROGMEM), like PSTR("house/data")
+boolean PubSubClient::publish_P(const char* topic, char* payload) {
+   return publishTopic(NULL, topic, NULL, true, (uint8_t*)payload, strlen(payload), false);
+}
+
+// The topic is prefix+name+suffix, all in flash (PROGMEM) and prefix/suffix may be NULL
+boolean PubSubClient::publish_P(const char* prefix, const char* name, const char* suffix, char* payload) {
+   return publishTopic(prefix, name, suffix, true, (uint8_t*)payload, strlen(payload), false);
+}
+
+boolean PubSubClient::publishTopic(const char* prefix, const char* name, const char* suffix, boolean flash, uint8_t* payload, unsigned int plength, boolean retained) {
    if (connected()) {
-      uint16_t length = writeString(topic,buffer,false);
+      uint16_t length = writeTopic(prefix,name,suffix,flash,buffer,0);
       uint16_t i;
       for (i=0;i<plength;i++) {
          buffer[length++] = payload[i];
@@ -207,6 +223,20 @@ boolean PubSubClient::write(uint8_t header, uint8_t* buf, uint16_t length) {
 
 
 boolean PubSubClient::subscribe(char* topic) {
+   return subscribeTopic(NULL, topic, NULL, false);
+}
+
+// The topic is in flash (PROGMEM)
+boolean PubSubClient::subscribe_P(const char* topic) {
+   return subscribeTopic(NULL, topic, NULL, true);
+}
+
+// The topic is prefix+name+suffix, all in flash (PROGMEM) and prefix/suffix may be NULL
+boolean PubSubClient::subscribe_P(const char* prefix, const char* name, const char* suffix) {
+   return subscribeTopic(prefix, name, suffix, true);
+}
+
+boolean PubSubClient::subscribeTopic(const char* prefix, const char* name, const char* suffix, boolean flash) {
    if (connected()) {
       uint16_t length = 2;
       nextMsgId++;
@@ -215,7 +245,7 @@ boolean PubSubClient::subscribe(char* topic) {
       }
       buffer[0] = nextMsgId >> 8;
       buffer[1] = nextMsgId - (buffer[0]<<8);
-      length = writeString(topic, buffer,length);
+      length = writeTopic(prefix,name,suffix,flash,buffer,length);
       buffer[length++] = 0; // Only do QoS 0 subs
       return write(MQTTSUBSCRIBE|MQTTQOS1,buffer,length);
    }
@@ -230,16 +260,30 @@ void PubSubClient::disconnect() {
    lastOutActivity = millis();
 }
 
-uint16_t PubSubClient::writeString(char* string, uint8_t* buf, uint16_t pos) {
-   char* idp = string;
-   uint16_t i = 0;
+uint16_t PubSubClient::writeString(const char* string, uint8_t* buf, uint16_t pos, boolean flash) {
+   return writeTopic(NULL,string,NULL,flash,buf,pos);
+}
+
+// The parts are written after each other as one string, prefix and suffix may be NULL
+uint16_t PubSubClient::writeTopic(const char* prefix, const char* name, const char* suffix, boolean flash, uint8_t* buf, uint16_t pos) {
+   const char* parts[3] = { prefix, name, suffix };
+   uint16_t start = pos;
    pos += 2;
-   while (*idp) {
-      buf[pos++] = *idp++;
-      i++;
+   for (uint8_t p=0;p<3;p++) {
+      const char* idp = parts[p];
+      if (!idp) {
+         continue;
+      }
+      char c = flash ? pgm_read_byte(idp) : *idp;
+      while (c) {
+         buf[pos++] = c;
+         idp++;
+         c = flash ? pgm_read_byte(idp) : *idp;
+      }
    }
-   buf[pos-i-2] = 0;
-   buf[pos-i-1] = i;
+   uint16_t i = pos-start-2;
+   buf[start] = i >> 8;
+   buf[start+1] = i & 0xFF;
    return pos;
 }
 
@@ -49,7 +49,10 @@ private:
    uint16_t readPacket();
    uint8_t readByte();
    boolean write(uint8_t header, uint8_t* buf, uint16_t length);
-   uint16_t writeString(char* string, uint8_t* buf, uint16_t pos);
+   uint16_t writeString(const char* string, uint8_t* buf, uint16_t pos, boolean flash = false);
+   uint16_t writeTopic(const char* prefix, const char* name, const char* suffix, boolean flash, uint8_t* buf, uint16_t pos);
+   boolean publishTopic(const char* prefix, const char* name, const char* suffix, boolean flash, uint8_t* payload, unsigned int plength, boolean retained);
+   boolean subscribeTopic(const char* prefix, const char* name, const char* suffix, boolean flash);
    uint8_t *ip;
    char* domain;
    uint16_t port;
@@ -63,7 +66,11 @@ public:
    boolean publish(char *, char *);
    boolean publish(char *, uint8_t *, unsigned int);
    boolean publish(char *, uint8_t *, unsigned int, boolean);
+   boolean publish_P(const char *, char *);
+   boolean publish_P(const char *, const char *, const char *, char *);
    boolean subscribe(char *);
+   boolean subscribe_P(const char *);
+   boolean subscribe_P(const char *, const char *, const char *);
    boolean loop();
    boolean connected();
 };
@@ -1,7 +1,7 @@
 /**
  * @file Regulator.cpp
  * @author Johan Simonsson
- * @brief ...
+ * @brief Base class for regulators with multi stage output
  */
 
 /*
@@ -30,8 +30,766 @@
 
 /**
  * The default constructor.
+ *
+ * @param stageCount how many output stages to use
+ * @param type what output type to use
+ */
+Regulator::Regulator(unsigned int stageCount, ThermostatType type)
+{
+    stages = stageCount;
+    stageOut = 0;
+    this->type = type;
+
+    //Some defaults.
+    value = 0;
+    setpoint = 60.0;
+
+    valueSent    = 0;
+    setpointSent = 0;
+    stageOutSent = 0;
+
+    valueDiffMax = 0.8;
+    valueSendCnt = 0;
+
+    firstAlarm = FIRST_ALARM_ALLOWED;
+
+    alarmLowActive = false;
+    alarmLevelLow = 10.0;
+    alarmHighActive = false;
+    alarmLevelHigh = 10.0;
+
+    alarmLow  = ALARM_NOT_ACTIVE;
+    alarmHigh = ALARM_NOT_ACTIVE;
+
+    maxOutValue = ((1 << stages)-1);
+    outMaxLimit = maxOutValue;
+}
+
+/**
+ * How many output stages is used by this regulator?
+ *
+ * @return unsigned int valid values goes from 1..n, 0 is valid but pointless.
+ */
+unsigned int Regulator::getStageCount()
+{
+    return stages;
+}
+
+/**
+ * If this state is active or not?
+ *
+ * @param stage the output stage number from 0..n
+ * @return true if active and false if not active.
+ */
+bool Regulator::getStageOut(unsigned int stage)
+{
+    if(stage >= stages)
+        return false;
+
+    uint8_t out = stageOut;
+    if(pwm.isActive() && !pwm.getOut())
+    {
+        //The top stage is in the off part of the cycle
+        out &= ~getTopStageMask();
+    }
+
+    uint8_t mask = 1 << stage;
+    return bool(out & mask);
+}
+
+/**
+ * The top active stage, that is the one that is time proportional.
+ *
+ * @return mask with the highest active bit in stageOut, or 0 if all off.
  */
-Regulator::Regulator()
+uint8_t Regulator::getTopStageMask()
 {
-};
+    uint8_t mask = 0x80;
+    while(mask != 0)
+    {
+        if(stageOut & mask)
+        {
+            break;
+        }
+        mask >>= 1;
+    }
+    return mask;
+}
+
+/**
+ * Is the output 100%
+ *
+ * @return true if output is 100%, false if there is more to give.
+ */
+bool Regulator::isOutMax()
+{
+    if(stageOut >= maxOutValue)
+    {
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Set the maximum allows value for the outputs.
+ *
+ * Example with THERMOSTAT_TYPE_BIN_CNT with 3 stages connected to a
+ * electric heater where stage 1 is 2kW, stage 2 is 4kW and stage3 is 9kW.
+ * And this heater can produce 2+4+9=15kW, but it is only connected to fuses that allows 10kW.
+ * Then a maxValue at 0x4 (bin 100), will allows it to step throu stages that reprecent
+ * 0kW, 2kW, 4kW, 6kW (2+4) and 9kW, but block the higher 11kW (9+2) and higher that would blow the fuse.
+ *
+ * If the output is higher than the new max value it is lowered at once.
+ *
+ * @param maxValue is the new max value.
+ * @return true if ok, false is probably a value bigger that the value spec by the stage count.
+ */
+bool Regulator::setOutMax(uint8_t maxValue)
+{
+    if(maxValue > ((1 << stages)-1))
+    {
+        return false;
+    }
+
+    this->maxOutValue = maxValue;
+    outMaxLimit = maxValue;
+
+    if(stageOut > maxOutValue)
+    {
+        stageOut = getLevelOut(getOutLevelMax());
+    }
+    return true;
+}
+
+/**
+ * How many output levels can be used, limited by setOutMax() but not by setLevelMax()?
+ *
+ * @return the highest level
+ */
+uint8_t Regulator::getLevelCount()
+{
+    return getMaskLevel(outMaxLimit);
+}
+
+/**
+ * Limit the output to a level, i.e. setOutMax() but counted in levels.
+ *
+ * Unlike setOutMax() this also drops the output at once if it is above the new limit,
+ * so it can be used to shed load.
+ *
+ * @param level the highest allowed level, 0..getLevelCount()
+ */
+void Regulator::setLevelMax(uint8_t level)
+{
+    if(level > getLevelCount())
+    {
+        level = getLevelCount();
+    }
+
+    maxOutValue = getLevelOut(level);
+
+    if(getOutLevel() > level)
+    {
+        stageOut = getLevelOut(level);
+    }
+}
+
+/**
+ * How far below the setpoint is the value?
+ *
+ * @return setpoint-value, or 0 if the value is on or above the setpoint.
+ */
+double Regulator::getDeficit()
+{
+    if(value < setpoint)
+    {
+        return (setpoint-value);
+    }
+    return 0;
+}
+
+/**
+ * How much must the value diff from last sent value before it is time to send again?
+ *
+ * If valueDiffMax is 2.0 and last value sent to server was 20.0,
+ * then the new value must be higher than 22 (20+2) or lower than 18 (20-2)
+ * before we send a new value.
+ *
+ * This will minimize the amount of duplicated data on the server.
+ *
+ * @param valueDiffMax diff, i.e. 2 will send if
+ */
+void Regulator::setValueDiff(double valueDiffMax)
+{
+    this->valueDiffMax = valueDiffMax;
+}
+
+/**
+ * Shall the alarm be active and what level should be used.
+ *
+ * Please note that the levels is relative to the setpoint.
+ * Values 10 and 10, and a setpoint at 50 will give alarm levels at 40 (50-10) and 60 (50+10).
+ *
+ * Please note that it is a good idea to put alarmLevelLow under setpoint-hyst,
+ * since that is the normal "low point" for the system.
+ *
+ * @param activateLowAlarm true to activate low alarm
+ * @param alarmLevelLow how much lower than setpoint shall the level be?
+ * @param activateHighAlarm true to active high alarm
+ * @param alarmLevelHigh how much higher than the setpoint shall the level be?
+ */
+void Regulator::setAlarmLevels(
+        bool activateLowAlarm, double alarmLevelLow,
+        bool activateHighAlarm, double alarmLevelHigh)
+{
+    alarmLowActive = activateLowAlarm;
+    this->alarmLevelLow = alarmLevelLow;
+
+    alarmHighActive = activateHighAlarm;
+    this->alarmLevelHigh = alarmLevelHigh;
+}
+
+/**
+ * Use time proportional output on the top active stage.
+ *
+ * The cycle time is counted in slots, where one slot is one call to nextSlot().
+ * If nextSlot() is called every 100ms then 600 slots is 60s (contactors)
+ * and 10 slots is 1s (solid state relays).
+ *
+ * @param slots cycle length in slots, 0 turns the time proportional mode off.
+ */
+void Regulator::setCycleTime(uint16_t slots)
+{
+    pwm.setCycle(slots);
+}
+
+/**
+ * Time has passed, move the time proportional output to the next slot.
+ *
+ * This should be called with a fixed period, since that is the slot time.
+ */
+void Regulator::nextSlot()
+{
+    pwm.nextSlot();
+}
+
+/**
+ * Apply a command from the server, "outmax" is the same as setOutMax().
+ *
+ * @param key [in] the command, not null terminated
+ * @param keyLen length of the key
+ * @param value the value in 0.01 steps
+ * @return true if ok, false if unknown command or bad value.
+ */
+bool Regulator::commandSet(const char* key, unsigned int keyLen, long value)
+{
+    if(commandIs(key, keyLen, "outmax"))
+    {
+        if( (value < 0) || (0 != (value % 100)) || (value > 25500) )
+        {
+            return false;
+        }
+        return setOutMax((uint8_t)(value/100));
+    }
+    return false;
+}
+
+/**
+ * Is the setpoint from a command inside REGULATOR_SETPOINT_MIN..REGULATOR_SETPOINT_MAX?
+ *
+ * @param value the setpoint in 0.01 steps
+ * @return true if ok
+ */
+bool Regulator::commandSetpointOk(long value)
+{
+    return ( (value >= (REGULATOR_SETPOINT_MIN*100L)) && (value <= (REGULATOR_SETPOINT_MAX*100L)) );
+}
+
+/**
+ * The ack after a command, with the state that can be changed by commands.
+ *
+ * @param data [out] the string to send
+ * @param size size of data
+ * @return true if ok
+ */
+bool Regulator::getCommandString(char* data, int size)
+{
+    int sI, sD;
+    StringHelp::splitDouble(setpoint, &sI, &sD);
+
+    int res = snprintf(data, size,
+            "setpoint=%d.%02d ; outmax=%u",
+            sI, sD, outMaxLimit);
+
+    if(res < size)
+        return true;
+
+    return false;
+}
+
+/**
+ * Shall we send data to the server?
+ *
+ * Please note that the value entered here,
+ * will trigger the calculation of outputs and alarms.
+ *
+ * @param value the new value used to calculate output
+ * @return bool true if there is data to send, false if there is only old data.
+ */
+bool Regulator::valueTimeToSend(double value)
+{
+    bool timeToSend = false;
+
+    this->value = value;
+
+    calcOutput();
 
+    if(0 >= valueSendCnt)
+        timeToSend = true;
+
+    double diff = value-valueSent;
+    if( diff > valueDiffMax || -diff > valueDiffMax )
+        timeToSend = true;
+
+    if(setpoint != setpointSent)
+        timeToSend = true;
+
+    if(stageOut != stageOutSent)
+        timeToSend = true;
+
+    valueSendCnt--;
+    return timeToSend;
+}
+
+/**
+ * If it is time to send data,
+ * this functions prepares the string that should be sent to the server.
+ *
+ * @return char* to the string
+ */
+bool Regulator::getValueString(char* data, int size)
+{
+    int vI, vD;
+    int sI, sD;
+
+    StringHelp::splitDouble(value, &vI, &vD);
+    StringHelp::splitDouble(setpoint, &sI, &sD);
+
+    int res = snprintf(data, size,
+            "value=%d.%02d ; setpoint=%d.%02d ; output=%03d%%",
+            vI, vD,
+            sI, sD, getOutValue());
+
+    if(res < size)
+        return true;
+    
+    return false;
+}
+
+/**
+ * If we could send the package to the server,
+ * then call this function since that will reset the internal counters.
+ */
+void Regulator::valueIsSent()
+{
+    valueSendCnt = ALWAYS_SEND_CNT;
+
+    valueSent    = value;
+    setpointSent = setpoint;
+    stageOutSent = stageOut;
+}
+
+/**
+ * Convert the output to a human readable procent number (0..100%)
+ *
+ * @return number between 0 and 100, where 100 is max.
+ */
+unsigned int Regulator::getOutValue()
+{
+    unsigned int out = 0;
+    unsigned int steps = 0;
+
+    //With time proportional output the top stage counts as part of a stage,
+    //so work in slots (one stage is one cycle).
+    uint32_t cycle = 1;
+    uint32_t duty  = 1;
+    if(pwm.isActive())
+    {
+        cycle = pwm.getCycle();
+        duty  = pwm.getDuty();
+    }
+
+    switch ( type )
+    {
+        case THERMOSTAT_TYPE_LINEAR:
+            while(steps<stages)
+            {
+                if(!(stageOut & (1 << steps)))
+                {
+                    break;
+                }
+                steps++;
+            }
+            /// @todo Use maxOutValue;
+            if(steps != 0)
+            {
+                out = (((steps-1)*cycle + duty)*100) / (stages*cycle);
+            }
+            break;
+        case THERMOSTAT_TYPE_BIN_CNT:
+            //The power budget may limit the output to nothing.
+            if(maxOutValue != 0)
+            {
+                uint32_t top = getTopStageMask();
+                out = (((stageOut-top)*cycle + top*duty)*100) / (maxOutValue*cycle);
+            }
+            break;
+        default :
+            break;
+    }
+
+    return out;
+}
+
+/**
+ * How many output levels is allowed by a max out value?
+ *
+ * With THERMOSTAT_TYPE_LINEAR every stage is one level,
+ * and with THERMOSTAT_TYPE_BIN_CNT the stages is a binary number.
+ *
+ * @param mask the max out value
+ * @return the highest level
+ */
+uint8_t Regulator::getMaskLevel(uint8_t mask)
+{
+    uint8_t level = 0;
+
+    switch ( type )
+    {
+        case THERMOSTAT_TYPE_LINEAR:
+            while( (level < stages) && (getLevelOut(level+1) <= mask) )
+            {
+                level++;
+            }
+            break;
+        case THERMOSTAT_TYPE_BIN_CNT:
+            level = mask;
+            break;
+        default :
+            break;
+    }
+    return level;
+}
+
+/**
+ * How many output levels is allowed by maxOutValue?
+ *
+ * @return the highest level
+ */
+uint8_t Regulator::getOutLevelMax()
+{
+    return getMaskLevel(maxOutValue);
+}
+
+/**
+ * What level is the output on now?
+ *
+ * @return level 0..getOutLevelMax()
+ */
+uint8_t Regulator::getOutLevel()
+{
+    uint8_t level = 0;
+
+    switch ( type )
+    {
+        case THERMOSTAT_TYPE_LINEAR:
+            while( (level < stages) && (stageOut & (1 << level)) )
+            {
+                level++;
+            }
+            break;
+        case THERMOSTAT_TYPE_BIN_CNT:
+            level = stageOut;
+            break;
+        default :
+            break;
+    }
+    return level;
+}
+
+/**
+ * The stage output pattern for a level.
+ *
+ * @param level the output level
+ * @return stage pattern, bit0 is stage0...
+ */
+uint8_t Regulator::getLevelOut(uint8_t level)
+{
+    if(THERMOSTAT_TYPE_LINEAR == type)
+    {
+        return ((1 << level)-1);
+    }
+    return level;
+}
+
+/**
+ * The stage quantizer, maps a continuous output onto the stages.
+ *
+ * Without time proportional output this picks the nearest level,
+ * with a small hysteresis so we don't toggle between two levels.
+ *
+ * With time proportional output the level is rounded up,
+ * and the duty for the top stage is set so the average is the wanted output.
+ *
+ * @param out wanted output 0..REGULATOR_OUT_MAX
+ */
+void Regulator::setOutput(uint16_t out)
+{
+    if(out > REGULATOR_OUT_MAX)
+    {
+        out = REGULATOR_OUT_MAX;
+    }
+
+    //The level in 1/256 steps
+    uint32_t levelMax = getOutLevelMax();
+    uint32_t levelQ   = (((uint32_t)out * levelMax) << 8) / REGULATOR_OUT_MAX;
+
+    if(pwm.isActive())
+    {
+        uint8_t level = levelQ >> 8;
+        uint8_t frac  = levelQ & 0xFF;
+
+        if(0 == frac)
+        {
+            stageOut = getLevelOut(level);
+            pwm.setDuty(pwm.getCycle());
+            return;
+        }
+
+        bool wasOff = (0 == stageOut);
+        stageOut = getLevelOut(level+1);
+
+        //The top stage is worth "weight" levels, (1 for linear)
+        uint32_t weight = 1;
+        if(THERMOSTAT_TYPE_BIN_CNT == type)
+        {
+            weight = getTopStageMask();
+        }
+        uint32_t cycle = pwm.getCycle();
+        pwm.setDuty( (cycle * (((weight-1) << 8) + frac)) / (weight << 8) );
+
+        if(wasOff)
+        {
+            //Start a new cycle so we turn on now and not at the next cycle.
+            pwm.restart();
+        }
+        return;
+    }
+
+    uint32_t level = getOutLevel();
+    if( (levelQ > ((level << 8) + 128 + REGULATOR_QUANT_HYST)) ||
+        ((levelQ + 128 + REGULATOR_QUANT_HYST) < (level << 8)) )
+    {
+        level = (levelQ + 128) >> 8;
+    }
+    stageOut = getLevelOut(level);
+}
+
+/**
+ * Delay when we allow the first alarm to be activated,
+ * so the controlled system has time to init.
+ *
+ * @return true when we allow alarms to be sent
+ */
+bool Regulator::allowAlarm()
+{
+    if(firstAlarm != 0)
+    {
+        firstAlarm--;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Is there a low alarm that should be sent to the server?
+ *
+ * @return true if there is a alarm, false if all is fine.
+ */
+bool Regulator::alarmLowTimeToSend()
+{
+    if(!allowAlarm())
+        return false;
+
+    if(!alarmLowActive)
+        return false;
+
+    bool status = false;
+
+    switch ( alarmLow )
+    {
+        case ALARM_NOT_ACTIVE:
+            if( (value < (setpoint-alarmLevelLow)) && isOutMax() )
+            {
+                alarmLow = ALARM_ACTIVE_NOT_SENT;
+                status = true;
+            }
+            break;
+        case ALARM_ACTIVE_SENT:
+            if( value > setpoint )
+            {
+                alarmLow = ALARM_NOT_ACTIVE;
+            }
+            break;
+        case ALARM_ACTIVE_NOT_SENT:
+            if( value > setpoint )
+            {
+                alarmLow = ALARM_NOT_ACTIVE;
+            }
+            else
+            {
+                status = true;
+            }
+            break;
+    }
+    return status;
+}
+
+/**
+ * Is there a high alarm that should be sent to the server?
+ *
+ * @return true if there is a alarm, false if all is fine.
+ */
+bool Regulator::alarmHighTimeToSend()
+{
+    if(!allowAlarm())
+        return false;
+
+    if(!alarmHighActive)
+        return false;
+
+    bool status = false;
+
+    switch ( alarmHigh )
+    {
+        case ALARM_NOT_ACTIVE:
+            //if( (value > (setpoint+alarmLevelLow)) && (!getStageOut(0)) )
+            if( (value > (setpoint+alarmLevelLow)) )
+            {
+                alarmHigh = ALARM_ACTIVE_NOT_SENT;
+                status = true;
+            }
+            break;
+        case ALARM_ACTIVE_SENT:
+            if( value < setpoint )
+            {
+                alarmHigh = ALARM_NOT_ACTIVE;
+            }
+            break;
+        case ALARM_ACTIVE_NOT_SENT:
+            if( value < setpoint )
+            {
+                alarmHigh = ALARM_NOT_ACTIVE;
+            }
+            else
+            {
+                status = true;
+            }
+            break;
+    }
+    return status;
+}
+
+/**
+ * Returns a alarm low string that can be sent
+ * to the server.
+ * This functions must only be called if alarmLowTimeToSend retured true.
+ *
+ * @return char* with the low alarm string
+ */
+bool Regulator::getAlarmLowString(char* data, int size)
+{
+    int vI, vD;
+    int sI, sD;
+    int aI, aD;
+
+    StringHelp::splitDouble(value, &vI, &vD);
+    StringHelp::splitDouble(setpoint, &sI, &sD);
+    StringHelp::splitDouble((setpoint-alarmLevelLow), &aI, &aD);
+
+    int res = snprintf(data, size,
+            "Alarm: Low ; value=%d.%02d ; alarm=%d.%02d ; setpoint=%d.%02d ; output=%03d%%",
+            vI, vD,
+            aI, aD,
+            sI, sD,
+            getOutValue());
+
+    if(res < size)
+        return true;
+    
+    return false;
+}
+
+/**
+ * Returns a alarm high string that can be sent to the server.
+ *
+ * This functions must only be called if alarmHighTimeToSend retured true.
+ *
+ * @return char* with the high alarm string
+ */
+bool Regulator::getAlarmHighString(char* data, int size)
+{
+    int vI, vD;
+    int sI, sD;
+    int aI, aD;
+
+    StringHelp::splitDouble(value, &vI, &vD);
+    StringHelp::splitDouble(setpoint, &sI, &sD);
+    StringHelp::splitDouble((setpoint+alarmLevelHigh), &aI, &aD);
+
+    int res = snprintf(data, size,
+            "Alarm: High ; value=%d.%02d ; alarm=%d.%02d ; setpoint=%d.%02d ; output=%03d%%",
+            vI, vD,
+            aI, aD,
+            sI, sD,
+            getOutValue());
+
+    if(res < size)
+        return true;
+    
+    return false;
+}
+
+/**
+ * Tell the logic that the alarm low was sucessfully sent to the server so it can be marked as sent.
+ */
+void Regulator::alarmLowIsSent()
+{
+    switch ( alarmLow )
+    {
+        case ALARM_ACTIVE_SENT:
+            break;
+        case ALARM_NOT_ACTIVE:
+            break;
+        case ALARM_ACTIVE_NOT_SENT:
+            alarmLow = ALARM_ACTIVE_SENT;
+            break;
+    }
+}
+
+/**
+ * Tell the logic that the alarm high was sucessfully sent to the server so it can be marked as sent.
+ */
+void Regulator::alarmHighIsSent()
+{
+    switch ( alarmHigh )
+    {
+        case ALARM_ACTIVE_SENT:
+            break;
+        case ALARM_NOT_ACTIVE:
+            break;
+        case ALARM_ACTIVE_NOT_SENT:
+            alarmHigh = ALARM_ACTIVE_SENT;
+            break;
+    }
+}
@@ -1,7 +1,7 @@
 /**
  * @file Regulator.h
  * @author Johan Simonsson
- * @brief ...
+ * @brief Base class for regulators with multi stage output
  */
 
 /*
@@ -27,13 +27,155 @@
 #include <stdint.h>
 
 #include "MQTT_Logic.h"
+#include "TimeProportional.h"
 
+/**
+ * If value is the "same" for "cnt" questions, then send anyway.
+ *
+ * If sleep is 1s (1000ms) and there is 1 question per rotation
+ * then we have 600/1s=600s or always send every 10min
+ * 1200/1s/60s=20min
+ */
+#define ALWAYS_SEND_CNT 1200
+
+/**
+ * Do not send any alarms at startup wait for the process to start as well.
+ */
+#define FIRST_ALARM_ALLOWED 600
+
+/**
+ * Full output for setOutput(), 0.01% per step.
+ */
+#define REGULATOR_OUT_MAX 10000
+
+/**
+ * Hysteresis for the stage quantizer in 1/256 stage,
+ * so a stage is not toggled back and forth when the output is between two stages.
+ */
+#define REGULATOR_QUANT_HYST 32
+
+/**
+ * The setpoints that a command from the server may set, in degC.
+ * A electric boiler should never be told to go above the max.
+ */
+#define REGULATOR_SETPOINT_MIN 0
+#define REGULATOR_SETPOINT_MAX 95
+
+/**
+ * The statemachine for the alarm
+ */
+typedef enum
+{
+    ALARM_ACTIVE_SENT = 0, ///< The alarm is triggered, and has been sent to the server.
+    ALARM_ACTIVE_NOT_SENT, ///< The alarm is triggered, but has not sent to the server.
+    ALARM_NOT_ACTIVE       ///< The alarm is not triggered, all is fine.
+} AlarmStates;
+
+/**
+ * What output type this thermostat is used.
+ */
+typedef enum
+{
+    THERMOSTAT_TYPE_LINEAR = 0, ///< Linear output, 3stages, 001, 011, 111
+    THERMOSTAT_TYPE_BIN_CNT     ///< Bin cnt output, 3stages, 001, 010, 011, 100, 101, 110, 111
+} ThermostatType;
+
+/**
+ * A regulator with multi stage output.
+ *
+ * This has the parts that is the same for all regulators,
+ * the stage outputs, the time proportional top stage,
+ * and the value/alarm logic towards the MQTT server.
+ *
+ * The actual control is done by calcOutput() in the subclass,
+ * that is called with every new value.
+ *
+ * @dotfile state_alarm_low.gv The alarm low state machine
+ * @dotfile state_alarm_high.gv The alarm high state machine
+ */
 class Regulator : public MQTT_Logic
 {
-     private:
+     protected:
+         unsigned int stages; ///< How many output stages does this regulator have?
+         ThermostatType type; ///< What output type to use.
+
+         double value;     ///< Measured process value, i.e. temperature.
+         double setpoint;  ///< Target value
+         uint8_t stageOut; ///< Output state for the stages, bit0 is stage0, bit1 is stage1 etc etc.
+         uint8_t maxOutValue; ///< Out not allowed to be bigger than this, more or less limit out to this.
+         uint8_t outMaxLimit; ///< The limit from setOutMax(), setLevelMax() can not go above this.
+
+         double valueSent;     ///< Last value sent to server.
+         double setpointSent;  ///< Last setpoint sent to server.
+         uint8_t stageOutSent; ///< Last output sent to server.
+
+         double valueDiffMax; ///< Value should diff more than this to be sent to the server
+         int    valueSendCnt; ///< Always send after "cnt time" even if there is no change
+
+         bool alarmLowActive; ///< Is low alarm active? if false then low alarm is off
+         double alarmLevelLow;///< Alarm level, setpoint-alarmLevelLow=>alarm
+         AlarmStates alarmLow;///< The low alarm statemachine.
+
+         bool alarmHighActive; ///< Is high alarm active? if false then high alarm is off
+         double alarmLevelHigh;///< Alarm level, setpoint+alarmLevelHigh=>alarm
+         AlarmStates alarmHigh;//< The high alarm statemachine
+
+         TimeProportional pwm; ///< Time proportional control of the top active stage
+
+         unsigned int firstAlarm; ///< Countdown timer so we dont sent the first alarms to early.
+
+         uint8_t getTopStageMask();
+         bool isOutMax();
+         bool allowAlarm();
+         unsigned int getOutValue();
+
+         uint8_t getMaskLevel(uint8_t mask);
+         uint8_t getOutLevelMax();
+         void setOutput(uint16_t out);
+
+         /**
+          * Calculate the new output from value and setpoint.
+          *
+          * @return true if ok
+          */
+         virtual bool calcOutput() = 0;
+
+         bool commandSet(const char* key, unsigned int keyLen, long value);
+         static bool commandSetpointOk(long value);
 
      public:
-         Regulator();
+         Regulator(unsigned int stages, ThermostatType type);
+         unsigned int getStageCount();
+         bool getStageOut(unsigned int stage);
+
+         bool setOutMax(uint8_t maxValue);
+
+         uint8_t getLevelCount();
+         uint8_t getOutLevel();
+         uint8_t getLevelOut(uint8_t level);
+         void setLevelMax(uint8_t level);
+         virtual double getDeficit();
+
+         void setValueDiff(double valueDiffMax);
+         void setAlarmLevels(bool activateLowAlarm, double alarmLevelLow,
+                 bool activateHighAlarm, double alarmLevelHigh);
+
+         void setCycleTime(uint16_t slots);
+         void nextSlot();
+
+         bool getCommandString(char* data, int size);
+
+         bool valueTimeToSend(double value);
+         bool getValueString(char* data, int size);
+         void valueIsSent();
+
+         bool alarmLowTimeToSend();
+         bool getAlarmLowString(char* data, int size);
+         void alarmLowIsSent();
+
+         bool alarmHighTimeToSend();
+         bool getAlarmHighString(char* data, int size);
+         void alarmHighIsSent();
 };
 
-#endif  // __REGULATOR_H 
+#endif  // __REGULATOR_H
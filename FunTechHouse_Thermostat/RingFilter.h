@@ -0,0 +1,273 @@
+/**
+ * @file RingFilter.h
+ * @author Johan Simonsson
+ * @brief Sliding window trimmed mean filter
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __RINGFILTER_H
+#define  __RINGFILTER_H
+
+#include <stdint.h>
+
+/**
+ * Trim away the min and max value when there is at least this many values,
+ * the same as ValueAvg.
+ */
+#define RING_FILTER_TRIM_MIN 7
+
+/**
+ * A sliding window filter, the trimmed mean of the last N values.
+ *
+ * Unlike ValueAvg this is not restarted every tick,
+ * so a few new samples per tick gives the same noise rejection
+ * as a big batch of samples every tick.
+ *
+ * Every new value is O(1) (amortized):
+ * - The sum is updated with the new and the oldest value.
+ * - The min and max is kept in two monotonic queues with positions in the ring buffer,
+ *   the front of each queue is the min (max) in the window.
+ *
+ * Use a integer type for S (i.e. raw adc readings),
+ * then the running sum has no rounding errors that grows over time.
+ *
+ * @tparam T the value type
+ * @tparam N window size, 1..255
+ * @tparam S the type for the sum, must fit N*T
+ */
+template <typename T, uint8_t N, typename S = long>
+class RingFilter
+{
+    private:
+        T buffer[N];   ///< The last N values
+        uint8_t head;  ///< Where to put the next value
+        uint8_t cnt;   ///< How many values in the window
+        S sum;         ///< Sum of all values in the window
+
+        uint8_t minQueue[N]; ///< Positions with rising values, front is the min
+        uint8_t minFirst;    ///< Front of the min queue
+        uint8_t minCnt;      ///< Size of the min queue
+
+        uint8_t maxQueue[N]; ///< Positions with falling values, front is the max
+        uint8_t maxFirst;    ///< Front of the max queue
+        uint8_t maxCnt;      ///< Size of the max queue
+
+        static uint8_t wrap(uint16_t pos);
+
+    public:
+        RingFilter();
+
+        void init();
+        void addValue(T data);
+        double getValue();
+        T getRounded();
+
+        uint8_t getCount();
+        bool isFull();
+        T getMin();
+        T getMax();
+};
+
+/**
+ * The default constructor, the window is empty.
+ */
+template <typename T, uint8_t N, typename S>
+RingFilter<T, N, S>::RingFilter()
+{
+    init();
+}
+
+/**
+ * Empty the window, i.e. when the sensor is broken.
+ */
+template <typename T, uint8_t N, typename S>
+void RingFilter<T, N, S>::init()
+{
+    head = 0;
+    cnt  = 0;
+    sum  = 0;
+
+    minFirst = 0;
+    minCnt   = 0;
+    maxFirst = 0;
+    maxCnt   = 0;
+}
+
+/**
+ * Position in the ring buffer.
+ *
+ * @param pos position that can be up to 2N
+ * @return pos in 0..N-1
+ */
+template <typename T, uint8_t N, typename S>
+uint8_t RingFilter<T, N, S>::wrap(uint16_t pos)
+{
+    if(pos >= N)
+    {
+        pos -= N;
+    }
+    return (uint8_t)pos;
+}
+
+/**
+ * Add a new value, if the window is full the oldest value is removed.
+ *
+ * @param data the new value
+ */
+template <typename T, uint8_t N, typename S>
+void RingFilter<T, N, S>::addValue(T data)
+{
+    if(cnt == N)
+    {
+        //The oldest value is at head, and is about to be overwritten.
+        sum -= buffer[head];
+
+        if( (minCnt > 0) && (minQueue[minFirst] == head) )
+        {
+            minFirst = wrap(minFirst+1);
+            minCnt--;
+        }
+        if( (maxCnt > 0) && (maxQueue[maxFirst] == head) )
+        {
+            maxFirst = wrap(maxFirst+1);
+            maxCnt--;
+        }
+    }
+    else
+    {
+        cnt++;
+    }
+
+    buffer[head] = data;
+    sum += data;
+
+    //Values that is bigger (smaller) than the new one can never be the min (max) again.
+    while( (minCnt > 0) && !(buffer[minQueue[wrap(minFirst+minCnt-1)]] < data) )
+    {
+        minCnt--;
+    }
+    minQueue[wrap(minFirst+minCnt)] = head;
+    minCnt++;
+
+    while( (maxCnt > 0) && !(data < buffer[maxQueue[wrap(maxFirst+maxCnt-1)]]) )
+    {
+        maxCnt--;
+    }
+    maxQueue[wrap(maxFirst+maxCnt)] = head;
+    maxCnt++;
+
+    head = wrap(head+1);
+}
+
+/**
+ * The trimmed mean of the window.
+ *
+ * If we have RING_FILTER_TRIM_MIN values or more,
+ * then the min and max value is not used.
+ *
+ * @return the mean, or 0 if there is no values
+ */
+template <typename T, uint8_t N, typename S>
+double RingFilter<T, N, S>::getValue()
+{
+    if(0 == cnt)
+    {
+        return 0.0;
+    }
+
+    if(cnt >= RING_FILTER_TRIM_MIN)
+    {
+        S trimmed = sum;
+        trimmed -= getMin();
+        trimmed -= getMax();
+        return ((double)trimmed)/(cnt-2);
+    }
+
+    return ((double)sum)/cnt;
+}
+
+/**
+ * The trimmed mean rounded to T, without floating point.
+ *
+ * @return the mean rounded to nearest (for positive values), or 0 if there is no values
+ */
+template <typename T, uint8_t N, typename S>
+T RingFilter<T, N, S>::getRounded()
+{
+    if(0 == cnt)
+    {
+        return 0;
+    }
+
+    S trimmed = sum;
+    uint8_t n = cnt;
+    if(cnt >= RING_FILTER_TRIM_MIN)
+    {
+        trimmed -= getMin();
+        trimmed -= getMax();
+        n -= 2;
+    }
+    return (T)((trimmed + (n/2)) / n);
+}
+
+/**
+ * How many values is in the window?
+ *
+ * @return 0..N
+ */
+template <typename T, uint8_t N, typename S>
+uint8_t RingFilter<T, N, S>::getCount()
+{
+    return cnt;
+}
+
+/**
+ * Is the window full?
+ *
+ * @return true if there is N values
+ */
+template <typename T, uint8_t N, typename S>
+bool RingFilter<T, N, S>::isFull()
+{
+    return (cnt == N);
+}
+
+/**
+ * The smallest value in the window.
+ *
+ * @return the min value, undefined if the window is empty
+ */
+template <typename T, uint8_t N, typename S>
+T RingFilter<T, N, S>::getMin()
+{
+    return buffer[minQueue[minFirst]];
+}
+
+/**
+ * The biggest value in the window.
+ *
+ * @return the max value, undefined if the window is empty
+ */
+template <typename T, uint8_t N, typename S>
+T RingFilter<T, N, S>::getMax()
+{
+    return buffer[maxQueue[maxFirst]];
+}
+
+#endif  // __RINGFILTER_H
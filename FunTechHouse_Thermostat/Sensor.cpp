@@ -79,3 +79,40 @@ int Sensor::getSensorPin()
     return connectedPin;
 }
 
+/**
+ * Is this a sensor on a analog input?
+ *
+ * @return true if the readings is from analogRead
+ */
+bool Sensor::isAnalog()
+{
+    switch(sensorType)
+    {
+        case LM35DZ:
+        case LM34DZ:
+        case NTC_10K:
+        case ANALOG_CURVE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Is this a DHT sensor (temperature and humidity)?
+ *
+ * @return true if DHT_11, DHT_21 or DHT_22
+ */
+bool Sensor::isDHT()
+{
+    switch(sensorType)
+    {
+        case DHT_11:
+        case DHT_21:
+        case DHT_22:
+            return true;
+        default:
+            return false;
+    }
+}
+
@@ -35,7 +35,10 @@ class Sensor : public MQTT_Logic
             DS18B20, ///< Temperature sensor, 1wire
             DHT_11,   ///< Humidity and temperature sensor DHT11
             DHT_21,   ///< Humidity and temperature sensor DHT21, AM2301
-            DHT_22    ///< Humidity and temperature sensor DHT22, AM2302
+            DHT_22,   ///< Humidity and temperature sensor DHT22, AM2302
+            LM34DZ,   ///< Temperature sensor, 10mV per degF
+            NTC_10K,  ///< Thermistor 10k B3950 with 33k to 5V, see AnalogSensor
+            ANALOG_CURVE ///< Analog sensor with a segment table, see AnalogSensor::setCurve
         };
 
     protected:
@@ -54,6 +57,8 @@ class Sensor : public MQTT_Logic
 		void setSensorPin(int pin);
         int getSensorType();
         int getSensorPin();
+        bool isAnalog();
+        bool isDHT();
 
 };
 
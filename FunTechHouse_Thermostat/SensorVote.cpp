@@ -0,0 +1,258 @@
+/**
+ * @file SensorVote.cpp
+ * @author Johan Simonsson
+ * @brief Vote between redundant temperature sensors
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SensorVote.h"
+
+/**
+ * The default constructor.
+ *
+ * @param inputs how many sensors, 1..SENSOR_VOTE_MAX
+ * @param type median or mean
+ */
+SensorVote::SensorVote(uint8_t inputs, SensorVoteType type)
+{
+    if(inputs > SENSOR_VOTE_MAX)
+    {
+        inputs = SENSOR_VOTE_MAX;
+    }
+    this->type = type;
+    count = inputs;
+    disagree = SENSOR_VOTE_DISAGREE;
+
+    for( uint8_t i=0 ; i<SENSOR_VOTE_MAX ; i++ )
+    {
+        value[i] = 0;
+        valid[i] = false;
+    }
+
+    lastValue = 0;
+    lastValid = false;
+
+    fault = 0;
+    faultSent = 0;
+    firstAlarm = SENSOR_VOTE_FIRST_ALARM;
+}
+
+/**
+ * How much a sensor may differ from the vote.
+ *
+ * @param centi max diff in 0.01 degC, default SENSOR_VOTE_DISAGREE
+ */
+void SensorVote::setDisagree(int16_t centi)
+{
+    disagree = centi;
+}
+
+/**
+ * The value for one input this tick.
+ *
+ * @param input 0..inputs-1
+ * @param centi the temperature in 0.01 degC
+ * @param ok false if the sensor could not be read
+ */
+void SensorVote::setValue(uint8_t input, int16_t centi, bool ok)
+{
+    if(input >= count)
+    {
+        return;
+    }
+    value[input] = centi;
+    valid[input] = ok;
+}
+
+/**
+ * The median of some values.
+ *
+ * @param values [in,out] the values, they are sorted
+ * @param n how many, at least 1
+ * @return the median
+ */
+int16_t SensorVote::median(int16_t* values, uint8_t n)
+{
+    //Insertion sort, there is only a few
+    for( uint8_t i=1 ; i<n ; i++ )
+    {
+        int16_t v = values[i];
+        uint8_t j = i;
+        while( (j > 0) && (values[j-1] > v) )
+        {
+            values[j] = values[j-1];
+            j--;
+        }
+        values[j] = v;
+    }
+
+    if(n & 1)
+    {
+        return values[n/2];
+    }
+    return (int16_t)(((int32_t)values[n/2-1] + values[n/2]) / 2);
+}
+
+/**
+ * Vote with the values from this tick,
+ * after this all inputs need a new value.
+ *
+ * @param ok becomes true if there is a vote, false if all sensors is broken
+ * @return temperature in 0.01 degC
+ */
+int16_t SensorVote::vote(bool* ok)
+{
+    if(firstAlarm != 0)
+    {
+        firstAlarm--;
+    }
+
+    int16_t values[SENSOR_VOTE_MAX];
+    uint8_t n = 0;
+    uint8_t first = 0;
+    for( uint8_t i=0 ; i<count ; i++ )
+    {
+        if(valid[i])
+        {
+            if(0 == n)
+            {
+                first = i;
+            }
+            values[n++] = value[i];
+        }
+    }
+
+    //What the others is compared to
+    int16_t ref = 0;
+    if(0 != n)
+    {
+        int16_t primary = value[first];
+        ref = median(values, n);
+        if( (2 == n) && ((values[1] - values[0]) > disagree) )
+        {
+            //No majority, keep the one that is closest to the last vote
+            ref = primary;
+            if(lastValid)
+            {
+                bool lowCloser = abs(lastValue - values[0]) <= abs(lastValue - values[1]);
+                ref = lowCloser ? values[0] : values[1];
+            }
+        }
+    }
+
+    //Only the ones that agree
+    fault = 0;
+    n = 0;
+    int32_t sum = 0;
+    for( uint8_t i=0 ; i<count ; i++ )
+    {
+        if( valid[i] && (abs(value[i] - ref) <= disagree) )
+        {
+            values[n++] = value[i];
+            sum += value[i];
+        }
+        else
+        {
+            fault |= (1 << i);
+        }
+        valid[i] = false;
+    }
+
+    if(0 == n)
+    {
+        *ok = false;
+        return 0;
+    }
+
+    if(SENSOR_VOTE_MEAN == type)
+    {
+        lastValue = (int16_t)(sum / n);
+    }
+    else
+    {
+        lastValue = median(values, n);
+    }
+    lastValid = true;
+
+    *ok = true;
+    return lastValue;
+}
+
+/**
+ * The broken inputs from the last vote.
+ *
+ * @return bit 0 is input 0 and so on
+ */
+uint8_t SensorVote::getFault()
+{
+    return fault;
+}
+
+/**
+ * Has the broken inputs changed since the last alarm?
+ *
+ * @return true if a alarm should be sent
+ */
+bool SensorVote::faultTimeToSend()
+{
+    if(firstAlarm != 0)
+    {
+        return false;
+    }
+    return (fault != faultSent);
+}
+
+/**
+ * The sensor fault alarm, like "Alarm: Sensor ; fault=0x02 ; ok=1/2".
+ *
+ * @param data [out] the string to send
+ * @param size size of data
+ * @return true if ok
+ */
+bool SensorVote::getFaultString(char* data, int size)
+{
+    uint8_t ok = 0;
+    for( uint8_t i=0 ; i<count ; i++ )
+    {
+        if(0 == (fault & (1 << i)))
+        {
+            ok++;
+        }
+    }
+
+    int res = snprintf(data, size,
+            "Alarm: Sensor ; fault=0x%02x ; ok=%u/%u",
+            fault, ok, count);
+
+    if(res < size)
+        return true;
+
+    return false;
+}
+
+/**
+ * The alarm was sent to the server.
+ */
+void SensorVote::faultIsSent()
+{
+    faultSent = fault;
+}
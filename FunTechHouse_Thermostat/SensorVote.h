@@ -0,0 +1,98 @@
+/**
+ * @file SensorVote.h
+ * @author Johan Simonsson
+ * @brief Vote between redundant temperature sensors
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __SENSORVOTE_H
+#define  __SENSORVOTE_H
+
+#include <stdint.h>
+
+/**
+ * How many sensors can vote.
+ */
+#define SENSOR_VOTE_MAX 4
+
+/**
+ * Sensors that differ more than this from the vote is broken, in 0.01 degC.
+ */
+#define SENSOR_VOTE_DISAGREE 200
+
+/**
+ * No fault alarm the first ticks, a DS18B20 needs a while for the first value.
+ */
+#define SENSOR_VOTE_FIRST_ALARM 5
+
+/**
+ * How the sensors that agree is combined.
+ */
+enum SensorVoteType {
+    SENSOR_VOTE_MEDIAN = 0, ///< The median, the mean of the middle two if even
+    SENSOR_VOTE_MEAN        ///< The mean
+};
+
+/**
+ * Votes between some sensors that measure the same thing,
+ * so the regulator has a value as long as one sensor is working.
+ *
+ * Every tick all inputs gets a value (setValue), then vote() gives the result.
+ * A input without a ok value this tick is broken,
+ * and so is a input that differ more than the disagree level from the others.
+ * With 3 or more sensors the median decides who is wrong,
+ * with 2 that disagree the one closest to the last vote is kept
+ * (or the first input if there is no last vote, so input 0 is the primary).
+ *
+ * The broken inputs is a bit each in the fault mask,
+ * and a alarm is sent every time the mask changes (also when it is fine again).
+ */
+class SensorVote
+{
+    private:
+        SensorVoteType type; ///< Median or mean
+        uint8_t count;       ///< How many inputs
+        int16_t disagree;    ///< Max diff from the vote, in 0.01 degC
+
+        int16_t value[SENSOR_VOTE_MAX]; ///< The value this tick, in 0.01 degC
+        bool valid[SENSOR_VOTE_MAX];    ///< There is a ok value this tick
+
+        int16_t lastValue; ///< The last vote
+        bool lastValid;    ///< There is a last vote
+
+        uint8_t fault;      ///< Bit per input that is broken
+        uint8_t faultSent;  ///< The fault mask last sent to the server
+        uint8_t firstAlarm; ///< Ticks left before a alarm is allowed
+
+        int16_t median(int16_t* values, uint8_t n);
+
+    public:
+        SensorVote(uint8_t inputs, SensorVoteType type = SENSOR_VOTE_MEDIAN);
+
+        void setDisagree(int16_t centi);
+        void setValue(uint8_t input, int16_t centi, bool ok);
+        int16_t vote(bool* ok);
+
+        uint8_t getFault();
+        bool faultTimeToSend();
+        bool getFaultString(char* data, int size);
+        void faultIsSent();
+};
+
+#endif  // __SENSORVOTE_H
@@ -0,0 +1,181 @@
+/**
+ * @file SortedWindow.h
+ * @author Johan Simonsson
+ * @brief The last values kept sorted, for running median filters
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __SORTEDWINDOW_H
+#define  __SORTEDWINDOW_H
+
+#include <stdint.h>
+
+/**
+ * The last N values, kept both in time order and sorted.
+ * Used by SpikeFilter and FilterMedian.
+ *
+ * A new value is O(N), the oldest is removed from the sorted copy
+ * and the new one is inserted in place (the window is small, so no heaps).
+ * Then the median and the other order statistics is found at once.
+ *
+ * @tparam T the value type
+ * @tparam N window size, 1..255
+ */
+template <typename T, uint8_t N>
+class SortedWindow
+{
+    private:
+        T buffer[N];  ///< The values in time order
+        T sorted[N];  ///< The same values sorted
+        uint8_t head; ///< Where to put the next value in buffer
+        uint8_t cnt;  ///< How many values in the window
+
+        void sortedRemove(T value);
+        void sortedInsert(T value);
+
+    public:
+        SortedWindow();
+
+        void init();
+        void addValue(T value);
+
+        uint8_t getCount();
+        T getSorted(uint8_t index);
+        T getMedian();
+};
+
+/**
+ * The default constructor, the window is empty.
+ */
+template <typename T, uint8_t N>
+SortedWindow<T, N>::SortedWindow()
+{
+    init();
+}
+
+/**
+ * Empty the window.
+ */
+template <typename T, uint8_t N>
+void SortedWindow<T, N>::init()
+{
+    head = 0;
+    cnt  = 0;
+}
+
+/**
+ * Remove one value from the sorted window.
+ *
+ * @param value the value to remove, must be in the window
+ */
+template <typename T, uint8_t N>
+void SortedWindow<T, N>::sortedRemove(T value)
+{
+    uint8_t i = 0;
+    while( (i < cnt) && (sorted[i] != value) )
+    {
+        i++;
+    }
+    for( ; (i+1) < cnt ; i++ )
+    {
+        sorted[i] = sorted[i+1];
+    }
+    cnt--;
+}
+
+/**
+ * Insert a value in the sorted window.
+ *
+ * @param value the new value
+ */
+template <typename T, uint8_t N>
+void SortedWindow<T, N>::sortedInsert(T value)
+{
+    uint8_t i = cnt;
+    while( (i > 0) && (sorted[i-1] > value) )
+    {
+        sorted[i] = sorted[i-1];
+        i--;
+    }
+    sorted[i] = value;
+    cnt++;
+}
+
+/**
+ * Add a new value, if the window is full the oldest value is removed.
+ *
+ * @param value the new value
+ */
+template <typename T, uint8_t N>
+void SortedWindow<T, N>::addValue(T value)
+{
+    if(cnt == N)
+    {
+        //The oldest is at head
+        sortedRemove(buffer[head]);
+    }
+    buffer[head] = value;
+    sortedInsert(value);
+
+    head++;
+    if(head >= N)
+    {
+        head = 0;
+    }
+}
+
+/**
+ * How many values is in the window?
+ *
+ * @return the count, 0..N
+ */
+template <typename T, uint8_t N>
+uint8_t SortedWindow<T, N>::getCount()
+{
+    return cnt;
+}
+
+/**
+ * A value in sorted order, 0 is the smallest.
+ *
+ * @param index 0..getCount()-1
+ * @return the value
+ */
+template <typename T, uint8_t N>
+T SortedWindow<T, N>::getSorted(uint8_t index)
+{
+    return sorted[index];
+}
+
+/**
+ * The median of the window, the upper one of the middle two if even.
+ *
+ * @return the median, or 0 if the window is empty
+ */
+template <typename T, uint8_t N>
+T SortedWindow<T, N>::getMedian()
+{
+    if(0 == cnt)
+    {
+        return 0;
+    }
+    return sorted[cnt/2];
+}
+
+#endif  // __SORTEDWINDOW_H
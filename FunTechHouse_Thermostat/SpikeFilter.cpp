@@ -0,0 +1,174 @@
+/**
+ * @file SpikeFilter.cpp
+ * @author Johan Simonsson
+ * @brief Running median and Hampel filter against spikes
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SpikeFilter.h"
+
+/**
+ * The default constructor, no filter until setType() is used.
+ */
+SpikeFilter::SpikeFilter()
+{
+    type = SPIKE_FILTER_NONE;
+    k = SPIKE_FILTER_HAMPEL_K;
+    init();
+}
+
+/**
+ * What filter to use.
+ *
+ * @param type median, hampel or none
+ */
+void SpikeFilter::setType(SpikeFilterType type)
+{
+    this->type = type;
+}
+
+/**
+ * What filter is used?
+ *
+ * @return the filter type
+ */
+SpikeFilterType SpikeFilter::getType()
+{
+    return type;
+}
+
+/**
+ * The Hampel threshold, lower removes more.
+ *
+ * @param k outlier if further than k standard deviations from the median, 1..
+ */
+void SpikeFilter::setThreshold(uint8_t k)
+{
+    if(0 == k)
+    {
+        k = 1;
+    }
+    this->k = k;
+}
+
+/**
+ * Empty the window.
+ */
+void SpikeFilter::init()
+{
+    window.init();
+}
+
+/**
+ * Add a new value and get the filtered value.
+ *
+ * @param value the new value, i.e. from analogRead
+ * @return the filtered value
+ */
+int16_t SpikeFilter::addValue(int16_t value)
+{
+    if(SPIKE_FILTER_NONE == type)
+    {
+        return value;
+    }
+
+    window.addValue(value);
+
+    int16_t median = getMedian();
+    if(SPIKE_FILTER_MEDIAN == type)
+    {
+        return median;
+    }
+
+    //Hampel, |value-median| > k*1.5*MAD
+    //MAD is at least one step, since the readings is quantized.
+    int32_t diff = (int32_t)value - median;
+    if(diff < 0)
+    {
+        diff = -diff;
+    }
+    uint32_t mad = getMAD();
+    if(0 == mad)
+    {
+        mad = 1;
+    }
+    if( ((uint32_t)diff*2) > (k*3*mad) )
+    {
+        return median;
+    }
+    return value;
+}
+
+/**
+ * The median of the window.
+ *
+ * @return the median, or 0 if the window is empty
+ */
+int16_t SpikeFilter::getMedian()
+{
+    return window.getMedian();
+}
+
+/**
+ * The median absolute deviation, the median of |value-median| in the window.
+ *
+ * Since the window is sorted the deviations grows outwards from the median,
+ * so the cnt/2 smallest is found by walking out from the middle.
+ *
+ * @return the MAD
+ */
+uint16_t SpikeFilter::getMAD()
+{
+    uint8_t cnt = window.getCount();
+    if(0 == cnt)
+    {
+        return 0;
+    }
+
+    int16_t median = window.getMedian();
+    int8_t  low  = (cnt/2)-1; //Next to check below the median
+    uint8_t high = (cnt/2)+1; //Next to check above the median
+    uint16_t dev = 0;         //The median itself has 0 deviation
+
+    for( uint8_t i=0 ; i<cnt/2 ; i++ )
+    {
+        uint16_t devLow  = 0xFFFF;
+        uint16_t devHigh = 0xFFFF;
+        if(low >= 0)
+        {
+            devLow = median - window.getSorted(low);
+        }
+        if(high < cnt)
+        {
+            devHigh = window.getSorted(high) - median;
+        }
+
+        if(devLow <= devHigh)
+        {
+            dev = devLow;
+            low--;
+        }
+        else
+        {
+            dev = devHigh;
+            high++;
+        }
+    }
+    return dev;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file SpikeFilter.h
+ * @author Johan Simonsson
+ * @brief Running median and Hampel filter against spikes
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __SPIKEFILTER_H
+#define  __SPIKEFILTER_H
+
+#include <stdint.h>
+
+#include "SortedWindow.h"
+
+/**
+ * Window size, a burst of up to (SPIKE_FILTER_WINDOW-1)/2 spikes is removed.
+ */
+#define SPIKE_FILTER_WINDOW 7
+
+/**
+ * Default Hampel threshold, a value is a outlier if it is more than
+ * this many standard deviations (estimated from the MAD) from the median.
+ */
+#define SPIKE_FILTER_HAMPEL_K 3
+
+/**
+ * What the spike filter shall do.
+ */
+typedef enum
+{
+    SPIKE_FILTER_NONE = 0, ///< Values pass as they are
+    SPIKE_FILTER_MEDIAN,   ///< The median of the window
+    SPIKE_FILTER_HAMPEL    ///< The value, or the median if the value is a outlier
+} SpikeFilterType;
+
+/**
+ * A running median and Hampel filter on a small fixed window,
+ * used on the raw adc readings before the mean filter.
+ *
+ * The mean filters (ValueAvg and RingFilter) only drops one min and one max,
+ * so a burst of spikes (i.e. when a contactor switch) goes right through.
+ *
+ * - The median follows the signal with a delay but no burst shorter than half the window.
+ * - The Hampel filter lets the value pass, unless it is further than K*1.5*MAD
+ *   from the median (1.4826*MAD is the standard deviation for gaussian noise).
+ *   Then the median is used instead, so normal noise is not changed.
+ *
+ * The window is kept both in time order and sorted (SortedWindow),
+ * so a new value is O(window) and the MAD is found in O(window) from the sorted copy.
+ */
+class SpikeFilter
+{
+    private:
+        SpikeFilterType type; ///< What to do
+        uint8_t k;            ///< Hampel threshold
+
+        SortedWindow<int16_t, SPIKE_FILTER_WINDOW> window; ///< The last values, also sorted
+
+    public:
+        SpikeFilter();
+
+        void setType(SpikeFilterType type);
+        SpikeFilterType getType();
+        void setThreshold(uint8_t k);
+
+        void init();
+        int16_t addValue(int16_t value);
+
+        int16_t getMedian();
+        uint16_t getMAD();
+};
+
+#endif  // __SPIKEFILTER_H
@@ -49,3 +49,77 @@ void StringHelp::splitDouble(double value, int* integer, int* decimal)
         *decimal -= 1;
     }
 }
+
+/**
+ * Parse a decimal number like "-12.5" into 0.01 steps (-1250),
+ * without the need of a null terminated string or floating point.
+ *
+ * Decimals after the second is ignored.
+ *
+ * @param str [in] The number, does not need to be null terminated
+ * @param len [in] How many chars to parse
+ * @param value [out] The number in 0.01 steps
+ * @return true if ok, false if there is no number or some junk
+ */
+bool StringHelp::parseFixed(const char* str, unsigned int len, long* value)
+{
+    long integer = 0;
+    long decimal = 0;
+    int decimals = -1; //-1 until the '.'
+    bool digits = false;
+    bool negative = false;
+    unsigned int i = 0;
+
+    if( (len > 0) && ('-' == str[0] || '+' == str[0]) )
+    {
+        negative = ('-' == str[0]);
+        i++;
+    }
+
+    for( ; i<len ; i++ )
+    {
+        char c = str[i];
+        if( ('.' == c) && (decimals < 0) )
+        {
+            decimals = 0;
+        }
+        else if( (c >= '0') && (c <= '9') )
+        {
+            digits = true;
+            if(decimals < 0)
+            {
+                integer = (integer*10) + (c-'0');
+                if(integer > 9999999L)
+                {
+                    return false;
+                }
+            }
+            else if(decimals < 2)
+            {
+                decimal = (decimal*10) + (c-'0');
+                decimals++;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if(!digits)
+    {
+        return false;
+    }
+
+    if(1 == decimals)
+    {
+        decimal *= 10;
+    }
+
+    *value = (integer*100) + decimal;
+    if(negative)
+    {
+        *value = -*value;
+    }
+    return true;
+}
@@ -32,6 +32,7 @@ class StringHelp
     private:
     public:
         static void splitDouble(double value, int* integer, int* decimal);
+        static bool parseFixed(const char* str, unsigned int len, long* value);
 };
 
 #endif  // __STRINGHELP_H 
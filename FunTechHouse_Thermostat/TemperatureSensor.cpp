@@ -52,6 +52,22 @@ TemperatureSensor::TemperatureSensor()
 
     alarmHyst = 1.0;
 
+    oneWire = 0;
+    oneWireIndex = 0;
+
+    dht = 0;
+    humidityWork = 0.0;
+    humiditySent = 0.0;
+    humidityDiffMax = 2.0;
+    humidityValid = false;
+
+    adc = 0;
+    adcChannel = -1;
+    analogValue = 0;
+    analogOk = false;
+
+    kalmanActive = false;
+
     valueSendCnt = ALWAYS_SEND_CNT;
 }
 
@@ -65,6 +81,7 @@ TemperatureSensor::TemperatureSensor()
 bool TemperatureSensor::valueTimeToSend(double value)
 {
     valueWork = value+valueOffset;
+    bool humidityChanged = updateHumidity();
 
     //Timeout lets send anyway
     if(0 == valueSendCnt)
@@ -78,6 +95,11 @@ bool TemperatureSensor::valueTimeToSend(double value)
         return true;
     }
 
+    if(humidityChanged)
+    {
+        return true;
+    }
+
     valueSendCnt--;
     return false;
 }
@@ -90,6 +112,21 @@ bool TemperatureSensor::getValueString(char* data, int size)
     int res = snprintf(data, size,
             "temperature=%d.%02d", intPart, decPart);
 
+    if( humidityValid && (res < size) )
+    {
+        StringHelp::splitDouble(humidityWork, &intPart, &decPart);
+        res += snprintf(data+res, size-res,
+                " ; humidity=%d.%02d", intPart, decPart);
+    }
+
+    bool slopeOk = false;
+    int slope = getSlope(&slopeOk);
+    if( slopeOk && (res < size) )
+    {
+        res += snprintf(data+res, size-res,
+                " ; slope=%s%d.%02d", (slope < 0) ? "-" : "", abs(slope)/100, abs(slope)%100);
+    }
+
     if(res < size)
         return true;
     
@@ -100,6 +137,7 @@ void TemperatureSensor::valueIsSent()
 {
     valueSendCnt = ALWAYS_SEND_CNT;
     valueSent = valueWork;
+    humiditySent = humidityWork;
 }
 
 /**
@@ -119,6 +157,8 @@ void TemperatureSensor::setAlarmLevels(bool activeHigh, double high, bool active
     alarmLowActive = activeLow;
     alarmLow = low;
     alarmLowSent = false;
+
+    updateOneWireAlarm();
 }
 
 
@@ -141,6 +181,443 @@ void TemperatureSensor::setDiffToSend(double value)
 void TemperatureSensor::setValueOffset(double value)
 {
     valueOffset = value;
+    updateOneWireAlarm();
+}
+
+/**
+ * The offset from setValueOffset() (or the offset command).
+ *
+ * @return the offset value
+ */
+double TemperatureSensor::getValueOffset()
+{
+    return valueOffset;
+}
+
+/**
+ * Use a spike filter on the raw readings, see filterReading().
+ *
+ * The median removes more but has a delay,
+ * the hampel only touch the outliers.
+ *
+ * @param type what filter to use, SPIKE_FILTER_NONE is default
+ */
+void TemperatureSensor::setSpikeFilter(SpikeFilterType type)
+{
+    spike.setType(type);
+    spike.init();
+}
+
+/**
+ * Run a raw reading (i.e. from analogRead) through the spike filter.
+ *
+ * @param reading the raw reading
+ * @return the filtered reading
+ */
+int TemperatureSensor::filterReading(int reading)
+{
+    return spike.addValue(reading);
+}
+
+/**
+ * The segment table for a ANALOG_CURVE sensor, see AnalogSensor.
+ *
+ * @param curve [in] the points in flash (PROGMEM), sorted on the reading
+ * @param size how many points
+ */
+void TemperatureSensor::setCurve(const AnalogPoint* curve, uint8_t size)
+{
+    analog.setCurve(curve, size);
+}
+
+/**
+ * Two point calibration (gain and offset) for a analog sensor,
+ * the offset from setValueOffset() is added after this.
+ *
+ * @param measured1 the first point as measured
+ * @param true1 the first point, the true value
+ * @param measured2 the second point as measured
+ * @param true2 the second point, the true value
+ * @return true if ok, false if the gain is not 0.5..2
+ */
+bool TemperatureSensor::setCalibration(double measured1, double true1, double measured2, double true2)
+{
+    return analog.setCalibration(
+            (int16_t)(measured1*100), (int16_t)(true1*100),
+            (int16_t)(measured2*100), (int16_t)(true2*100));
+}
+
+/**
+ * Convert a reading from a analog sensor,
+ * with the table for the sensor type and the calibration.
+ *
+ * @param reading from analogRead, (0..1023<<extraBits).
+ * @param ok becomes true if ok, false if fail.
+ * @param extraBits the reading is oversampled with this many extra bits
+ * @return temperature in 0.01 degC
+ */
+int16_t TemperatureSensor::convertReading(uint16_t reading, bool *ok, uint8_t extraBits)
+{
+    return analog.convert((SensorTypes)getSensorType(), reading, ok, extraBits);
+}
+
+/**
+ * The DS18B20 for this sensor,
+ * the same bus can be used by many sensors (one device each).
+ *
+ * @param bus the bus, begin() and tick() is done by the owner
+ * @param index what device on the bus, see DS18B20Bus::getRom
+ */
+void TemperatureSensor::setOneWire(DS18B20Bus* bus, uint8_t index)
+{
+    oneWire = bus;
+    oneWireIndex = index;
+    updateOneWireAlarm();
+}
+
+/**
+ * The DS18B20 from setOneWire().
+ *
+ * @param index becomes the device on the bus
+ * @return the bus, or NULL if not used
+ */
+DS18B20Bus* TemperatureSensor::getOneWire(uint8_t* index)
+{
+    *index = oneWireIndex;
+    return oneWire;
+}
+
+/**
+ * Give the alarm levels to the DS18B20 (TH and TL),
+ * so the bus can find the sensors with a alarm without reading them all.
+ *
+ * TH and TL is whole degC on the raw value (before the offset),
+ * and is set so the device has a alarm in the whole hysteresis band.
+ * That way a alarm is seen the next tick, and the reset by the heartbeat.
+ */
+void TemperatureSensor::updateOneWireAlarm()
+{
+    if( (0 == oneWire) || (DS18B20 != getSensorType()) )
+    {
+        return;
+    }
+
+    //The device alarm is value >= TH or value <= TL
+    int high = DS18B20_ALARM_HIGH_OFF;
+    int low  = DS18B20_ALARM_LOW_OFF;
+
+    if(alarmHighActive)
+    {
+        double level = alarmHigh - valueOffset - alarmHyst;
+        if(level < DS18B20_ALARM_LOW_OFF)
+        {
+            level = DS18B20_ALARM_LOW_OFF;
+        }
+        if(level < DS18B20_ALARM_HIGH_OFF)
+        {
+            //Round down
+            high = (int)(level - DS18B20_ALARM_LOW_OFF) + DS18B20_ALARM_LOW_OFF;
+        }
+    }
+
+    if(alarmLowActive)
+    {
+        double level = alarmLow - valueOffset + alarmHyst;
+        if(level > DS18B20_ALARM_HIGH_OFF)
+        {
+            level = DS18B20_ALARM_HIGH_OFF;
+        }
+        if(level > DS18B20_ALARM_LOW_OFF)
+        {
+            //Round up
+            low = DS18B20_ALARM_HIGH_OFF - (int)(DS18B20_ALARM_HIGH_OFF - level);
+        }
+    }
+
+    oneWire->setAlarm(oneWireIndex, (int8_t)low, (int8_t)high);
+}
+
+/**
+ * The last value from the DS18B20.
+ *
+ * @param ok becomes true if ok, false if fail.
+ * @return temperature in 0.01 degC
+ */
+int16_t TemperatureSensor::readOneWire(bool *ok)
+{
+    if( (0 == oneWire) || (DS18B20 != getSensorType()) )
+    {
+        *ok = false;
+        return 0;
+    }
+    return oneWire->getCenti(oneWireIndex, ok);
+}
+
+/**
+ * The DHT for this sensor, the humidity is sent together with the temperature.
+ *
+ * @param dht the sensor, begin() and poll() is done by the owner
+ */
+void TemperatureSensor::setDHT(DHTSensor* dht)
+{
+    this->dht = dht;
+}
+
+/**
+ * The last temperature from the DHT.
+ *
+ * @param ok becomes true if ok, false if fail.
+ * @return temperature in 0.01 degC
+ */
+int16_t TemperatureSensor::readDHT(bool *ok)
+{
+    if( (0 == dht) || !isDHT() )
+    {
+        *ok = false;
+        return 0;
+    }
+    return dht->getTemperature(ok);
+}
+
+/**
+ * The humidity is sent when it has changed more than this,
+ * or together with the temperature.
+ *
+ * @param value the diff in %RH, default 2.0
+ */
+void TemperatureSensor::setHumidityDiffToSend(double value)
+{
+    humidityDiffMax = value;
+}
+
+/**
+ * The read phases for every sensor type, in the same order as Sensor::SensorTypes.
+ * The DS18B20 has no poll, the buses is polled by the DS18B20Group.
+ */
+const SensorReadType TemperatureSensor::readTypes[] = {
+    { 0, 0, 0 },                      // NO_SENSOR
+    { startAnalog, 0, resultAnalog }, // LM35DZ
+    { 0, 0, resultOneWire },          // DS18B20
+    { 0, pollDHT, resultDHT },        // DHT_11
+    { 0, pollDHT, resultDHT },        // DHT_21
+    { 0, pollDHT, resultDHT },        // DHT_22
+    { startAnalog, 0, resultAnalog }, // LM34DZ
+    { startAnalog, 0, resultAnalog }, // NTC_10K
+    { startAnalog, 0, resultAnalog }  // ANALOG_CURVE
+};
+
+/**
+ * The read phases for this sensor.
+ *
+ * @return the entry in readTypes, or NULL if the type is unknown
+ */
+const SensorReadType* TemperatureSensor::getReadType()
+{
+    int type = getSensorType();
+    if( (type < 0) || (type >= (int)(sizeof(readTypes)/sizeof(readTypes[0]))) )
+    {
+        return 0;
+    }
+    return &readTypes[type];
+}
+
+/**
+ * The adc that samples the analog sensors,
+ * a channel is added if this is a analog sensor so it must be done before AdcSampler::begin().
+ *
+ * @param adc the sampler
+ */
+void TemperatureSensor::setAdc(AdcSampler* adc)
+{
+    this->adc = adc;
+    adcChannel = -1;
+    if( (0 != adc) && isAnalog() )
+    {
+        adcChannel = adc->addChannel(getSensorPin());
+    }
+}
+
+/**
+ * Start a new read, once every tick before readResult().
+ */
+void TemperatureSensor::readStart()
+{
+    const SensorReadType* type = getReadType();
+    if( (0 != type) && (0 != type->start) )
+    {
+        type->start(this);
+    }
+}
+
+/**
+ * Give the sensor some time between the ticks.
+ *
+ * @param ms the time since the last poll
+ */
+void TemperatureSensor::readPoll(uint16_t ms)
+{
+    const SensorReadType* type = getReadType();
+    if( (0 != type) && (0 != type->poll) )
+    {
+        type->poll(this, ms);
+    }
+}
+
+/**
+ * The temperature from the last read, whatever the sensor type is.
+ *
+ * @param ok becomes true if ok, false if fail or no sensor.
+ * @return temperature in 0.01 degC
+ */
+int16_t TemperatureSensor::readResult(bool *ok)
+{
+    const SensorReadType* type = getReadType();
+    if( (0 == type) || (0 == type->result) )
+    {
+        *ok = false;
+        kalman.init();
+        return 0;
+    }
+
+    int16_t value = type->result(this, ok);
+    if(kalmanActive)
+    {
+        if(*ok)
+        {
+            value = kalman.addValue(value);
+        }
+        else
+        {
+            kalman.init();
+        }
+    }
+    return value;
+}
+
+/**
+ * Let the result go through a Kalman filter, that also gives the slope.
+ * Then the value string has the slope as well.
+ *
+ * @param active true to use the filter
+ * @param noise the noise of the readings, in 0.01 degC (std dev)
+ * @param process the change of the slope per tick, in 0.001 degC (std dev)
+ */
+void TemperatureSensor::setKalman(bool active, uint16_t noise, uint16_t process)
+{
+    kalmanActive = active;
+    kalman.setNoise(noise, process);
+    kalman.init();
+}
+
+/**
+ * The slope from the Kalman filter.
+ *
+ * @param ok becomes true if ok, false if there is no filter or no estimate
+ * @return the slope in 0.01 degC per minute
+ */
+int16_t TemperatureSensor::getSlope(bool *ok)
+{
+    *ok = kalmanActive && kalman.isValid();
+    if(!*ok)
+    {
+        return 0;
+    }
+    return kalman.getSlope(SENSOR_SAMPLES_PER_MINUTE);
+}
+
+/**
+ * Take the next adc value through the spike and mean filter,
+ * a bad value restarts the mean.
+ *
+ * @param sensor the analog sensor
+ */
+void TemperatureSensor::startAnalog(TemperatureSensor* sensor)
+{
+    uint16_t reading = 0;
+    bool ok = (0 != sensor->adc) && sensor->adc->getValue(sensor->adcChannel, &reading);
+    if(ok)
+    {
+        sensor->convertReading(reading, &ok, sensor->adc->getBits());
+    }
+
+    if(ok)
+    {
+        sensor->analogValue = sensor->meanFilter.addValue( sensor->filterReading(reading) );
+    }
+    else
+    {
+        sensor->meanFilter.init();
+    }
+    sensor->analogOk = ok;
+}
+
+/**
+ * Only the filtered value is converted to degrees.
+ *
+ * @param sensor the analog sensor
+ * @param ok becomes true if ok, false if fail.
+ * @return temperature in 0.01 degC
+ */
+int16_t TemperatureSensor::resultAnalog(TemperatureSensor* sensor, bool* ok)
+{
+    if(!sensor->analogOk)
+    {
+        *ok = false;
+        return 0;
+    }
+    return sensor->convertReading(sensor->analogValue, ok, sensor->adc->getBits());
+}
+
+/**
+ * @see readOneWire
+ */
+int16_t TemperatureSensor::resultOneWire(TemperatureSensor* sensor, bool* ok)
+{
+    return sensor->readOneWire(ok);
+}
+
+/**
+ * @see DHTSensor::poll
+ */
+void TemperatureSensor::pollDHT(TemperatureSensor* sensor, uint16_t ms)
+{
+    if(0 != sensor->dht)
+    {
+        sensor->dht->poll(ms);
+    }
+}
+
+/**
+ * @see readDHT
+ */
+int16_t TemperatureSensor::resultDHT(TemperatureSensor* sensor, bool* ok)
+{
+    return sensor->readDHT(ok);
+}
+
+/**
+ * Take the humidity from the DHT.
+ *
+ * @return true if it has changed more than humidityDiffMax since the last send
+ */
+bool TemperatureSensor::updateHumidity()
+{
+    bool ok = false;
+    int16_t value = 0;
+    if( (0 != dht) && isDHT() )
+    {
+        value = dht->getHumidity(&ok);
+    }
+
+    humidityValid = ok;
+    if(!ok)
+    {
+        return false;
+    }
+
+    humidityWork = value / 100.0;
+    double diff = humidityWork-humiditySent;
+    return ( diff > humidityDiffMax || -diff > humidityDiffMax );
 }
 
 bool TemperatureSensor::alarmHighCheck(char* responce, int maxSize)
@@ -218,4 +695,79 @@ void TemperatureSensor::alarmLowFailed()
     alarmLowSent = false;
 }
 
+/**
+ * Apply a command from the server,
+ * "offset", "diff", "alarmhigh" and "alarmlow" is the same as the set functions.
+ * A offset outside +-SENSOR_OFFSET_MAX or a negative diff is not used.
+ *
+ * @param key [in] the command, not null terminated
+ * @param keyLen length of the key
+ * @param value the value in 0.01 steps
+ * @return true if ok, false if unknown command or bad value.
+ */
+bool TemperatureSensor::commandSet(const char* key, unsigned int keyLen, long value)
+{
+    if(commandIs(key, keyLen, "offset"))
+    {
+        if( (value < -(SENSOR_OFFSET_MAX*100L)) || (value > (SENSOR_OFFSET_MAX*100L)) )
+        {
+            return false;
+        }
+        valueOffset = value/100.0;
+        updateOneWireAlarm();
+        return true;
+    }
+    if(commandIs(key, keyLen, "diff"))
+    {
+        if(value < 0)
+        {
+            return false;
+        }
+        valueDiffMax = value/100.0;
+        return true;
+    }
+    if(commandIs(key, keyLen, "alarmhigh"))
+    {
+        alarmHigh = value/100.0;
+        alarmHighSent = false;
+        updateOneWireAlarm();
+        return true;
+    }
+    if(commandIs(key, keyLen, "alarmlow"))
+    {
+        alarmLow = value/100.0;
+        alarmLowSent = false;
+        updateOneWireAlarm();
+        return true;
+    }
+    return false;
+}
+
+/**
+ * The ack after a command, with the state that can be changed by commands.
+ *
+ * @param data [out] the string to send
+ * @param size size of data
+ * @return true if ok
+ */
+bool TemperatureSensor::getCommandString(char* data, int size)
+{
+    int oI, oD;
+    int dI, dD;
+    int hI, hD;
+    int lI, lD;
+
+    StringHelp::splitDouble(valueOffset,  &oI, &oD);
+    StringHelp::splitDouble(valueDiffMax, &dI, &dD);
+    StringHelp::splitDouble(alarmHigh,    &hI, &hD);
+    StringHelp::splitDouble(alarmLow,     &lI, &lD);
+
+    int res = snprintf(data, size,
+            "offset=%d.%02d ; diff=%d.%02d ; alarmhigh=%d.%02d ; alarmlow=%d.%02d",
+            oI, oD, dI, dD, hI, hD, lI, lD);
+
+    if(res < size)
+        return true;
 
+    return false;
+}
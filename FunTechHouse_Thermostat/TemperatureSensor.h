@@ -25,6 +25,13 @@
 #define  __TEMPERATURESENSOR_H
 
 #include "Sensor.h"
+#include "SpikeFilter.h"
+#include "AnalogSensor.h"
+#include "DS18B20Bus.h"
+#include "DHTSensor.h"
+#include "AdcSampler.h"
+#include "FilterChain.h"
+#include "KalmanFilter.h"
 
 // If value is the "same" for "cnt" questions, then send anyway.
 // If sleep is 1s (1000ms) and there is 1 question per rotation
@@ -32,6 +39,29 @@
 // 1200/1s/60s=20min
 #define ALWAYS_SEND_CNT 1200
 
+// The analog sensors is filtered over a sliding window of the adc values, one per tick.
+#define SENSOR_FILTER_WINDOW 8
+
+// The sensors is read once a tick (1s), the slope is sent per minute.
+#define SENSOR_SAMPLES_PER_MINUTE 60
+
+// The largest offset a command may set, in degC,
+// OneWireStore saves offset*100 in a int16_t.
+#define SENSOR_OFFSET_MAX 327
+
+class TemperatureSensor;
+
+/**
+ * How a sensor type is read, one entry per Sensor::SensorTypes.
+ * A new type only needs a new entry, the loop does not change.
+ * A phase that is NULL has nothing to do for the type.
+ */
+typedef struct
+{
+    void (*start)(TemperatureSensor* sensor);               ///< Once every tick, before the result
+    void (*poll)(TemperatureSensor* sensor, uint16_t ms);   ///< Often between the ticks
+    int16_t (*result)(TemperatureSensor* sensor, bool* ok); ///< The temperature in 0.01 degC
+} SensorReadType;
 
 class TemperatureSensor : public Sensor
 {
@@ -55,6 +85,39 @@ class TemperatureSensor : public Sensor
 
         double alarmHyst; ///< alarm level must go back this much to be reseted
 
+        SpikeFilter spike; ///< Removes spikes from the raw readings
+        AnalogSensor analog; ///< Converts the readings from a analog sensor
+
+        DS18B20Bus* oneWire;  ///< The bus for a DS18B20 sensor
+        uint8_t oneWireIndex; ///< What device on the bus
+
+        DHTSensor* dht;         ///< The DHT for a DHT sensor
+        double humidityWork;    ///< The humidity from the DHT
+        double humiditySent;    ///< Last humidity sent to the server
+        double humidityDiffMax; ///< Humidity should diff more than this to be sent
+        bool   humidityValid;   ///< There is a humidity to send
+
+        AdcSampler* adc;    ///< The adc for a analog sensor
+        int8_t adcChannel;  ///< The channel in the adc, -1 if none
+        FilterChain< FilterMean<SENSOR_FILTER_WINDOW> > meanFilter; ///< The mean of the adc values
+        uint16_t analogValue; ///< The filtered adc value from the last start
+        bool analogOk;        ///< The last adc value was ok
+
+        KalmanFilter kalman; ///< The estimate of the temperature and slope
+        bool kalmanActive;   ///< The result is from the Kalman filter
+
+        static const SensorReadType readTypes[];
+
+        static void startAnalog(TemperatureSensor* sensor);
+        static int16_t resultAnalog(TemperatureSensor* sensor, bool* ok);
+        static int16_t resultOneWire(TemperatureSensor* sensor, bool* ok);
+        static void pollDHT(TemperatureSensor* sensor, uint16_t ms);
+        static int16_t resultDHT(TemperatureSensor* sensor, bool* ok);
+        const SensorReadType* getReadType();
+
+        bool commandSet(const char* key, unsigned int keyLen, long value);
+        void updateOneWireAlarm();
+        bool updateHumidity();
 
 
     public:
@@ -66,6 +129,30 @@ class TemperatureSensor : public Sensor
 
         void setDiffToSend(double value);
         void setValueOffset(double value);
+        double getValueOffset();
+
+        void setSpikeFilter(SpikeFilterType type);
+        int filterReading(int reading);
+
+        void setCurve(const AnalogPoint* curve, uint8_t size);
+        bool setCalibration(double measured1, double true1, double measured2, double true2);
+        int16_t convertReading(uint16_t reading, bool *ok, uint8_t extraBits = 0);
+
+        void setOneWire(DS18B20Bus* bus, uint8_t index);
+        DS18B20Bus* getOneWire(uint8_t* index);
+        int16_t readOneWire(bool *ok);
+
+        void setDHT(DHTSensor* dht);
+        int16_t readDHT(bool *ok);
+        void setHumidityDiffToSend(double value);
+
+        void setAdc(AdcSampler* adc);
+        void readStart();
+        void readPoll(uint16_t ms);
+        int16_t readResult(bool *ok);
+
+        void setKalman(bool active, uint16_t noise = KALMAN_NOISE, uint16_t process = KALMAN_PROCESS);
+        int16_t getSlope(bool *ok);
 
         void setAlarmLevels(bool activeHigh, double high, bool activeLow, double low);
         bool alarmHighCheck(char* responce, int maxSize);
@@ -73,6 +160,8 @@ class TemperatureSensor : public Sensor
         void alarmHighFailed();
         void alarmLowFailed();
 
+        bool getCommandString(char* data, int size);
+
 };
 
 #endif  // __TEMPERATURESENSOR_H
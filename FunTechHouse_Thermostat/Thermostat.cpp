@@ -27,75 +27,30 @@
 
 #include "Thermostat.h"
 #include "Regulator.h"
+#include "PlantIdent.h"
 #include "StringHelp.h"
 
 /**
  * The default constructor.
  *
  * @param stageCount how many output stages to use
+ * @param type what output type to use
  */
 Thermostat::Thermostat(unsigned int stageCount, ThermostatType type)
+    : Regulator(stageCount, type)
 {
-    stages = stageCount;
-    stageOut = 0;
-    this->type = type;
-
-    //Some defaults.
-    value = 0;
-    setpoint = 60.0;
-
-    valueSent    = 0;
-    setpointSent = 0;
-    stageOutSent = 0;
     setpointHyst = 5;
 
-    valueDiffMax = 0.8;
-    valueSendCnt = 0;
-
     lowValueCount = 0;
+    lowValueCountMax = LOW_VALUE_COUNT_MAX;
 
-    firstAlarm = FIRST_ALARM_ALLOWED;
-
-    alarmLowActive = false;
-    alarmLevelLow = 10.0;
-    alarmHighActive = false;
-    alarmLevelHigh = 10.0;
-
-    alarmLow  = ALARM_NOT_ACTIVE;
-    alarmHigh = ALARM_NOT_ACTIVE;
-
-    maxOutValue = ((1 << stages)-1);
+    autoTune = false;
 
     //The delayed off is default not active.
     delayOffCount = 0;
     delayOff      = 0;
 };
 
-/**
- * How many output stages is used by this thermostat?
- *
- * @return unsigned int valid values goes from 1..n, 0 is valid but pointless.
- */
-unsigned int Thermostat::getStageCount()
-{
-    return stages;
-}
-
-/**
- * If this state is active or not?
- *
- * @param stage the output stage number from 0..n
- * @return true if active and false if not active.
- */
-bool Thermostat::getStageOut(unsigned int stage)
-{
-    if(stage >= stages)
-        return false;
-
-    uint8_t mask = 1 << stage;
-    return bool(stageOut & mask);
-}
-
 /**
  * Enable the next step and keep the old steps active.
  */
@@ -118,43 +73,6 @@ void Thermostat::incStageOut()
     }
 }
 
-/**
- * Is the output 100%
- *
- * @return true if output is 100%, false if there is more to give.
- */
-bool Thermostat::isOutMax()
-{
-    if(stageOut >= maxOutValue)
-    {
-        return true;
-    }
-    return false;
-}
-
-/**
- * Set the maximum allows value for the outputs.
- *
- * Example with THERMOSTAT_TYPE_BIN_CNT with 3 stages connected to a
- * electric heater where stage 1 is 2kW, stage 2 is 4kW and stage3 is 9kW.
- * And this heater can produce 2+4+9=15kW, but it is only connected to fuses that allows 10kW.
- * Then a maxValue at 0x4 (bin 100), will allows it to step throu stages that reprecent
- * 0kW, 2kW, 4kW, 6kW (2+4) and 9kW, but block the higher 11kW (9+2) and higher that would blow the fuse.
- *
- * @param maxValue is the new max value.
- * @return true if ok, false is probably a value bigger that the value spec by the stage count.
- */
-bool Thermostat::setOutMax(uint8_t maxValue)
-{
-    if(maxValue > ((1 << stages)-1))
-    {
-        return false;
-    }
-
-    this->maxOutValue = maxValue;
-    return true;
-}
-
 /**
  * Setpoint to work with.
  *
@@ -174,69 +92,112 @@ void Thermostat::setSetpoint(double setpoint, double hysteresis)
 }
 
 /**
- * How much must the value diff from last sent value before it is time to send again?
- *
- * If valueDiffMax is 2.0 and last value sent to server was 20.0,
- * then the new value must be higher than 22 (20+2) or lower than 18 (20-2)
- * before we send a new value.
+ * Set a delay for turn off when high
  *
- * This will minimize the amount of duplicated data on the server.
+ * This will delay the turn off when the value is high, 
+ * this is practical if the device has its own high level protection 
+ * and must run high for X time. 
+ * But this is also dangerous if there is no secondary protection, 
+ * use this feature with care. 
  *
- * @param valueDiffMax diff, i.e. 2 will send if
+ * @param delayOffCount time in seconds between the time the value hits the setpoint and we actually turn off.
  */
-void Thermostat::setValueDiff(double valueDiffMax)
+void Thermostat::setDelayOff(unsigned int delayOffCount)
 {
-    this->valueDiffMax = valueDiffMax;
+    this->delayOffCount = delayOffCount;
+    this->delayOff      = delayOffCount;
 }
 
 /**
- * Shall the alarm be active and what level should be used.
+ * Calculate how many slots of the cycle the top stage shall be on.
  *
- * Please note that the levels is relative to the setpoint.
- * Values 10 and 10, and a setpoint at 50 will give alarm levels at 40 (50-10) and 60 (50+10).
+ * Inside the band setpoint-hyst..setpoint the duty goes linear from 100% to 0%,
+ * under the band it is always 100% (and we rely on more stages).
+ */
+void Thermostat::calcDuty()
+{
+    if(!pwm.isActive())
+        return;
+
+    uint16_t cycle = pwm.getCycle();
+    uint16_t duty = cycle;
+
+    if( (value < setpoint) && (value > (setpoint-setpointHyst)) )
+    {
+        duty = (uint16_t)( ((setpoint-value)*cycle) / setpointHyst );
+    }
+    pwm.setDuty(duty);
+}
+
+/**
+ * Use the plant estimate for the time between stages and the hysteresis?
  *
- * Please note that it is a good idea to put alarmLevelLow under setpoint-hyst,
- * since that is the normal "low point" for the system.
+ * Until there is a estimate the configured values is used.
+ * A "hyst" command turns it off, so the hysteresis from the server is kept.
  *
- * @param activateLowAlarm true to activate low alarm
- * @param alarmLevelLow how much lower than setpoint shall the level be?
- * @param activateHighAlarm true to active high alarm
- * @param alarmLevelHigh how much higher than the setpoint shall the level be?
+ * @param active true to use the estimate
  */
-void Thermostat::setAlarmLevels(
-        bool activateLowAlarm, double alarmLevelLow,
-        bool activateHighAlarm, double alarmLevelHigh)
+void Thermostat::setAutoTune(bool active)
 {
-    alarmLowActive = activateLowAlarm;
-    this->alarmLevelLow = alarmLevelLow;
-
-    alarmHighActive = activateHighAlarm;
-    this->alarmLevelHigh = alarmLevelHigh;
+    autoTune = active;
 }
 
 /**
- * Set a delay for turn off when high
+ * How far below the setpoint is the value?
  *
- * This will delay the turn off when the value is high, 
- * this is practical if the device has its own high level protection 
- * and must run high for X time. 
- * But this is also dangerous if there is no secondary protection, 
- * use this feature with care. 
+ * When turned off we don't turn on until we are under the hysteresis,
+ * so until then there is no need for power.
  *
- * @param delayOffCount time in seconds between the time the value hits the setpoint and we actually turn off.
+ * @return setpoint-value, or 0 if there is no need for more power.
  */
-void Thermostat::setDelayOff(unsigned int delayOffCount)
+double Thermostat::getDeficit()
 {
-    this->delayOffCount = delayOffCount;
-    this->delayOff      = delayOffCount;
+    if( (0 == stageOut) && !pwm.isActive() && (value >= (setpoint-setpointHyst)) )
+    {
+        return 0;
+    }
+    return Regulator::getDeficit();
 }
 
 /**
- * Calculate the new output.
+ * Calculate the new output, and feed the plant estimate with the step responses.
  *
  * @return true if ok
  */
 bool Thermostat::calcOutput()
+{
+    uint8_t stageOutLast = stageOut;
+    unsigned int outLast = getOutValue();
+    int16_t valueQ = (int16_t)(value*100);
+
+    calcStages();
+
+    if(stageOut > stageOutLast)
+    {
+        unsigned int out = getOutValue();
+        plant.stepStart(valueQ, (out > outLast)?(out-outLast):0);
+    }
+    else if(stageOut < stageOutLast)
+    {
+        plant.stepAbort();
+    }
+    else
+    {
+        plant.addValue(valueQ);
+    }
+
+    if(autoTune)
+    {
+        lowValueCountMax = plant.getStageInterval(lowValueCountMax);
+        setpointHyst = plant.getHyst((int16_t)(setpointHyst*100)) / 100.0;
+    }
+    return true;
+}
+
+/**
+ * Calculate the new stage output.
+ */
+void Thermostat::calcStages()
 {
     if(0 == stageOut)
     {
@@ -249,6 +210,21 @@ bool Thermostat::calcOutput()
             //Reset the counter so we get a correct count the second time.
             lowValueCount = 0;
         }
+        else if(pwm.isActive() && (value < setpoint))
+        {
+            //With time proportional output the hyst is the proportional band,
+            //so turn on at once with a small duty.
+            incStageOut();
+            lowValueCount = 0;
+        }
+
+        if(0 != stageOut)
+        {
+            //Start a new cycle so we turn on now and not at the next cycle.
+            calcDuty();
+            pwm.restart();
+            return;
+        }
     }
     else
     {
@@ -258,7 +234,7 @@ bool Thermostat::calcOutput()
             //We are still really low, let's think about more power!
             lowValueCount++;
 
-            if(lowValueCount % LOW_VALUE_COUNT_MAX == 0)
+            if(lowValueCount % lowValueCountMax == 0)
             {
                 //Since we are still under the setpoint,
                 //let's active the next step.
@@ -291,310 +267,111 @@ bool Thermostat::calcOutput()
             }
         }
     }
-    return true;
+
+    calcDuty();
 }
 
 /**
- * Shall we send data to the server?
- *
- * Please note that the value entered here,
- * will trigger the calculation of outputs and alarms.
+ * Is there a new plant estimate to send to the server?
  *
- * @param value the new value used to calculate output
- * @return bool true if there is data to send, false if there is only old data.
+ * @return true if there is a new estimate
  */
-bool Thermostat::valueTimeToSend(double value)
+bool Thermostat::plantTimeToSend()
 {
-    bool timeToSend = false;
-
-    this->value = value;
-
-    calcOutput();
-
-    if(0 >= valueSendCnt)
-        timeToSend = true;
-
-    double diff = value-valueSent;
-    if( diff > valueDiffMax || -diff > valueDiffMax )
-        timeToSend = true;
-
-    if(setpoint != setpointSent)
-        timeToSend = true;
-
-    if(stageOut != stageOutSent)
-        timeToSend = true;
-
-    valueSendCnt--;
-    return timeToSend;
+    return plant.resultTimeToSend();
 }
 
 /**
- * If it is time to send data,
- * this functions prepares the string that should be sent to the server.
+ * The plant estimate and the staging parameters that we get from it.
  *
- * @return char* to the string
+ * @param data [out] the string to send
+ * @param size size of data
+ * @return true if ok
  */
-bool Thermostat::getValueString(char* data, int size)
+bool Thermostat::getPlantString(char* data, int size)
 {
-    int vI, vD;
-    int sI, sD;
-
-    StringHelp::splitDouble(value, &vI, &vD);
-    StringHelp::splitDouble(setpoint, &sI, &sD);
+    unsigned int gain = plant.getGain();
+    int hyst = plant.getHyst((int16_t)(setpointHyst*100));
 
     int res = snprintf(data, size,
-            "value=%d.%02d ; setpoint=%d.%02d ; output=%03d%%",
-            vI, vD,
-            sI, sD, getOutValue());
+            "deadtime=%u ; tau=%u ; gain=%u.%02u ; interval=%u ; hyst=%d.%02d",
+            plant.getDeadTime(), plant.getTimeConstant(),
+            gain/100, gain%100,
+            plant.getStageInterval(lowValueCountMax),
+            hyst/100, hyst%100);
 
     if(res < size)
         return true;
-    
-    return false;
-}
-
-/**
- * If we could send the package to the server,
- * then call this function since that will reset the internal counters.
- */
-void Thermostat::valueIsSent()
-{
-    valueSendCnt = ALWAYS_SEND_CNT;
-
-    valueSent    = value;
-    setpointSent = setpoint;
-    stageOutSent = stageOut;
-}
-
-/**
- * Convert the output to a human readable procent number (0..100%)
- *
- * @return number between 0 and 100, where 100 is max.
- */
-unsigned int Thermostat::getOutValue()
-{
-    unsigned int out = 0;
-    unsigned int steps = 0;
-
-    switch ( type )
-    {
-        case THERMOSTAT_TYPE_LINEAR:
-            while(steps<stages)
-            {
-                if(!getStageOut(steps))
-                {
-                    break;
-                }
-                steps++;
-            }
-            /// @todo Use maxOutValue;
-            out = ((steps*100.0)/stages);
-            break;
-        case THERMOSTAT_TYPE_BIN_CNT:
-            out = (stageOut*100) / maxOutValue;
-            break;
-        default :
-            break;
-    }
 
-    return out;
+    return false;
 }
 
 /**
- * Delay when we allow the first alarm to be activated,
- * so the controlled system has time to init.
- *
- * @return true when we allow alarms to be sent
+ * The plant estimate was sent to the server.
  */
-bool Thermostat::allowAlarm()
+void Thermostat::plantIsSent()
 {
-    if(firstAlarm != 0)
-    {
-        firstAlarm--;
-        return false;
-    }
-    return true;
+    plant.resultIsSent();
 }
 
 /**
- * Is there a low alarm that should be sent to the server?
+ * Apply a command from the server,
+ * "setpoint" and "hyst" is the same as setSetpoint() and the rest is done by Regulator.
+ * A setpoint outside REGULATOR_SETPOINT_MIN..REGULATOR_SETPOINT_MAX
+ * or a hyst outside 0..THERMOSTAT_HYST_MAX is not used.
+ * A "hyst" turns off setAutoTune(), else the next tick would replace it,
+ * the staging interval stays at the last estimate.
  *
- * @return true if there is a alarm, false if all is fine.
+ * @param key [in] the command, not null terminated
+ * @param keyLen length of the key
+ * @param value the value in 0.01 steps
+ * @return true if ok, false if unknown command or bad value.
  */
-bool Thermostat::alarmLowTimeToSend()
+bool Thermostat::commandSet(const char* key, unsigned int keyLen, long value)
 {
-    if(!allowAlarm())
-        return false;
-
-    if(!alarmLowActive)
-        return false;
-
-    bool status = false;
-
-    switch ( alarmLow )
+    if(commandIs(key, keyLen, "setpoint"))
     {
-        case ALARM_NOT_ACTIVE:
-            if( (value < (setpoint-alarmLevelLow)) && isOutMax() )
-            {
-                alarmLow = ALARM_ACTIVE_NOT_SENT;
-                status = true;
-            }
-            break;
-        case ALARM_ACTIVE_SENT:
-            if( value > setpoint )
-            {
-                alarmLow = ALARM_NOT_ACTIVE;
-            }
-            break;
-        case ALARM_ACTIVE_NOT_SENT:
-            if( value > setpoint )
-            {
-                alarmLow = ALARM_NOT_ACTIVE;
-            }
-            else
-            {
-                status = true;
-            }
-            break;
+        if(!commandSetpointOk(value))
+        {
+            return false;
+        }
+        setpoint = value/100.0;
+        return true;
     }
-    return status;
-}
-
-/**
- * Is there a high alarm that should be sent to the server?
- *
- * @return true if there is a alarm, false if all is fine.
- */
-bool Thermostat::alarmHighTimeToSend()
-{
-    if(!allowAlarm())
-        return false;
-
-    if(!alarmHighActive)
-        return false;
-
-    bool status = false;
-
-    switch ( alarmHigh )
+    if(commandIs(key, keyLen, "hyst"))
     {
-        case ALARM_NOT_ACTIVE:
-            //if( (value > (setpoint+alarmLevelLow)) && (!getStageOut(0)) )
-            if( (value > (setpoint+alarmLevelLow)) )
-            {
-                alarmHigh = ALARM_ACTIVE_NOT_SENT;
-                status = true;
-            }
-            break;
-        case ALARM_ACTIVE_SENT:
-            if( value < setpoint )
-            {
-                alarmHigh = ALARM_NOT_ACTIVE;
-            }
-            break;
-        case ALARM_ACTIVE_NOT_SENT:
-            if( value < setpoint )
-            {
-                alarmHigh = ALARM_NOT_ACTIVE;
-            }
-            else
-            {
-                status = true;
-            }
-            break;
+        if( (value < 0) || (value > (THERMOSTAT_HYST_MAX*100L)) )
+        {
+            return false;
+        }
+        setpointHyst = value/100.0;
+        autoTune = false;
+        return true;
     }
-    return status;
+    return Regulator::commandSet(key, keyLen, value);
 }
 
 /**
- * Returns a alarm low string that can be sent
- * to the server.
- * This functions must only be called if alarmLowTimeToSend retured true.
+ * The ack after a command, with the state that can be changed by commands.
  *
- * @return char* with the low alarm string
+ * @param data [out] the string to send
+ * @param size size of data
+ * @return true if ok
  */
-bool Thermostat::getAlarmLowString(char* data, int size)
+bool Thermostat::getCommandString(char* data, int size)
 {
-    int vI, vD;
     int sI, sD;
-    int aI, aD;
+    int hI, hD;
 
-    StringHelp::splitDouble(value, &vI, &vD);
     StringHelp::splitDouble(setpoint, &sI, &sD);
-    StringHelp::splitDouble((setpoint-alarmLevelLow), &aI, &aD);
+    StringHelp::splitDouble(setpointHyst, &hI, &hD);
 
     int res = snprintf(data, size,
-            "Alarm: Low ; value=%d.%02d ; alarm=%d.%02d ; setpoint=%d.%02d ; output=%03d%%",
-            vI, vD,
-            aI, aD,
-            sI, sD,
-            getOutValue());
+            "setpoint=%d.%02d ; hyst=%d.%02d ; outmax=%u",
+            sI, sD, hI, hD, outMaxLimit);
 
     if(res < size)
         return true;
-    
-    return false;
-}
-
-/**
- * Returns a alarm high string that can be sent to the server.
- *
- * This functions must only be called if alarmHighTimeToSend retured true.
- *
- * @return char* with the high alarm string
- */
-bool Thermostat::getAlarmHighString(char* data, int size)
-{
-    int vI, vD;
-    int sI, sD;
-    int aI, aD;
-
-    StringHelp::splitDouble(value, &vI, &vD);
-    StringHelp::splitDouble(setpoint, &sI, &sD);
-    StringHelp::splitDouble((setpoint+alarmLevelHigh), &aI, &aD);
 
-    int res = snprintf(data, size,
-            "Alarm: High ; value=%d.%02d ; alarm=%d.%02d ; setpoint=%d.%02d ; output=%03d%%",
-            vI, vD,
-            aI, aD,
-            sI, sD,
-            getOutValue());
-
-    if(res < size)
-        return true;
-    
     return false;
 }
-
-/**
- * Tell the logic that the alarm low was sucessfully sent to the server so it can be marked as sent.
- */
-void Thermostat::alarmLowIsSent()
-{
-    switch ( alarmLow )
-    {
-        case ALARM_ACTIVE_SENT:
-            break;
-        case ALARM_NOT_ACTIVE:
-            break;
-        case ALARM_ACTIVE_NOT_SENT:
-            alarmLow = ALARM_ACTIVE_SENT;
-            break;
-    }
-}
-
-/**
- * Tell the logic that the alarm high was sucessfully sent to the server so it can be marked as sent.
- */
-void Thermostat::alarmHighIsSent()
-{
-    switch ( alarmHigh )
-    {
-        case ALARM_ACTIVE_SENT:
-            break;
-        case ALARM_NOT_ACTIVE:
-            break;
-        case ALARM_ACTIVE_NOT_SENT:
-            alarmHigh = ALARM_ACTIVE_SENT;
-            break;
-    }
-}
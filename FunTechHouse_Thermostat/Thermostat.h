@@ -26,8 +26,8 @@
 
 #include <stdint.h>
 
-#include "MQTT_Logic.h"
 #include "Regulator.h"
+#include "PlantIdent.h"
 
 /**
  * Time until next stage kicks in
@@ -35,38 +35,9 @@
 #define LOW_VALUE_COUNT_MAX 180
 
 /**
- * If value is the "same" for "cnt" questions, then send anyway.
- *
- * If sleep is 1s (1000ms) and there is 1 question per rotation
- * then we have 600/1s=600s or always send every 10min
- * 1200/1s/60s=20min
- */
-#define ALWAYS_SEND_CNT 1200
-
-/**
- * Do not send any alarms at startup wait for the process to start as well.
- */
-#define FIRST_ALARM_ALLOWED 600
-
-/**
- * The statemachine for the alarm
+ * The largest hysteresis a command may set, in degC.
  */
-typedef enum
-{
-    ALARM_ACTIVE_SENT = 0, ///< The alarm is triggered, and has been sent to the server.
-    ALARM_ACTIVE_NOT_SENT, ///< The alarm is triggered, but has not sent to the server.
-    ALARM_NOT_ACTIVE       ///< The alarm is not triggered, all is fine.
-} AlarmStates;
-
-/**
- * What output type this thermostat is used.
- */
-typedef enum
-{
-    THERMOSTAT_TYPE_LINEAR = 0, ///< Linear output, 3stages, 001, 011, 111
-    THERMOSTAT_TYPE_BIN_CNT     ///< Bin cnt output, 3stages, 001, 010, 011, 100, 101, 110, 111
-} ThermostatType;
-
+#define THERMOSTAT_HYST_MAX 20
 
 /**
  * A thermostat with multi stage output.
@@ -79,75 +50,50 @@ typedef enum
  * It also has two alarm functions that will notify you if the
  * process has failed in some way.
  *
- * @dotfile state_alarm_low.gv The alarm low state machine
- * @dotfile state_alarm_high.gv The alarm high state machine
+ * With a cycle time set the top active stage is time proportional,
+ * and the hysteresis band becomes a proportional band where the
+ * top stage is on for a part of the cycle (more on when further from the setpoint).
+ *
+ * Every time a stage is added the step response is used to estimate
+ * the plant (see PlantIdent), and with auto tune active the estimate
+ * replaces LOW_VALUE_COUNT_MAX and the hysteresis.
+ *
+ * The output and alarm logic is in Regulator.
  */
-class Thermostat : public Regulator 
+class Thermostat : public Regulator
 {
      private:
-         unsigned int stages; ///< How many output stages does this thermostat have?
-         ThermostatType type; ///< What output type to use.
-
-         double value;     ///< Measured process value, i.e. temperature.
-         double setpoint;  ///< Target value
-         uint8_t stageOut; ///< Output state for the stages, bit0 is stage0, bit1 is stage1 etc etc.
-         uint8_t maxOutValue; ///< Out not allowed to be bigger than this, more or less limit out to this.
-
-         double valueSent;     ///< Last value sent to server.
-         double setpointSent;  ///< Last setpoint sent to server.
-         uint8_t stageOutSent; ///< Last output sent to server.
-
          double setpointHyst; ///< Must fall with this much before we active again.
 
-         unsigned int lowValueCount; ///< How many times has we been under the setpoint?
-
-         double valueDiffMax; ///< Value should diff more than this to be sent to the server
-         int    valueSendCnt; ///< Always send after "cnt time" even if there is no change
-
-         bool alarmLowActive; ///< Is low alarm active? if false then low alarm is off
-         double alarmLevelLow;///< Alarm level, setpoint-alarmLevelLow=>alarm
-         AlarmStates alarmLow;///< The low alarm statemachine.
-
-         bool alarmHighActive; ///< Is high alarm active? if false then high alarm is off
-         double alarmLevelHigh;///< Alarm level, setpoint+alarmLevelHigh=>alarm
-         AlarmStates alarmHigh;//< The high alarm statemachine
+         unsigned int lowValueCount;    ///< How many times has we been under the setpoint?
+         unsigned int lowValueCountMax; ///< Time until next stage kicks in
 
          unsigned int delayOffCount; ///< How long shall we delay the off
          unsigned int delayOff;      ///< The countdown variable for delay off
 
+         PlantIdent plant; ///< Estimates the plant from the step responses
+         bool autoTune;    ///< Use the plant estimate for the staging?
+
          void incStageOut();
          //void decStageOut();
-         bool isOutMax();
-
-         unsigned int firstAlarm; ///< Countdown timer so we dont sent the first alarms to early.
-         bool allowAlarm();
+         void calcDuty();
+         void calcStages();
          bool calcOutput();
-         unsigned int getOutValue();
+         bool commandSet(const char* key, unsigned int keyLen, long value);
 
      public:
          Thermostat(unsigned int stages, ThermostatType type);
-         unsigned int getStageCount();
-         bool getStageOut(unsigned int stage);
-
-         bool setOutMax(uint8_t maxValue);
 
          void setSetpoint(double setpoint, double hysteresis);
-         void setValueDiff(double valueDiffMax);
-         void setAlarmLevels(bool activateLowAlarm, double alarmLevelLow,
-                 bool activateHighAlarm, double alarmLevelHigh);
          void setDelayOff(unsigned int delayOffCount);
+         void setAutoTune(bool active);
 
-         bool valueTimeToSend(double value);
-         bool getValueString(char* data, int size);
-         void valueIsSent();
-
-         bool alarmLowTimeToSend();
-         bool getAlarmLowString(char* data, int size);
-         void alarmLowIsSent();
+         double getDeficit();
+         bool getCommandString(char* data, int size);
 
-         bool alarmHighTimeToSend();
-         bool getAlarmHighString(char* data, int size);
-         void alarmHighIsSent();
+         bool plantTimeToSend();
+         bool getPlantString(char* data, int size);
+         void plantIsSent();
 
          //bool  alarmError();
          //char* getAlarmErrorString();
@@ -0,0 +1,137 @@
+/**
+ * @file TimeProportional.cpp
+ * @author Johan Simonsson
+ * @brief Time proportional output (slow PWM)
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TimeProportional.h"
+
+/**
+ * The default constructor, not active until a cycle is set.
+ */
+TimeProportional::TimeProportional()
+{
+    cycle    = 0;
+    slot     = 0;
+    duty     = 0;
+    dutyNext = 0;
+}
+
+/**
+ * How many slots shall one cycle be?
+ *
+ * This will restart the cycle.
+ *
+ * @param slots cycle length in slots, 0 will turn off the time proportional mode.
+ */
+void TimeProportional::setCycle(uint16_t slots)
+{
+    cycle = slots;
+
+    if(dutyNext > cycle)
+    {
+        dutyNext = cycle;
+    }
+    restart();
+}
+
+/**
+ * Get the cycle length.
+ *
+ * @return cycle length in slots
+ */
+uint16_t TimeProportional::getCycle()
+{
+    return cycle;
+}
+
+/**
+ * Is the time proportional mode active?
+ *
+ * @return true if there is a cycle configured
+ */
+bool TimeProportional::isActive()
+{
+    return (cycle != 0);
+}
+
+/**
+ * Start a new cycle now with the latest duty,
+ * i.e. when the output is turned on from off.
+ */
+void TimeProportional::restart()
+{
+    slot = 0;
+    duty = dutyNext;
+}
+
+/**
+ * How many slots of the next cycle shall the output be on?
+ *
+ * @param onSlots 0 is always off and cycle (or more) is always on.
+ */
+void TimeProportional::setDuty(uint16_t onSlots)
+{
+    if(onSlots > cycle)
+    {
+        onSlots = cycle;
+    }
+    dutyNext = onSlots;
+}
+
+/**
+ * Get the duty that is used in the current cycle.
+ *
+ * @return slots that is on in the current cycle.
+ */
+uint16_t TimeProportional::getDuty()
+{
+    return duty;
+}
+
+/**
+ * Time has passed, move to the next slot.
+ */
+void TimeProportional::nextSlot()
+{
+    if(0 == cycle)
+        return;
+
+    slot++;
+    if(slot >= cycle)
+    {
+        //New cycle, time to use the new duty
+        slot = 0;
+        duty = dutyNext;
+    }
+}
+
+/**
+ * Shall the output be on in this slot?
+ *
+ * The on slots comes first in the cycle,
+ * so the output turns on when a new cycle starts.
+ *
+ * @return true if on
+ */
+bool TimeProportional::getOut()
+{
+    return (slot < duty);
+}
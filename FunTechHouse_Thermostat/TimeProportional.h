@@ -0,0 +1,62 @@
+/**
+ * @file TimeProportional.h
+ * @author Johan Simonsson
+ * @brief Time proportional output (slow PWM)
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __TIMEPROPORTIONAL_H
+#define  __TIMEPROPORTIONAL_H
+
+#include <stdint.h>
+
+/**
+ * A slow PWM that turns a output on for "duty" slots out of "cycle" slots.
+ *
+ * A slot is one call to nextSlot(), so the cycle time in seconds
+ * is cycle*slotTime. Use long cycles (i.e. 60s) for contactors
+ * and short cycles (i.e. 1s) for solid state relays.
+ *
+ * A new duty is only used from the start of the next cycle,
+ * so the output will never toggle more than twice per cycle.
+ */
+class TimeProportional
+{
+    private:
+        uint16_t cycle;    ///< Number of slots in one cycle, 0 means not active.
+        uint16_t slot;     ///< The current slot in the cycle, 0..cycle-1
+        uint16_t duty;     ///< Slots that is on in the current cycle.
+        uint16_t dutyNext; ///< Slots that will be on in the next cycle.
+
+    public:
+        TimeProportional();
+
+        void setCycle(uint16_t slots);
+        uint16_t getCycle();
+        bool isActive();
+        void restart();
+
+        void setDuty(uint16_t onSlots);
+        uint16_t getDuty();
+
+        void nextSlot();
+        bool getOut();
+};
+
+#endif  // __TIMEPROPORTIONAL_H
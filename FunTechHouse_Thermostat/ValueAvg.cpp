@@ -52,7 +52,7 @@ void ValueAvg::addValue(double data)
         {
             higest = data;
         }
-        else if(data < smallest)
+        if(data < smallest)
         {
             smallest = data;
         }
@@ -0,0 +1,314 @@
+/**
+ * @file FakeOneWireBus.h
+ * @author Johan Simonsson
+ * @brief A OneWire bus with DS18B20 on byte level, for the tests
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __FAKEONEWIREBUS_H
+#define  __FAKEONEWIREBUS_H
+
+#include <string.h>
+
+#include "OneWireBus.h"
+#include "DS18B20Bus.h"
+
+#define FAKE_BUS_DEVICES_MAX 10
+
+/**
+ * A device on the fake bus.
+ */
+typedef struct
+{
+    uint8_t rom[8];     ///< ROM code
+    uint8_t scratch[9]; ///< Scratchpad
+    int16_t raw;        ///< Temperature after the next conversion, 1/16 degC
+    bool    broken;     ///< The scratchpad crc is wrong
+} FakeDevice;
+
+/**
+ * A OneWire bus on byte level, only what DS18B20Bus needs.
+ * The counters is there so the tests can see what was done on the bus.
+ */
+class FakeOneWireBus : public OneWireBus
+{
+    public:
+        FakeDevice dev[FAKE_BUS_DEVICES_MAX];
+        int devCount;
+
+        int selected;   ///< Selected device, -1 is all (skip), -2 after reset, -3 no match
+        uint8_t matchRom[8]; ///< The ROM code after Match ROM
+        int romPos;     ///< Next byte in matchRom, -1 is none
+        int readPos;    ///< Next byte in the scratchpad
+        int searchPos;  ///< Next device for search()
+        int writePos;   ///< Next byte in the scratchpad for Write Scratchpad, -1 is none
+
+        int resets;     ///< Reset pulses
+        int converts;   ///< Convert T to all devices
+        int selects;    ///< Match ROM
+        int writes;     ///< Write Scratchpad
+        int copies;     ///< Copy Scratchpad to all devices
+        int transfers;  ///< Calls to transfer()
+        int searches;   ///< Searches started
+        int busyCalls;  ///< A transfer is busy for this many getTransferState()
+        int busyLeft;   ///< How many more busy
+        bool powered;   ///< The bus is held high
+
+        FakeOneWireBus()
+        {
+            devCount = 0;
+            selected = -1;
+            romPos = -1;
+            readPos = 0;
+            searchPos = 0;
+            writePos = -1;
+            resets = 0;
+            converts = 0;
+            selects = 0;
+            writes = 0;
+            copies = 0;
+            transfers = 0;
+            searches = 0;
+            busyCalls = 0;
+            busyLeft = 0;
+            powered = false;
+        }
+
+        /**
+         * Add a device at a place in the search order,
+         * the scratchpad is the power on 85degC until the next conversion.
+         *
+         * @param pos the place, 0..devCount
+         * @param family the first byte of the ROM code
+         * @param serial the ROM code is serial+1, serial+2...
+         * @param raw the temperature after the next conversion, 1/16 degC
+         */
+        void insert(int pos, uint8_t family, uint8_t serial, int16_t raw)
+        {
+            memmove(&dev[pos+1], &dev[pos], (devCount - pos) * sizeof(FakeDevice));
+            devCount++;
+
+            FakeDevice* d = &dev[pos];
+            memset(d, 0, sizeof(FakeDevice));
+            d->rom[0] = family;
+            for( int i=1 ; i<7 ; i++ )
+            {
+                d->rom[i] = serial + i;
+            }
+            d->rom[7] = crc8(d->rom, 7);
+            d->raw = raw;
+            d->scratch[2] = 0x4B;
+            d->scratch[3] = 0x46;
+            setScratch(d, 85*16, 0x7F);
+        }
+
+        /**
+         * Add a device last in the search order.
+         */
+        void add(uint8_t family, uint8_t serial, int16_t raw = 85*16)
+        {
+            insert(devCount, family, serial, raw);
+        }
+
+        /**
+         * Take a device off the bus.
+         */
+        FakeDevice remove(int pos)
+        {
+            FakeDevice d = dev[pos];
+            devCount--;
+            memmove(&dev[pos], &dev[pos+1], (devCount - pos) * sizeof(FakeDevice));
+            return d;
+        }
+
+        /**
+         * The scratchpad after a conversion, TH and TL is kept.
+         */
+        static void setScratch(FakeDevice* d, int16_t raw, uint8_t cfg)
+        {
+            d->scratch[0] = raw & 0xFF;
+            d->scratch[1] = (raw >> 8) & 0xFF;
+            d->scratch[4] = cfg;
+            d->scratch[5] = 0xFF;
+            d->scratch[6] = 0x0C;
+            d->scratch[7] = 0x10;
+            d->scratch[8] = crc8(d->scratch, 8);
+        }
+
+        uint8_t reset()
+        {
+            resets++;
+            powered = false;
+            selected = -2;
+            readPos = 0;
+            writePos = -1;
+            romPos = -1;
+            return (devCount > 0) ? 1 : 0;
+        }
+
+        void write(uint8_t value, uint8_t power)
+        {
+            powered = (1 == power);
+            if(romPos >= 0)
+            {
+                matchRom[romPos++] = value;
+                if(8 == romPos)
+                {
+                    romPos = -1;
+                    select(matchRom);
+                }
+                return;
+            }
+            if(-2 == selected)
+            {
+                //The ROM command after the reset
+                if(ONEWIRE_CMD_MATCH_ROM == value)
+                {
+                    romPos = 0;
+                }
+                else if(ONEWIRE_CMD_SKIP_ROM == value)
+                {
+                    skip();
+                }
+                return;
+            }
+            if(writePos >= 0)
+            {
+                //TH, TL and config (not on a DS18S20)
+                FakeDevice* d = &dev[selected];
+                int last = (DS18B20_FAMILY_DS18S20 == d->rom[0]) ? 3 : 4;
+                if(writePos <= last)
+                {
+                    d->scratch[writePos++] = value;
+                    d->scratch[8] = crc8(d->scratch, 8);
+                }
+                return;
+            }
+            if( (DS18B20_CMD_WRITE_SCRATCH == value) && (selected >= 0) )
+            {
+                writes++;
+                writePos = 2;
+                return;
+            }
+            if( (DS18B20_CMD_COPY_SCRATCH == value) && (-1 == selected) )
+            {
+                copies++;
+            }
+            if( (DS18B20_CMD_CONVERT == value) && (-1 == selected) )
+            {
+                converts++;
+                for( int i=0 ; i<devCount ; i++ )
+                {
+                    setScratch(&dev[i], dev[i].raw, dev[i].scratch[4]);
+                }
+            }
+        }
+
+        uint8_t read()
+        {
+            if( (selected < 0) || (readPos >= 9) )
+            {
+                return 0xFF;
+            }
+            uint8_t value = dev[selected].scratch[readPos++];
+            if(dev[selected].broken && (0 == readPos-1))
+            {
+                value ^= 0x01;
+            }
+            return value;
+        }
+
+        void select(const uint8_t* rom)
+        {
+            selects++;
+            selected = -3;
+            for( int i=0 ; i<devCount ; i++ )
+            {
+                if(0 == memcmp(dev[i].rom, rom, 8))
+                {
+                    selected = i;
+                }
+            }
+        }
+
+        void skip()
+        {
+            selected = -1;
+        }
+
+        void depower()
+        {
+            powered = false;
+        }
+
+        void resetSearch()
+        {
+            searchPos = 0;
+        }
+
+        /**
+         * Done at once, but looks busy like a transfer in the background.
+         */
+        bool transfer(uint8_t flags, const uint8_t* tx, uint8_t txLen, uint8_t* rx, uint8_t rxLen)
+        {
+            transfers++;
+            busyLeft = busyCalls;
+            return OneWireBus::transfer(flags, tx, txLen, rx, rxLen);
+        }
+
+        uint8_t getTransferState()
+        {
+            if(busyLeft > 0)
+            {
+                busyLeft--;
+                return ONEWIRE_XFER_BUSY;
+            }
+            return OneWireBus::getTransferState();
+        }
+
+        /**
+         * The alarm flag, the whole degrees is compared with TH and TL.
+         */
+        static bool hasAlarm(const FakeDevice* d)
+        {
+            int16_t raw = (int16_t)(d->scratch[0] | (d->scratch[1] << 8));
+            int temp = raw >> 4;
+            return (temp >= (int8_t)d->scratch[2]) || (temp <= (int8_t)d->scratch[3]);
+        }
+
+        uint8_t search(uint8_t* rom, bool alarm)
+        {
+            if(0 == searchPos)
+            {
+                searches++;
+            }
+            while( (searchPos < devCount) && alarm && !hasAlarm(&dev[searchPos]) )
+            {
+                searchPos++;
+            }
+            if(searchPos >= devCount)
+            {
+                return 0;
+            }
+            memcpy(rom, dev[searchPos++].rom, 8);
+            return 1;
+        }
+};
+
+#endif  // __FAKEONEWIREBUS_H
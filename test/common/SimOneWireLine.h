@@ -0,0 +1,482 @@
+/**
+ * @file SimOneWireLine.h
+ * @author Johan Simonsson
+ * @brief A OneWire wire with DS18B20 on slot level, for the tests
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef  __SIMONEWIRELINE_H
+#define  __SIMONEWIRELINE_H
+
+#include <QtCore>
+#include <string.h>
+
+#include "OneWireEngine.h"
+#include "DS18B20Bus.h"
+
+#ifndef SIM_DEVICES_MAX
+#define SIM_DEVICES_MAX 64
+#endif
+
+#define SIM_MODE_IDLE     0 ///< Waits for a reset
+#define SIM_MODE_ROM      1 ///< Waits for the ROM command
+#define SIM_MODE_MATCH    2 ///< Match ROM, compares the ROM code
+#define SIM_MODE_FUNCTION 3 ///< Waits for the function command
+#define SIM_MODE_SEND     4 ///< Sends the scratchpad
+#define SIM_MODE_WRITE    5 ///< Write Scratchpad, TH, TL and config
+#define SIM_MODE_SEARCH   6 ///< Search ROM or Alarm Search
+
+/**
+ * A DS18B20 on the simulated bus.
+ */
+typedef struct
+{
+    uint8_t rom[8];     ///< ROM code
+    uint8_t scratch[9]; ///< Scratchpad
+    int16_t raw;        ///< Temperature after the next conversion, 1/16 degC
+    bool present;       ///< On the bus
+    bool crcFault;      ///< The scratchpad is sent with a bad crc
+
+    uint8_t mode;       ///< SIM_MODE_*
+    uint8_t inByte;     ///< The byte from the master
+    uint8_t inBits;     ///< Bits in inByte
+    uint8_t pos;        ///< Byte in the ROM code or scratchpad, bit in the ROM code for search
+    uint8_t sendBit;    ///< Next bit in the scratchpad
+    uint8_t searchStep; ///< 0 the bit, 1 the complement, 2 the direction
+    bool sending;       ///< This slot is a read slot for this device
+    uint8_t txBit;      ///< The bit in this read slot
+} SimDevice;
+
+/**
+ * A OneWire bus with many DS18B20 on slot level,
+ * every device follows the slots and the wire is low if any device pulls it.
+ *
+ * The conversion uses the resolution in the config register,
+ * and the undefined low bits is set to 1 (as the datasheet allows).
+ *
+ * The timing of the master is checked against the datasheet:
+ * - reset low >= 480us, the presence is 15-60us after and 60-240us long
+ * - a slot >= 60us and >= 1us between the slots
+ * - write 1 low 1-15us, write 0 low 60-120us
+ * - read, the master must sample within 15us from the start of the slot
+ * - the strong pull up within 10us after Convert T
+ *
+ * A slot outside that is counted in badSlots and no device gets a bit.
+ */
+class SimBus : public OneWireLine
+{
+    public:
+        SimDevice dev[SIM_DEVICES_MAX];
+        int count;
+
+        bool masterLow;     ///< The master has the wire low
+        uint32_t lowSince;  ///< The last falling edge
+        uint32_t highSince; ///< The last rising edge
+        uint32_t lastSlot;  ///< The start of the last slot, 0 after a reset
+        uint32_t presenceFrom; ///< The presence pulse
+        uint32_t presenceTo;   ///< The end of the presence pulse
+        bool anyPresent;    ///< A device answered the last reset
+        bool powered;       ///< The master drives the wire high
+
+        int resets;         ///< Reset pulses
+        int slotCount;      ///< Time slots
+        int badSlots;       ///< Slots with a bad low time
+        int converts;       ///< Convert T, counted once for every device
+        int copies;         ///< Copy Scratchpad, counted once for every device
+        uint32_t resetMin;  ///< Shortest reset pulse
+        uint32_t shortMin;  ///< Shortest write 1 or read low time
+        uint32_t shortMax;  ///< Longest write 1 or read low time
+        uint32_t zeroMin;   ///< Shortest write 0 low time
+        uint32_t zeroMax;   ///< Longest write 0 low time
+        uint32_t slotMin;   ///< Shortest time between two slots
+        uint32_t recoveryMin; ///< Shortest high time before a slot
+        uint32_t sampleMax; ///< Longest time from the slot start to a sample
+        uint32_t powerDelay;///< From the start of the last slot to the power
+
+        SimBus()
+        {
+            count = 0;
+            masterLow = false;
+            lowSince = 0;
+            highSince = 0;
+            lastSlot = 0;
+            presenceFrom = 0;
+            presenceTo = 0;
+            anyPresent = false;
+            powered = false;
+
+            resets = 0;
+            slotCount = 0;
+            badSlots = 0;
+            converts = 0;
+            copies = 0;
+            resetMin = 0xFFFFFFFF;
+            shortMin = 0xFFFFFFFF;
+            shortMax = 0;
+            zeroMin = 0xFFFFFFFF;
+            zeroMax = 0;
+            slotMin = 0xFFFFFFFF;
+            recoveryMin = 0xFFFFFFFF;
+            sampleMax = 0;
+            powerDelay = 0;
+        }
+
+        /**
+         * Add a device, the power on scratchpad (85degC, TH 75, TL 70, 12bit).
+         */
+        SimDevice* add(const uint8_t* serial)
+        {
+            SimDevice* d = &dev[count++];
+            memset(d, 0, sizeof(SimDevice));
+            d->rom[0] = DS18B20_FAMILY_DS18B20;
+            memcpy(&d->rom[1], serial, 6);
+            d->rom[7] = OneWireBus::crc8(d->rom, 7);
+            d->present = true;
+            d->raw = 85*16;
+            d->scratch[2] = 0x4B;
+            d->scratch[3] = 0x46;
+            d->scratch[4] = 0x7F;
+            setTemp(d, d->raw);
+            d->mode = SIM_MODE_IDLE;
+            return d;
+        }
+
+        /**
+         * Add many devices with pseudo random serial numbers.
+         */
+        void addMany(int n, uint32_t seed)
+        {
+            for( int i=0 ; i<n ; i++ )
+            {
+                uint8_t serial[6];
+                for( int j=0 ; j<6 ; j++ )
+                {
+                    seed = seed*1103515245 + 12345;
+                    serial[j] = (seed >> 16) & 0xFF;
+                }
+                serial[5] = i; // Unique
+                add(serial);
+            }
+        }
+
+        static int resolution(const SimDevice* d)
+        {
+            return 9 + ((d->scratch[4] >> 5) & 0x03);
+        }
+
+        static void setTemp(SimDevice* d, int16_t value)
+        {
+            int16_t undefined = (1 << (12 - resolution(d))) - 1;
+            value = (value & ~undefined) | undefined;
+
+            d->scratch[0] = value & 0xFF;
+            d->scratch[1] = (value >> 8) & 0xFF;
+            d->scratch[5] = 0xFF;
+            d->scratch[6] = 0x0C;
+            d->scratch[7] = 0x10;
+            d->scratch[8] = OneWireBus::crc8(d->scratch, 8);
+        }
+
+        static bool hasAlarm(const SimDevice* d)
+        {
+            int16_t value = (int16_t)(d->scratch[0] | (d->scratch[1] << 8));
+            int temp = value >> 4;
+            return (temp >= (int8_t)d->scratch[2]) || (temp <= (int8_t)d->scratch[3]);
+        }
+
+        static uint8_t romBit(const SimDevice* d)
+        {
+            return (d->rom[d->pos >> 3] >> (d->pos & 7)) & 0x01;
+        }
+
+        static uint8_t scratchBit(const SimDevice* d)
+        {
+            uint8_t value = d->scratch[d->sendBit >> 3];
+            if( d->crcFault && (8 == (d->sendBit >> 3)) )
+            {
+                value ^= 0x01;
+            }
+            return (value >> (d->sendBit & 7)) & 0x01;
+        }
+
+        void handleByte(SimDevice* d, uint8_t value)
+        {
+            if(SIM_MODE_ROM == d->mode)
+            {
+                d->mode = SIM_MODE_IDLE;
+                if(ONEWIRE_CMD_SKIP_ROM == value)
+                {
+                    d->mode = SIM_MODE_FUNCTION;
+                }
+                else if(ONEWIRE_CMD_MATCH_ROM == value)
+                {
+                    d->mode = SIM_MODE_MATCH;
+                    d->pos = 0;
+                }
+                else if( (ONEWIRE_CMD_SEARCH_ROM == value) ||
+                         ((ONEWIRE_CMD_ALARM_SEARCH == value) && hasAlarm(d)) )
+                {
+                    d->mode = SIM_MODE_SEARCH;
+                    d->pos = 0;
+                    d->searchStep = 0;
+                }
+            }
+            else if(SIM_MODE_MATCH == d->mode)
+            {
+                if(value != d->rom[d->pos++])
+                {
+                    d->mode = SIM_MODE_IDLE;
+                }
+                else if(8 == d->pos)
+                {
+                    d->mode = SIM_MODE_FUNCTION;
+                }
+            }
+            else if(SIM_MODE_FUNCTION == d->mode)
+            {
+                d->mode = SIM_MODE_IDLE;
+                if(DS18B20_CMD_CONVERT == value)
+                {
+                    converts++;
+                    setTemp(d, d->raw);
+                }
+                else if(DS18B20_CMD_READ_SCRATCH == value)
+                {
+                    d->mode = SIM_MODE_SEND;
+                    d->sendBit = 0;
+                }
+                else if(DS18B20_CMD_WRITE_SCRATCH == value)
+                {
+                    d->mode = SIM_MODE_WRITE;
+                    d->pos = 2;
+                }
+                else if(DS18B20_CMD_COPY_SCRATCH == value)
+                {
+                    copies++;
+                }
+            }
+            else if(SIM_MODE_WRITE == d->mode)
+            {
+                d->scratch[d->pos++] = value;
+                d->scratch[8] = OneWireBus::crc8(d->scratch, 8);
+                if(d->pos > 4)
+                {
+                    d->mode = SIM_MODE_IDLE;
+                }
+            }
+        }
+
+        void receiveBit(SimDevice* d, uint8_t bit)
+        {
+            if(SIM_MODE_IDLE == d->mode)
+            {
+                return;
+            }
+            if(SIM_MODE_SEARCH == d->mode)
+            {
+                //The direction, the devices with the other bit is out
+                if(bit != romBit(d))
+                {
+                    d->mode = SIM_MODE_IDLE;
+                    return;
+                }
+                d->pos++;
+                d->searchStep = 0;
+                if(64 == d->pos)
+                {
+                    d->mode = SIM_MODE_IDLE;
+                }
+                return;
+            }
+
+            d->inByte |= bit << d->inBits;
+            d->inBits++;
+            if(8 == d->inBits)
+            {
+                handleByte(d, d->inByte);
+                d->inByte = 0;
+                d->inBits = 0;
+            }
+        }
+
+        void slotStart(SimDevice* d)
+        {
+            d->sending = false;
+            if(SIM_MODE_SEND == d->mode)
+            {
+                d->sending = true;
+                d->txBit = scratchBit(d);
+            }
+            else if( (SIM_MODE_SEARCH == d->mode) && (d->searchStep < 2) )
+            {
+                d->sending = true;
+                d->txBit = (0 == d->searchStep) ? romBit(d) : !romBit(d);
+            }
+        }
+
+        void slotDone(SimDevice* d)
+        {
+            if(SIM_MODE_SEND == d->mode)
+            {
+                d->sendBit++;
+                if(9*8 == d->sendBit)
+                {
+                    d->mode = SIM_MODE_IDLE;
+                }
+            }
+            else if(SIM_MODE_SEARCH == d->mode)
+            {
+                d->searchStep++;
+            }
+        }
+
+        /**
+         * The end of a slot, with the low time from the master.
+         */
+        void slotEnd(uint32_t width)
+        {
+            bool anySending = false;
+            for( int i=0 ; i<count ; i++ )
+            {
+                anySending |= dev[i].sending;
+            }
+
+            slotCount++;
+            lastSlot = lowSince;
+            if( (width >= 1) && (width < 15) )
+            {
+                shortMin = qMin(shortMin, width);
+                shortMax = qMax(shortMax, width);
+                for( int i=0 ; i<count ; i++ )
+                {
+                    if(dev[i].sending)
+                    {
+                        slotDone(&dev[i]);
+                    }
+                    else
+                    {
+                        receiveBit(&dev[i], 1);
+                    }
+                }
+            }
+            else if( (width >= 60) && (width <= 120) && !anySending )
+            {
+                zeroMin = qMin(zeroMin, width);
+                zeroMax = qMax(zeroMax, width);
+                for( int i=0 ; i<count ; i++ )
+                {
+                    receiveBit(&dev[i], 0);
+                }
+            }
+            else
+            {
+                badSlots++;
+            }
+        }
+
+        void drive(uint32_t us, uint8_t level)
+        {
+            if(ONEWIRE_LINE_LOW == level)
+            {
+                if(masterLow)
+                {
+                    return;
+                }
+                if( (0 != lastSlot) && (us - highSince < recoveryMin) )
+                {
+                    recoveryMin = us - highSince;
+                }
+                if( (0 != lastSlot) && (us - lastSlot < slotMin) )
+                {
+                    slotMin = us - lastSlot;
+                }
+                masterLow = true;
+                powered = false;
+                lowSince = us;
+                for( int i=0 ; i<count ; i++ )
+                {
+                    slotStart(&dev[i]);
+                }
+                return;
+            }
+
+            if(masterLow)
+            {
+                uint32_t width = us - lowSince;
+                masterLow = false;
+                highSince = us;
+
+                if(width >= 480)
+                {
+                    resets++;
+                    resetMin = qMin(resetMin, width);
+                    lastSlot = 0;
+                    anyPresent = false;
+                    for( int i=0 ; i<count ; i++ )
+                    {
+                        SimDevice* d = &dev[i];
+                        d->sending = false;
+                        d->inByte = 0;
+                        d->inBits = 0;
+                        d->mode = d->present ? SIM_MODE_ROM : SIM_MODE_IDLE;
+                        anyPresent |= d->present;
+                    }
+                    presenceFrom = us + 30;
+                    presenceTo   = us + 150;
+                }
+                else
+                {
+                    slotEnd(width);
+                }
+            }
+
+            powered = (ONEWIRE_LINE_POWER == level);
+            if(powered)
+            {
+                powerDelay = us - lowSince;
+            }
+        }
+
+        uint8_t sample(uint32_t us)
+        {
+            if(masterLow)
+            {
+                return 0;
+            }
+            if( anyPresent && (us >= presenceFrom) && (us < presenceTo) )
+            {
+                return 0;
+            }
+            uint8_t level = 1;
+            for( int i=0 ; i<count ; i++ )
+            {
+                if(dev[i].sending)
+                {
+                    sampleMax = qMax(sampleMax, us - lowSince);
+                    if( (0 == dev[i].txBit) && (us - lowSince < 30) )
+                    {
+                        level = 0;
+                    }
+                }
+            }
+            return level;
+        }
+};
+
+#endif  // __SIMONEWIRELINE_H
@@ -0,0 +1 @@
+../../FunTechHouse_Thermostat/MQTT_Logic.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../FunTechHouse_Thermostat/MQTT_Logic.h
\ No newline at end of file
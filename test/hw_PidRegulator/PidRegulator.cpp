@@ -0,0 +1 @@
+../../FunTechHouse_Thermostat/PidRegulator.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../FunTechHouse_Thermostat/PidRegulator.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../FunTechHouse_Thermostat/Regulator.cpp
\ No newline at end of file
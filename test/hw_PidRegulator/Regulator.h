@@ -0,0 +1 @@
+../../FunTechHouse_Thermostat/Regulator.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../FunTechHouse_Thermostat/StringHelp.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../FunTechHouse_Thermostat/StringHelp.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../FunTechHouse_Thermostat/TimeProportional.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../FunTechHouse_Thermostat/TimeProportional.h
\ No newline at end of file
@@ -0,0 +1,60 @@
+/**
+ * @file hw_PidRegulator.ino
+ * @author Johan Simonsson
+ * @brief Benchmark for PidRegulator, cycles per update on the AVR
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PidRegulator.h"
+
+#define UPDATE_CNT 1000
+
+PidRegulator pid(3, THERMOSTAT_TYPE_BIN_CNT);
+
+void setup() {
+    Serial.begin(9600);
+    Serial.println("PidRegulator benchmark!");
+
+    pid.setSetpoint(50.0);
+    pid.setTuning(10.0, 0.1, 5.0);
+    pid.setCycleTime(600);
+}
+
+void loop() {
+    double value = 40.0;
+
+    unsigned long start = micros();
+    for( int i=0 ; i<UPDATE_CNT ; i++ )
+    {
+        pid.valueTimeToSend(value);
+        value += 0.01;
+    }
+    unsigned long time = micros()-start;
+
+    //micros() has 4us resolution, but that is ok over many updates.
+    unsigned long cycles = (time * (F_CPU/1000000UL)) / UPDATE_CNT;
+
+    Serial.print("Update: ");
+    Serial.print(time/UPDATE_CNT);
+    Serial.print("us ");
+    Serial.print(cycles);
+    Serial.println(" cycles");
+
+    delay(1000);
+}
@@ -0,0 +1,299 @@
+/**
+ * @file TestAnalogSensor.cpp
+ * @author Johan Simonsson
+ * @brief Testfile and table generator for AnalogSensor
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "AnalogSensor.h"
+#include "LVTS.h"
+
+class TestAnalogSensor : public QObject
+{
+    Q_OBJECT
+
+    private:
+    public:
+
+    private slots:
+        void test_ntcTable();
+        void test_ntcAccuracy();
+        void test_polynomial();
+        void test_oversampled();
+        void test_calibration();
+        void test_convert();
+};
+
+/**
+ * The NTC divider, 10k B3950 from GND to the input and 33k to 5V.
+ * The adc has the internal 1.1V reference.
+ */
+#define NTC_R25     10000.0
+#define NTC_BETA     3950.0
+#define NTC_RSERIES 33000.0
+#define NTC_SUPPLY      5.0
+#define NTC_AREF        1.1
+#define NTC_MAX       125.0
+
+/**
+ * Steinhart-Hart, 1/T = A + B*ln(R) + C*ln(R)^3.
+ * The coefficients is from R25 and B (then C is 0),
+ * put the ones from the datasheet here for a better fit.
+ */
+static const double shA = (1.0/298.15) - (log(NTC_R25)/NTC_BETA);
+static const double shB = 1.0/NTC_BETA;
+static const double shC = 0.0;
+
+/**
+ * The NTC temperature for a reading (with decimals).
+ *
+ * @param reading 10bit reading
+ * @return degC, or 1000 if there is no answer
+ */
+static double ntc(double reading)
+{
+    double volt = (reading*NTC_AREF)/1024.0;
+    if(volt <= 0.0)
+    {
+        return 1000.0;
+    }
+    double r = (NTC_RSERIES*volt)/(NTC_SUPPLY-volt);
+    double lnR = log(r);
+    return (1.0/(shA + shB*lnR + shC*lnR*lnR*lnR)) - 273.15;
+}
+
+/**
+ * A amplified PT1000, 0..150 degC is 0..1V (1.1V reference).
+ * The inverse of Callendar-Van Dusen as a polynomial.
+ *
+ * @param reading 10bit reading
+ * @return degC
+ */
+static double poly(double reading)
+{
+    double x = (reading*NTC_AREF)/1024.0;
+    return -0.05 + 148.2*x + 1.9*x*x;
+}
+
+/**
+ * Make a segment table, the points is put as far apart as possible
+ * and the interpolation is still within tol from the real curve.
+ *
+ * @param curve the real curve
+ * @param first the first valid reading
+ * @param last the last valid reading
+ * @param tol max error in 0.01 degC
+ * @param table [out] the points
+ */
+static void makeTable(double (*curve)(double), int first, int last, double tol, QVector<AnalogPoint>& table)
+{
+    AnalogPoint p;
+    p.reading = first;
+    p.centi   = (int16_t)floor(curve(first)*100 + 0.5);
+    table.append(p);
+
+    int start = first;
+    while(start < last)
+    {
+        //Try longer and longer segments
+        int end = start+1;
+        while(end < last)
+        {
+            int next = end+1;
+            double y0 = floor(curve(start)*100 + 0.5);
+            double y1 = floor(curve(next)*100 + 0.5);
+            bool fit = true;
+            for( int x=start ; x<=next ; x++ )
+            {
+                double y = y0 + ((y1-y0)*(x-start))/(next-start);
+                if(fabs(y - curve(x)*100) > tol)
+                {
+                    fit = false;
+                    break;
+                }
+            }
+            if(!fit)
+            {
+                break;
+            }
+            end = next;
+        }
+
+        p.reading = end;
+        p.centi   = (int16_t)floor(curve(end)*100 + 0.5);
+        table.append(p);
+        start = end;
+    }
+}
+
+/**
+ * The segment table for the NTC, from where it is below NTC_MAX to the end.
+ */
+static void makeNtcTable(QVector<AnalogPoint>& table)
+{
+    int first = 1;
+    while(ntc(first) > NTC_MAX)
+    {
+        first++;
+    }
+    makeTable(ntc, first, 1023, 5.0, table);
+}
+
+void TestAnalogSensor::test_ntcTable()
+{
+    QVector<AnalogPoint> table;
+    makeNtcTable(table);
+
+    //ANALOG_TABLE=ntc10k prints the table for AnalogSensor.cpp
+    const char* print = getenv("ANALOG_TABLE");
+    if( (NULL != print) && (0 == strcmp(print, "ntc10k")) )
+    {
+        for( int i=0 ; i<table.size() ; i++ )
+        {
+            printf("    { %4d, %6d },\n", table.at(i).reading, table.at(i).centi);
+        }
+    }
+
+    //The table in flash must be the same as the one made here
+    QCOMPARE((int)analogNtc10kSize, table.size());
+    for( int i=0 ; i<table.size() ; i++ )
+    {
+        QCOMPARE(analogNtc10k[i].reading, table.at(i).reading);
+        QCOMPARE(analogNtc10k[i].centi, table.at(i).centi);
+    }
+}
+
+void TestAnalogSensor::test_ntcAccuracy()
+{
+    double worst = 0;
+    for( int read=0 ; read<=1023 ; read++ )
+    {
+        bool ok = false;
+        int16_t centi = AnalogSensor::interpolate(analogNtc10k, analogNtc10kSize, read, &ok);
+        if(ntc(read) > NTC_MAX)
+        {
+            QVERIFY(!ok);
+            continue;
+        }
+        QVERIFY(ok);
+        worst = qMax(worst, fabs(centi - ntc(read)*100));
+    }
+    printf("NTC 10k, %d points, worst error %.3f degC\n", analogNtc10kSize, worst/100);
+    QVERIFY(worst < 6.0);
+}
+
+void TestAnalogSensor::test_polynomial()
+{
+    QVector<AnalogPoint> table;
+    makeTable(poly, 0, 1000, 2.0, table);
+    QVERIFY(table.size() < 20);
+
+    //The host has no PROGMEM, so the table can be used from RAM here
+    AnalogSensor analog;
+    analog.setCurve(table.data(), table.size());
+    for( int read=0 ; read<=1023 ; read++ )
+    {
+        bool ok = false;
+        int16_t centi = analog.convert(Sensor::ANALOG_CURVE, read, &ok);
+        if(read > 1000)
+        {
+            QVERIFY(!ok);
+            continue;
+        }
+        QVERIFY(ok);
+        QVERIFY(fabs(centi - poly(read)*100) < 3.0);
+    }
+}
+
+void TestAnalogSensor::test_oversampled()
+{
+    for( long read=(300L<<2) ; read<=(1023L<<2) ; read++ )
+    {
+        bool ok = false;
+        int16_t centi = AnalogSensor::interpolate(analogNtc10k, analogNtc10kSize, read, &ok, 2);
+        QVERIFY(ok);
+        QVERIFY(fabs(centi - ntc(read/4.0)*100) < 6.0);
+    }
+
+    //The table ends at 1023, and that is the top with 2 extra bits as well
+    bool ok = true;
+    AnalogSensor::interpolate(analogNtc10k, analogNtc10kSize, (1023<<2)+1, &ok, 2);
+    QVERIFY(!ok);
+}
+
+void TestAnalogSensor::test_calibration()
+{
+    AnalogSensor analog;
+    QCOMPARE((int)analog.calibrate(5000), 5000);
+
+    //Reads 0.5 too high at 0degC and 1.0 too low at 100degC
+    QVERIFY(analog.setCalibration(50, 0, 9900, 10000));
+    QCOMPARE((int)analog.calibrate(50), 0);
+    QCOMPARE((int)analog.calibrate(9900), 10000);
+    QCOMPARE((int)analog.calibrate(4975), 5000);
+    QVERIFY(analog.calibrate(-1000) < -1000);
+
+    //Bad gain is not used
+    QVERIFY(!analog.setCalibration(0, 0, 1000, 3000));
+    QVERIFY(!analog.setCalibration(1000, 0, 1000, 3000));
+    QCOMPARE((int)analog.calibrate(9900), 10000);
+
+    analog.clearCalibration();
+    QCOMPARE((int)analog.calibrate(9900), 9900);
+}
+
+void TestAnalogSensor::test_convert()
+{
+    AnalogSensor analog;
+    bool ok = false;
+    bool okLvts = false;
+
+    //LM35 and LM34 is the same as LVTS
+    for( int read=0 ; read<=1023 ; read+=7 )
+    {
+        QCOMPARE(analog.convert(Sensor::LM35DZ, read, &ok), LVTS::lm35Centi(read, &okLvts));
+        QCOMPARE(ok, okLvts);
+        QCOMPARE(analog.convert(Sensor::LM34DZ, read, &ok), LVTS::lm34Centi(read, &okLvts));
+        QCOMPARE(ok, okLvts);
+    }
+
+    int16_t centi = analog.convert(Sensor::NTC_10K, 500, &ok);
+    QVERIFY(ok);
+    QVERIFY(fabs(centi - ntc(500)*100) < 6.0);
+
+    //The calibration is used for all types
+    QVERIFY(analog.setCalibration(0, 100, 10000, 10100));
+    QCOMPARE((int)analog.convert(Sensor::LM35DZ, 279, &ok), LVTS::lm35Centi(279, &okLvts) + 100);
+
+    //Not analog, or no curve
+    analog.convert(Sensor::DS18B20, 500, &ok);
+    QVERIFY(!ok);
+    analog.convert(Sensor::ANALOG_CURVE, 500, &ok);
+    QVERIFY(!ok);
+}
+
+QTEST_MAIN(TestAnalogSensor)
+#include "TestAnalogSensor.moc"
@@ -0,0 +1,314 @@
+/**
+ * @file TestDHTSensor.cpp
+ * @author Johan Simonsson
+ * @brief Testfile for DHTSensor
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+#include <string.h>
+
+#include "DHTSensor.h"
+#include "TemperatureSensor.h"
+
+/**
+ * Poll until the pin is released, then the falling edges of a frame
+ * like the sensor sends it, and poll until it is decoded.
+ *
+ * @param dht the sensor
+ * @param data the 5 bytes, the checksum is done here
+ * @param edges how many edges the interrupt gets
+ */
+static void sendFrame(DHTSensor* dht, const uint8_t* data, int edges = DHT_EDGES)
+{
+    int polls = 0;
+    while( (DHT_STATE_CAPTURE != dht->state) && (polls++ < 1000) )
+    {
+        dht->poll(10);
+    }
+
+    uint8_t frame[5];
+    memcpy(frame, data, 4);
+    frame[4] = data[0] + data[1] + data[2] + data[3];
+
+    //The times wraps around, only the difference is used
+    uint16_t us = 65500;
+    int sent = 0;
+    if(sent++ < edges)
+    {
+        dht->fall(us); // Response, 80us low
+    }
+    us += 160;
+    if(sent++ < edges)
+    {
+        dht->fall(us); // And 80us high
+    }
+    for( int i=0 ; i<40 ; i++ )
+    {
+        bool one = frame[i/8] & (0x80 >> (i%8));
+        us += one ? 120 : 77;
+        if(sent++ < edges)
+        {
+            dht->fall(us);
+        }
+    }
+
+    //Decoded at once, or after DHT_TIMEOUT if a edge is lost
+    polls = 0;
+    while( dht->isBusy() && (polls++ < 10) )
+    {
+        dht->poll(10);
+    }
+}
+
+class TestDHTSensor : public QObject
+{
+    Q_OBJECT
+
+    private:
+    public:
+
+    private slots:
+        void test_poll();
+        void test_dht22();
+        void test_dht22_data();
+        void test_dht11();
+        void test_errors();
+        void test_oneAtATime();
+        void test_temperatureSensor();
+};
+
+void TestDHTSensor::test_poll()
+{
+    DHTSensor dht(8, Sensor::DHT_11);
+    dht.begin();
+
+    //The first read after DHT_INTERVAL
+    for( int i=0 ; i<(DHT_INTERVAL/10)-1 ; i++ )
+    {
+        dht.poll(10);
+        QVERIFY(!dht.isBusy());
+    }
+    dht.poll(10);
+    QCOMPARE((int)dht.state, DHT_STATE_START);
+
+    //18ms low for the DHT11
+    dht.poll(10);
+    QCOMPARE((int)dht.state, DHT_STATE_START);
+    dht.poll(10);
+    QCOMPARE((int)dht.state, DHT_STATE_CAPTURE);
+
+    //No answer, stop after DHT_TIMEOUT
+    dht.poll(10);
+    QVERIFY(dht.isBusy());
+    dht.poll(10);
+    QVERIFY(!dht.isBusy());
+    bool ok = true;
+    dht.getTemperature(&ok);
+    QVERIFY(!ok);
+
+    //The DHT22 is 1ms
+    DHTSensor fast(8, Sensor::DHT_22);
+    fast.begin();
+    fast.poll(DHT_INTERVAL);
+    QCOMPARE((int)fast.state, DHT_STATE_START);
+    fast.poll(10);
+    QCOMPARE((int)fast.state, DHT_STATE_CAPTURE);
+    fast.poll(DHT_TIMEOUT);
+    QVERIFY(!fast.isBusy());
+}
+
+void TestDHTSensor::test_dht22_data()
+{
+    QTest::addColumn<int>("hum");
+    QTest::addColumn<int>("temp");
+
+    QTest::newRow("warm") << 652 << 235;
+    QTest::newRow("zero") << 0 << 0;
+    QTest::newRow("negative") << 1000 << -101;
+    QTest::newRow("cold") << 305 << -400;
+    QTest::newRow("hot") << 12 << 800;
+}
+
+void TestDHTSensor::test_dht22()
+{
+    QFETCH(int, hum);
+    QFETCH(int, temp);
+
+    DHTSensor dht(8, Sensor::DHT_22);
+    dht.begin();
+
+    uint16_t t = (temp < 0) ? (0x8000 | -temp) : temp;
+    uint8_t data[4] = { (uint8_t)(hum >> 8), (uint8_t)hum, (uint8_t)(t >> 8), (uint8_t)t };
+    sendFrame(&dht, data);
+    QVERIFY(!dht.isBusy());
+
+    bool ok = false;
+    QCOMPARE((int)dht.getHumidity(&ok), hum*10);
+    QVERIFY(ok);
+    QCOMPARE((int)dht.getTemperature(&ok), temp*10);
+    QVERIFY(ok);
+}
+
+void TestDHTSensor::test_dht11()
+{
+    DHTSensor dht(8, Sensor::DHT_11);
+    dht.begin();
+
+    uint8_t data[4] = { 45, 0, 22, 0 };
+    sendFrame(&dht, data);
+
+    bool ok = false;
+    QCOMPARE((int)dht.getHumidity(&ok), 4500);
+    QVERIFY(ok);
+    QCOMPARE((int)dht.getTemperature(&ok), 2200);
+
+    //The newer has tenths
+    uint8_t tenths[4] = { 45, 3, 22, 7 };
+    sendFrame(&dht, tenths);
+    QCOMPARE((int)dht.getHumidity(&ok), 4530);
+    QCOMPARE((int)dht.getTemperature(&ok), 2270);
+}
+
+void TestDHTSensor::test_errors()
+{
+    DHTSensor dht(8, Sensor::DHT_22);
+    dht.begin();
+
+    uint8_t data[4] = { 0x02, 0x8C, 0x00, 0xEB };
+    sendFrame(&dht, data);
+    bool ok = false;
+    QCOMPARE((int)dht.getTemperature(&ok), 2350);
+
+    //A lost edge, a bad checksum and out of range keeps the last value
+    sendFrame(&dht, data, DHT_EDGES-1);
+    QCOMPARE((int)dht.getTemperature(&ok), 2350);
+    QVERIFY(ok);
+
+    dht.edgeCount = 0;
+    int polls = 0;
+    while( (DHT_STATE_CAPTURE != dht.state) && (polls++ < 1000) )
+    {
+        dht.poll(10);
+    }
+    for( int i=0 ; i<DHT_EDGES ; i++ )
+    {
+        dht.fall(i*100); // All 1, bad checksum
+    }
+    dht.poll(10);
+    QCOMPARE((int)dht.getTemperature(&ok), 2350);
+    QVERIFY(ok);
+
+    uint8_t hot[4] = { 0x02, 0x8C, 0x03, 0x21 }; // 80.1 degC
+    sendFrame(&dht, hot);
+    dht.getTemperature(&ok);
+    QVERIFY(!ok);
+
+    //And is back after a good read
+    sendFrame(&dht, data);
+    QCOMPARE((int)dht.getHumidity(&ok), 6520);
+    QVERIFY(ok);
+}
+
+void TestDHTSensor::test_oneAtATime()
+{
+    DHTSensor a(7, Sensor::DHT_22);
+    DHTSensor b(8, Sensor::DHT_22);
+    a.begin();
+    b.begin();
+
+    //Both wants to read, b waits for the interrupt
+    a.poll(DHT_INTERVAL);
+    b.poll(DHT_INTERVAL);
+    QVERIFY(a.isBusy());
+    QVERIFY(!b.isBusy());
+
+    uint8_t data[4] = { 0x01, 0x00, 0x00, 0x64 };
+    sendFrame(&a, data);
+    QVERIFY(!a.isBusy());
+    b.poll(10);
+    QVERIFY(b.isBusy());
+    a.poll(DHT_INTERVAL);
+    QVERIFY(!a.isBusy());
+    sendFrame(&b, data);
+
+    bool ok = false;
+    QCOMPARE((int)a.getTemperature(&ok), 1000);
+    QCOMPARE((int)b.getTemperature(&ok), 1000);
+    QVERIFY(ok);
+}
+
+void TestDHTSensor::test_temperatureSensor()
+{
+    DHTSensor dht(8, Sensor::DHT_22);
+    dht.begin();
+
+    TemperatureSensor sensor;
+    sensor.setSensor(TemperatureSensor::DHT_22, 8);
+    sensor.setDiffToSend(1.0);
+    sensor.setHumidityDiffToSend(2.0);
+
+    bool ok = true;
+    sensor.readDHT(&ok);
+    QVERIFY(!ok);
+    sensor.setDHT(&dht);
+    sensor.readDHT(&ok);
+    QVERIFY(!ok);
+
+    uint8_t data[4] = { 0x01, 0xC2, 0x00, 0xD7 }; // 45.0% 21.5degC
+    sendFrame(&dht, data);
+    QCOMPARE((int)sensor.readDHT(&ok), 2150);
+    QVERIFY(ok);
+
+    char str[60];
+    QVERIFY(sensor.valueTimeToSend(21.5));
+    QVERIFY(sensor.getValueString(str, sizeof(str)));
+    QCOMPARE(str, "temperature=21.50 ; humidity=45.00");
+    sensor.valueIsSent();
+
+    //The humidity has its own diff
+    uint8_t wet[4] = { 0x01, 0xD6, 0x00, 0xD7 }; // 47.0%
+    sendFrame(&dht, wet);
+    QVERIFY(!sensor.valueTimeToSend(21.5));
+    uint8_t wetter[4] = { 0x01, 0xD7, 0x00, 0xD7 }; // 47.1%
+    sendFrame(&dht, wetter);
+    QVERIFY(sensor.valueTimeToSend(21.5));
+    sensor.valueIsSent();
+    QVERIFY(!sensor.valueTimeToSend(21.5));
+
+    //The DHT is polled and read like any other sensor
+    sensor.readPoll(DHT_INTERVAL);
+    QVERIFY(dht.isBusy());
+    sendFrame(&dht, data);
+    sensor.readStart();
+    QCOMPARE((int)sensor.readResult(&ok), 2150);
+    QVERIFY(ok);
+
+    //No humidity without the DHT
+    TemperatureSensor other;
+    other.setSensor(TemperatureSensor::LM35DZ, 14);
+    other.setDHT(&dht);
+    other.valueTimeToSend(21.5);
+    QVERIFY(other.getValueString(str, sizeof(str)));
+    QCOMPARE(str, "temperature=21.50");
+}
+
+QTEST_MAIN(TestDHTSensor)
+#include "TestDHTSensor.moc"
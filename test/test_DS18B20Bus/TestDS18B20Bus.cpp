@@ -0,0 +1,641 @@
+/**
+ * @file TestDS18B20Bus.cpp
+ * @author Johan Simonsson
+ * @brief Testfile for DS18B20Bus
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+#include <string.h>
+
+#include "DS18B20Bus.h"
+#include "DS18B20Group.h"
+#include "../common/FakeOneWireBus.h"
+
+/**
+ * The transfers on all named buses, like "Ar Br AC BC".
+ */
+static QString transferLog;
+
+/**
+ * The fake bus with a name, so the transfers on many buses can be logged.
+ */
+class FakeBus : public FakeOneWireBus
+{
+    public:
+        char name;      ///< The name in transferLog, 0 is not logged
+
+        FakeBus()
+        {
+            name = 0;
+        }
+
+        bool transfer(uint8_t flags, const uint8_t* tx, uint8_t txLen, uint8_t* rx, uint8_t rxLen)
+        {
+            if(name)
+            {
+                //r read, w write, C convert and P copy
+                char kind = 'P';
+                if(ONEWIRE_CMD_MATCH_ROM == tx[0])
+                {
+                    kind = (DS18B20_CMD_READ_SCRATCH == tx[9]) ? 'r' : 'w';
+                }
+                else if(DS18B20_CMD_CONVERT == tx[1])
+                {
+                    kind = 'C';
+                }
+                if(!transferLog.isEmpty())
+                {
+                    transferLog += " ";
+                }
+                transferLog += QString(name) + kind;
+            }
+            return FakeOneWireBus::transfer(flags, tx, txLen, rx, rxLen);
+        }
+};
+
+class TestDS18B20Bus : public QObject
+{
+    Q_OBJECT
+
+    private:
+    public:
+
+    private slots:
+        void test_crc8();
+        void test_begin();
+        void test_tick();
+        void test_errors();
+        void test_toRaw();
+        void test_noBus();
+        void test_alarmWrite();
+        void test_alarmSearch();
+        void test_alarmLost();
+        void test_resolution();
+        void test_poll();
+        void test_background();
+        void test_group();
+        void test_groupPoll();
+};
+
+void TestDS18B20Bus::test_crc8()
+{
+    //The example from Maxim AN27
+    uint8_t rom[8] = { 0x02, 0x1C, 0xB8, 0x01, 0x00, 0x00, 0x00, 0xA2 };
+    QCOMPARE((int)OneWireBus::crc8(rom, 7), 0xA2);
+    QCOMPARE((int)OneWireBus::crc8(rom, 8), 0);
+}
+
+void TestDS18B20Bus::test_begin()
+{
+    FakeBus bus;
+    bus.add(DS18B20_FAMILY_DS18B20, 0x10);
+    bus.add(0x01, 0x20);                   // DS2401, not a sensor
+    bus.add(DS18B20_FAMILY_DS18B20, 0x30);
+    bus.add(DS18B20_FAMILY_DS18S20, 0x40);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x50);
+    bus.dev[4].rom[7] ^= 0xFF;             // Bad crc
+
+    DS18B20Bus ds(&bus);
+    QCOMPARE((int)ds.begin(), 3);
+    QCOMPARE((int)ds.getCount(), 3);
+    QVERIFY(0 == memcmp(ds.getRom(0), bus.dev[0].rom, 8));
+    QVERIFY(0 == memcmp(ds.getRom(1), bus.dev[2].rom, 8));
+    QVERIFY(0 == memcmp(ds.getRom(2), bus.dev[3].rom, 8));
+    QVERIFY(NULL == ds.getRom(3));
+
+    QCOMPARE((int)ds.findRom(bus.dev[2].rom), 1);
+    QCOMPARE((int)ds.findRom(bus.dev[1].rom), -1);
+
+    //More devices than DS18B20_DEVICES_MAX
+    FakeBus full;
+    for( int i=0 ; i<DS18B20_DEVICES_MAX+2 ; i++ )
+    {
+        full.add(DS18B20_FAMILY_DS18B20, i*8);
+    }
+    DS18B20Bus many(&full);
+    QCOMPARE((int)many.begin(), DS18B20_DEVICES_MAX);
+}
+
+void TestDS18B20Bus::test_tick()
+{
+    FakeBus bus;
+    bus.add(DS18B20_FAMILY_DS18B20, 0x10);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x20);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x30);
+    bus.dev[0].raw = 55*16 + 8;   // 55.5
+    bus.dev[1].raw = -(10*16 + 4); // -10.25
+    bus.dev[2].raw = 0;           // 0.0
+
+    DS18B20Bus ds(&bus);
+    QCOMPARE((int)ds.begin(), 3);
+
+    //First tick, TH and TL to all, one conversion for all and nothing to read
+    bool ok = true;
+    ds.tick();
+    QCOMPARE(bus.converts, 1);
+    QCOMPARE(bus.writes, 3);
+    QCOMPARE(bus.selects, 3);
+    QVERIFY(bus.powered);
+    ds.getCenti(0, &ok);
+    QVERIFY(!ok);
+
+    //Next tick, read every device once and a new conversion
+    ds.tick();
+    QCOMPARE(bus.converts, 2);
+    QCOMPARE(bus.writes, 3);
+    QCOMPARE(bus.selects, 6);
+    QCOMPARE(bus.resets, 8);
+
+    QCOMPARE((int)ds.getCenti(0, &ok), 5550);
+    QVERIFY(ok);
+    QCOMPARE((int)ds.getCenti(1, &ok), -1025);
+    QVERIFY(ok);
+    QCOMPARE((int)ds.getCenti(2, &ok), 0);
+    QVERIFY(ok);
+
+    ds.getCenti(3, &ok);
+    QVERIFY(!ok);
+
+    //New values, seen one tick later since the conversion was already done
+    bus.dev[0].raw = 20*16;
+    ds.tick();
+    QCOMPARE((int)ds.getCenti(0, &ok), 5550);
+    ds.tick();
+    QCOMPARE((int)ds.getCenti(0, &ok), 2000);
+}
+
+void TestDS18B20Bus::test_errors()
+{
+    FakeBus bus;
+    bus.add(DS18B20_FAMILY_DS18B20, 0x10);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x20);
+    bus.dev[0].raw = 30*16;
+    bus.dev[1].raw = 40*16;
+
+    DS18B20Bus ds(&bus);
+    ds.begin();
+
+    //The power on value is not used
+    bool ok = true;
+    ds.tick();
+    bus.dev[1].raw = 85*16;
+    ds.tick();
+    QCOMPARE((int)ds.getCenti(0, &ok), 3000);
+    QVERIFY(ok);
+    ds.getCenti(1, &ok);
+    QVERIFY(ok);
+
+    //A bad crc keeps the last value for a while
+    bus.dev[0].broken = true;
+    bus.dev[0].raw = 31*16;
+    for( int i=0 ; i<DS18B20_ERRORS_MAX-1 ; i++ )
+    {
+        ds.tick();
+        QCOMPARE((int)ds.getCenti(0, &ok), 3000);
+        QVERIFY(ok);
+    }
+    ds.tick();
+    ds.getCenti(0, &ok);
+    QVERIFY(!ok);
+
+    //And is back when the crc is good
+    bus.dev[0].broken = false;
+    ds.tick();
+    QCOMPARE((int)ds.getCenti(0, &ok), 3100);
+    QVERIFY(ok);
+
+    //The other device is not affected
+    QCOMPARE((int)ds.getCenti(1, &ok), 8500);
+    QVERIFY(ok);
+}
+
+void TestDS18B20Bus::test_toRaw()
+{
+    uint8_t data[9] = { 0x91, 0x01, 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10, 0 };
+
+    // 0x0191 is 25.0625 at 12 bit
+    QCOMPARE((int)DS18B20Bus::toRaw(data, DS18B20_FAMILY_DS18B20), 0x191);
+
+    // 9 bit, the low bits is undefined
+    data[4] = 0x1F;
+    QCOMPARE((int)DS18B20Bus::toRaw(data, DS18B20_FAMILY_DS18B20), 0x190);
+
+    // -25.0625
+    data[0] = 0x6F;
+    data[1] = 0xFE;
+    data[4] = 0x7F;
+    QCOMPARE((int)DS18B20Bus::toRaw(data, DS18B20_FAMILY_DS18B20), -401);
+
+    // DS18S20 +25 in 0.5 steps, and the count remain adds 6/16
+    uint8_t s20[9] = { 0x32, 0x00, 0x4B, 0x46, 0xFF, 0xFF, 0x06, 0x10, 0 };
+    QCOMPARE((int)DS18B20Bus::toRaw(s20, DS18B20_FAMILY_DS18S20), 25*16 + 6);
+}
+
+void TestDS18B20Bus::test_noBus()
+{
+    FakeBus bus;
+    DS18B20Bus ds(&bus);
+    QCOMPARE((int)ds.begin(), 0);
+    ds.tick();
+    QCOMPARE(bus.resets, 0);
+}
+
+void TestDS18B20Bus::test_alarmWrite()
+{
+    FakeBus bus;
+    bus.add(DS18B20_FAMILY_DS18B20, 0x10);
+    bus.add(DS18B20_FAMILY_DS18S20, 0x20);
+
+    //Can be set before begin, and is kept
+    DS18B20Bus ds(&bus);
+    QVERIFY(ds.setAlarm(0, 20, 30));
+    QVERIFY(!ds.setAlarm(DS18B20_DEVICES_MAX, 20, 30));
+    ds.begin();
+
+    //No alarm is the range of the device
+    ds.tick();
+    QCOMPARE(bus.writes, 2);
+    QCOMPARE((int)(int8_t)bus.dev[0].scratch[2], 30);
+    QCOMPARE((int)(int8_t)bus.dev[0].scratch[3], 20);
+    QCOMPARE((int)bus.dev[0].scratch[4], DS18B20_CONFIG_12BIT);
+    QCOMPARE((int)(int8_t)bus.dev[1].scratch[2], DS18B20_ALARM_HIGH_OFF);
+    QCOMPARE((int)(int8_t)bus.dev[1].scratch[3], DS18B20_ALARM_LOW_OFF);
+
+    //Only written when changed
+    ds.tick();
+    QVERIFY(ds.setAlarm(1, -10, 10));
+    QVERIFY(ds.setAlarm(0, 20, 30));
+    ds.tick();
+    QCOMPARE(bus.writes, 3);
+    QCOMPARE((int)(int8_t)bus.dev[1].scratch[2], 10);
+    QCOMPARE((int)(int8_t)bus.dev[1].scratch[3], -10);
+
+    //Outside the device range
+    QVERIFY(ds.setAlarm(1, -100, 127));
+    QCOMPARE((int)ds.alarmLow[1], DS18B20_ALARM_LOW_OFF);
+    QCOMPARE((int)ds.alarmHigh[1], DS18B20_ALARM_HIGH_OFF);
+}
+
+void TestDS18B20Bus::test_alarmSearch()
+{
+    FakeBus bus;
+    bus.add(DS18B20_FAMILY_DS18B20, 0x10);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x20);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x30);
+    bus.dev[0].raw = 20*16;
+    bus.dev[1].raw = 21*16;
+    bus.dev[2].raw = 22*16;
+
+    DS18B20Bus ds(&bus);
+    ds.setHeartbeat(5);
+    ds.setAlarm(1, 10, 25);
+    ds.begin();
+
+    //Write TH/TL, then all is read the first time
+    bool ok = false;
+    ds.tick();
+    ds.tick();
+    QCOMPARE((int)ds.getCenti(2, &ok), 2200);
+    QVERIFY(ok);
+
+    //No alarm, nothing is read between the heartbeats
+    int selects = bus.selects;
+    bus.dev[0].raw = 30*16;
+    ds.tick();
+    ds.tick();
+    QCOMPARE(bus.selects, selects);
+    QCOMPARE((int)ds.getCenti(0, &ok), 2000);
+
+    //A alarm is read the next tick, only that device
+    bus.dev[1].raw = 26*16;
+    ds.tick();
+    QCOMPARE(bus.selects, selects);
+    ds.tick();
+    QCOMPARE(bus.selects, selects+1);
+    QCOMPARE((int)ds.getCenti(1, &ok), 2600);
+    QCOMPARE((int)ds.getCenti(0, &ok), 2000);
+
+    //And the heartbeat reads all
+    ds.tick();
+    QCOMPARE(bus.selects, selects+1+3);
+    QCOMPARE((int)ds.getCenti(0, &ok), 3000);
+
+    //Every tick when the heartbeat is 1
+    ds.setHeartbeat(0);
+    ds.tick();
+    ds.tick();
+    QCOMPARE(bus.selects, selects+1+3+6);
+}
+
+void TestDS18B20Bus::test_alarmLost()
+{
+    FakeBus bus;
+    bus.add(DS18B20_FAMILY_DS18B20, 0x10);
+    bus.dev[0].raw = 20*16;
+
+    DS18B20Bus ds(&bus);
+    ds.setAlarm(0, 10, 25);
+    ds.begin();
+    ds.tick();
+    ds.tick();
+    QCOMPARE(bus.writes, 1);
+
+    //A power loss gives the EEPROM values (the fake has 75 and 70)
+    bus.dev[0].scratch[2] = 0x4B;
+    bus.dev[0].scratch[3] = 0x46;
+    bus.dev[0].scratch[8] = OneWireBus::crc8(bus.dev[0].scratch, 8);
+    ds.tick();
+    QCOMPARE(bus.writes, 2);
+    QCOMPARE((int)(int8_t)bus.dev[0].scratch[2], 25);
+    QCOMPARE((int)(int8_t)bus.dev[0].scratch[3], 10);
+
+    bool ok = false;
+    QCOMPARE((int)ds.getCenti(0, &ok), 2000);
+    QVERIFY(ok);
+}
+
+void TestDS18B20Bus::test_resolution()
+{
+    FakeBus bus;
+    bus.add(DS18B20_FAMILY_DS18B20, 0x10);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x20);
+    bus.add(DS18B20_FAMILY_DS18S20, 0x30);
+    bus.dev[0].raw = 20*16 + 13; // 20.8125
+    bus.dev[1].raw = 20*16 + 13;
+
+    DS18B20Bus ds(&bus);
+    QVERIFY(ds.setResolution(0, 9));
+    QVERIFY(!ds.setResolution(0, 8));
+    QVERIFY(!ds.setResolution(0, 13));
+    QVERIFY(!ds.setResolution(DS18B20_DEVICES_MAX, 10));
+    QCOMPARE((int)ds.getResolution(0), 0);
+    QCOMPARE((int)ds.begin(), 3);
+
+    QCOMPARE((int)ds.getResolution(0), 9);
+    QCOMPARE((int)ds.getResolution(1), 12);
+    QCOMPARE((int)ds.getResolution(2), 9);
+
+    //The DS18S20 is always 750ms
+    QCOMPARE((int)ds.getConversionTime(), 750);
+
+    //Written and copied to the EEPROM, no conversion the same time
+    ds.tick();
+    QCOMPARE((int)bus.dev[0].scratch[4], 0x1F);
+    QCOMPARE((int)bus.dev[1].scratch[4], 0x7F);
+    QCOMPARE(bus.copies, 1);
+    QCOMPARE(bus.converts, 0);
+    QVERIFY(bus.powered);
+
+    //Only once
+    ds.tick();
+    ds.tick();
+    QCOMPARE(bus.copies, 1);
+    QCOMPARE(bus.converts, 2);
+
+    //The low bits is not used at 9bit
+    bool ok = false;
+    QCOMPARE((int)ds.getCenti(0, &ok), 2050);
+    QVERIFY(ok);
+    QCOMPARE((int)ds.getCenti(1, &ok), 2081);
+
+    QVERIFY(ds.setResolution(1, 11));
+    QVERIFY(ds.setResolution(0, 9));
+    ds.tick();
+    QCOMPARE(bus.writes, 3+1);
+    QCOMPARE(bus.copies, 2);
+    QCOMPARE((int)bus.dev[1].scratch[4], 0x5F);
+    ds.tick();
+    ds.tick();
+    QCOMPARE((int)ds.getCenti(1, &ok), 2075);
+}
+
+void TestDS18B20Bus::test_poll()
+{
+    FakeBus bus;
+    bus.add(DS18B20_FAMILY_DS18B20, 0x10);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x20);
+
+    DS18B20Bus ds(&bus);
+    ds.begin();
+    QCOMPARE((int)ds.getConversionTime(), 750);
+
+    //The first poll starts a conversion
+    ds.poll(100);
+    QCOMPARE(bus.converts, 1);
+
+    //Then wait for the 12bit conversion
+    for( int i=0 ; i<7 ; i++ )
+    {
+        ds.poll(100);
+    }
+    QCOMPARE(bus.converts, 1);
+    ds.poll(100);
+    QCOMPARE(bus.converts, 2);
+
+    //10bit is 188ms, the copy uses one poll
+    ds.setResolution(0, 10);
+    ds.setResolution(1, 10);
+    QCOMPARE((int)ds.getConversionTime(), 188);
+    for( int i=0 ; i<3 ; i++ )
+    {
+        ds.poll(100);
+    }
+    QCOMPARE(bus.copies, 1);
+    QCOMPARE(bus.converts, 3);
+    for( int i=0 ; i<10 ; i++ )
+    {
+        ds.poll(100);
+    }
+    QCOMPARE(bus.converts, 3+5);
+
+    //And the slowest device sets the time
+    ds.setResolution(1, 11);
+    QCOMPARE((int)ds.getConversionTime(), 375);
+}
+
+void TestDS18B20Bus::test_background()
+{
+    FakeBus bus;
+    bus.add(DS18B20_FAMILY_DS18B20, 0x10);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x20);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x30);
+    bus.dev[1].raw = 25*16;
+    bus.busyCalls = 1;
+
+    DS18B20Bus ds(&bus);
+    ds.begin();
+
+    //One transfer every poll when the bus is busy
+    ds.poll(0);
+    QCOMPARE(bus.transfers, 1);
+    QVERIFY(ds.isBusy());
+    ds.poll(0);
+    ds.poll(0);
+    QCOMPARE(bus.writes, 3);
+    QCOMPARE(bus.converts, 0);
+    ds.poll(0);
+    QCOMPARE(bus.transfers, 4);
+    QCOMPARE(bus.converts, 1);
+    QVERIFY(ds.isBusy());
+    ds.poll(0);
+    QVERIFY(!ds.isBusy());
+
+    //Then wait for the conversion
+    ds.poll(700);
+    QCOMPARE(bus.transfers, 4);
+    ds.poll(100);
+    QCOMPARE(bus.transfers, 5);
+    ds.poll(0);
+    ds.poll(0);
+    ds.poll(0);
+    ds.poll(0);
+    QCOMPARE(bus.transfers, 8);
+    QVERIFY(!ds.isBusy());
+
+    bool ok = false;
+    QCOMPARE((int)ds.getCenti(1, &ok), 2500);
+    QVERIFY(ok);
+
+    //tick() waits for the bus
+    bus.busyCalls = 3;
+    ds.tick();
+    QCOMPARE(bus.transfers, 12);
+    QVERIFY(!ds.isBusy());
+}
+
+void TestDS18B20Bus::test_group()
+{
+    FakeBus a;
+    a.name = 'A';
+    a.add(DS18B20_FAMILY_DS18B20, 0x10);
+    a.add(DS18B20_FAMILY_DS18B20, 0x20);
+    a.add(DS18B20_FAMILY_DS18B20, 0x30);
+    a.dev[2].raw = 21*16;
+
+    FakeBus b;
+    b.name = 'B';
+    b.add(DS18B20_FAMILY_DS18B20, 0x40);
+    b.dev[0].raw = 22*16;
+
+    FakeBus c;
+    c.name = 'C';
+    c.add(DS18B20_FAMILY_DS18B20, 0x50);
+    c.add(DS18B20_FAMILY_DS18B20, 0x60);
+    c.dev[1].raw = 23*16;
+
+    DS18B20Bus dsA(&a);
+    DS18B20Bus dsB(&b);
+    DS18B20Bus dsC(&c);
+
+    DS18B20Group group;
+    QVERIFY(group.add(&dsA));
+    QVERIFY(group.add(&dsB));
+    QVERIFY(group.add(&dsC));
+    QCOMPARE((int)group.getCount(), 3);
+    QVERIFY(group.getBus(1) == &dsB);
+    QVERIFY(group.getBus(3) == NULL);
+    QCOMPARE((int)group.begin(), 6);
+
+    //The buses in turn, and the conversion on all after the last write
+    transferLog.clear();
+    group.tick();
+    QCOMPARE(transferLog, QString("Aw Bw Cw Aw Cw Aw AC BC CC"));
+    QVERIFY(!group.isBusy());
+
+    //The next tick starts with the next bus
+    transferLog.clear();
+    group.tick();
+    QCOMPARE(transferLog, QString("Br Cr Ar Cr Ar Ar AC BC CC"));
+
+    bool ok = false;
+    QCOMPARE((int)dsA.getCenti(2, &ok), 2100);
+    QVERIFY(ok);
+    QCOMPARE((int)dsB.getCenti(0, &ok), 2200);
+    QVERIFY(ok);
+    QCOMPARE((int)dsC.getCenti(1, &ok), 2300);
+    QVERIFY(ok);
+
+    //Full
+    DS18B20Bus dsD(&a);
+    DS18B20Bus dsE(&a);
+    QVERIFY(group.add(&dsD));
+    QVERIFY(!group.add(&dsE));
+    QVERIFY(!group.add(NULL));
+}
+
+void TestDS18B20Bus::test_groupPoll()
+{
+    FakeBus a;
+    a.name = 'A';
+    a.busyCalls = 1; // In the background
+    a.add(DS18B20_FAMILY_DS18B20, 0x10);
+    a.add(DS18B20_FAMILY_DS18B20, 0x20);
+
+    FakeBus b;
+    b.name = 'B';
+    b.add(DS18B20_FAMILY_DS18B20, 0x30);
+    b.dev[0].raw = 30*16;
+
+    DS18B20Bus dsA(&a);
+    DS18B20Bus dsB(&b);
+    DS18B20Group group;
+    group.add(&dsA);
+    group.add(&dsB);
+    group.begin();
+
+    //B is done at once, but waits for A before the conversion
+    transferLog.clear();
+    group.poll(0);
+    QCOMPARE(transferLog, QString("Aw Bw Aw"));
+    QCOMPARE(b.converts, 0);
+    QVERIFY(group.isBusy());
+    group.poll(0);
+    QCOMPARE(transferLog, QString("Aw Bw Aw AC BC"));
+    QVERIFY(!group.isBusy());
+
+    //Both buses is read after one conversion time
+    transferLog.clear();
+    group.poll(700);
+    QCOMPARE(transferLog, QString(""));
+    group.poll(50);
+    QVERIFY(group.isBusy());
+    for( int i=0 ; i<5 ; i++ )
+    {
+        group.poll(0);
+    }
+    QVERIFY(!group.isBusy());
+    QCOMPARE(a.converts, 2);
+    QCOMPARE(b.converts, 2);
+
+    //The slowest device on any bus sets the time
+    dsB.setResolution(0, 9);
+    QCOMPARE((int)group.getConversionTime(), 750);
+    dsA.setResolution(0, 10);
+    dsA.setResolution(1, 10);
+    QCOMPARE((int)group.getConversionTime(), 188);
+
+    bool ok = false;
+    QCOMPARE((int)dsB.getCenti(0, &ok), 3000);
+    QVERIFY(ok);
+}
+
+QTEST_MAIN(TestDS18B20Bus)
+#include "TestDS18B20Bus.moc"
@@ -0,0 +1,15 @@
+CONFIG += qtestlib debug
+TEMPLATE = app
+TARGET = 
+DEFINES += private=public
+
+# Test code
+DEPENDPATH += .
+INCLUDEPATH += .
+SOURCES += TestDS18B20Bus.cpp
+
+# Code to test
+DEPENDPATH  += ../../FunTechHouse_Thermostat/
+INCLUDEPATH += ../../FunTechHouse_Thermostat/
+SOURCES += DS18B20Bus.cpp DS18B20Group.cpp OneWireBus.cpp
+
@@ -0,0 +1,229 @@
+/**
+ * @file TestFilterChain.cpp
+ * @author Johan Simonsson
+ * @brief Testfile for FilterChain
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+#include <math.h>
+
+#include "FilterChain.h"
+
+class TestFilterChain : public QObject
+{
+    Q_OBJECT
+
+    private:
+    public:
+
+    private slots:
+        void test_median();
+        void test_ema();
+        void test_clamp();
+        void test_mean();
+        void test_chain();
+        void test_nested();
+        void test_init();
+};
+
+/**
+ * Simple random numbers, so the test is the same every time.
+ */
+static unsigned long randomState = 1;
+static int randomInt(int max)
+{
+    randomState = randomState * 1103515245UL + 12345UL;
+    return (int)((randomState >> 16) % max);
+}
+
+/**
+ * The median the slow way.
+ */
+static int median(QList<int> window)
+{
+    qSort(window);
+    return window.at(window.size()/2);
+}
+
+void TestFilterChain::test_median()
+{
+    FilterMedian<5> filter;
+    QCOMPARE(filter.getValue(), 0.0);
+
+    QList<int> window;
+    for( int i=0 ; i<1000 ; i++ )
+    {
+        //Many equal values, so the remove finds the right one
+        int value = randomInt(10);
+        window.append(value);
+        if(window.size() > 5)
+        {
+            window.removeFirst();
+        }
+        QCOMPARE((int)filter.addValue(value), median(window));
+        QCOMPARE(filter.getValue(), (double)median(window));
+    }
+
+    //One spike is gone
+    filter.init();
+    QCOMPARE((int)filter.addValue(500), 500);
+    filter.addValue(500);
+    filter.addValue(500);
+    QCOMPARE((int)filter.addValue(1023), 500);
+    QCOMPARE((int)filter.addValue(500), 500);
+}
+
+void TestFilterChain::test_ema()
+{
+    FilterEma<2> filter;
+
+    //First value is the start value
+    QCOMPARE((int)filter.addValue(400), 400);
+    QCOMPARE(filter.getValue(), 400.0);
+
+    //A quarter of the step every time
+    filter.addValue(500);
+    QCOMPARE(filter.getValue(), 425.0);
+    filter.addValue(500);
+    QCOMPARE(filter.getValue(), 443.75);
+
+    //Down as well
+    filter.init();
+    filter.addValue(500);
+    filter.addValue(400);
+    QCOMPARE(filter.getValue(), 475.0);
+
+    //Goes all the way to the new value, the extra bits is not stuck
+    for( int i=0 ; i<100 ; i++ )
+    {
+        filter.addValue(401);
+    }
+    QCOMPARE((int)filter.addValue(401), 401);
+    QVERIFY(fabs(filter.getValue() - 401.0) < 0.02);
+
+    //Noise around 300.5 keeps the decimals
+    for( int i=0 ; i<1000 ; i++ )
+    {
+        filter.addValue(300 + (i%2));
+    }
+    QVERIFY(fabs(filter.getValue() - 300.5) < 0.3);
+    QVERIFY(filter.getValue() != floor(filter.getValue()));
+}
+
+void TestFilterChain::test_clamp()
+{
+    FilterClamp<10, 977> filter;
+    QCOMPARE(filter.getValue(), 10.0);
+    QCOMPARE((int)filter.addValue(0), 10);
+    QCOMPARE((int)filter.addValue(10), 10);
+    QCOMPARE((int)filter.addValue(500), 500);
+    QCOMPARE(filter.getValue(), 500.0);
+    QCOMPARE((int)filter.addValue(977), 977);
+    QCOMPARE((int)filter.addValue(1023), 977);
+}
+
+void TestFilterChain::test_mean()
+{
+    FilterMean<8> filter;
+    QCOMPARE((int)filter.addValue(10), 10);
+    QCOMPARE((int)filter.addValue(13), 12);
+    QCOMPARE(filter.getValue(), 11.5);
+
+    //Same as RingFilter, trimmed when there is enough values
+    RingFilter<uint16_t, 8, uint32_t> ring;
+    filter.init();
+    for( int i=0 ; i<100 ; i++ )
+    {
+        uint16_t value = randomInt(1024);
+        ring.addValue(value);
+        QCOMPARE((int)filter.addValue(value), (int)(ring.getValue()+0.5));
+        QCOMPARE(filter.getValue(), ring.getValue());
+    }
+}
+
+void TestFilterChain::test_chain()
+{
+    FilterChain< FilterMedian<5>, FilterEma<3>, FilterClamp<100,900> > chain;
+    FilterMedian<5> median;
+    FilterEma<3> ema;
+    FilterClamp<100,900> clamp;
+
+    for( int i=0 ; i<1000 ; i++ )
+    {
+        uint16_t value = randomInt(1024);
+        uint16_t out = clamp.addValue( ema.addValue( median.addValue(value) ) );
+        QCOMPARE(chain.addValue(value), out);
+        QCOMPARE(chain.getValue(), clamp.getValue());
+    }
+
+    //The decimals from the last stage
+    FilterChain< FilterMedian<3>, FilterMean<4> > mean;
+    mean.addValue(100);
+    mean.addValue(101);
+    QCOMPARE(mean.getValue(), 100.5);
+
+    //Only one stage
+    FilterChain< FilterEma<1> > one;
+    one.addValue(100);
+    QCOMPARE((int)one.addValue(103), 102);
+    QCOMPARE(one.getValue(), 101.5);
+}
+
+void TestFilterChain::test_nested()
+{
+    typedef FilterChain< FilterMedian<3>, FilterClamp<0,977> > Pre;
+    FilterChain< Pre, FilterMean<16> > nested;
+    FilterChain< FilterMedian<3>, FilterClamp<0,977>, FilterMean<16> > flat;
+
+    for( int i=0 ; i<500 ; i++ )
+    {
+        uint16_t value = randomInt(1024);
+        QCOMPARE(nested.addValue(value), flat.addValue(value));
+        QCOMPARE(nested.getValue(), flat.getValue());
+    }
+
+    //The thermostat chain, the spike is gone and the rest is averaged
+    FilterChain< FilterSpike<SPIKE_FILTER_HAMPEL>, FilterMean<16> > thermostat;
+    for( int i=0 ; i<16 ; i++ )
+    {
+        thermostat.addValue( (i==10) ? 1023 : 500 + (i%2) );
+    }
+    QVERIFY(thermostat.getValue() > 500.0);
+    QVERIFY(thermostat.getValue() < 501.0);
+}
+
+void TestFilterChain::test_init()
+{
+    FilterChain< FilterMedian<5>, FilterEma<2> > chain;
+    for( int i=0 ; i<20 ; i++ )
+    {
+        chain.addValue(800);
+    }
+    QCOMPARE(chain.getValue(), 800.0);
+
+    //All stages forget the old values
+    chain.init();
+    QCOMPARE((int)chain.addValue(200), 200);
+    QCOMPARE(chain.getValue(), 200.0);
+}
+
+QTEST_MAIN(TestFilterChain)
+#include "TestFilterChain.moc"
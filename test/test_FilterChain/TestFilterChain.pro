@@ -0,0 +1,15 @@
+CONFIG += qtestlib debug
+TEMPLATE = app
+TARGET = 
+DEFINES += private=public
+
+# Test code
+DEPENDPATH += .
+INCLUDEPATH += .
+SOURCES += TestFilterChain.cpp
+
+# Code to test
+DEPENDPATH  += ../../FunTechHouse_Thermostat/
+INCLUDEPATH += ../../FunTechHouse_Thermostat/
+SOURCES += SpikeFilter.cpp
+
@@ -0,0 +1,226 @@
+/**
+ * @file TestKalmanFilter.cpp
+ * @author Johan Simonsson
+ * @brief Testfile for KalmanFilter
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+#include <math.h>
+
+#include "KalmanFilter.h"
+#include "ValueAvg.h"
+
+/**
+ * The same noise every run, about +-noise*1.7 (uniform).
+ */
+static int noise(uint32_t* seed, int level)
+{
+    *seed = (*seed * 1103515245) + 12345;
+    int r = (int)((*seed >> 16) & 0x7FFF) - 0x4000;
+    return (r * level * 17) / (0x4000 * 10);
+}
+
+class TestKalmanFilter : public QObject
+{
+    Q_OBJECT
+
+    private:
+    public:
+
+    private slots:
+        void test_first();
+        void test_constant();
+        void test_ramp();
+        void test_ramp_data();
+        void test_noise();
+        void test_init();
+};
+
+void TestKalmanFilter::test_first()
+{
+    KalmanFilter kalman;
+    QVERIFY(!kalman.isValid());
+
+    QCOMPARE((int)kalman.addValue(5500), 5500);
+    QVERIFY(kalman.isValid());
+    QCOMPARE((int)kalman.getValue(), 5500);
+    QCOMPARE((int)kalman.getSlope(60), 0);
+
+    //The same value again does not move it
+    for( int i=0 ; i<100 ; i++ )
+    {
+        QCOMPARE((int)kalman.addValue(5500), 5500);
+    }
+    QCOMPARE((int)kalman.getSlope(60), 0);
+}
+
+void TestKalmanFilter::test_constant()
+{
+    KalmanFilter kalman;
+    kalman.addValue(2000);
+
+    //A step is followed, the slope overshoots a little
+    int value = kalman.addValue(3000);
+    QVERIFY(value > 2000);
+    QVERIFY(value < 3000);
+    for( int i=0 ; i<5 ; i++ )
+    {
+        value = kalman.addValue(3000);
+    }
+    QVERIFY(value > 2900);
+    QVERIFY(value < 3300);
+
+    for( int i=0 ; i<300 ; i++ )
+    {
+        value = kalman.addValue(3000);
+    }
+    QVERIFY(abs(value - 3000) <= 2);
+    QVERIFY(abs(kalman.getSlope(60)) <= 5);
+
+    //The negative side
+    KalmanFilter cold;
+    for( int i=0 ; i<100 ; i++ )
+    {
+        value = cold.addValue(-1500);
+    }
+    QCOMPARE(value, -1500);
+}
+
+void TestKalmanFilter::test_ramp_data()
+{
+    QTest::addColumn<int>("perMinute");
+
+    QTest::newRow("heating") << 120;
+    QTest::newRow("slow") << 15;
+    QTest::newRow("cooling") << -60;
+}
+
+/**
+ * A steady ramp, one sample per second.
+ */
+void TestKalmanFilter::test_ramp()
+{
+    QFETCH(int, perMinute);
+
+    KalmanFilter kalman;
+    uint32_t seed = 1;
+    int value = 0;
+    for( int i=0 ; i<600 ; i++ )
+    {
+        int truth = 4000 + (perMinute * i) / 60;
+        value = kalman.addValue(truth + noise(&seed, KALMAN_NOISE));
+    }
+
+    //No lag on a ramp
+    int truth = 4000 + (perMinute * 599) / 60;
+    QVERIFY(abs(value - truth) < KALMAN_NOISE);
+    int slope = kalman.getSlope(60);
+    QVERIFY(abs(slope - perMinute) <= 30);
+}
+
+/**
+ * The Kalman with one raw value per sample
+ * is less noisy than ValueAvg with four.
+ */
+void TestKalmanFilter::test_noise()
+{
+    KalmanFilter kalman;
+    ValueAvg avg;
+    uint32_t seed = 7;
+
+    double kalmanSum = 0;
+    double avgSum = 0;
+    int cnt = 0;
+    for( int i=0 ; i<1000 ; i++ )
+    {
+        int value = kalman.addValue(5000 + noise(&seed, KALMAN_NOISE));
+
+        avg.init();
+        for( int j=0 ; j<4 ; j++ )
+        {
+            avg.addValue(5000 + noise(&seed, KALMAN_NOISE));
+        }
+
+        //After it has settled
+        if(i >= 100)
+        {
+            kalmanSum += (value-5000)*(value-5000);
+            avgSum += (avg.getValue()-5000)*(avg.getValue()-5000);
+            cnt++;
+        }
+    }
+
+    double kalmanRms = sqrt(kalmanSum/cnt);
+    double avgRms = sqrt(avgSum/cnt);
+    QVERIFY(kalmanRms < avgRms);
+}
+
+void TestKalmanFilter::test_init()
+{
+    KalmanFilter kalman;
+    for( int i=0 ; i<60 ; i++ )
+    {
+        kalman.addValue(2000 + i*2);
+    }
+    QVERIFY(kalman.getSlope(60) > 100);
+
+    kalman.init();
+    QVERIFY(!kalman.isValid());
+    QCOMPARE((int)kalman.addValue(7000), 7000);
+    QCOMPARE((int)kalman.getSlope(60), 0);
+
+    //Less process noise is a smoother value
+    KalmanFilter smooth;
+    smooth.setNoise(100, 1);
+    KalmanFilter fast;
+    fast.setNoise(10, 10);
+    smooth.addValue(2000);
+    fast.addValue(2000);
+    QVERIFY(fast.addValue(3000) > smooth.addValue(3000));
+
+    //Outside the limits is the same as the limits
+    KalmanFilter high;
+    high.setNoise(60000, 60000);
+    KalmanFilter max;
+    max.setNoise(KALMAN_NOISE_MAX, KALMAN_PROCESS_MAX);
+    QCOMPARE(high.r, max.r);
+    QCOMPARE(high.q, max.q);
+    KalmanFilter zero;
+    zero.setNoise(0, 0);
+    KalmanFilter one;
+    one.setNoise(1, 0);
+    QCOMPARE(zero.r, one.r);
+
+    //And the covariance does not overflow with jumps between -50 and 120 degC
+    for( int i=0 ; i<2000 ; i++ )
+    {
+        int16_t value = (i & 1) ? 12000 : -5000;
+        QVERIFY(high.addValue(value) > -6000);
+        QVERIFY(high.getValue() < 13000);
+        QVERIFY(zero.addValue(value) > -6000);
+        QVERIFY(zero.getValue() < 13000);
+    }
+    QVERIFY(high.p00 > 0);
+    QVERIFY(high.p11 > 0);
+}
+
+QTEST_MAIN(TestKalmanFilter)
+#include "TestKalmanFilter.moc"
@@ -1,6 +1,8 @@
 #include <QtCore>
 #include <QtTest>
 
+#include <math.h>
+
 #include "LVTS.h"
 
 class TestLVTS : public QObject
@@ -16,6 +18,10 @@ class TestLVTS : public QObject
 
         void test_LM35();
         void test_LM35_data();
+        void test_LM35Valid();
+        void test_LM35Centi();
+        void test_LM34Centi();
+        void test_Oversampled();
 
         void test_F2C();
         void test_F2C_data();
@@ -89,6 +95,79 @@ void TestLVTS::test_LM35()
     QCOMPARE(temperature, value);
 }
 
+void TestLVTS::test_LM35Valid()
+{
+    //Same answer as lm35 for all readings
+    for( int read=-1 ; read<=1024 ; read++ )
+    {
+        bool ok = false;
+        LVTS::lm35(read, &ok);
+        QCOMPARE(LVTS::lm35Valid(read), ok);
+    }
+}
+
+void TestLVTS::test_LM35Centi()
+{
+    //The table is the same as the floating point for all readings
+    for( int read=0 ; read<=1023 ; read++ )
+    {
+        bool ok = false;
+        bool okCenti = false;
+        double value = LVTS::lm35(read, &ok);
+        int16_t centi = LVTS::lm35Centi(read, &okCenti);
+        QCOMPARE(okCenti, ok);
+        if(ok)
+        {
+            QCOMPARE((int)centi, (int)round(value*100));
+        }
+    }
+
+    bool ok = true;
+    LVTS::lm35Centi(1024, &ok);
+    QVERIFY(!ok);
+}
+
+void TestLVTS::test_LM34Centi()
+{
+    for( int read=0 ; read<=1023 ; read++ )
+    {
+        bool ok = false;
+        bool okCenti = false;
+        double value = LVTS::lm34(read, &ok);
+        int16_t centi = LVTS::lm34Centi(read, &okCenti);
+        QCOMPARE(okCenti, ok);
+        if(ok)
+        {
+            QCOMPARE((int)centi, (int)round(value*100));
+        }
+    }
+}
+
+void TestLVTS::test_Oversampled()
+{
+    //The extra bits is interpolated between the table values
+    for( int bits=1 ; bits<=5 ; bits++ )
+    {
+        for( long read=0 ; read<=(1023L<<bits) ; read++ )
+        {
+            bool ok = false;
+            bool okCenti = false;
+            double value = LVTS::lm35(read, &ok, bits);
+            int16_t centi = LVTS::lm35Centi(read, &okCenti, bits);
+            if(okCenti)
+            {
+                QVERIFY(ok);
+                QVERIFY(fabs(centi - value*100) <= 1.0);
+            }
+            else
+            {
+                //Only the last step before the limit can differ
+                QVERIFY( !ok || ((read >> bits) == (977)) );
+            }
+        }
+    }
+}
+
 void TestLVTS::test_F2C_data()
 {
     QTest::addColumn<double>("degC");
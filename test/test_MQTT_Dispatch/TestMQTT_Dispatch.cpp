@@ -0,0 +1,167 @@
+/**
+ * @file TestMQTT_Dispatch.cpp
+ * @author Johan Simonsson
+ * @brief Testfile for MQTT_Dispatch.
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+
+#include "MQTT_Dispatch.h"
+
+class TestMQTT_Dispatch : public QObject
+{
+    Q_OBJECT
+
+    private:
+    public:
+
+    private slots:
+        void test_find();
+        void test_hash();
+        void test_collision();
+        void test_full();
+};
+
+void TestMQTT_Dispatch::test_find()
+{
+    static const char prefix[] = "FunTechHouse/Pannrum/";
+
+    MQTT_Logic thermostat;
+    MQTT_Logic sensor;
+    MQTT_Logic flash;
+    MQTT_Logic ram;
+    MQTT_Logic none;
+    thermostat.setTopicName_P(prefix, "ElPanna",
+            MQTT_TOPIC_SUBSCRIBE | MQTT_TOPIC_PUBLISH | MQTT_TOPIC_DIAGNOSTIC);
+    sensor.setTopicName_P(prefix, "GT1-VV", MQTT_TOPIC_SUBSCRIBE | MQTT_TOPIC_PUBLISH);
+    flash.setTopic_P("Flash/in", "Flash/out");
+    ram.setTopic((char*)"Ram/in", (char*)"Ram/out");
+
+    MQTT_Dispatch dispatch;
+    QVERIFY(dispatch.add(&thermostat));
+    QVERIFY(dispatch.add(&sensor));
+    QVERIFY(dispatch.add(&flash));
+    QVERIFY(dispatch.add(&ram));
+    QVERIFY(!dispatch.add(&none));
+    QCOMPARE((int)dispatch.cnt, 4);
+
+    QVERIFY(&thermostat == dispatch.find("FunTechHouse/Pannrum/ElPanna_Data"));
+    QVERIFY(&sensor == dispatch.find("FunTechHouse/Pannrum/GT1-VV_Data"));
+    QVERIFY(&flash == dispatch.find("Flash/in"));
+    QVERIFY(&ram == dispatch.find("Ram/in"));
+
+    //Only the subscribe topics
+    QVERIFY(NULL == dispatch.find("FunTechHouse/Pannrum/ElPanna"));
+    QVERIFY(NULL == dispatch.find("FunTechHouse/Pannrum/ElPanna_Diag"));
+    QVERIFY(NULL == dispatch.find("Ram/out"));
+
+    //Not a part or more
+    QVERIFY(NULL == dispatch.find("FunTechHouse/Pannrum/"));
+    QVERIFY(NULL == dispatch.find("FunTechHouse/Pannrum/GT1-VV_Data2"));
+    QVERIFY(NULL == dispatch.find("Ram/i"));
+    QVERIFY(NULL == dispatch.find(""));
+}
+
+void TestMQTT_Dispatch::test_hash()
+{
+    static const char prefix[] = "FunTechHouse/Pannrum/";
+
+    MQTT_Logic sensor;
+    sensor.setTopicName_P(prefix, "GT1-VV", MQTT_TOPIC_SUBSCRIBE | MQTT_TOPIC_PUBLISH);
+    MQTT_Dispatch dispatch;
+    QVERIFY(dispatch.add(&sensor));
+
+    //The parts gives the same hash as the whole topic
+    uint16_t len = 0;
+    uint16_t hash = MQTT_Dispatch::hashTopic("FunTechHouse/Pannrum/GT1-VV_Data", &len);
+    QCOMPARE((int)len, 32);
+    QCOMPARE((int)dispatch.hash[0], (int)hash);
+    QCOMPARE((int)dispatch.len[0], 32);
+
+    //Only the own slot is used
+    int used = 0;
+    for( int i=0 ; i<MQTT_DISPATCH_SLOTS ; i++ )
+    {
+        if(MQTT_DISPATCH_EMPTY != dispatch.slot[i])
+        {
+            QCOMPARE((int)i, (int)(hash & (MQTT_DISPATCH_SLOTS-1)));
+            used++;
+        }
+    }
+    QCOMPARE(used, 1);
+}
+
+void TestMQTT_Dispatch::test_collision()
+{
+    //The same hash and length, so the string decides
+    uint16_t lenA = 0;
+    uint16_t lenB = 0;
+    QCOMPARE(MQTT_Dispatch::hashTopic("Test/SensorB1_Data", &lenA),
+             MQTT_Dispatch::hashTopic("Test/SensorCP_Data", &lenB));
+    QCOMPARE(lenA, lenB);
+
+    MQTT_Logic a;
+    MQTT_Logic b;
+    a.setTopic_P("Test/SensorB1_Data", "Test/SensorB1");
+    b.setTopic_P("Test/SensorCP_Data", "Test/SensorCP");
+
+    MQTT_Dispatch dispatch;
+    QVERIFY(dispatch.add(&a));
+    QVERIFY(dispatch.add(&b));
+    QVERIFY(&a == dispatch.find("Test/SensorB1_Data"));
+    QVERIFY(&b == dispatch.find("Test/SensorCP_Data"));
+    QVERIFY(NULL == dispatch.find("Test/SensorXX_Data"));
+}
+
+void TestMQTT_Dispatch::test_full()
+{
+    static const char* names[MQTT_DISPATCH_MAX+1] = {
+        "S0", "S1", "S2", "S3", "S4", "S5", "S6", "S7", "S8"
+    };
+
+    MQTT_Logic logic[MQTT_DISPATCH_MAX+1];
+    MQTT_Dispatch dispatch;
+    for( int i=0 ; i<MQTT_DISPATCH_MAX ; i++ )
+    {
+        logic[i].setTopicName_P("Prefix/", names[i], MQTT_TOPIC_SUBSCRIBE);
+        QVERIFY(dispatch.add(&logic[i]));
+    }
+    logic[MQTT_DISPATCH_MAX].setTopicName_P("Prefix/", names[MQTT_DISPATCH_MAX], MQTT_TOPIC_SUBSCRIBE);
+    QVERIFY(!dispatch.add(&logic[MQTT_DISPATCH_MAX]));
+
+    //All is found, also the ones that had to take the next slot
+    char topic[20];
+    for( int i=0 ; i<=MQTT_DISPATCH_MAX ; i++ )
+    {
+        snprintf(topic, sizeof(topic), "Prefix/%s_Data", names[i]);
+        if(i < MQTT_DISPATCH_MAX)
+        {
+            QVERIFY(&logic[i] == dispatch.find(topic));
+        }
+        else
+        {
+            QVERIFY(NULL == dispatch.find(topic));
+        }
+    }
+}
+
+QTEST_MAIN(TestMQTT_Dispatch)
+#include "TestMQTT_Dispatch.moc"
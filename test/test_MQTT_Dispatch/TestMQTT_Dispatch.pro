@@ -0,0 +1,16 @@
+CONFIG += qtestlib
+TEMPLATE = app
+TARGET = 
+DEFINES += private=public
+DEFINES += protected=public
+
+# Test code
+DEPENDPATH += .
+INCLUDEPATH += .
+SOURCES += TestMQTT_Dispatch.cpp
+
+# Code to test
+DEPENDPATH  += ../../FunTechHouse_Thermostat/
+INCLUDEPATH += ../../FunTechHouse_Thermostat/
+SOURCES += MQTT_Dispatch.cpp MQTT_Logic.cpp StringHelp.cpp
+
@@ -23,8 +23,27 @@
 
 #include <QtCore>
 #include <QtTest>
+#include <stdio.h>
+#include <string.h>
 
 #include "MQTT_Logic.h"
+#include "TemperatureSensor.h"
+#include "Thermostat.h"
+
+/**
+ * Saves the commands so we can see what the parser found.
+ */
+class CommandLog : public MQTT_Logic
+{
+    public:
+        QStringList log;
+
+        bool commandSet(const char* key, unsigned int keyLen, long value)
+        {
+            log << QString("%1:%2").arg(QString::fromLatin1(key, keyLen)).arg(value);
+            return !commandIs(key, keyLen, "bad");
+        }
+};
 
 class TestMQTT_Logic : public QObject
 {
@@ -36,6 +55,11 @@ class TestMQTT_Logic : public QObject
     private slots:
         void test_setTopic();
         void test_checkTopic();
+        void test_setTopic_P();
+        void test_setTopicName_P();
+        void test_footprint();
+        void test_commandParse_data();
+        void test_commandParse();
 };
 
 
@@ -65,6 +89,7 @@ void TestMQTT_Logic::test_setTopic()
 void TestMQTT_Logic::test_checkTopic()
 {
     MQTT_Logic mqttLogic;
+    QCOMPARE(false, mqttLogic.checkTopicSubscribe("in_0"));
     mqttLogic.setTopic("in_0", "out_0");
 
     QCOMPARE(true,  mqttLogic.checkTopicSubscribe("in_0"));
@@ -75,5 +100,239 @@ void TestMQTT_Logic::test_checkTopic()
     QCOMPARE(false, mqttLogic.checkTopicSubscribe("house/party2/data"));
 }
 
+/**
+ * Topics in flash is not copied, on the pc it is just the pointer.
+ */
+void TestMQTT_Logic::test_setTopic_P()
+{
+    static const char in[] = "house/in";
+    static const char out[] = "house/out";
+    static const char diag[] = "house/diag";
+
+    MQTT_Logic mqttLogic;
+    QVERIFY( NULL == mqttLogic.getTopic(MQTT_TOPIC_DIAGNOSTIC) );
+
+    QVERIFY( mqttLogic.setTopic("in_0", "out_0") );
+    QVERIFY( !mqttLogic.isTopicFlash(MQTT_TOPIC_SUBSCRIBE) );
+    QVERIFY( !mqttLogic.isTopicFlash(MQTT_TOPIC_PUBLISH) );
+
+    //The copies is replaced
+    QVERIFY( mqttLogic.setTopic_P(in, out) );
+    QVERIFY( mqttLogic.getTopicSubscribe() == in );
+    QVERIFY( mqttLogic.getTopic(MQTT_TOPIC_PUBLISH) == out );
+    QVERIFY( mqttLogic.isTopicFlash(MQTT_TOPIC_SUBSCRIBE) );
+    QVERIFY( mqttLogic.isTopicFlash(MQTT_TOPIC_PUBLISH) );
+    QVERIFY( !mqttLogic.isTopicFlash(MQTT_TOPIC_DIAGNOSTIC) );
+    QVERIFY( mqttLogic.checkTopicSubscribe("house/in") );
+    QVERIFY( !mqttLogic.checkTopicSubscribe("house/out") );
+
+    QVERIFY( mqttLogic.setTopicDiagnostic_P(diag) );
+    QVERIFY( mqttLogic.getTopicDiagnostic() == diag );
+    QVERIFY( mqttLogic.isTopicFlash(MQTT_TOPIC_DIAGNOSTIC) );
+
+    //And back to ram, the flash is not freed
+    QVERIFY( mqttLogic.setTopic("in_1", "out_1") );
+    QCOMPARE( mqttLogic.getTopicSubscribe(), "in_1" );
+    QCOMPARE( mqttLogic.getTopicPublish(), "out_1" );
+    QVERIFY( !mqttLogic.isTopicFlash(MQTT_TOPIC_SUBSCRIBE) );
+    QVERIFY( mqttLogic.setTopicDiagnostic("diag_1") );
+    QCOMPARE( mqttLogic.getTopic(MQTT_TOPIC_DIAGNOSTIC), "diag_1" );
+    QVERIFY( !mqttLogic.isTopicFlash(MQTT_TOPIC_DIAGNOSTIC) );
+    QCOMPARE( in, "house/in" );
+
+    //A new copy replaces the old
+    QVERIFY( mqttLogic.setTopic("in_2", "out_2") );
+    QCOMPARE( mqttLogic.getTopicSubscribe(), "in_2" );
+    QVERIFY( mqttLogic.checkTopicSubscribe("in_2") );
+}
+
+/**
+ * The topic as it is written to the packet.
+ */
+static QString topicString(MQTT_Logic* mqttLogic, uint8_t topic)
+{
+    const char* prefix;
+    const char* name;
+    const char* suffix;
+    if(!mqttLogic->getTopic_P(topic, &prefix, &name, &suffix))
+    {
+        return QString();
+    }
+
+    QString str;
+    if(NULL != prefix)
+    {
+        str += prefix;
+    }
+    str += name;
+    if(NULL != suffix)
+    {
+        str += suffix;
+    }
+    return str;
+}
+
+/**
+ * Many objects share the prefix.
+ */
+void TestMQTT_Logic::test_setTopicName_P()
+{
+    static const char prefix[] = "FunTechHouse/Pannrum/";
+    static const char other[] = "FunTechHouse/Pannrum/";
+
+    MQTT_Logic thermostat;
+    MQTT_Logic sensor;
+    QVERIFY( thermostat.setTopicName_P(prefix, "ElPanna",
+                MQTT_TOPIC_SUBSCRIBE | MQTT_TOPIC_PUBLISH | MQTT_TOPIC_DIAGNOSTIC) );
+    QVERIFY( sensor.setTopicName_P(prefix, "GT1-VV", MQTT_TOPIC_SUBSCRIBE | MQTT_TOPIC_PUBLISH) );
+
+    //The same topics as before
+    QCOMPARE( topicString(&thermostat, MQTT_TOPIC_SUBSCRIBE), QString("FunTechHouse/Pannrum/ElPanna_Data") );
+    QCOMPARE( topicString(&thermostat, MQTT_TOPIC_PUBLISH), QString("FunTechHouse/Pannrum/ElPanna") );
+    QCOMPARE( topicString(&thermostat, MQTT_TOPIC_DIAGNOSTIC), QString("FunTechHouse/Pannrum/ElPanna_Diag") );
+    QCOMPARE( topicString(&sensor, MQTT_TOPIC_PUBLISH), QString("FunTechHouse/Pannrum/GT1-VV") );
+    QVERIFY( topicString(&sensor, MQTT_TOPIC_DIAGNOSTIC).isEmpty() );
+
+    //Not in one piece
+    QVERIFY( NULL == sensor.getTopic(MQTT_TOPIC_PUBLISH) );
+    QVERIFY( sensor.isTopicFlash(MQTT_TOPIC_PUBLISH) );
+
+    //The prefix once, then only the names
+    const char* name = MQTT_Logic::skipPrefix("FunTechHouse/Pannrum/GT1-VV_Data", prefix);
+    QCOMPARE( name, "GT1-VV_Data" );
+    QVERIFY( !thermostat.checkTopicSubscribe(prefix, name) );
+    QVERIFY( sensor.checkTopicSubscribe(prefix, name) );
+    QVERIFY( !sensor.checkTopicSubscribe(other, name) );
+    QVERIFY( !sensor.checkTopicSubscribe(prefix, "GT1-VV") );
+    QVERIFY( !sensor.checkTopicSubscribe(prefix, "GT1-VV_Data2") );
+    QVERIFY( !sensor.checkTopicSubscribe(prefix, "GT1-V_Data") );
+    QVERIFY( NULL == MQTT_Logic::skipPrefix("FunTechHouse/Garage/GT1-VV_Data", prefix) );
+    QVERIFY( !sensor.checkTopicSubscribe(prefix, NULL) );
+
+    //And the whole topic
+    QVERIFY( sensor.checkTopicSubscribe("FunTechHouse/Pannrum/GT1-VV_Data") );
+    QVERIFY( !sensor.checkTopicSubscribe("FunTechHouse/Pannrum/GT1-VV") );
+    QVERIFY( thermostat.checkTopicSubscribe("FunTechHouse/Pannrum/ElPanna_Data") );
+
+    //A whole topic replaces one of them
+    QVERIFY( thermostat.setTopicDiagnostic_P("diag") );
+    QCOMPARE( topicString(&thermostat, MQTT_TOPIC_DIAGNOSTIC), QString("diag") );
+    QCOMPARE( topicString(&thermostat, MQTT_TOPIC_PUBLISH), QString("FunTechHouse/Pannrum/ElPanna") );
+    QVERIFY( thermostat.setTopic("in_0", "out_0") );
+    QVERIFY( !thermostat.getTopic_P(MQTT_TOPIC_PUBLISH, &name, &name, &name) );
+    QVERIFY( thermostat.checkTopicSubscribe("in_0") );
+    QVERIFY( !thermostat.checkTopicSubscribe(prefix, "in_0") );
+}
+
+/**
+ * Ram for the topics of the thermostat and many sensors, with sizeof
+ * and the strings that is really stored (on this machine, the AVR has 2 byte pointers).
+ */
+void TestMQTT_Logic::test_footprint()
+{
+    const char prefix[] = "FunTechHouse/Pannrum/";
+
+    MQTT_Logic mqttLogic;
+    int topicRam = sizeof(mqttLogic.topicIn) + sizeof(mqttLogic.topicOut) + sizeof(mqttLogic.topicDiag) +
+        sizeof(mqttLogic.topicPrefix) + sizeof(mqttLogic.topicFlash);
+    QCOMPARE(topicRam, 4*(int)sizeof(char*) + 1);
+    QVERIFY((int)sizeof(MQTT_Logic) >= topicRam);
+
+    printf("MQTT_Logic %d B (topics %d B), Thermostat %d B, TemperatureSensor %d B\n",
+            (int)sizeof(MQTT_Logic), topicRam, (int)sizeof(Thermostat), (int)sizeof(TemperatureSensor));
+    printf("  sensors  objects  topics  setTopic heap  setTopicName_P heap/flash\n");
+
+    const int counts[2] = { 8, 16 };
+    for( int c=0 ; c<2 ; c++ )
+    {
+        //The thermostat has a diagnostic topic as well
+        int objects = counts[c]+1;
+        int objectRam = sizeof(Thermostat) + counts[c]*sizeof(TemperatureSensor);
+        int copyHeap = 0;
+        int namedHeap = 0;
+        int namedFlash = sizeof(prefix);
+        for( int i=0 ; i<objects ; i++ )
+        {
+            char name[16];
+            char in[64];
+            char out[64];
+            char diag[64];
+            snprintf(name, sizeof(name), (0 == i) ? "ElPanna" : "GT%d-VV", i);
+            snprintf(in, sizeof(in), "%s%s_Data", prefix, name);
+            snprintf(out, sizeof(out), "%s%s", prefix, name);
+            snprintf(diag, sizeof(diag), "%s%s_Diag", prefix, name);
+
+            MQTT_Logic copy;
+            QVERIFY(copy.setTopic(in, out));
+            copyHeap += strlen(copy.getTopicSubscribe())+1 + strlen(copy.getTopicPublish())+1;
+            if(0 == i)
+            {
+                QVERIFY(copy.setTopicDiagnostic(diag));
+                copyHeap += strlen(copy.getTopicDiagnostic())+1;
+            }
+
+            MQTT_Logic named;
+            uint8_t topics = MQTT_TOPIC_SUBSCRIBE | MQTT_TOPIC_PUBLISH | ((0 == i) ? MQTT_TOPIC_DIAGNOSTIC : 0);
+            QVERIFY(named.setTopicName_P(prefix, name, topics));
+            for( uint8_t t=MQTT_TOPIC_SUBSCRIBE ; t<=MQTT_TOPIC_DIAGNOSTIC ; t<<=1 )
+            {
+                if( (topics & t) && !named.isTopicFlash(t) )
+                {
+                    namedHeap += strlen(named.getTopic(t))+1;
+                }
+            }
+            namedFlash += strlen(name)+1;
+        }
+
+        printf("  %7d  %5d B  %4d B        %5d B           %4d B / %4d B\n",
+                counts[c], objectRam, objects*topicRam, copyHeap, namedHeap, namedFlash);
+
+        QCOMPARE(namedHeap, 0);
+        QVERIFY(namedFlash < copyHeap/3);
+    }
+}
+
+void TestMQTT_Logic::test_commandParse_data()
+{
+    QTest::addColumn<QString>("payload");
+    QTest::addColumn<bool>("ok");
+    QTest::addColumn<QString>("log");
+
+    QTest::newRow("one")      << "setpoint=55.5"              << true  << "setpoint:5550";
+    QTest::newRow("many")     << "setpoint=55.5 ; hyst=3"     << true  << "setpoint:5550,hyst:300";
+    QTest::newRow("no space") << "outmax=2;hyst=1.25\r\n"     << true  << "outmax:200,hyst:125";
+    QTest::newRow("empty")    << ""                           << true  << "";
+    QTest::newRow("unknown")  << "bad=1 ; hyst=3"             << false << "bad:100,hyst:300";
+    QTest::newRow("no value") << "hyst= ; outmax=3"           << false << "outmax:300";
+    QTest::newRow("no equal") << "hyst ; outmax=3"            << false << "outmax:300";
+    QTest::newRow("junk")     << "hyst=3x ; outmax=3"         << false << "outmax:300";
+}
+
+/**
+ * Parse commands from a buffer that is not null terminated.
+ */
+void TestMQTT_Logic::test_commandParse()
+{
+    QFETCH(QString, payload);
+    QFETCH(bool, ok);
+    QFETCH(QString, log);
+
+    char buf[80];
+    memset(buf, 'x', sizeof(buf));
+    memcpy(buf, payload.toLatin1().data(), payload.length());
+
+    CommandLog logic;
+    QVERIFY(!logic.commandTimeToSend());
+    QCOMPARE(logic.commandParse(buf, payload.length()), ok);
+    QCOMPARE(logic.log.join(","), log);
+
+    //Always ack so the server gets the state
+    QVERIFY(logic.commandTimeToSend());
+    char str[20];
+    QVERIFY(logic.getCommandString(str, 20));
+    logic.commandIsSent();
+    QVERIFY(!logic.commandTimeToSend());
+}
+
 QTEST_MAIN(TestMQTT_Logic)
 #include "TestMQTT_Logic.moc"
@@ -12,5 +12,5 @@ SOURCES += TestMQTT_Logic.cpp
 # Code to test
 DEPENDPATH  += ../../FunTechHouse_Thermostat/
 INCLUDEPATH += ../../FunTechHouse_Thermostat/
-SOURCES += MQTT_Logic.cpp
+SOURCES += MQTT_Logic.cpp StringHelp.cpp
 
@@ -0,0 +1,331 @@
+/**
+ * @file TestOneWireEngine.cpp
+ * @author Johan Simonsson
+ * @brief Testfile for OneWireEngine
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+#include <string.h>
+#include <stdio.h>
+
+#include "OneWireEngine.h"
+#include "DS18B20Bus.h"
+#include "../common/SimOneWireLine.h"
+
+/**
+ * The serial number of the device on the wire.
+ */
+static const uint8_t serial[6] = { 0x13, 0x23, 0x33, 0x43, 0x53, 0x63 };
+
+class TestOneWireEngine : public QObject
+{
+    Q_OBJECT
+
+    private:
+    public:
+
+    private slots:
+        void test_reset();
+        void test_timing();
+        void test_power();
+        void test_latency();
+        void test_latency_data();
+        void test_background();
+        void test_search();
+        void test_ds18b20();
+};
+
+void TestOneWireEngine::test_reset()
+{
+    SimBus bus;
+    SimDevice* dev = bus.add(serial);
+    OneWireEngine ow(6);
+    ow.setLine(&bus);
+    ow.begin();
+
+    QCOMPARE((int)ow.reset(), 1);
+    QCOMPARE(bus.resets, 1);
+    QVERIFY(bus.resetMin >= 480);
+    QCOMPARE(ow.getTime(), (uint32_t)(ONEWIRE_US_RESET_LOW + ONEWIRE_US_PRESENCE + ONEWIRE_US_RESET_REST));
+
+    //The presence pulse is not there
+    dev->present = false;
+    QCOMPARE((int)ow.reset(), 0);
+    QCOMPARE((int)ow.getTransferState(), ONEWIRE_XFER_NO_DEVICE);
+
+    //Nothing on the wire
+    OneWireEngine none(6);
+    none.begin();
+    QCOMPARE((int)none.reset(), 0);
+}
+
+void TestOneWireEngine::test_timing()
+{
+    SimBus bus;
+    SimDevice* dev = bus.add(serial);
+    dev->raw = 21*16 + 5;
+    OneWireEngine ow(6);
+    ow.setLine(&bus);
+    ow.begin();
+
+    QVERIFY(ow.reset());
+    ow.skip();
+    ow.write(DS18B20_CMD_CONVERT);
+    QCOMPARE(bus.converts, 1);
+
+    uint8_t data[9];
+    QVERIFY(ow.reset());
+    ow.select(dev->rom);
+    ow.write(DS18B20_CMD_READ_SCRATCH);
+    for( int i=0 ; i<9 ; i++ )
+    {
+        data[i] = ow.read();
+    }
+    QVERIFY(0 == memcmp(data, dev->scratch, 9));
+    QCOMPARE((int)OneWireBus::crc8(data, 9), 0);
+
+    //All slots within the datasheet
+    QCOMPARE(bus.badSlots, 0);
+    QCOMPARE(bus.slotCount, (2+10+9)*8);
+    QVERIFY(bus.shortMin >= 1);
+    QVERIFY(bus.shortMax < 15);
+    QVERIFY(bus.zeroMin >= 60);
+    QVERIFY(bus.zeroMax <= 120);
+    QVERIFY(bus.slotMin >= 61);
+    QVERIFY(bus.recoveryMin >= 1);
+    QVERIFY(bus.sampleMax < 15);
+}
+
+void TestOneWireEngine::test_power()
+{
+    SimBus bus;
+    bus.add(serial);
+    OneWireEngine ow(6);
+    ow.setLine(&bus);
+    ow.begin();
+
+    //Convert T to all, with the strong pull up
+    uint8_t cmd[2] = { ONEWIRE_CMD_SKIP_ROM, DS18B20_CMD_CONVERT };
+    QVERIFY(ow.transfer(ONEWIRE_XFER_RESET | ONEWIRE_XFER_POWER, cmd, 2, NULL, 0));
+    while(ONEWIRE_XFER_BUSY == ow.getTransferState())
+    {
+    }
+    QCOMPARE(bus.converts, 1);
+    QVERIFY(bus.powered);
+
+    //The last slot is 60us, then 10us to the power
+    QVERIFY(bus.powerDelay <= 70);
+
+    //The next reset ends it
+    QVERIFY(ow.reset());
+    QVERIFY(!bus.powered);
+
+    ow.write(0x01, 1);
+    QVERIFY(bus.powered);
+    ow.depower();
+    QVERIFY(!bus.powered);
+}
+
+void TestOneWireEngine::test_latency_data()
+{
+    QTest::addColumn<int>("latency");
+
+    QTest::newRow("ideal") << 0;
+    QTest::newRow("4us") << 4;
+    QTest::newRow("6us") << 6;
+    QTest::newRow("slow") << 10;
+}
+
+/**
+ * The interrupt is some us after the compare match on the AVR,
+ * the short recovery after a 0 must not miss the match (then it is 512us more).
+ */
+void TestOneWireEngine::test_latency()
+{
+    QFETCH(int, latency);
+
+    SimBus bus;
+    SimDevice* dev = bus.add(serial);
+    dev->raw = 21*16 + 5;
+    OneWireEngine ow(6);
+    ow.setLine(&bus);
+    ow.setLatency(latency);
+    ow.begin();
+
+    //Eight 0 bits
+    QVERIFY(ow.reset());
+    uint32_t start = ow.getTime();
+    ow.write(0x00);
+    uint32_t zeros = ow.getTime() - start;
+    QVERIFY(zeros < 8*(ONEWIRE_US_WRITE0_LOW + ONEWIRE_US_RECOVERY + latency + ONEWIRE_US_TIMER_MIN) + ONEWIRE_US_START);
+
+    //All slots within the datasheet
+    uint8_t data[9];
+    QVERIFY(ow.reset());
+    ow.select(dev->rom);
+    ow.write(DS18B20_CMD_READ_SCRATCH);
+    for( int i=0 ; i<9 ; i++ )
+    {
+        data[i] = ow.read();
+    }
+    QVERIFY(0 == memcmp(data, dev->scratch, 9));
+    QCOMPARE(bus.badSlots, 0);
+    QVERIFY(bus.slotMin >= 61);
+    QVERIFY(bus.recoveryMin >= 1);
+    QVERIFY(bus.sampleMax < 15);
+
+    //Convert T ends with a 0, the power comes after the recovery and not after the wrap
+    uint8_t cmd[2] = { ONEWIRE_CMD_SKIP_ROM, DS18B20_CMD_CONVERT };
+    QVERIFY(ow.transfer(ONEWIRE_XFER_RESET | ONEWIRE_XFER_POWER, cmd, 2, NULL, 0));
+    while(ONEWIRE_XFER_BUSY == ow.getTransferState())
+    {
+    }
+    QVERIFY(bus.powered);
+    QVERIFY(bus.powerDelay <= (uint32_t)(ONEWIRE_US_WRITE0_LOW + ONEWIRE_US_RECOVERY + latency + ONEWIRE_US_TIMER_MIN));
+}
+
+void TestOneWireEngine::test_background()
+{
+    SimBus bus;
+    SimDevice* dev = bus.add(serial);
+    dev->raw = 30*16;
+    SimBus::setTemp(dev, dev->raw);
+    OneWireEngine ow(6);
+    ow.setLine(&bus);
+    ow.begin();
+
+    //Match ROM and Read Scratchpad
+    uint8_t tx[10];
+    uint8_t rx[9];
+    tx[0] = ONEWIRE_CMD_MATCH_ROM;
+    memcpy(&tx[1], dev->rom, 8);
+    tx[9] = DS18B20_CMD_READ_SCRATCH;
+
+    //Returns at once, nothing is done yet
+    uint32_t start = ow.getTime();
+    QVERIFY(ow.transfer(ONEWIRE_XFER_RESET, tx, 10, rx, 9));
+    QCOMPARE(bus.slotCount, 0);
+    QVERIFY(!ow.transfer(ONEWIRE_XFER_RESET, tx, 10, rx, 9));
+
+    //One interrupt every look on the pc
+    int looks = 0;
+    while(ONEWIRE_XFER_BUSY == ow.getTransferState())
+    {
+        looks++;
+    }
+    QVERIFY(0 == memcmp(rx, dev->scratch, 9));
+
+    uint32_t busTime = ow.getTime() - start;
+    uint32_t busyTime = ow.getBusyTime();
+    printf("Scratchpad read: %d interrupts, %.1fms on the bus, %.1fms in the interrupt (%d%%)\n",
+            looks+1, busTime/1000.0, busyTime/1000.0, (int)(100*busyTime/busTime));
+    printf("  the OneWire library waits for the whole %.1fms\n", busTime/1000.0);
+
+    //Reset (2 interrupts) + the slots (1 or 2 each) + done
+    QVERIFY(looks >= 2 + 19*8);
+    QVERIFY(busTime > 11000);
+    QVERIFY(busTime < 13000);
+    QVERIFY(busyTime*100 < busTime*20);
+}
+
+void TestOneWireEngine::test_search()
+{
+    SimBus bus;
+    SimDevice* dev = bus.add(serial);
+    dev->raw = 20*16;
+    SimBus::setTemp(dev, dev->raw);
+    OneWireEngine ow(6);
+    ow.setLine(&bus);
+    ow.begin();
+
+    uint8_t rom[8];
+    ow.resetSearch();
+    QCOMPARE((int)ow.search(rom), 1);
+    QVERIFY(0 == memcmp(rom, dev->rom, 8));
+    QCOMPARE((int)ow.search(rom), 0);
+    QCOMPARE(bus.badSlots, 0);
+
+    //No alarm, 20 is between 10 and 75
+    dev->scratch[3] = 10;
+    ow.resetSearch();
+    QCOMPARE((int)ow.search(rom, true), 0);
+
+    //TH is 20
+    dev->scratch[2] = 20;
+    ow.resetSearch();
+    QCOMPARE((int)ow.search(rom, true), 1);
+    QVERIFY(0 == memcmp(rom, dev->rom, 8));
+
+    //Nothing on the bus
+    dev->present = false;
+    ow.resetSearch();
+    QCOMPARE((int)ow.search(rom), 0);
+}
+
+void TestOneWireEngine::test_ds18b20()
+{
+    SimBus bus;
+    SimDevice* dev = bus.add(serial);
+    dev->raw = 23*16 + 8;
+    OneWireEngine ow(6);
+    ow.setLine(&bus);
+    ow.begin();
+
+    DS18B20Bus ds(&ow);
+    ds.setAlarm(0, 10, 40);
+    QCOMPARE((int)ds.begin(), 1);
+
+    //Writes TH and TL, converts and then reads
+    ds.tick();
+    QCOMPARE((int)(int8_t)dev->scratch[2], 40);
+    QCOMPARE((int)(int8_t)dev->scratch[3], 10);
+    QCOMPARE(bus.converts, 1);
+    ds.tick();
+
+    bool ok = false;
+    QCOMPARE((int)ds.getCenti(0, &ok), 2350);
+    QVERIFY(ok);
+
+    //poll() only starts the transfers
+    dev->raw = 24*16;
+    uint32_t start = ow.getTime();
+    ds.poll(1000);
+    QVERIFY(ds.isBusy());
+    QVERIFY(ow.getTime() - start < 1000);
+    while(ds.isBusy())
+    {
+        ow.getTransferState();
+        ds.poll(0);
+    }
+    QCOMPARE(bus.converts, 3);
+    QCOMPARE(bus.badSlots, 0);
+
+    ds.poll(1000);
+    while(ds.isBusy())
+    {
+        ow.getTransferState();
+        ds.poll(0);
+    }
+    QCOMPARE((int)ds.getCenti(0, &ok), 2400);
+}
+
+QTEST_MAIN(TestOneWireEngine)
+#include "TestOneWireEngine.moc"
@@ -0,0 +1,311 @@
+/**
+ * @file TestOneWireSim.cpp
+ * @author Johan Simonsson
+ * @brief Many simulated DS18B20 on OneWireEngine and DS18B20Bus
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+#include <string.h>
+#include <stdio.h>
+
+#include "OneWireEngine.h"
+#include "DS18B20Bus.h"
+#include "../common/SimOneWireLine.h"
+
+class TestOneWireSim : public QObject
+{
+    Q_OBJECT
+
+    private:
+    public:
+
+    private slots:
+        void test_enumerate();
+        void test_read();
+        void test_resolution();
+        void test_crcFault();
+        void test_alarm();
+        void test_benchmark();
+};
+
+void TestOneWireSim::test_enumerate()
+{
+    SimBus sim;
+    sim.addMany(50, 1);
+    sim.dev[7].present = false;
+
+    OneWireEngine ow(6);
+    ow.setLine(&sim);
+    ow.begin();
+
+    DS18B20Bus ds(&ow);
+    QCOMPARE((int)ds.begin(), 49);
+
+    for( int i=0 ; i<50 ; i++ )
+    {
+        int index = ds.findRom(sim.dev[i].rom);
+        QVERIFY( (7 == i) ? (index < 0) : (index >= 0) );
+    }
+
+    //The search takes the lowest bit first, so the ROM codes is in that order
+    for( int i=1 ; i<49 ; i++ )
+    {
+        const uint8_t* a = ds.getRom(i-1);
+        const uint8_t* b = ds.getRom(i);
+        int k = 0;
+        while( (k < 64) && (((a[k>>3] >> (k&7)) & 1) == ((b[k>>3] >> (k&7)) & 1)) )
+        {
+            k++;
+        }
+        QVERIFY(k < 64);
+        QVERIFY(((a[k>>3] >> (k&7)) & 1) < ((b[k>>3] >> (k&7)) & 1));
+    }
+}
+
+void TestOneWireSim::test_read()
+{
+    SimBus sim;
+    sim.addMany(20, 2);
+    for( int i=0 ; i<20 ; i++ )
+    {
+        sim.dev[i].raw = (i*16*5) + i; // 0.0 .. 95.xx
+    }
+
+    OneWireEngine ow(6);
+    ow.setLine(&sim);
+    ow.begin();
+
+    DS18B20Bus ds(&ow);
+    QCOMPARE((int)ds.begin(), 20);
+    ds.tick();
+    ds.tick();
+    QCOMPARE(sim.converts, 2*20);
+    QCOMPARE(sim.slotCount > 0, true);
+
+    for( int i=0 ; i<20 ; i++ )
+    {
+        int index = ds.findRom(sim.dev[i].rom);
+        bool ok = false;
+        int centi = ds.getCenti(index, &ok);
+        QVERIFY(ok);
+        QCOMPARE(centi, (int)((sim.dev[i].raw*100 + 8)/16));
+    }
+}
+
+void TestOneWireSim::test_resolution()
+{
+    SimBus sim;
+    sim.addMany(4, 3);
+    for( int i=0 ; i<4 ; i++ )
+    {
+        sim.dev[i].raw = 20*16 + 15; // 20.9375
+    }
+
+    OneWireEngine ow(6);
+    ow.setLine(&sim);
+    ow.begin();
+
+    DS18B20Bus ds(&ow);
+    ds.begin();
+    for( int i=0 ; i<4 ; i++ )
+    {
+        ds.setResolution(ds.findRom(sim.dev[i].rom), 9+i);
+    }
+    QCOMPARE((int)ds.getConversionTime(), 750);
+
+    //Written and copied to all, then converted and read
+    ds.tick();
+    QCOMPARE(sim.copies, 4);
+    ds.tick();
+    ds.tick();
+
+    //The undefined bits is not used
+    int expected[4] = { 2050, 2075, 2088, 2094 };
+    for( int i=0 ; i<4 ; i++ )
+    {
+        bool ok = false;
+        int index = ds.findRom(sim.dev[i].rom);
+        QCOMPARE(SimBus::resolution(&sim.dev[i]), 9+i);
+        QCOMPARE((int)ds.getCenti(index, &ok), expected[i]);
+        QVERIFY(ok);
+    }
+}
+
+void TestOneWireSim::test_crcFault()
+{
+    SimBus sim;
+    sim.addMany(5, 4);
+    for( int i=0 ; i<5 ; i++ )
+    {
+        sim.dev[i].raw = 40*16;
+    }
+
+    OneWireEngine ow(6);
+    ow.setLine(&sim);
+    ow.begin();
+
+    DS18B20Bus ds(&ow);
+    ds.begin();
+    ds.tick();
+    ds.tick();
+
+    int bad = ds.findRom(sim.dev[2].rom);
+    sim.dev[2].crcFault = true;
+    for( int i=0 ; i<DS18B20_ERRORS_MAX ; i++ )
+    {
+        ds.tick();
+    }
+
+    for( int i=0 ; i<5 ; i++ )
+    {
+        bool ok = false;
+        ds.getCenti(i, &ok);
+        QCOMPARE(ok, (i != bad));
+    }
+
+    sim.dev[2].crcFault = false;
+    ds.tick();
+    bool ok = false;
+    QCOMPARE((int)ds.getCenti(bad, &ok), 4000);
+    QVERIFY(ok);
+}
+
+void TestOneWireSim::test_alarm()
+{
+    SimBus sim;
+    sim.addMany(30, 5);
+    for( int i=0 ; i<30 ; i++ )
+    {
+        sim.dev[i].raw = 20*16;
+    }
+
+    OneWireEngine ow(6);
+    ow.setLine(&sim);
+    ow.begin();
+
+    DS18B20Bus ds(&ow);
+    ds.begin();
+    for( int i=0 ; i<30 ; i++ )
+    {
+        ds.setAlarm(i, 10, 30);
+    }
+    ds.setHeartbeat(100);
+    ds.tick();
+    ds.tick();
+
+    //Two devices over TH, only those is read
+    int a = ds.findRom(sim.dev[4].rom);
+    int b = ds.findRom(sim.dev[17].rom);
+    sim.dev[4].raw = 35*16;
+    sim.dev[17].raw = 5*16;
+    sim.dev[20].raw = 25*16;
+    ds.tick();
+    ds.tick();
+
+    bool ok = false;
+    QCOMPARE((int)ds.getCenti(a, &ok), 3500);
+    QCOMPARE((int)ds.getCenti(b, &ok), 500);
+    QCOMPARE((int)ds.getCenti(ds.findRom(sim.dev[20].rom), &ok), 2000);
+}
+
+/**
+ * Measure the bus time for one device count.
+ */
+static void measure(int n, double* enumerate, double* tickAll, double* tickAlarm, double* busy)
+{
+    SimBus sim;
+    sim.addMany(n, 100+n);
+    for( int i=0 ; i<n ; i++ )
+    {
+        sim.dev[i].raw = 20*16;
+    }
+
+    OneWireEngine ow(6);
+    ow.setLine(&sim);
+    ow.begin();
+
+    DS18B20Bus ds(&ow);
+    uint32_t start = ow.getTime();
+    QCOMPARE((int)ds.begin(), n);
+    *enumerate = (ow.getTime() - start) / 1000.0;
+
+    for( int i=0 ; i<n ; i++ )
+    {
+        ds.setAlarm(i, 10, 30);
+    }
+    ds.setHeartbeat(2);
+    ds.tick(); // Write TH, TL and convert
+
+    start = ow.getTime();
+    uint32_t busyStart = ow.getBusyTime();
+    ds.tick(); // Heartbeat, read all
+    *tickAll = (ow.getTime() - start) / 1000.0;
+    *busy = 100.0 * (ow.getBusyTime() - busyStart) / (ow.getTime() - start);
+
+    sim.dev[n/2].raw = 40*16;
+    ds.tick(); // Converts 40
+    ds.tick(); // Heartbeat
+
+    start = ow.getTime();
+    ds.tick(); // Only the one with a alarm
+    *tickAlarm = (ow.getTime() - start) / 1000.0;
+
+    bool ok = false;
+    QCOMPARE((int)ds.getCenti(ds.findRom(sim.dev[n/2].rom), &ok), 4000);
+}
+
+void TestOneWireSim::test_benchmark()
+{
+    int counts[] = { 1, 2, 4, 8, 16, 32, 50, 64 };
+    double enumerate[8];
+    double tickAll[8];
+    double tickAlarm[8];
+    double busy[8];
+
+    printf("OneWire bus simulator, bus time with OneWireEngine\n");
+    printf("  devices  enumerate  tick all (in isr)  tick with 1 alarm\n");
+    for( int i=0 ; i<8 ; i++ )
+    {
+        measure(counts[i], &enumerate[i], &tickAll[i], &tickAlarm[i], &busy[i]);
+        printf("  %7d  %7.1fms  %7.1fms (%2.0f%%)  %7.1fms\n",
+                counts[i], enumerate[i], tickAll[i], busy[i], tickAlarm[i]);
+    }
+
+    for( int i=0 ; i<8 ; i++ )
+    {
+        int n = counts[i];
+
+        //A search is about 200 slots and a reset for every device
+        QVERIFY(enumerate[i] > n*15.0);
+        QVERIFY(enumerate[i] < n*17.0 + 2.0);
+
+        //A scratchpad read is 11.6ms, and the conversion 1.6ms
+        QVERIFY(tickAll[i] < n*12.0 + 2.0);
+        QVERIFY(busy[i] < 20.0);
+    }
+
+    //The alarm search is one search and one read, whatever the count
+    QVERIFY(tickAlarm[7] < 35.0);
+    QVERIFY(tickAlarm[7]*10 < tickAll[7]);
+}
+
+QTEST_MAIN(TestOneWireSim)
+#include "TestOneWireSim.moc"
@@ -0,0 +1,15 @@
+CONFIG += qtestlib debug
+TEMPLATE = app
+TARGET = 
+DEFINES += private=public DS18B20_DEVICES_MAX=64
+
+# Test code
+DEPENDPATH += .
+INCLUDEPATH += .
+SOURCES += TestOneWireSim.cpp
+
+# Code to test
+DEPENDPATH  += ../../FunTechHouse_Thermostat/
+INCLUDEPATH += ../../FunTechHouse_Thermostat/
+SOURCES += OneWireEngine.cpp OneWireBus.cpp DS18B20Bus.cpp
+
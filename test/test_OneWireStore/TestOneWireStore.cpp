@@ -0,0 +1,323 @@
+/**
+ * @file TestOneWireStore.cpp
+ * @author Johan Simonsson
+ * @brief Testfile for OneWireStore
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+#include <string.h>
+
+#include "OneWireStore.h"
+#include "../common/FakeOneWireBus.h"
+
+#define SENSORS 3
+
+/**
+ * One tick like loop(), a lost device starts a new search.
+ */
+static void loopTick(DS18B20Bus* ds, OneWireStore* store, TemperatureSensor* sensors)
+{
+    ds->tick();
+    if(ds->hasLost())
+    {
+        store->rescan(ds, sensors, SENSORS);
+    }
+}
+
+class TestOneWireStore : public QObject
+{
+    Q_OBJECT
+
+    private:
+        void setup(TemperatureSensor* sensors);
+
+    public:
+
+    private slots:
+        void test_firstBoot();
+        void test_load();
+        void test_newDevice();
+        void test_badRecord();
+        void test_rescan();
+};
+
+/**
+ * A empty EEPROM and the DS18B20 sensors.
+ */
+void TestOneWireStore::setup(TemperatureSensor* sensors)
+{
+    memset(oneWireStoreEeprom, 0xFF, sizeof(oneWireStoreEeprom));
+    oneWireStoreWrites = 0;
+    for( int i=0 ; i<SENSORS ; i++ )
+    {
+        sensors[i].setSensor(TemperatureSensor::DS18B20, 6);
+    }
+}
+
+void TestOneWireStore::test_firstBoot()
+{
+    TemperatureSensor sensors[SENSORS];
+    setup(sensors);
+
+    FakeOneWireBus bus;
+    bus.add(DS18B20_FAMILY_DS18B20, 0x10, 20*16);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x20, 21*16);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x30, 22*16);
+
+    DS18B20Bus ds(&bus);
+    OneWireStore store(16);
+    QCOMPARE((int)OneWireStore::getSize(), 4 + 12*DS18B20_DEVICES_MAX);
+
+    //Nothing saved, search and save
+    QVERIFY(!store.load(&ds, sensors, SENSORS));
+    QCOMPARE((int)ds.getCount(), 0);
+    QCOMPARE((int)ds.begin(), 3);
+
+    sensors[0].setOneWire(&ds, 2);
+    sensors[2].setOneWire(&ds, 0);
+    sensors[2].setValueOffset(-1.25);
+    QVERIFY(store.save(&ds, sensors, SENSORS));
+    QCOMPARE((int)oneWireStoreEeprom[16], ONEWIRE_STORE_MAGIC);
+    QCOMPARE((int)oneWireStoreEeprom[16+2], 3);
+    QCOMPARE((int)oneWireStoreEeprom[15], 0xFF);
+    QCOMPARE((int)oneWireStoreEeprom[16+4+3*12], 0xFF);
+
+    //Only the changes is written
+    int writes = oneWireStoreWrites;
+    QVERIFY(store.save(&ds, sensors, SENSORS));
+    QCOMPARE((int)oneWireStoreWrites, writes);
+    sensors[2].setValueOffset(-1.5);
+    QVERIFY(store.save(&ds, sensors, SENSORS));
+    QVERIFY(oneWireStoreWrites - writes <= 2+1);
+
+    //A sensor with a device that is not on the bus is not saved
+    sensors[1].setOneWire(&ds, 3);
+    writes = oneWireStoreWrites;
+    QVERIFY(!store.save(&ds, sensors, SENSORS));
+    QCOMPARE((int)oneWireStoreWrites, writes);
+
+    store.erase();
+    DS18B20Bus again(&bus);
+    QVERIFY(!store.load(&again, sensors, SENSORS));
+}
+
+void TestOneWireStore::test_load()
+{
+    TemperatureSensor sensors[SENSORS];
+    setup(sensors);
+
+    FakeOneWireBus bus;
+    bus.add(DS18B20_FAMILY_DS18B20, 0x10, 20*16);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x20, 21*16);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x30, 22*16);
+
+    {
+        DS18B20Bus ds(&bus);
+        OneWireStore store(0);
+        ds.begin();
+        sensors[0].setOneWire(&ds, 2);
+        sensors[1].setOneWire(&ds, 1);
+        sensors[1].setValueOffset(0.37);
+        sensors[2].setValueOffset(-2.0); // Not a DS18B20 on this bus
+        store.save(&ds, sensors, SENSORS);
+    }
+
+    //The next boot, no search
+    TemperatureSensor boot[SENSORS];
+    for( int i=0 ; i<SENSORS ; i++ )
+    {
+        boot[i].setSensor(TemperatureSensor::DS18B20, 6);
+    }
+    bus.searches = 0;
+    DS18B20Bus ds(&bus);
+    OneWireStore store(0);
+    QVERIFY(store.load(&ds, boot, SENSORS));
+    QCOMPARE(bus.searches, 0);
+    QCOMPARE((int)ds.getCount(), 3);
+    QVERIFY(0 == memcmp(ds.getRom(1), bus.dev[1].rom, 8));
+
+    uint8_t index = 0;
+    QVERIFY(boot[0].getOneWire(&index) == &ds);
+    QCOMPARE((int)index, 2);
+    QVERIFY(boot[1].getOneWire(&index) == &ds);
+    QCOMPARE((int)index, 1);
+    QCOMPARE(boot[1].getValueOffset(), 0.37);
+    QVERIFY(boot[2].getOneWire(&index) == NULL);
+    QCOMPARE(boot[2].getValueOffset(), 0.0);
+
+    //And the devices is read as usual
+    ds.tick();
+    ds.tick();
+    bool ok = false;
+    QCOMPARE((int)boot[0].readOneWire(&ok), 2200);
+    QVERIFY(ok);
+    QVERIFY(!ds.hasLost());
+}
+
+void TestOneWireStore::test_newDevice()
+{
+    TemperatureSensor sensors[SENSORS];
+    setup(sensors);
+
+    FakeOneWireBus bus;
+    bus.add(DS18B20_FAMILY_DS18B20, 0x10, 20*16);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x20, 21*16);
+
+    OneWireStore store(0);
+    {
+        DS18B20Bus ds(&bus);
+        ds.begin();
+        sensors[0].setOneWire(&ds, 1);
+        store.save(&ds, sensors, SENSORS);
+    }
+
+    //A new device first in the search order, the sensor keeps its device
+    bus.insert(0, DS18B20_FAMILY_DS18B20, 0x05, 30*16);
+    DS18B20Bus ds(&bus);
+    QVERIFY(store.load(&ds, sensors, SENSORS));
+    QCOMPARE((int)ds.getCount(), 2);
+
+    ds.tick();
+    ds.tick();
+    bool ok = false;
+    QCOMPARE((int)sensors[0].readOneWire(&ok), 2100);
+    QVERIFY(ok);
+}
+
+void TestOneWireStore::test_badRecord()
+{
+    TemperatureSensor sensors[SENSORS];
+    setup(sensors);
+
+    FakeOneWireBus bus;
+    bus.add(DS18B20_FAMILY_DS18B20, 0x10, 20*16);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x20, 21*16);
+
+    DS18B20Bus ds(&bus);
+    OneWireStore store(0);
+    ds.begin();
+    store.save(&ds, sensors, SENSORS);
+
+    //One bit in the second record, then nothing is used
+    oneWireStoreEeprom[4+12+3] ^= 0x10;
+    DS18B20Bus bad(&bus);
+    QVERIFY(!store.load(&bad, sensors, SENSORS));
+    QCOMPARE((int)bad.getCount(), 0);
+
+    //A other version
+    store.save(&ds, sensors, SENSORS);
+    oneWireStoreEeprom[1]++;
+    QVERIFY(!store.load(&bad, sensors, SENSORS));
+}
+
+void TestOneWireStore::test_rescan()
+{
+    TemperatureSensor sensors[SENSORS];
+    setup(sensors);
+
+    FakeOneWireBus bus;
+    bus.add(DS18B20_FAMILY_DS18B20, 0x10, 20*16);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x20, 21*16);
+    bus.add(DS18B20_FAMILY_DS18B20, 0x30, 22*16);
+
+    OneWireStore store(0);
+    {
+        DS18B20Bus ds(&bus);
+        ds.begin();
+        sensors[0].setOneWire(&ds, 2);
+        sensors[1].setOneWire(&ds, 1);
+        store.save(&ds, sensors, SENSORS);
+    }
+
+    //The device for sensor 1 is gone
+    FakeDevice gone = bus.remove(1);
+    DS18B20Bus ds(&bus);
+    QVERIFY(store.load(&ds, sensors, SENSORS));
+    bus.searches = 0;
+    int writes = oneWireStoreWrites;
+    for( int i=0 ; i<DS18B20_ERRORS_MAX ; i++ )
+    {
+        loopTick(&ds, &store, sensors);
+        QVERIFY(!ds.hasLost());
+    }
+    QCOMPARE(bus.searches, 0);
+
+    //The search finds the others, the lost one is kept and the EEPROM is kept
+    loopTick(&ds, &store, sensors);
+    QCOMPARE(bus.searches, 1);
+    QCOMPARE((int)ds.getCount(), 3);
+    QCOMPARE((int)oneWireStoreWrites, writes);
+
+    uint8_t index = 0;
+    sensors[0].getOneWire(&index);
+    QCOMPARE((int)index, 1);
+    sensors[1].getOneWire(&index);
+    QCOMPARE((int)index, 2);
+    ds.tick();
+    ds.tick();
+    bool ok = false;
+    QCOMPARE((int)sensors[0].readOneWire(&ok), 2200);
+    QVERIFY(ok);
+    sensors[1].readOneWire(&ok);
+    QVERIFY(!ok);
+
+    //It is still lost, but the next search waits
+    for( int i=0 ; i<ONEWIRE_STORE_RESCAN_WAIT ; i++ )
+    {
+        loopTick(&ds, &store, sensors);
+    }
+    QCOMPARE(bus.searches, 1);
+    for( int i=0 ; (i<DS18B20_ERRORS_MAX+2) && (bus.searches < 2) ; i++ )
+    {
+        loopTick(&ds, &store, sensors);
+    }
+    QCOMPARE(bus.searches, 2);
+    QCOMPARE((int)ds.getCount(), 3);
+
+    //It is back, and the sensor gets it again without a search
+    bus.insert(0, DS18B20_FAMILY_DS18B20, gone.rom[1] - 1, 23*16);
+    for( int i=0 ; i<3 ; i++ )
+    {
+        loopTick(&ds, &store, sensors);
+    }
+    QVERIFY(!ds.hasLost());
+    QCOMPARE((int)sensors[1].readOneWire(&ok), 2300);
+    QVERIFY(ok);
+    QCOMPARE((int)sensors[0].readOneWire(&ok), 2200);
+    QVERIFY(ok);
+    QCOMPARE(bus.searches, 2);
+
+    //And the next boot has all three
+    QVERIFY(store.save(&ds, sensors, SENSORS));
+    TemperatureSensor boot[SENSORS];
+    for( int i=0 ; i<SENSORS ; i++ )
+    {
+        boot[i].setSensor(TemperatureSensor::DS18B20, 6);
+    }
+    DS18B20Bus next(&bus);
+    QVERIFY(store.load(&next, boot, SENSORS));
+    QCOMPARE((int)next.getCount(), 3);
+    boot[1].getOneWire(&index);
+    QVERIFY(0 == memcmp(next.getRom(index), gone.rom, 8));
+}
+
+QTEST_MAIN(TestOneWireStore)
+#include "TestOneWireStore.moc"
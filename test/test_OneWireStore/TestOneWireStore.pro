@@ -0,0 +1,16 @@
+CONFIG += qtestlib debug
+TEMPLATE = app
+TARGET = 
+DEFINES += private=public
+
+# Test code
+DEPENDPATH += .
+INCLUDEPATH += .
+SOURCES += TestOneWireStore.cpp
+
+# Code to test
+DEPENDPATH  += ../../FunTechHouse_Thermostat/
+INCLUDEPATH += ../../FunTechHouse_Thermostat/
+SOURCES += OneWireStore.cpp TemperatureSensor.cpp Sensor.cpp MQTT_Logic.cpp StringHelp.cpp SpikeFilter.cpp
+SOURCES += AnalogSensor.cpp LVTS.cpp DS18B20Bus.cpp OneWireBus.cpp DHTSensor.cpp AdcSampler.cpp Oversample.cpp KalmanFilter.cpp
+
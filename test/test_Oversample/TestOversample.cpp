@@ -0,0 +1,253 @@
+/**
+ * @file TestOversample.cpp
+ * @author Johan Simonsson
+ * @brief Testfile and ENOB benchmark for Oversample
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+#include <stdio.h>
+#include <math.h>
+
+#include "Oversample.h"
+#include "LVTS.h"
+
+class TestOversample : public QObject
+{
+    Q_OBJECT
+
+    private:
+    public:
+
+    private slots:
+        void test_decimate();
+        void test_bits();
+        void test_noDither();
+        void test_enob();
+        void test_lm35();
+};
+
+/**
+ * Simple random numbers, so the test is the same every time.
+ */
+static unsigned long randomState = 1;
+static int randomInt(int max)
+{
+    randomState = randomState * 1103515245UL + 12345UL;
+    return (int)((randomState >> 16) % max);
+}
+
+/**
+ * Gaussian noise, the sum of 12 uniform is close enough.
+ *
+ * @param sigma the standard deviation
+ */
+static double noise(double sigma)
+{
+    double sum = 0;
+    for( int i=0 ; i<12 ; i++ )
+    {
+        sum += randomInt(10000)/10000.0;
+    }
+    return (sum-6.0)*sigma;
+}
+
+/**
+ * The 10bit adc, rounded to nearest step.
+ */
+static uint16_t adc(double volt)
+{
+    double step = floor(volt + 0.5);
+    if(step < 0)
+    {
+        step = 0;
+    }
+    if(step > 1023)
+    {
+        step = 1023;
+    }
+    return (uint16_t)step;
+}
+
+void TestOversample::test_decimate()
+{
+    Oversample over(2);
+    QCOMPARE((int)over.getSampleCount(), 16);
+
+    //16 samples is 4*mean, so 10 and 11 half each is 42
+    for( int i=0 ; i<15 ; i++ )
+    {
+        QVERIFY(!over.addValue(10 + (i%2)));
+    }
+    QVERIFY(over.addValue(11));
+    QCOMPARE((int)over.getValue(), 42);
+
+    //The value stays until the next is done
+    QVERIFY(!over.addValue(0));
+    QCOMPARE((int)over.getValue(), 42);
+
+    //Full scale
+    over.init();
+    for( int i=0 ; i<16 ; i++ )
+    {
+        over.addValue(1023);
+    }
+    QCOMPARE((int)over.getValue(), 1023<<2);
+}
+
+void TestOversample::test_bits()
+{
+    Oversample none;
+    QCOMPARE((int)none.getBits(), 0);
+    QCOMPARE((int)none.getSampleCount(), 1);
+    QVERIFY(none.addValue(512));
+    QCOMPARE((int)none.getValue(), 512);
+
+    //Full scale for all bits, the sum must not overflow
+    for( int bits=0 ; bits<=OVERSAMPLE_BITS_MAX ; bits++ )
+    {
+        Oversample over(bits);
+        QCOMPARE((int)over.getSampleCount(), 1<<(2*bits));
+        bool done = false;
+        for( int i=0 ; i<over.getSampleCount() ; i++ )
+        {
+            done = over.addValue(1023);
+        }
+        QVERIFY(done);
+        QCOMPARE((int)over.getValue(), 1023<<bits);
+    }
+
+    Oversample tooMany(OVERSAMPLE_BITS_MAX+1);
+    QCOMPARE((int)tooMany.getBits(), OVERSAMPLE_BITS_MAX);
+}
+
+void TestOversample::test_noDither()
+{
+    //Without noise there is nothing to gain, 500.3 is always 500
+    for( int bits=1 ; bits<=4 ; bits++ )
+    {
+        Oversample over(bits);
+        for( int i=0 ; i<over.getSampleCount() ; i++ )
+        {
+            over.addValue(adc(500.3));
+        }
+        QCOMPARE((int)over.getValue(), 500<<bits);
+    }
+}
+
+/**
+ * ENOB for a slow random signal with gaussian dither.
+ *
+ * The error is compared with the true value (in 10bit steps),
+ * and a ideal 10bit adc has the error 1/sqrt(12) steps,
+ * ENOB = log2(1024 / (rms*sqrt(12))).
+ *
+ * @param bits extra bits
+ * @param sigma dither in adc steps
+ * @return effective number of bits
+ */
+static double enob(uint8_t bits, double sigma)
+{
+    const int values = 4000;
+    Oversample over(bits);
+    double err = 0;
+
+    randomState = 42;
+    for( int i=0 ; i<values ; i++ )
+    {
+        //Any value in 100..900, constant during one oversample
+        double truth = 100.0 + randomInt(800000)/1000.0;
+        for( int j=0 ; j<over.getSampleCount() ; j++ )
+        {
+            over.addValue( adc(truth + noise(sigma)) );
+        }
+
+        double e = (over.getValue() / (double)(1<<bits)) - truth;
+        err += e*e;
+    }
+
+    double rms = sqrt(err/values);
+    return log2(1024.0/(rms*sqrt(12.0)));
+}
+
+void TestOversample::test_enob()
+{
+    printf("Oversample ENOB, 10bit adc with gaussian dither\n");
+    printf("  sigma  bits=0  bits=1  bits=2  bits=3  bits=4\n");
+
+    double sigmas[] = { 0.0, 0.5, 1.0, 1.5 };
+    for( int s=0 ; s<4 ; s++ )
+    {
+        double result[5];
+        printf("  %5.2f", sigmas[s]);
+        for( int bits=0 ; bits<=4 ; bits++ )
+        {
+            result[bits] = enob(bits, sigmas[s]);
+            printf("  %6.2f", result[bits]);
+        }
+        printf("\n");
+
+        if(0 == s)
+        {
+            //No dither, no gain
+            QVERIFY(fabs(result[4] - result[0]) < 0.2);
+            QVERIFY(fabs(result[0] - 10.0) < 0.1);
+        }
+        else if(sigmas[s] >= 1.0)
+        {
+            //Close to one bit for every 4x samples
+            for( int bits=1 ; bits<=4 ; bits++ )
+            {
+                QVERIFY(result[bits] - result[0] > bits - 0.3);
+            }
+        }
+    }
+
+    //The LM35 noise is about 1.5 steps, 16x gives 2 bits more than one sample,
+    //and 64x is better than a ideal 10bit adc.
+    QVERIFY(enob(2, 1.5) - enob(0, 1.5) > 1.7);
+    QVERIFY(enob(3, 1.5) > 10.0);
+}
+
+void TestOversample::test_lm35()
+{
+    //Same temperature with and without the extra bits
+    bool ok = false;
+    double t10 = LVTS::lm35(279, &ok);
+    QVERIFY(ok);
+    double t12 = LVTS::lm35(279*4, &ok, 2);
+    QVERIFY(ok);
+    QCOMPARE(t12, t10);
+
+    //A quarter step is now seen
+    t12 = LVTS::lm35(279*4+1, &ok, 2);
+    QVERIFY(fabs(t12 - t10 - (110.0/4096)) < 0.0001);
+
+    //Same limit
+    for( long read=4*950 ; read<=4*1000 ; read++ )
+    {
+        LVTS::lm35(read, &ok, 2);
+        QCOMPARE(LVTS::lm35Valid(read, 2), ok);
+    }
+    QVERIFY(!LVTS::lm35Valid(-1, 2));
+}
+
+QTEST_MAIN(TestOversample)
+#include "TestOversample.moc"
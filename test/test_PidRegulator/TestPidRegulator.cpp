@@ -0,0 +1,339 @@
+/**
+ * @file TestPidRegulator.cpp
+ * @author Johan Simonsson
+ * @brief Testfile for PidRegulator and the Regulator stage quantizer
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+
+#include "PidRegulator.h"
+
+class TestPidRegulator : public QObject
+{
+    Q_OBJECT
+
+    private:
+    public:
+
+    private slots:
+        void test_setOutput();
+        void test_setOutput_data();
+        void test_setOutputHyst();
+        void test_setOutputPwm();
+        void test_setOutputPwm_data();
+
+        void test_proportional();
+        void test_integral();
+        void test_antiWindup();
+        void test_derivativeOnMeasurement();
+        void test_samplePeriod();
+        void test_getValueString();
+        void test_command();
+
+        void test_benchmark();
+};
+
+void TestPidRegulator::test_setOutput_data()
+{
+    QTest::addColumn<unsigned int>("type");
+    QTest::addColumn<uint8_t>("outMax");
+    QTest::addColumn<unsigned int>("out");
+    QTest::addColumn<uint8_t>("stageOut");
+
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_LINEAR  << (uint8_t)0x7 <<     0u << (uint8_t)0x0;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_LINEAR  << (uint8_t)0x7 <<  3333u << (uint8_t)0x1;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_LINEAR  << (uint8_t)0x7 <<  6666u << (uint8_t)0x3;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_LINEAR  << (uint8_t)0x7 << 10000u << (uint8_t)0x7;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_LINEAR  << (uint8_t)0x7 << 20000u << (uint8_t)0x7;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_LINEAR  << (uint8_t)0x3 << 10000u << (uint8_t)0x3;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_LINEAR  << (uint8_t)0x3 <<  5000u << (uint8_t)0x1;
+
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_BIN_CNT << (uint8_t)0x7 <<     0u << (uint8_t)0x0;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_BIN_CNT << (uint8_t)0x7 <<  1428u << (uint8_t)0x1;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_BIN_CNT << (uint8_t)0x7 <<  4285u << (uint8_t)0x3;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_BIN_CNT << (uint8_t)0x7 << 10000u << (uint8_t)0x7;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_BIN_CNT << (uint8_t)0x4 << 10000u << (uint8_t)0x4;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_BIN_CNT << (uint8_t)0x4 <<  5000u << (uint8_t)0x2;
+}
+
+/**
+ * The quantizer picks the nearest level.
+ */
+void TestPidRegulator::test_setOutput()
+{
+    QFETCH(unsigned int, type);
+    QFETCH(uint8_t, outMax);
+    QFETCH(unsigned int, out);
+    QFETCH(uint8_t, stageOut);
+
+    PidRegulator pid(3, (ThermostatType)type);
+    QVERIFY(pid.setOutMax(outMax));
+    pid.setOutput(out);
+    QCOMPARE(pid.stageOut, stageOut);
+}
+
+/**
+ * Between two levels the quantizer keeps the old level.
+ */
+void TestPidRegulator::test_setOutputHyst()
+{
+    PidRegulator pid(3, THERMOSTAT_TYPE_LINEAR);
+
+    pid.setOutput(3333);
+    QCOMPARE(pid.stageOut, (uint8_t)0x1);
+
+    //1.55 stages is nearest 2, but inside the hysteresis.
+    pid.setOutput(5166);
+    QCOMPARE(pid.stageOut, (uint8_t)0x1);
+
+    //1.7 stages
+    pid.setOutput(5666);
+    QCOMPARE(pid.stageOut, (uint8_t)0x3);
+
+    //1.45 stages, still 2
+    pid.setOutput(4833);
+    QCOMPARE(pid.stageOut, (uint8_t)0x3);
+
+    //1.3 stages
+    pid.setOutput(4333);
+    QCOMPARE(pid.stageOut, (uint8_t)0x1);
+
+    pid.setOutput(0);
+    QCOMPARE(pid.stageOut, (uint8_t)0x0);
+}
+
+void TestPidRegulator::test_setOutputPwm_data()
+{
+    QTest::addColumn<unsigned int>("type");
+    QTest::addColumn<unsigned int>("out");
+    QTest::addColumn<uint8_t>("stageOut");
+    QTest::addColumn<unsigned int>("duty");
+
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_LINEAR  <<     0u << (uint8_t)0x0 << 100u;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_LINEAR  <<  1000u << (uint8_t)0x1 <<  29u;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_LINEAR  <<  5000u << (uint8_t)0x3 <<  50u;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_LINEAR  << 10000u << (uint8_t)0x7 << 100u;
+
+    //3.5 => 100 with 3/4 + 1/8 on
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_BIN_CNT <<  5000u << (uint8_t)0x4 <<  87u;
+    //2.5 => 011 where the top stage is 010, 1+2*3/4
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_BIN_CNT <<  3571u << (uint8_t)0x3 <<  74u;
+}
+
+/**
+ * With time proportional output the top stage gets the fraction.
+ */
+void TestPidRegulator::test_setOutputPwm()
+{
+    QFETCH(unsigned int, type);
+    QFETCH(unsigned int, out);
+    QFETCH(uint8_t, stageOut);
+    QFETCH(unsigned int, duty);
+
+    PidRegulator pid(3, (ThermostatType)type);
+    pid.setCycleTime(100);
+    pid.setOutput(out);
+    pid.pwm.restart();
+
+    QCOMPARE(pid.stageOut, stageOut);
+    QCOMPARE((unsigned int)pid.pwm.getDuty(), duty);
+
+    //And the reported output is about the same as the wanted.
+    int diff = (int)pid.getOutValue() - (int)(out/100);
+    QVERIFY(diff <= 1 && diff >= -1);
+}
+
+void TestPidRegulator::test_proportional()
+{
+    PidRegulator pid(3, THERMOSTAT_TYPE_LINEAR);
+    pid.setSetpoint(50.0);
+    pid.setTuning(10.0, 0.0, 0.0);
+
+    //5 degrees low and 10%/degree
+    pid.valueTimeToSend(45.0);
+    QCOMPARE(pid.getOutput(), (uint16_t)5000);
+
+    pid.valueTimeToSend(50.0);
+    QCOMPARE(pid.getOutput(), (uint16_t)0);
+
+    //Over setpoint, never less than 0
+    pid.valueTimeToSend(60.0);
+    QCOMPARE(pid.getOutput(), (uint16_t)0);
+
+    //Far away, never more than 100%
+    pid.valueTimeToSend(20.0);
+    QCOMPARE(pid.getOutput(), (uint16_t)REGULATOR_OUT_MAX);
+    QCOMPARE(pid.stageOut, (uint8_t)0x7);
+}
+
+void TestPidRegulator::test_integral()
+{
+    PidRegulator pid(3, THERMOSTAT_TYPE_LINEAR);
+    pid.setSetpoint(50.0);
+    pid.setTuning(0.0, 1.0, 0.0);
+
+    //1 degree low and 1%/(degree*s) => 1% more every tick
+    for(int i=1; i<=10; i++)
+    {
+        pid.valueTimeToSend(49.0);
+        QCOMPARE(pid.getOutput(), (uint16_t)(i*100));
+    }
+
+    //On the setpoint the integral holds the output
+    pid.valueTimeToSend(50.0);
+    QCOMPARE(pid.getOutput(), (uint16_t)1000);
+
+    //Over and it goes down again
+    pid.valueTimeToSend(52.0);
+    QCOMPARE(pid.getOutput(), (uint16_t)800);
+}
+
+void TestPidRegulator::test_antiWindup()
+{
+    PidRegulator pid(3, THERMOSTAT_TYPE_LINEAR);
+    pid.setSetpoint(50.0);
+    pid.setTuning(10.0, 1.0, 0.0);
+
+    //P alone is over 100%, so the integral shall not grow.
+    for(int i=0; i<1000; i++)
+    {
+        pid.valueTimeToSend(30.0);
+        QCOMPARE(pid.getOutput(), (uint16_t)REGULATOR_OUT_MAX);
+    }
+    QCOMPARE(pid.iTerm, (int32_t)0);
+
+    //So when we reach the setpoint the output is off at once.
+    pid.valueTimeToSend(50.0);
+    QCOMPARE(pid.getOutput(), (uint16_t)0);
+
+    //Integral only, it stops at 100%
+    pid.setTuning(0.0, 1.0, 0.0);
+    for(int i=0; i<1000; i++)
+    {
+        pid.valueTimeToSend(40.0);
+    }
+    QCOMPARE(pid.getOutput(), (uint16_t)REGULATOR_OUT_MAX);
+
+    //and turns down at once when over the setpoint.
+    pid.valueTimeToSend(51.0);
+    QCOMPARE(pid.getOutput(), (uint16_t)(REGULATOR_OUT_MAX-100));
+}
+
+void TestPidRegulator::test_derivativeOnMeasurement()
+{
+    PidRegulator pid(3, THERMOSTAT_TYPE_LINEAR);
+    pid.setSetpoint(50.0);
+    pid.setTuning(10.0, 0.0, 10.0);
+
+    pid.valueTimeToSend(45.0);
+    QCOMPARE(pid.getOutput(), (uint16_t)5000);
+
+    //A setpoint step gives no derivative kick, only P.
+    pid.setSetpoint(55.0);
+    pid.valueTimeToSend(45.0);
+    QCOMPARE(pid.getOutput(), (uint16_t)10000);
+    pid.setSetpoint(50.0);
+    pid.valueTimeToSend(45.0);
+    QCOMPARE(pid.getOutput(), (uint16_t)5000);
+
+    //Rising 1 degree per tick, 10%*s/degree => -10%
+    pid.valueTimeToSend(46.0);
+    QCOMPARE(pid.getOutput(), (uint16_t)(4000-1000));
+}
+
+void TestPidRegulator::test_samplePeriod()
+{
+    PidRegulator pid(3, THERMOSTAT_TYPE_LINEAR);
+    pid.setSetpoint(50.0);
+    pid.setTuning(0.0, 1.0, 0.0);
+    pid.setSamplePeriod(10);
+
+    //First value is always used
+    pid.valueTimeToSend(49.0);
+    QCOMPARE(pid.getOutput(), (uint16_t)1000);
+
+    //Then nothing until 10 ticks has passed, and the integral counts all 10.
+    for(int i=1; i<10; i++)
+    {
+        pid.valueTimeToSend(49.0);
+        QCOMPARE(pid.getOutput(), (uint16_t)1000);
+    }
+    pid.valueTimeToSend(49.0);
+    QCOMPARE(pid.getOutput(), (uint16_t)2000);
+}
+
+/**
+ * Same MQTT value string as the Thermostat.
+ */
+void TestPidRegulator::test_getValueString()
+{
+    PidRegulator pid(4, THERMOSTAT_TYPE_LINEAR);
+    pid.setSetpoint(40.0);
+    pid.setTuning(10.0, 0.0, 0.0);
+
+    QCOMPARE(pid.valueTimeToSend(35.0), true);
+
+    char str[80];
+    QVERIFY(pid.getValueString(str, 80));
+    QCOMPARE(QString(str), QString("value=35.00 ; setpoint=40.00 ; output=050%"));
+}
+
+/**
+ * The setpoint from the server, only inside the range.
+ */
+void TestPidRegulator::test_command()
+{
+    PidRegulator pid(4, THERMOSTAT_TYPE_LINEAR);
+    pid.setSetpoint(40.0);
+
+    char cmd[] = "setpoint=55.5";
+    QVERIFY(pid.commandParse(cmd, strlen(cmd)));
+    QCOMPARE(pid.setpoint, 55.5);
+
+    char bad[] = "setpoint=500 ; setpoint=-1";
+    QVERIFY(!pid.commandParse(bad, strlen(bad)));
+    QCOMPARE(pid.setpoint, 55.5);
+}
+
+/**
+ * Host time for one PID update,
+ * see test/hw_PidRegulator for the cycles on the AVR.
+ */
+void TestPidRegulator::test_benchmark()
+{
+    PidRegulator pid(3, THERMOSTAT_TYPE_BIN_CNT);
+    pid.setSetpoint(50.0);
+    pid.setTuning(10.0, 0.1, 5.0);
+    pid.setCycleTime(600);
+
+    int32_t v = 4000;
+    QBENCHMARK
+    {
+        for(int i=0; i<1000; i++)
+        {
+            pid.calcPid(v + (i & 0xFF));
+            pid.setOutput(pid.getOutput());
+        }
+    }
+}
+
+QTEST_MAIN(TestPidRegulator)
+#include "TestPidRegulator.moc"
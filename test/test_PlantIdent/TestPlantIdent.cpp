@@ -0,0 +1,179 @@
+/**
+ * @file TestPlantIdent.cpp
+ * @author Johan Simonsson
+ * @brief Testfile for PlantIdent
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+#include <math.h>
+
+#include "PlantIdent.h"
+
+class TestPlantIdent : public QObject
+{
+    Q_OBJECT
+
+    private:
+    public:
+
+    private slots:
+        void test_stepResponse();
+        void test_stepResponse_data();
+        void test_noStep();
+        void test_abort();
+        void test_average();
+};
+
+/**
+ * First order plus dead time step response.
+ *
+ * @return value in 0.01 degrees
+ */
+static int16_t fopdt(int t, double y0, double dy, double deadTime, double tau)
+{
+    double y = y0;
+    if(t > deadTime)
+    {
+        y += dy * (1.0 - exp(-(t-deadTime)/tau));
+    }
+    return (int16_t)round(y*100);
+}
+
+void TestPlantIdent::test_stepResponse_data()
+{
+    QTest::addColumn<int>("deadTime");
+    QTest::addColumn<int>("tau");
+    QTest::addColumn<double>("dy");
+    QTest::addColumn<int>("du");
+
+    QTest::newRow("boiler") << 30 << 300 << 20.0 << 33;
+    QTest::newRow("tank")   << 90 << 900 << 30.0 << 50;
+    QTest::newRow("fast")   << 10 << 100 << 10.0 << 14;
+}
+
+/**
+ * The estimates must be within some % of the real plant.
+ */
+void TestPlantIdent::test_stepResponse()
+{
+    QFETCH(int, deadTime);
+    QFETCH(int, tau);
+    QFETCH(double, dy);
+    QFETCH(int, du);
+
+    PlantIdent plant;
+    QVERIFY(!plant.isValid());
+
+    plant.stepStart(fopdt(0, 40.0, dy, deadTime, tau), du);
+
+    int t = 1;
+    while(!plant.resultTimeToSend() && t < PLANT_STEP_MAX)
+    {
+        plant.addValue(fopdt(t, 40.0, dy, deadTime, tau));
+        t++;
+    }
+
+    QVERIFY(plant.isValid());
+
+    //qDebug() << plant.getDeadTime() << plant.getTimeConstant() << plant.getGain();
+    QVERIFY( abs((int)plant.getDeadTime() - deadTime) <= (PLANT_SLOPE_WINDOW/2)+2 );
+    QVERIFY( abs((int)plant.getTimeConstant() - tau) <= (tau/10) );
+
+    int gain = (int)round((dy*100)/du);
+    QVERIFY( abs((int)plant.getGain() - gain) <= (gain/10)+1 );
+
+    int interval = plant.getDeadTime()+plant.getTimeConstant();
+    if(interval < PLANT_INTERVAL_MIN)
+        interval = PLANT_INTERVAL_MIN;
+    if(interval > PLANT_INTERVAL_MAX)
+        interval = PLANT_INTERVAL_MAX;
+    QCOMPARE(plant.getStageInterval(180), (uint16_t)interval);
+
+    plant.resultIsSent();
+    QVERIFY(!plant.resultTimeToSend());
+}
+
+/**
+ * A flat response gives nothing to learn from.
+ */
+void TestPlantIdent::test_noStep()
+{
+    PlantIdent plant;
+    plant.stepStart(4000, 33);
+    for(int t=0; t<PLANT_STEP_MAX+10; t++)
+    {
+        plant.addValue(4000 + (t%3)); //some noise
+    }
+    QVERIFY(!plant.isValid());
+    QVERIFY(!plant.resultTimeToSend());
+    QCOMPARE(plant.getStageInterval(180), (uint16_t)180);
+    QCOMPARE(plant.getHyst(500), (int16_t)500);
+}
+
+/**
+ * Turned off before the slope decays, we only get the dead time.
+ */
+void TestPlantIdent::test_abort()
+{
+    PlantIdent plant;
+    plant.stepStart(fopdt(0, 40.0, 20.0, 30, 300), 33);
+    for(int t=1; t<100; t++)
+    {
+        plant.addValue(fopdt(t, 40.0, 20.0, 30, 300));
+    }
+    plant.stepAbort();
+
+    QVERIFY(plant.resultTimeToSend());
+    QVERIFY(!plant.isValid());
+    QVERIFY( abs((int)plant.getDeadTime() - 30) <= (PLANT_SLOPE_WINDOW/2)+2 );
+
+    //Not enough for the interval, but the hyst is ok.
+    QCOMPARE(plant.getStageInterval(180), (uint16_t)180);
+
+    //Slope 20/300 degrees per tick, 2*30*0.066=4 degrees
+    int hyst = plant.getHyst(500);
+    QVERIFY(hyst > 300 && hyst < 500);
+}
+
+/**
+ * Every new estimate is averaged with the old.
+ */
+void TestPlantIdent::test_average()
+{
+    PlantIdent plant;
+
+    int tau[2] = {200, 400};
+    for(int i=0; i<2; i++)
+    {
+        plant.stepStart(fopdt(0, 40.0, 20.0, 20, tau[i]), 33);
+        int t = 1;
+        while(plant.active)
+        {
+            plant.addValue(fopdt(t, 40.0, 20.0, 20, tau[i]));
+            t++;
+        }
+    }
+
+    QVERIFY( abs((int)plant.getTimeConstant() - 300) <= 30 );
+}
+
+QTEST_MAIN(TestPlantIdent)
+#include "TestPlantIdent.moc"
@@ -0,0 +1,310 @@
+/**
+ * @file TestPowerBudget.cpp
+ * @author Johan Simonsson
+ * @brief Testfile for PowerBudget
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+
+#include "PowerBudget.h"
+#include "Thermostat.h"
+
+class TestPowerBudget : public QObject
+{
+    Q_OBJECT
+
+    private:
+    public:
+
+    private slots:
+        void test_setLevelMax();
+        void test_single();
+        void test_single_data();
+        void test_priority();
+        void test_deficit();
+        void test_satisfied();
+        void test_shed();
+        void test_simulate();
+};
+
+/**
+ * The power for the stages on right now.
+ */
+static uint32_t powerNow(Regulator* reg, const uint16_t* stagePower)
+{
+    uint32_t power = 0;
+    for( unsigned int i=0 ; i<reg->getStageCount() ; i++ )
+    {
+        if(reg->stageOut & (1 << i))
+        {
+            power += stagePower[i];
+        }
+    }
+    return power;
+}
+
+void TestPowerBudget::test_setLevelMax()
+{
+    Thermostat lin(3, THERMOSTAT_TYPE_LINEAR);
+    QCOMPARE(lin.getLevelCount(), (uint8_t)3);
+    lin.stageOut = 0x7;
+    lin.setLevelMax(2);
+    QCOMPARE(lin.maxOutValue, (uint8_t)0x3);
+    QCOMPARE(lin.stageOut, (uint8_t)0x3);
+    lin.setLevelMax(9);
+    QCOMPARE(lin.maxOutValue, (uint8_t)0x7);
+    QCOMPARE(lin.stageOut, (uint8_t)0x3);
+
+    Thermostat bin(3, THERMOSTAT_TYPE_BIN_CNT);
+    QCOMPARE(bin.getLevelCount(), (uint8_t)7);
+    bin.stageOut = 0x5;
+    bin.setLevelMax(4);
+    QCOMPARE(bin.maxOutValue, (uint8_t)0x4);
+    QCOMPARE(bin.stageOut, (uint8_t)0x4);
+    bin.setLevelMax(0);
+    QCOMPARE(bin.stageOut, (uint8_t)0x0);
+}
+
+void TestPowerBudget::test_single_data()
+{
+    QTest::addColumn<unsigned int>("type");
+    QTest::addColumn<unsigned int>("budget");
+    QTest::addColumn<unsigned int>("level");
+
+    //Stages 2kW, 4kW and 9kW, bin cnt gives 0,2,4,6,9,11,13,15kW
+    QTest::newRow("bin 0")  << (unsigned int)THERMOSTAT_TYPE_BIN_CNT << 1999u  << 0u;
+    QTest::newRow("bin 2")  << (unsigned int)THERMOSTAT_TYPE_BIN_CNT << 2000u  << 1u;
+    QTest::newRow("bin 6")  << (unsigned int)THERMOSTAT_TYPE_BIN_CNT << 6000u  << 3u;
+    QTest::newRow("bin 10") << (unsigned int)THERMOSTAT_TYPE_BIN_CNT << 10000u << 4u;
+    QTest::newRow("bin 15") << (unsigned int)THERMOSTAT_TYPE_BIN_CNT << 20000u << 7u;
+
+    //Linear gives 0,2,6,15kW
+    QTest::newRow("lin 5")  << (unsigned int)THERMOSTAT_TYPE_LINEAR  << 5000u  << 1u;
+    QTest::newRow("lin 6")  << (unsigned int)THERMOSTAT_TYPE_LINEAR  << 6000u  << 2u;
+    QTest::newRow("lin 15") << (unsigned int)THERMOSTAT_TYPE_LINEAR  << 15000u << 3u;
+}
+
+/**
+ * One regulator below setpoint climbs one level per update,
+ * until the highest level that fits.
+ */
+void TestPowerBudget::test_single()
+{
+    QFETCH(unsigned int, type);
+    QFETCH(unsigned int, budget);
+    QFETCH(unsigned int, level);
+
+    const uint16_t stagePower[] = { 2000, 4000, 9000 };
+    Thermostat thermostat(3, (ThermostatType)type);
+    thermostat.setSetpoint(60.0, 5.0);
+    thermostat.valueTimeToSend(40.0);
+
+    PowerBudget power(budget);
+    QVERIFY(power.add(&thermostat, stagePower, 0));
+    for( int i=0 ; i<10 ; i++ )
+    {
+        power.update();
+        thermostat.stageOut = thermostat.getLevelOut(power.getLevelMax(0));
+    }
+
+    QCOMPARE((unsigned int)power.getLevelMax(0), level);
+    QVERIFY(power.getPowerMax() <= budget);
+}
+
+/**
+ * The most important regulator gets its share first.
+ */
+void TestPowerBudget::test_priority()
+{
+    const uint16_t stagePower[] = { 3000, 3000 };
+    Thermostat boiler(2, THERMOSTAT_TYPE_LINEAR);
+    Thermostat floor(2, THERMOSTAT_TYPE_LINEAR);
+    boiler.setSetpoint(60.0, 5.0);
+    floor.setSetpoint(25.0, 1.0);
+
+    //The floor is further from its setpoint, but the boiler is more important.
+    boiler.valueTimeToSend(50.0);
+    floor.valueTimeToSend(15.0);
+
+    PowerBudget power(9000);
+    QVERIFY(power.add(&floor,  stagePower, 1));
+    QVERIFY(power.add(&boiler, stagePower, 0));
+
+    boiler.stageOut = 0x1;
+    floor.stageOut  = 0x3;
+    power.update();
+
+    QCOMPARE(power.getLevelMax(1), (uint8_t)2);
+    QCOMPARE(power.getLevelMax(0), (uint8_t)1);
+    QCOMPARE(floor.stageOut, (uint8_t)0x1);
+    QCOMPARE(power.getPowerMax(), (uint32_t)9000);
+
+    //No room for more
+    QVERIFY(power.add(&floor, stagePower, 2));
+    QVERIFY(power.add(&floor, stagePower, 2));
+    QVERIFY(!power.add(&floor, stagePower, 2));
+    QCOMPARE(power.getLevelMax(POWER_BUDGET_MAX), (uint8_t)0);
+}
+
+/**
+ * Same priority, the one furthest below the setpoint goes first.
+ */
+void TestPowerBudget::test_deficit()
+{
+    const uint16_t stagePower[] = { 3000, 3000 };
+    Thermostat a(2, THERMOSTAT_TYPE_LINEAR);
+    Thermostat b(2, THERMOSTAT_TYPE_LINEAR);
+    a.setSetpoint(60.0, 5.0);
+    b.setSetpoint(60.0, 5.0);
+
+    PowerBudget power(9000);
+    QVERIFY(power.add(&a, stagePower, 0));
+    QVERIFY(power.add(&b, stagePower, 0));
+
+    a.valueTimeToSend(50.0);
+    b.valueTimeToSend(40.0);
+    a.stageOut = 0x1;
+    b.stageOut = 0x1;
+    power.update();
+    QCOMPARE(power.getLevelMax(0), (uint8_t)1);
+    QCOMPARE(power.getLevelMax(1), (uint8_t)2);
+
+    a.valueTimeToSend(30.0);
+    a.stageOut = 0x1;
+    b.stageOut = 0x1;
+    power.update();
+    QCOMPARE(power.getLevelMax(0), (uint8_t)2);
+    QCOMPARE(power.getLevelMax(1), (uint8_t)1);
+}
+
+/**
+ * A satisfied regulator only keeps what it uses,
+ * so the rest can go to the one that needs it.
+ */
+void TestPowerBudget::test_satisfied()
+{
+    const uint16_t stagePower[] = { 3000, 3000 };
+    Thermostat a(2, THERMOSTAT_TYPE_LINEAR);
+    Thermostat b(2, THERMOSTAT_TYPE_LINEAR);
+    a.setSetpoint(60.0, 5.0);
+    b.setSetpoint(60.0, 5.0);
+
+    PowerBudget power(6000);
+    QVERIFY(power.add(&a, stagePower, 0));
+    QVERIFY(power.add(&b, stagePower, 1));
+
+    a.valueTimeToSend(70.0);
+    b.valueTimeToSend(40.0);
+    b.stageOut = 0x1;
+    power.update();
+    QCOMPARE(power.getLevelMax(0), (uint8_t)0);
+    QCOMPARE(power.getLevelMax(1), (uint8_t)2);
+
+    //Turned off and inside the hysteresis is also satisfied.
+    a.valueTimeToSend(57.0);
+    power.update();
+    QCOMPARE(a.getDeficit(), 0.0);
+    QCOMPARE(power.getLevelMax(0), (uint8_t)0);
+    QCOMPARE(power.getLevelMax(1), (uint8_t)2);
+}
+
+/**
+ * When a more important regulator needs power, the other is turned down at once.
+ */
+void TestPowerBudget::test_shed()
+{
+    const uint16_t stagePower[] = { 2000, 4000, 9000 };
+    Thermostat a(3, THERMOSTAT_TYPE_BIN_CNT);
+    Thermostat b(3, THERMOSTAT_TYPE_BIN_CNT);
+    a.setSetpoint(60.0, 5.0);
+    b.setSetpoint(60.0, 5.0);
+
+    PowerBudget power(10000);
+    QVERIFY(power.add(&a, stagePower, 0));
+    QVERIFY(power.add(&b, stagePower, 1));
+
+    a.valueTimeToSend(70.0);
+    b.valueTimeToSend(40.0);
+    b.stageOut = 0x4; //9kW
+    power.update();
+    QCOMPARE(power.getLevelMax(1), (uint8_t)4);
+
+    a.valueTimeToSend(40.0);
+    power.update();
+    QCOMPARE(power.getLevelMax(0), (uint8_t)1);
+    QCOMPARE(power.getLevelMax(1), (uint8_t)3);
+    QCOMPARE(b.stageOut, (uint8_t)0x3);
+    QVERIFY(powerNow(&a, stagePower) + powerNow(&b, stagePower) <= 10000);
+}
+
+/**
+ * Three thermostats on one fuse,
+ * the power used must always be inside the budget.
+ */
+void TestPowerBudget::test_simulate()
+{
+    const uint16_t boilerPower[] = { 2000, 4000, 9000 };
+    const uint16_t tankPower[]   = { 3000 };
+    const uint16_t floorPower[]  = { 1000, 1000, 1000 };
+
+    Thermostat boiler(3, THERMOSTAT_TYPE_BIN_CNT);
+    Thermostat tank(1, THERMOSTAT_TYPE_LINEAR);
+    Thermostat floor(3, THERMOSTAT_TYPE_LINEAR);
+    boiler.setSetpoint(60.0, 5.0);
+    tank.setSetpoint(55.0, 5.0);
+    floor.setSetpoint(25.0, 1.0);
+
+    PowerBudget power(11000);
+    QVERIFY(power.add(&boiler, boilerPower, 0));
+    QVERIFY(power.add(&tank,   tankPower,   1));
+    QVERIFY(power.add(&floor,  floorPower,  1));
+
+    double boilerValue = 30.0;
+    double tankValue   = 30.0;
+    double floorValue  = 15.0;
+
+    for( int t=0 ; t<4*3600 ; t++ )
+    {
+        boiler.valueTimeToSend(boilerValue);
+        tank.valueTimeToSend(tankValue);
+        floor.valueTimeToSend(floorValue);
+        power.update();
+
+        uint32_t boilerNow = powerNow(&boiler, boilerPower);
+        uint32_t tankNow   = powerNow(&tank,   tankPower);
+        uint32_t floorNow  = powerNow(&floor,  floorPower);
+        QVERIFY(boilerNow + tankNow + floorNow <= 11000);
+        QVERIFY(power.getPowerMax() <= 11000);
+
+        //Simple plants, heat in and some loss
+        boilerValue += (boilerNow/1000.0)*0.002 - (boilerValue-20.0)*0.0002;
+        tankValue   += (tankNow/1000.0)*0.004   - (tankValue-20.0)*0.0002;
+        floorValue  += (floorNow/1000.0)*0.001  - (floorValue-15.0)*0.0002;
+    }
+
+    //All is on its way to the setpoint, the boiler first
+    QVERIFY(boilerValue > 55.0);
+    QVERIFY(tankValue > 40.0);
+    QVERIFY(floorValue > 22.0);
+}
+
+QTEST_MAIN(TestPowerBudget)
+#include "TestPowerBudget.moc"
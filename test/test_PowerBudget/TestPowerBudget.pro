@@ -0,0 +1,16 @@
+CONFIG += qtestlib debug
+TEMPLATE = app
+TARGET = 
+DEFINES += private=public
+DEFINES += protected=public
+
+# Test code
+DEPENDPATH += .
+INCLUDEPATH += .
+SOURCES += TestPowerBudget.cpp
+
+# Code to test
+DEPENDPATH  += ../../FunTechHouse_Thermostat/
+INCLUDEPATH += ../../FunTechHouse_Thermostat/
+SOURCES += PowerBudget.cpp Thermostat.cpp Regulator.cpp MQTT_Logic.cpp StringHelp.cpp TimeProportional.cpp PlantIdent.cpp
+
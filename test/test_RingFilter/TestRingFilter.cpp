@@ -0,0 +1,278 @@
+/**
+ * @file TestRingFilter.cpp
+ * @author Johan Simonsson
+ * @brief Testfile and benchmark for RingFilter
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "RingFilter.h"
+#include "ValueAvg.h"
+#include "LVTS.h"
+
+class TestRingFilter : public QObject
+{
+    Q_OBJECT
+
+    private:
+    public:
+
+    private slots:
+        void test_empty();
+        void test_window();
+        void test_init();
+        void test_benchmark();
+};
+
+/**
+ * Simple random numbers, so the test is the same every time.
+ */
+static unsigned long randomState = 1;
+static int randomInt(int max)
+{
+    randomState = randomState * 1103515245UL + 12345UL;
+    return (int)((randomState >> 16) % max);
+}
+
+/**
+ * The trimmed mean the slow way.
+ */
+static double trimmedMean(const QList<int>& window)
+{
+    double sum = 0;
+    int min = window.at(0);
+    int max = window.at(0);
+    for( int i=0 ; i<window.size() ; i++ )
+    {
+        sum += window.at(i);
+        min = qMin(min, window.at(i));
+        max = qMax(max, window.at(i));
+    }
+    if(window.size() >= RING_FILTER_TRIM_MIN)
+    {
+        return (sum-min-max)/(window.size()-2);
+    }
+    return sum/window.size();
+}
+
+/**
+ * Compare the filter with the slow way for many random values.
+ */
+template <uint8_t N>
+static bool checkWindow()
+{
+    RingFilter<int, N> filter;
+    QList<int> window;
+
+    for( int i=0 ; i<1000 ; i++ )
+    {
+        //Many equal values to test the queues
+        int value = randomInt(20);
+        filter.addValue(value);
+        window.append(value);
+        if(window.size() > N)
+        {
+            window.removeFirst();
+        }
+
+        if( (filter.getCount() != window.size()) ||
+            (filter.isFull() != (window.size() == N)) ||
+            (fabs(filter.getValue() - trimmedMean(window)) > 0.0001) )
+        {
+            qDebug() << "N" << N << "i" << i << filter.getValue() << trimmedMean(window);
+            return false;
+        }
+    }
+    return true;
+}
+
+void TestRingFilter::test_empty()
+{
+    RingFilter<int, 8> filter;
+    QCOMPARE(filter.getValue(), 0.0);
+    QCOMPARE((int)filter.getCount(), 0);
+    QVERIFY(!filter.isFull());
+
+    filter.addValue(5);
+    QCOMPARE(filter.getValue(), 5.0);
+    QCOMPARE(filter.getMin(), 5);
+    QCOMPARE(filter.getMax(), 5);
+}
+
+void TestRingFilter::test_window()
+{
+    QVERIFY(checkWindow<1>());
+    QVERIFY(checkWindow<2>());
+    QVERIFY(checkWindow<7>());
+    QVERIFY(checkWindow<8>());
+    QVERIFY(checkWindow<16>());
+    QVERIFY(checkWindow<255>());
+}
+
+void TestRingFilter::test_init()
+{
+    RingFilter<int, 8> filter;
+    for( int i=0 ; i<20 ; i++ )
+    {
+        filter.addValue(100+i);
+    }
+    QVERIFY(filter.isFull());
+    QCOMPARE(filter.getMin(), 112);
+    QCOMPARE(filter.getMax(), 119);
+
+    filter.init();
+    QVERIFY(!filter.isFull());
+    filter.addValue(10);
+    filter.addValue(20);
+    QCOMPARE(filter.getValue(), 15.0);
+}
+
+/**
+ * The LM35 noise, from a file or a simulated trace.
+ *
+ * The file can be made with test/hw_LM35 on a stable temperature,
+ * one analogRead value per line (set LM35_TRACE=file).
+ * Then the mean of the whole file is used as the true value.
+ *
+ * The simulated trace is a slow sine with quantization noise,
+ * a gaussian noise of about 1.5 adc steps and some spikes (i.e. from the relays).
+ */
+static void makeTrace(QVector<int>& readings, QVector<double>& truth)
+{
+    const char* file = getenv("LM35_TRACE");
+    if(NULL != file)
+    {
+        FILE* fp = fopen(file, "r");
+        int value = 0;
+        double sum = 0;
+        while( (NULL != fp) && (1 == fscanf(fp, "%d", &value)) )
+        {
+            readings.append(value);
+            sum += value;
+        }
+        if(NULL != fp)
+        {
+            fclose(fp);
+        }
+        for( int i=0 ; i<readings.size() ; i++ )
+        {
+            truth.append(sum/readings.size());
+        }
+        if(readings.size() > 0)
+        {
+            return;
+        }
+    }
+
+    randomState = 42;
+    for( int i=0 ; i<36000 ; i++ )
+    {
+        //9 readings per second, 55 +-2 degrees with a 30min period
+        double degree = 55.0 + 2.0*sin((2*M_PI*i)/(9*1800));
+        double adc = (degree*1024.0)/110.0;
+
+        //Sum of uniform is close enough to gaussian
+        double noise = 0;
+        for( int j=0 ; j<6 ; j++ )
+        {
+            noise += (randomInt(1000)/1000.0) - 0.5;
+        }
+        adc += noise * 1.5 * 1.41;
+
+        if(randomInt(100) < 2)
+        {
+            adc += randomInt(60) - 30;
+        }
+
+        readings.append((int)round(adc));
+        truth.append(degree*1024.0/110.0);
+    }
+}
+
+/**
+ * The old ValueAvg batch against the RingFilter with fewer samples per tick.
+ *
+ * The trace has 9 readings per tick, a filter that use k samples per tick
+ * takes the first k of them. The error is the rms in degrees at every tick.
+ */
+void TestRingFilter::test_benchmark()
+{
+    QVector<int> readings;
+    QVector<double> truth;
+    makeTrace(readings, truth);
+
+    const int perTick = 9;
+    int ticks = readings.size() / perTick;
+
+    //The old way, ValueAvg on 9 readings every tick
+    double errAvg = 0;
+    for( int t=0 ; t<ticks ; t++ )
+    {
+        ValueAvg filter;
+        filter.init();
+        for( int j=0 ; j<perTick ; j++ )
+        {
+            filter.addValue(readings.at(t*perTick+j));
+        }
+        double err = filter.getValue() - truth.at(t*perTick+perTick-1);
+        errAvg += err*err;
+    }
+    errAvg = sqrt(errAvg/ticks) * 110.0/1024.0;
+    printf("RingFilter benchmark, %d ticks\n", ticks);
+    printf("  ValueAvg     9 samples/tick: rms %.4f degC\n", errAvg);
+
+    double errRing2 = 0;
+    for( int samples=1 ; samples<=3 ; samples++ )
+    {
+        RingFilter<int, 16> filter;
+        double errRing = 0;
+        int cnt = 0;
+        for( int t=0 ; t<ticks ; t++ )
+        {
+            for( int j=0 ; j<samples ; j++ )
+            {
+                filter.addValue(readings.at(t*perTick+j));
+            }
+            if(filter.isFull())
+            {
+                double err = filter.getValue() - truth.at(t*perTick+samples-1);
+                errRing += err*err;
+                cnt++;
+            }
+        }
+        errRing = sqrt(errRing/cnt) * 110.0/1024.0;
+        printf("  RingFilter16 %d samples/tick: rms %.4f degC\n", samples, errRing);
+
+        if(2 == samples)
+        {
+            errRing2 = errRing;
+        }
+    }
+
+    //Two samples per tick shall be as good as the old batch of nine.
+    QVERIFY(errRing2 <= errAvg*1.1);
+}
+
+QTEST_MAIN(TestRingFilter)
+#include "TestRingFilter.moc"
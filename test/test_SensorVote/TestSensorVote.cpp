@@ -0,0 +1,206 @@
+/**
+ * @file TestSensorVote.cpp
+ * @author Johan Simonsson
+ * @brief Testfile for SensorVote
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+
+#include "SensorVote.h"
+
+class TestSensorVote : public QObject
+{
+    Q_OBJECT
+
+    private:
+    public:
+
+    private slots:
+        void test_median();
+        void test_median_data();
+        void test_mean();
+        void test_failover();
+        void test_disagree();
+        void test_alarm();
+};
+
+void TestSensorVote::test_median_data()
+{
+    QTest::addColumn<int>("a");
+    QTest::addColumn<int>("b");
+    QTest::addColumn<int>("c");
+    QTest::addColumn<int>("result");
+    QTest::addColumn<int>("fault");
+
+    QTest::newRow("same")    << 5500 << 5500 << 5500 << 5500 << 0;
+    QTest::newRow("close")   << 5510 << 5450 << 5500 << 5500 << 0;
+    QTest::newRow("high")    << 5500 << 9000 << 5450 << 5475 << 0x02;
+    QTest::newRow("low")     << 100  << 5500 << 5550 << 5525 << 0x01;
+    QTest::newRow("negative")<< -300 << -250 << -200 << -250 << 0;
+}
+
+void TestSensorVote::test_median()
+{
+    QFETCH(int, a);
+    QFETCH(int, b);
+    QFETCH(int, c);
+    QFETCH(int, result);
+    QFETCH(int, fault);
+
+    SensorVote vote(3, SENSOR_VOTE_MEDIAN);
+    vote.setValue(0, a, true);
+    vote.setValue(1, b, true);
+    vote.setValue(2, c, true);
+
+    bool ok = false;
+    QCOMPARE((int)vote.vote(&ok), result);
+    QVERIFY(ok);
+    QCOMPARE((int)vote.getFault(), fault);
+}
+
+void TestSensorVote::test_mean()
+{
+    SensorVote vote(4, SENSOR_VOTE_MEAN);
+    vote.setValue(0, 5400, true);
+    vote.setValue(1, 5500, true);
+    vote.setValue(2, 5500, true);
+    vote.setValue(3, 5700, true);
+
+    bool ok = false;
+    QCOMPARE((int)vote.vote(&ok), 5525);
+    QVERIFY(ok);
+
+    //The one that is far off is not in the mean
+    vote.setValue(0, 5400, true);
+    vote.setValue(1, 5500, true);
+    vote.setValue(2, 5600, true);
+    vote.setValue(3, 2000, true);
+    QCOMPARE((int)vote.vote(&ok), 5500);
+    QCOMPARE((int)vote.getFault(), 0x08);
+}
+
+void TestSensorVote::test_failover()
+{
+    SensorVote vote(2);
+    bool ok = false;
+
+    vote.setValue(0, 5500, true);
+    vote.setValue(1, 5600, true);
+    QCOMPARE((int)vote.vote(&ok), 5550);
+    QVERIFY(ok);
+    QCOMPARE((int)vote.getFault(), 0);
+
+    //The same tick as the first is lost
+    vote.setValue(0, 0, false);
+    vote.setValue(1, 5600, true);
+    QCOMPARE((int)vote.vote(&ok), 5600);
+    QVERIFY(ok);
+    QCOMPARE((int)vote.getFault(), 0x01);
+
+    //A input without a new value is broken as well
+    vote.setValue(0, 5500, true);
+    QCOMPARE((int)vote.vote(&ok), 5500);
+    QVERIFY(ok);
+    QCOMPARE((int)vote.getFault(), 0x02);
+
+    //None left
+    QCOMPARE((int)vote.vote(&ok), 0);
+    QVERIFY(!ok);
+    QCOMPARE((int)vote.getFault(), 0x03);
+
+    //And back
+    vote.setValue(0, 5500, true);
+    vote.setValue(1, 5500, true);
+    QCOMPARE((int)vote.vote(&ok), 5500);
+    QVERIFY(ok);
+    QCOMPARE((int)vote.getFault(), 0);
+}
+
+void TestSensorVote::test_disagree()
+{
+    bool ok = false;
+
+    //No last vote, the first input wins
+    SensorVote vote(2);
+    vote.setValue(0, 5500, true);
+    vote.setValue(1, 10900, true); // LM35 without a sensor
+    QCOMPARE((int)vote.vote(&ok), 5500);
+    QCOMPARE((int)vote.getFault(), 0x02);
+
+    //Then the one closest to the last vote
+    vote.setValue(0, 1000, true);
+    vote.setValue(1, 5600, true);
+    QCOMPARE((int)vote.vote(&ok), 5600);
+    QVERIFY(ok);
+    QCOMPARE((int)vote.getFault(), 0x01);
+
+    //The level can be changed
+    vote.setDisagree(50);
+    vote.setValue(0, 5500, true);
+    vote.setValue(1, 5600, true);
+    QCOMPARE((int)vote.vote(&ok), 5600);
+    QCOMPARE((int)vote.getFault(), 0x01);
+}
+
+void TestSensorVote::test_alarm()
+{
+    SensorVote vote(2);
+    bool ok = false;
+    char str[60];
+
+    //Nothing the first ticks
+    for( int i=0 ; i<SENSOR_VOTE_FIRST_ALARM ; i++ )
+    {
+        vote.setValue(0, 5500, true);
+        vote.vote(&ok);
+        if(i != SENSOR_VOTE_FIRST_ALARM-1)
+        {
+            QVERIFY(!vote.faultTimeToSend());
+        }
+    }
+    QVERIFY(vote.faultTimeToSend());
+    QVERIFY(vote.getFaultString(str, sizeof(str)));
+    QCOMPARE(str, "Alarm: Sensor ; fault=0x02 ; ok=1/2");
+
+    //Again until it is sent
+    vote.setValue(0, 5500, true);
+    vote.vote(&ok);
+    QVERIFY(vote.faultTimeToSend());
+    vote.faultIsSent();
+    vote.setValue(0, 5500, true);
+    vote.vote(&ok);
+    QVERIFY(!vote.faultTimeToSend());
+
+    //And when it is fine again
+    vote.setValue(0, 5500, true);
+    vote.setValue(1, 5500, true);
+    vote.vote(&ok);
+    QVERIFY(vote.faultTimeToSend());
+    QVERIFY(vote.getFaultString(str, sizeof(str)));
+    QCOMPARE(str, "Alarm: Sensor ; fault=0x00 ; ok=2/2");
+    vote.faultIsSent();
+    QVERIFY(!vote.faultTimeToSend());
+
+    QVERIFY(!vote.getFaultString(str, 10));
+}
+
+QTEST_MAIN(TestSensorVote)
+#include "TestSensorVote.moc"
@@ -0,0 +1,213 @@
+/**
+ * @file TestSpikeFilter.cpp
+ * @author Johan Simonsson
+ * @brief Testfile for SpikeFilter
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+#include <stdlib.h>
+#include <algorithm>
+
+#include "SpikeFilter.h"
+#include "ValueAvg.h"
+
+class TestSpikeFilter : public QObject
+{
+    Q_OBJECT
+
+    private:
+    public:
+
+    private slots:
+        void test_none();
+        void test_median();
+        void test_mad();
+        void test_hampelPass();
+        void test_burst();
+        void test_burst_data();
+};
+
+/**
+ * Simple random numbers, so the test is the same every time.
+ */
+static unsigned long randomState = 1;
+static int randomInt(int max)
+{
+    randomState = randomState * 1103515245UL + 12345UL;
+    return (int)((randomState >> 16) % max);
+}
+
+void TestSpikeFilter::test_none()
+{
+    SpikeFilter filter;
+    QCOMPARE(filter.getType(), SPIKE_FILTER_NONE);
+    QCOMPARE(filter.addValue(10), (int16_t)10);
+    QCOMPARE(filter.addValue(900), (int16_t)900);
+}
+
+/**
+ * The median against a sorted copy of the window.
+ */
+void TestSpikeFilter::test_median()
+{
+    SpikeFilter filter;
+    filter.setType(SPIKE_FILTER_MEDIAN);
+    QCOMPARE(filter.getMedian(), (int16_t)0);
+
+    QList<int> window;
+    for( int i=0 ; i<500 ; i++ )
+    {
+        int value = randomInt(10) - 5;
+        int16_t out = filter.addValue(value);
+
+        window.append(value);
+        if(window.size() > SPIKE_FILTER_WINDOW)
+        {
+            window.removeFirst();
+        }
+        QList<int> sorted = window;
+        std::sort(sorted.begin(), sorted.end());
+
+        QCOMPARE((int)out, sorted.at(sorted.size()/2));
+    }
+}
+
+/**
+ * The MAD against the slow way.
+ */
+void TestSpikeFilter::test_mad()
+{
+    SpikeFilter filter;
+    filter.setType(SPIKE_FILTER_MEDIAN);
+
+    QList<int> window;
+    for( int i=0 ; i<500 ; i++ )
+    {
+        int value = randomInt(100);
+        filter.addValue(value);
+
+        window.append(value);
+        if(window.size() > SPIKE_FILTER_WINDOW)
+        {
+            window.removeFirst();
+        }
+        QList<int> sorted = window;
+        std::sort(sorted.begin(), sorted.end());
+        int median = sorted.at(sorted.size()/2);
+
+        QList<int> dev;
+        for( int j=0 ; j<sorted.size() ; j++ )
+        {
+            dev.append(abs(sorted.at(j)-median));
+        }
+        std::sort(dev.begin(), dev.end());
+
+        QCOMPARE((int)filter.getMAD(), dev.at(dev.size()/2));
+    }
+}
+
+/**
+ * Normal noise shall pass the Hampel filter untouched.
+ */
+void TestSpikeFilter::test_hampelPass()
+{
+    SpikeFilter filter;
+    filter.setType(SPIKE_FILTER_HAMPEL);
+
+    int changed = 0;
+    for( int i=0 ; i<1000 ; i++ )
+    {
+        int value = 500 + randomInt(5) - 2;
+        if(filter.addValue(value) != value)
+        {
+            changed++;
+        }
+    }
+    QVERIFY(changed < 10);
+}
+
+void TestSpikeFilter::test_burst_data()
+{
+    QTest::addColumn<int>("type");
+    QTest::addColumn<int>("burst");
+    QTest::addColumn<int>("maxError");
+
+    //The old filter only removes a single spike
+    QTest::newRow("none 1")   << (int)SPIKE_FILTER_NONE   << 1 << 1;
+    QTest::newRow("none 3")   << (int)SPIKE_FILTER_NONE   << 3 << 200;
+    QTest::newRow("median 1") << (int)SPIKE_FILTER_MEDIAN << 1 << 3;
+    QTest::newRow("median 3") << (int)SPIKE_FILTER_MEDIAN << 3 << 3;
+    QTest::newRow("hampel 1") << (int)SPIKE_FILTER_HAMPEL << 1 << 3;
+    QTest::newRow("hampel 3") << (int)SPIKE_FILTER_HAMPEL << 3 << 3;
+}
+
+/**
+ * Bursts of impulse noise (like from the contactors) on a noisy signal,
+ * then a 9 sample ValueAvg like the main loop used to do.
+ *
+ * There is a burst every other tick.
+ */
+void TestSpikeFilter::test_burst()
+{
+    QFETCH(int, type);
+    QFETCH(int, burst);
+    QFETCH(int, maxError);
+
+    SpikeFilter filter;
+    filter.setType((SpikeFilterType)type);
+
+    int worst = 0;
+    for( int tick=0 ; tick<200 ; tick++ )
+    {
+        ValueAvg avg;
+        avg.init();
+
+        int spikeAt = randomInt(9-burst+1);
+        int spike = (randomInt(2) ? 300 : -300);
+        for( int j=0 ; j<9 ; j++ )
+        {
+            int value = 500 + randomInt(3) - 1;
+            if( (tick > 2) && (0 == (tick%2)) && (j >= spikeAt) && (j < spikeAt+burst) )
+            {
+                value += spike;
+            }
+            avg.addValue( filter.addValue(value) );
+        }
+
+        if(tick > 2)
+        {
+            int error = abs((int)(avg.getValue()+0.5) - 500);
+            worst = qMax(worst, error);
+        }
+    }
+
+    if(maxError > 100)
+    {
+        QVERIFY(worst > 20);
+    }
+    else
+    {
+        QVERIFY(worst <= maxError);
+    }
+}
+
+QTEST_MAIN(TestSpikeFilter)
+#include "TestSpikeFilter.moc"
@@ -37,6 +37,8 @@ class TestStringHelp : public QObject
     private slots:
         void test_add_data();
         void test_add();
+        void test_parseFixed_data();
+        void test_parseFixed();
 };
 
 void TestStringHelp::test_add_data()
@@ -118,5 +120,49 @@ void TestStringHelp::test_add()
 }
 
 
+void TestStringHelp::test_parseFixed_data()
+{
+    QTest::addColumn<QString>("str");
+    QTest::addColumn<bool>("ok");
+    QTest::addColumn<int>("value");
+
+    QTest::newRow("int")       << "55"     << true  <<  5500;
+    QTest::newRow("one dec")   << "55.5"   << true  <<  5550;
+    QTest::newRow("two dec")   << "55.25"  << true  <<  5525;
+    QTest::newRow("three dec") << "55.259" << true  <<  5525;
+    QTest::newRow("no int")    << ".5"     << true  <<    50;
+    QTest::newRow("dot")       << "3."     << true  <<   300;
+    QTest::newRow("neg")       << "-12.5"  << true  << -1250;
+    QTest::newRow("pos")       << "+0.05"  << true  <<     5;
+    QTest::newRow("zero")      << "0"      << true  <<     0;
+
+    QTest::newRow("empty")     << ""       << false <<     0;
+    QTest::newRow("sign")      << "-"      << false <<     0;
+    QTest::newRow("only dot")  << "."      << false <<     0;
+    QTest::newRow("two dots")  << "1.2.3"  << false <<     0;
+    QTest::newRow("junk")      << "12a"    << false <<     0;
+    QTest::newRow("space")     << "1 2"    << false <<     0;
+    QTest::newRow("too big")   << "123456789" << false << 0;
+}
+
+void TestStringHelp::test_parseFixed()
+{
+    QFETCH(QString, str);
+    QFETCH(bool, ok);
+    QFETCH(int, value);
+
+    //Put some junk after the number, since it shall not need a null terminated string.
+    char buf[40];
+    memset(buf, '9', sizeof(buf));
+    memcpy(buf, str.toLatin1().data(), str.length());
+
+    long res = 0;
+    QCOMPARE(StringHelp::parseFixed(buf, str.length(), &res), ok);
+    if(ok)
+    {
+        QCOMPARE(res, (long)value);
+    }
+}
+
 QTEST_MAIN(TestStringHelp)
 #include "TestStringHelp.moc"
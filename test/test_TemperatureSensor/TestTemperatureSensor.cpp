@@ -1,5 +1,6 @@
 #include <QtCore>
 #include <QtTest>
+#include <string.h>
 
 #include "TemperatureSensor.h"
 
@@ -24,6 +25,13 @@ class TestTemperatureSensor : public QObject
 
         void test_getValueString();
         void test_getValueString_data();
+
+        void test_command();
+        void test_spikeFilter();
+        void test_convertReading();
+        void test_oneWireAlarm();
+        void test_readPipeline();
+        void test_kalman();
 };
 
 /*
@@ -325,5 +333,244 @@ void TestTemperatureSensor::test_getValueString()
     QCOMPARE(valueString, result);
 }
 
+/**
+ * Commands from the server changes the config.
+ */
+void TestTemperatureSensor::test_command()
+{
+    TemperatureSensor sensor;
+    sensor.setAlarmLevels(true, 25.0, true, 20.0);
+
+    char cmd[] = "offset=-0.5 ; diff=2 ; alarmhigh=30 ; alarmlow=15.25 ; bogus=1";
+    QVERIFY(!sensor.commandParse(cmd, strlen(cmd)));
+    QVERIFY(sensor.commandTimeToSend());
+
+    QCOMPARE(sensor.valueOffset, -0.5);
+    QCOMPARE(sensor.valueDiffMax, 2.0);
+    QCOMPARE(sensor.alarmHigh, 30.0);
+    QCOMPARE(sensor.alarmLow, 15.25);
+
+    char str[100];
+    QVERIFY(sensor.getCommandString(str, 100));
+    QCOMPARE(str, "offset=0.50 ; diff=2.00 ; alarmhigh=30.00 ; alarmlow=15.25");
+    QVERIFY(!sensor.getCommandString(str, 20));
+    sensor.commandIsSent();
+    QVERIFY(!sensor.commandTimeToSend());
+
+    //The offset is used directly
+    sensor.valueTimeToSend(20.0);
+    QCOMPARE(sensor.valueWork, 19.5);
+
+    //Bad values is not used, the offset must fit the int16_t in OneWireStore
+    char bad[] = "diff=-0.01 ; offset=327.01 ; offset=-327.01 ; offset=1000";
+    QVERIFY(!sensor.commandParse(bad, strlen(bad)));
+    QCOMPARE(sensor.valueDiffMax, 2.0);
+    QCOMPARE(sensor.valueOffset, -0.5);
+
+    char edge[] = "diff=0 ; offset=-327";
+    QVERIFY(sensor.commandParse(edge, strlen(edge)));
+    QCOMPARE(sensor.valueDiffMax, 0.0);
+    QCOMPARE(sensor.valueOffset, -327.0);
+}
+
+/**
+ * Every sensor has its own spike filter.
+ */
+void TestTemperatureSensor::test_spikeFilter()
+{
+    TemperatureSensor sensors[2];
+    sensors[0].setSpikeFilter(SPIKE_FILTER_HAMPEL);
+
+    for( int i=0 ; i<SPIKE_FILTER_WINDOW ; i++ )
+    {
+        QCOMPARE(sensors[0].filterReading(500+(i%2)), 500+(i%2));
+        QCOMPARE(sensors[1].filterReading(500+(i%2)), 500+(i%2));
+    }
+
+    QCOMPARE(sensors[0].filterReading(900), 501); //The median
+    QCOMPARE(sensors[1].filterReading(900), 900);
+}
+
+void TestTemperatureSensor::test_convertReading()
+{
+    TemperatureSensor sensors[3];
+    sensors[0].setSensor(Sensor::LM35DZ, 15);
+    sensors[1].setSensor(Sensor::NTC_10K, 16);
+    sensors[2].setSensor(Sensor::DS18B20, 5);
+
+    QVERIFY(sensors[0].isAnalog());
+    QVERIFY(sensors[1].isAnalog());
+    QVERIFY(!sensors[2].isAnalog());
+
+    // 1024 * (0.30V/1.1V) = 279 => 30degC
+    bool ok = false;
+    int16_t centi = sensors[0].convertReading(279, &ok);
+    QVERIFY(ok);
+    QCOMPARE((int)((centi+50)/100), 30);
+
+    // Two extra bits
+    QCOMPARE(sensors[0].convertReading(279*4, &ok, 2), centi);
+
+    // Reads 1 degC too low
+    QVERIFY(sensors[0].setCalibration(0.0, 1.0, 100.0, 101.0));
+    QCOMPARE((int)sensors[0].convertReading(279, &ok), centi+100);
+    QVERIFY(!sensors[0].setCalibration(0.0, 0.0, 10.0, 50.0));
+
+    // The NTC table is in the warm end
+    sensors[1].convertReading(500, &ok);
+    QVERIFY(ok);
+    sensors[1].convertReading(10, &ok);
+    QVERIFY(!ok);
+
+    sensors[2].convertReading(500, &ok);
+    QVERIFY(!ok);
+
+    // No bus for the DS18B20
+    ok = true;
+    sensors[2].readOneWire(&ok);
+    QVERIFY(!ok);
+}
+
+void TestTemperatureSensor::test_oneWireAlarm()
+{
+    DS18B20Bus bus(NULL);
+    TemperatureSensor sensor;
+    sensor.setSensor(Sensor::DS18B20, 5);
+    sensor.setOneWire(&bus, 1);
+
+    // No alarm is the device range
+    QCOMPARE((int)bus.alarmHigh[1], DS18B20_ALARM_HIGH_OFF);
+    QCOMPARE((int)bus.alarmLow[1],  DS18B20_ALARM_LOW_OFF);
+
+    // Inside the hysteresis (1.0), whole degC
+    sensor.setAlarmLevels(true, 80.0, true, 10.0);
+    QCOMPARE((int)bus.alarmHigh[1], 79);
+    QCOMPARE((int)bus.alarmLow[1],  11);
+
+    // The device has the value before the offset
+    sensor.setValueOffset(0.5);
+    QCOMPARE((int)bus.alarmHigh[1], 78);
+    QCOMPARE((int)bus.alarmLow[1],  11);
+
+    QVERIFY(sensor.commandParse("alarmhigh=90.5", 14));
+    QCOMPARE((int)bus.alarmHigh[1], 89);
+
+    sensor.setAlarmLevels(true, 80.0, false, 10.0);
+    QCOMPARE((int)bus.alarmLow[1],  DS18B20_ALARM_LOW_OFF);
+
+    // Only the own device
+    QCOMPARE((int)bus.alarmHigh[0], DS18B20_ALARM_HIGH_OFF);
+}
+
+
+/**
+ * The same calls for every sensor type.
+ */
+void TestTemperatureSensor::test_readPipeline()
+{
+    AdcSampler adc;
+    adc.setBits(2);
+
+    TemperatureSensor sensors[3];
+    sensors[0].setSensor(Sensor::LM35DZ, 15);
+    sensors[1].setSensor(Sensor::DS18B20, 5);
+    sensors[2].setSensor(Sensor::NO_SENSOR, 0);
+    for( int i=0 ; i<3 ; i++ )
+    {
+        sensors[i].setAdc(&adc);
+    }
+    QCOMPARE((int)sensors[0].adcChannel, 0);
+    QCOMPARE((int)sensors[1].adcChannel, -1);
+    QCOMPARE(adc.count, (uint8_t)1);
+
+    // No adc value yet
+    bool ok = true;
+    sensors[0].readStart();
+    sensors[0].readResult(&ok);
+    QVERIFY(!ok);
+
+    // The filtered value is converted
+    bool convertOk = false;
+    int16_t centi = sensors[0].convertReading(279*4, &convertOk, 2);
+    adc.setValue(0, 279*4);
+    for( int i=0 ; i<SENSOR_FILTER_WINDOW ; i++ )
+    {
+        sensors[0].readStart();
+        sensors[0].readPoll(10);
+        QCOMPARE(sensors[0].readResult(&ok), centi);
+        QVERIFY(ok);
+    }
+
+    // A bad value is not kept
+    adc.setValue(0, 0xFFFF);
+    sensors[0].readStart();
+    sensors[0].readResult(&ok);
+    QVERIFY(!ok);
+
+    // No bus for the DS18B20, and nothing to read without a sensor
+    for( int i=1 ; i<3 ; i++ )
+    {
+        ok = true;
+        sensors[i].readStart();
+        sensors[i].readPoll(10);
+        QCOMPARE((int)sensors[i].readResult(&ok), 0);
+        QVERIFY(!ok);
+    }
+
+    // A type that is not in the table
+    sensors[2].setSensorType((Sensor::SensorTypes)42);
+    ok = true;
+    sensors[2].readStart();
+    sensors[2].readPoll(10);
+    sensors[2].readResult(&ok);
+    QVERIFY(!ok);
+}
+
+void TestTemperatureSensor::test_kalman()
+{
+    AdcSampler adc;
+    TemperatureSensor sensor;
+    sensor.setSensor(Sensor::LM35DZ, 15);
+    sensor.setAdc(&adc);
+
+    bool ok = true;
+    sensor.getSlope(&ok);
+    QVERIFY(!ok);
+
+    sensor.setKalman(true);
+    sensor.getSlope(&ok);
+    QVERIFY(!ok);
+
+    bool convertOk = false;
+    int16_t centi = sensor.convertReading(279, &convertOk);
+    adc.setValue(0, 279);
+    for( int i=0 ; i<10 ; i++ )
+    {
+        sensor.readStart();
+        QCOMPARE(sensor.readResult(&ok), centi);
+        QVERIFY(ok);
+    }
+    QCOMPARE((int)sensor.getSlope(&ok), 0);
+    QVERIFY(ok);
+
+    char str[60];
+    sensor.valueTimeToSend(centi/100.0);
+    QVERIFY(sensor.getValueString(str, sizeof(str)));
+    QVERIFY(0 != strstr(str, " ; slope=0.00"));
+
+    //Falling, the sign is there also when it is less than 1
+    sensor.kalman.slope = -(30 << KALMAN_SHIFT) / SENSOR_SAMPLES_PER_MINUTE;
+    QVERIFY(sensor.getValueString(str, sizeof(str)));
+    QVERIFY(0 != strstr(str, " ; slope=-0.30"));
+
+    //A bad reading starts over
+    adc.setValue(0, 0xFFFF);
+    sensor.readStart();
+    sensor.readResult(&ok);
+    QVERIFY(!ok);
+    sensor.getSlope(&ok);
+    QVERIFY(!ok);
+}
+
 QTEST_MAIN(TestTemperatureSensor)
 #include "TestTemperatureSensor.moc"
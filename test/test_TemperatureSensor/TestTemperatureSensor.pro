@@ -11,5 +11,6 @@ SOURCES += TestTemperatureSensor.cpp
 # Code to test
 DEPENDPATH  += ../../FunTechHouse_Thermostat/
 INCLUDEPATH += ../../FunTechHouse_Thermostat/
-SOURCES += TemperatureSensor.cpp Sensor.cpp MQTT_Logic.cpp StringHelp.cpp
+SOURCES += TemperatureSensor.cpp Sensor.cpp MQTT_Logic.cpp StringHelp.cpp SpikeFilter.cpp
+SOURCES += AnalogSensor.cpp LVTS.cpp DS18B20Bus.cpp OneWireBus.cpp DHTSensor.cpp AdcSampler.cpp Oversample.cpp KalmanFilter.cpp
 
@@ -23,6 +23,7 @@
 
 #include <QtCore>
 #include <QtTest>
+#include <math.h>
 
 #include "Thermostat.h"
 
@@ -59,6 +60,14 @@ class TestThermostat : public QObject
         void test_calcOutput();
 
         void test_setDelayOff();
+
+        void test_timeProportional();
+        void test_timeProportionalOutValue();
+        void test_timeProportionalOutValue_data();
+
+        void test_autoTune();
+
+        void test_command();
 };
 
 
@@ -834,6 +843,227 @@ void TestThermostat::test_setDelayOff()
 }
 
 
+/**
+ * Walk one cycle and count the slots the stage is on.
+ */
+static unsigned int countOnSlots(Thermostat* thermostat, unsigned int stage, unsigned int cycle)
+{
+    unsigned int cnt = 0;
+    for( unsigned int i=0 ; i<cycle ; i++ )
+    {
+        if(thermostat->getStageOut(stage))
+        {
+            cnt++;
+        }
+        thermostat->nextSlot();
+    }
+    return cnt;
+}
+
+void TestThermostat::test_timeProportional()
+{
+    Thermostat thermostat(3, THERMOSTAT_TYPE_LINEAR);
+    thermostat.setSetpoint(50.0, 10.0);
+    thermostat.setCycleTime(100);
+
+    //Over setpoint, off
+    thermostat.valueTimeToSend(55.0);
+    QCOMPARE(countOnSlots(&thermostat, 0, 100), (unsigned int)0);
+
+    //In the band we turn on directly, but only part of the cycle.
+    //50-47.5=2.5 of 10 => 25%
+    thermostat.valueTimeToSend(47.5);
+    QCOMPARE((unsigned int)thermostat.stageOut, (unsigned int)0x1);
+    QCOMPARE(countOnSlots(&thermostat, 0, 100), (unsigned int)25);
+
+    //Closer to the setpoint, less on (but first from the next cycle)
+    thermostat.valueTimeToSend(49.0);
+    QCOMPARE(countOnSlots(&thermostat, 0, 100), (unsigned int)25);
+    QCOMPARE(countOnSlots(&thermostat, 0, 100), (unsigned int)10);
+    QCOMPARE(countOnSlots(&thermostat, 1, 100), (unsigned int)0);
+
+    //Under the band, 100% and wait for the next stage.
+    for( int i=0 ; i<LOW_VALUE_COUNT_MAX ; i++ )
+    {
+        thermostat.valueTimeToSend(35.0);
+    }
+    QCOMPARE((unsigned int)thermostat.stageOut, (unsigned int)0x3);
+    QCOMPARE(countOnSlots(&thermostat, 0, 100), (unsigned int)100);
+    QCOMPARE(countOnSlots(&thermostat, 1, 100), (unsigned int)100);
+
+    //Back in the band, only the top stage is time proportional.
+    thermostat.valueTimeToSend(45.0);
+    QCOMPARE(countOnSlots(&thermostat, 1, 100), (unsigned int)100);
+    QCOMPARE(countOnSlots(&thermostat, 0, 100), (unsigned int)100);
+    QCOMPARE(countOnSlots(&thermostat, 1, 100), (unsigned int)50);
+    QCOMPARE(countOnSlots(&thermostat, 2, 100), (unsigned int)0);
+
+    //Over setpoint, all off
+    thermostat.valueTimeToSend(51.0);
+    QCOMPARE((unsigned int)thermostat.stageOut, (unsigned int)0x0);
+    QCOMPARE(countOnSlots(&thermostat, 0, 100), (unsigned int)0);
+
+    //And back to normal on/off
+    thermostat.setCycleTime(0);
+    thermostat.valueTimeToSend(45.0);
+    QCOMPARE((unsigned int)thermostat.stageOut, (unsigned int)0x0);
+    thermostat.valueTimeToSend(39.0);
+    QCOMPARE((unsigned int)thermostat.stageOut, (unsigned int)0x1);
+    QCOMPARE(countOnSlots(&thermostat, 0, 100), (unsigned int)100);
+}
+
+void TestThermostat::test_timeProportionalOutValue_data()
+{
+    QTest::addColumn<unsigned int>("type");
+    QTest::addColumn<uint8_t>("outStages");
+    QTest::addColumn<unsigned int>("duty");
+    QTest::addColumn<unsigned int>("out"); ///< 0..100%
+
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_LINEAR << (uint8_t)0x0 << 50u << 0u;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_LINEAR << (uint8_t)0x1 << 50u << 12u;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_LINEAR << (uint8_t)0x3 << 50u << 37u;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_LINEAR << (uint8_t)0xF << 100u << 100u;
+
+    //Bin cnt, top stage 0x4 of 0x7, (2+4*0.5)/7
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_BIN_CNT << (uint8_t)0x6 << 50u << 57u;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_BIN_CNT << (uint8_t)0x1 << 50u << 7u;
+    QTest::newRow("Test") << (unsigned int)THERMOSTAT_TYPE_BIN_CNT << (uint8_t)0x7 << 100u << 100u;
+}
+
+void TestThermostat::test_timeProportionalOutValue()
+{
+    QFETCH(unsigned int, type);
+    QFETCH(uint8_t, outStages);
+    QFETCH(unsigned int, duty);
+    QFETCH(unsigned int, out);
+
+    Thermostat thermostat((THERMOSTAT_TYPE_LINEAR == type)?4:3, (ThermostatType)type);
+    thermostat.setCycleTime(100);
+    thermostat.stageOut = outStages;
+    thermostat.pwm.setDuty(duty);
+    thermostat.pwm.restart();
+
+    QCOMPARE(thermostat.getOutValue(), out);
+}
+
+/**
+ * Turn on one stage and let the value follow a first order plus dead time
+ * response (dead time 20, tau 100), then the estimate shall replace
+ * the staging interval and the hysteresis.
+ */
+void TestThermostat::test_autoTune()
+{
+    Thermostat thermostat(2, THERMOSTAT_TYPE_LINEAR);
+    thermostat.setSetpoint(60.0, 2.0);
+    thermostat.setAutoTune(true);
+
+    thermostat.valueTimeToSend(40.0);
+    QCOMPARE((unsigned int)thermostat.stageOut, (unsigned int)0x1);
+    QVERIFY(!thermostat.plantTimeToSend());
+
+    int t = 1;
+    while(!thermostat.plantTimeToSend() && t < LOW_VALUE_COUNT_MAX)
+    {
+        double value = 40.0;
+        if(t > 20)
+        {
+            value += 10.0 * (1.0 - exp(-(t-20)/100.0));
+        }
+        thermostat.valueTimeToSend(value);
+        t++;
+    }
+
+    //The second stage is not turned on yet, and the estimate is ready.
+    QVERIFY(thermostat.plantTimeToSend());
+    QCOMPARE((unsigned int)thermostat.stageOut, (unsigned int)0x1);
+
+    //interval=L+T and hyst=2*L*slope (10 degrees over tau 100)
+    QVERIFY(thermostat.lowValueCountMax > 100);
+    QVERIFY(thermostat.lowValueCountMax < 140);
+    QVERIFY(thermostat.setpointHyst > 3.0);
+    QVERIFY(thermostat.setpointHyst < 5.0);
+
+    char str[80];
+    QVERIFY(thermostat.getPlantString(str, 80));
+    QCOMPARE(strncmp(str, "deadtime=", 9), 0);
+    QVERIFY(!thermostat.getPlantString(str, 10));
+
+    thermostat.plantIsSent();
+    QVERIFY(!thermostat.plantTimeToSend());
+
+    //A hyst from the server turns off the tuning, and is kept
+    unsigned int interval = thermostat.lowValueCountMax;
+    char cmd[] = "hyst=1.5";
+    QVERIFY(thermostat.commandParse(cmd, strlen(cmd)));
+    QVERIFY(!thermostat.autoTune);
+    for( int i=0 ; i<10 ; i++ )
+    {
+        thermostat.valueTimeToSend(50.0);
+    }
+    QCOMPARE(thermostat.setpointHyst, 1.5);
+    QCOMPARE((unsigned int)thermostat.lowValueCountMax, interval);
+}
+
+/**
+ * Commands from the server is used in the next tick,
+ * and outmax turns down the output at once.
+ */
+void TestThermostat::test_command()
+{
+    Thermostat thermostat(3, THERMOSTAT_TYPE_BIN_CNT);
+    thermostat.setSetpoint(60.0, 5.0);
+    thermostat.stageOut = 0x5;
+    thermostat.valueTimeToSend(50.0);
+    QCOMPARE((unsigned int)thermostat.stageOut, (unsigned int)0x5);
+
+    //Not null terminated, like the payload from the mqtt client.
+    char cmd[] = "setpoint=45.5 ; hyst=2 ; outmax=3xxxx";
+    QVERIFY(thermostat.commandParse(cmd, strlen(cmd)-4));
+    QCOMPARE(thermostat.setpoint, 45.5);
+    QCOMPARE(thermostat.setpointHyst, 2.0);
+    QCOMPARE((unsigned int)thermostat.maxOutValue, (unsigned int)0x3);
+    QCOMPARE((unsigned int)thermostat.stageOut, (unsigned int)0x3);
+
+    QVERIFY(thermostat.commandTimeToSend());
+    char str[80];
+    QVERIFY(thermostat.getCommandString(str, 80));
+    QCOMPARE(str, "setpoint=45.50 ; hyst=2.00 ; outmax=3");
+    thermostat.commandIsSent();
+    QVERIFY(!thermostat.commandTimeToSend());
+
+    //Over the new setpoint, so off in the next tick
+    thermostat.valueTimeToSend(50.0);
+    QCOMPARE((unsigned int)thermostat.stageOut, (unsigned int)0x0);
+
+    //Bad values is not used
+    char bad[] = "outmax=8 ; outmax=1.5 ; hyst=-1";
+    QVERIFY(!thermostat.commandParse(bad, strlen(bad)));
+    QCOMPARE((unsigned int)thermostat.maxOutValue, (unsigned int)0x3);
+    QCOMPARE(thermostat.setpointHyst, 2.0);
+    QVERIFY(thermostat.commandTimeToSend());
+
+    //A setpoint outside the range is not used, and the ack has the old one
+    char hot[] = "setpoint=500";
+    QVERIFY(!thermostat.commandParse(hot, strlen(hot)));
+    char cold[] = "setpoint=-5";
+    QVERIFY(!thermostat.commandParse(cold, strlen(cold)));
+    char max[] = "setpoint=95.01";
+    QVERIFY(!thermostat.commandParse(max, strlen(max)));
+    QCOMPARE(thermostat.setpoint, 45.5);
+    QVERIFY(thermostat.getCommandString(str, 80));
+    QCOMPARE(str, "setpoint=45.50 ; hyst=2.00 ; outmax=3");
+
+    char edge[] = "setpoint=95 ; setpoint=0";
+    QVERIFY(thermostat.commandParse(edge, strlen(edge)));
+    QCOMPARE(thermostat.setpoint, 0.0);
+
+    char wide[] = "hyst=20.01";
+    QVERIFY(!thermostat.commandParse(wide, strlen(wide)));
+    QCOMPARE(thermostat.setpointHyst, 2.0);
+    char hyst[] = "hyst=20";
+    QVERIFY(thermostat.commandParse(hyst, strlen(hyst)));
+    QCOMPARE(thermostat.setpointHyst, 20.0);
+}
 
 QTEST_MAIN(TestThermostat)
 #include "TestThermostat.moc"
@@ -2,6 +2,7 @@ CONFIG += qtestlib debug
 TEMPLATE = app
 TARGET = 
 DEFINES += private=public
+DEFINES += protected=public
 
 # Test code
 DEPENDPATH += .
@@ -11,5 +12,5 @@ SOURCES += TestThermostat.cpp
 # Code to test
 DEPENDPATH  += ../../FunTechHouse_Thermostat/
 INCLUDEPATH += ../../FunTechHouse_Thermostat/
-SOURCES += Thermostat.cpp Regulator.cpp MQTT_Logic.cpp StringHelp.cpp
+SOURCES += Thermostat.cpp Regulator.cpp MQTT_Logic.cpp StringHelp.cpp TimeProportional.cpp PlantIdent.cpp
 
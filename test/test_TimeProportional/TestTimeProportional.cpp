@@ -0,0 +1,153 @@
+/**
+ * @file TestTimeProportional.cpp
+ * @author Johan Simonsson
+ * @brief Testfile for TimeProportional
+ */
+
+/*
+ * Copyright (C) 2013 Johan Simonsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtCore>
+#include <QtTest>
+
+#include "TimeProportional.h"
+
+class TestTimeProportional : public QObject
+{
+    Q_OBJECT
+
+    private:
+    public:
+
+    private slots:
+        void test_notActive();
+        void test_duty();
+        void test_duty_data();
+        void test_dutyNextCycle();
+};
+
+/**
+ * Default is not active and always off.
+ */
+void TestTimeProportional::test_notActive()
+{
+    TimeProportional pwm;
+    QCOMPARE(pwm.isActive(), false);
+
+    pwm.setDuty(10);
+    QCOMPARE(pwm.getDuty(), (uint16_t)0);
+    for(int i=0; i<100; i++)
+    {
+        pwm.nextSlot();
+        QCOMPARE(pwm.getOut(), false);
+    }
+}
+
+void TestTimeProportional::test_duty_data()
+{
+    QTest::addColumn<unsigned int>("cycle");
+    QTest::addColumn<unsigned int>("duty");
+    QTest::addColumn<unsigned int>("onCount");
+
+    QTest::newRow("off")    << 10u <<  0u <<  0u;
+    QTest::newRow("on")     << 10u << 10u << 10u;
+    QTest::newRow("to big") << 10u << 20u << 10u;
+    QTest::newRow("30%")    << 10u <<  3u <<  3u;
+    QTest::newRow("60s")    << 600u << 150u << 150u;
+}
+
+/**
+ * Count the on slots during some cycles.
+ */
+void TestTimeProportional::test_duty()
+{
+    QFETCH(unsigned int, cycle);
+    QFETCH(unsigned int, duty);
+    QFETCH(unsigned int, onCount);
+
+    TimeProportional pwm;
+    pwm.setDuty(duty);
+    pwm.setCycle(cycle);
+    pwm.setDuty(duty);
+    pwm.restart();
+    QVERIFY(pwm.isActive());
+
+    for(int j=0; j<3; j++)
+    {
+        unsigned int cnt = 0;
+        unsigned int toggles = 0;
+        bool last = pwm.getOut();
+        for(unsigned int i=0; i<cycle; i++)
+        {
+            if(pwm.getOut())
+            {
+                cnt++;
+            }
+            if(pwm.getOut() != last)
+            {
+                toggles++;
+            }
+            last = pwm.getOut();
+            pwm.nextSlot();
+        }
+        QCOMPARE(cnt, onCount);
+
+        //Never more than on and off in one cycle
+        QVERIFY(toggles <= 1);
+    }
+}
+
+/**
+ * A new duty is used first in the next cycle.
+ */
+void TestTimeProportional::test_dutyNextCycle()
+{
+    TimeProportional pwm;
+    pwm.setCycle(10);
+    pwm.setDuty(5);
+    pwm.restart();
+
+    //Slot 0..2 on
+    QCOMPARE(pwm.getOut(), true);
+    pwm.nextSlot();
+    pwm.nextSlot();
+    QCOMPARE(pwm.getOut(), true);
+
+    //Change in the middle, still 5 in this cycle
+    pwm.setDuty(2);
+    QCOMPARE(pwm.getDuty(), (uint16_t)5);
+    pwm.nextSlot();
+    pwm.nextSlot();
+    QCOMPARE(pwm.getOut(), true);
+    pwm.nextSlot();
+    QCOMPARE(pwm.getOut(), false);
+
+    //Walk to the next cycle
+    for(int i=5; i<10; i++)
+    {
+        pwm.nextSlot();
+    }
+    QCOMPARE(pwm.getDuty(), (uint16_t)2);
+    QCOMPARE(pwm.getOut(), true);
+    pwm.nextSlot();
+    QCOMPARE(pwm.getOut(), true);
+    pwm.nextSlot();
+    QCOMPARE(pwm.getOut(), false);
+}
+
+QTEST_MAIN(TestTimeProportional)
+#include "TestTimeProportional.moc"
@@ -63,6 +63,20 @@ void TestValueAvg::test_ValueAvg()
     //5+8+14=27/3=9
     QCOMPARE(9.0, filter.getValue());
 
+    //The min and max shall both be found,
+    //also when a value is both the first max and then the min is updated.
+    filter.init();
+
+    filter.addValue(14.0);
+    filter.addValue(400.0); //max value
+    filter.addValue(14.0);
+    filter.addValue(-2.0);  //min value
+    filter.addValue(13.0);
+    filter.addValue(14.0);
+    filter.addValue(15.0);
+
+    QCOMPARE(14.0, filter.getValue());
+
 }
 
 QTEST_MAIN(TestValueAvg)